@@ -1,8 +1,44 @@
+#define _DEFAULT_SOURCE
+
 #include <SDL2/SDL_timer.h>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdalign.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <threads.h>
 
+#include "tie/arclength.h"
+#include "tie/arrangement.h"
+#include "tie/autosave.h"
+#include "tie/bernstein.h"
+#include "tie/clip.h"
+#include "tie/closest.h"
+#include "tie/core.h"
+#include "tie/curve_fit.h"
+#include "tie/delaunay.h"
+#include "tie/depgraph.h"
 #include "tie/geometry.h"
+#include "tie/history.h"
+#include "tie/journal.h"
 #include "tie/math.h"
+#include "tie/memalloc.h"
+#include "tie/metrics.h"
+#include "tie/objectstore.h"
+#include "tie/objecttable.h"
+#include "tie/pager.h"
+#include "tie/predicates.h"
+#include "tie/random.h"
+#include "tie/rtree.h"
+#include "tie/simplify.h"
+#include "tie/stroke.h"
+#include "tie/tiefile.h"
+#include "tie/winding.h"
+#include "tie/workpool.h"
 
 #define MAP(macro, arg, ...) macro(arg) __VA_OPT__(MAP(macro, __VA_ARGS__))
 #define PRIM_CAT(x, ...) x##__VA_ARGS__
@@ -56,6 +92,2839 @@
 
 #define SZ (1 << 10)
 
+// Reports a failed check without stopping, so that a run shows all of them.
+#define check(cond)                                                            \
+        ((cond) ? (void)0                                                      \
+                : (void)(fprintf(stderr,                                       \
+                                 "%s:%d: check failed: %s\n",                  \
+                                 __FILE__,                                     \
+                                 __LINE__,                                     \
+                                 #cond),                                       \
+                         ++failures))
+
+static int failures = 0;
+
+// A random double in [0, 1).
+static double test_random(uint64_t *restrict seed)
+{
+        return (splitmix64(seed) >> 11) * 0x1p-53;
+}
+
+static int32_t test_winding(size_t count,
+                            const size_t offsets[static count + 1],
+                            const vec2d points[],
+                            const vec2d *restrict p)
+{
+        int32_t winding = 0;
+        size_t i;
+
+        for (i = 0; i < count; ++i) {
+                if (offsets[i + 1] > offsets[i]) {
+                        winding += winding_number(offsets[i + 1] - offsets[i],
+                                                  &points[offsets[i]],
+                                                  p);
+                }
+        }
+        return winding;
+}
+
+static void test_predicates(void)
+{
+        // points a few ulps off the line through q and r, where the rounded
+        // determinant is all noise
+        static const vec2d q = make_vec2d(12, 12), r = make_vec2d(24, 24);
+        // the unit circle far from the origin, where ulps are coarse
+        static const vec2d a = make_vec2d(0x1p20 + 1, 0x1p20),
+                           b = make_vec2d(0x1p20, 0x1p20 + 1),
+                           c = make_vec2d(0x1p20 - 1, 0x1p20);
+        vec2d p;
+        double s;
+        int i, j;
+
+        for (i = 0; i < 32; ++i) {
+                for (j = 0; j < 32; ++j) {
+                        vec_x(p) = 0.5 + i * 0x1p-53;
+                        vec_y(p) = 0.5 + j * 0x1p-53;
+                        s = orient2d(&p, &q, &r);
+                        check((s > 0) == (j > i) && (s < 0) == (j < i));
+                }
+        }
+        for (i = -8; i <= 8; ++i) {
+                vec_x(p) = 0x1p20;
+                vec_y(p) = 0x1p20 - 1 + i * 0x1p-32;
+                s = incircle(&a, &b, &c, &p);
+                check((s > 0) == (i > 0) && (s < 0) == (i < 0));
+        }
+}
+
+// The point of a bezier curve at `t`, where de_casteljau() leaves the right
+// split to start.
+static vec2d test_bezier_point(size_t n, const vec2d bezier[static n], double t)
+{
+        vec2d copy[OBJECT_MAX_CONTROL_POINTS];
+
+        memcpy(copy, bezier, n * sizeof(*copy));
+        de_casteljau(t, n, copy, NULL);
+
+        return copy[0];
+}
+
+static void test_bezier_bounds(void)
+{
+        vec2d bezier[OBJECT_MAX_CONTROL_POINTS], p;
+        aabb2d box, samples;
+        uint64_t seed = 3;
+        size_t n, i, j;
+
+        for (i = 0; i < 256; ++i) {
+                n = 1 + i % OBJECT_MAX_CONTROL_POINTS;
+                for (j = 0; j < n; ++j) {
+                        vec_x(bezier[j]) = test_random(&seed);
+                        vec_y(bezier[j]) = test_random(&seed);
+                }
+                bezier_bounds(n, bezier, &box);
+                empty_aabb2d(&samples);
+                for (j = 0; j <= 1024; ++j) {
+                        p = test_bezier_point(n, bezier, j / 1024.0);
+                        extend_aabb2d(&samples, &p);
+                }
+                // the box holds the curve, and is tight up to the sampling
+                // for the degrees it's found in closed form for
+                check(vec_x(box.min) <= vec_x(samples.min) + 0x1p-40
+                      && vec_y(box.min) <= vec_y(samples.min) + 0x1p-40
+                      && vec_x(box.max) >= vec_x(samples.max) - 0x1p-40
+                      && vec_y(box.max) >= vec_y(samples.max) - 0x1p-40);
+                check(n > 4
+                      || (vec_x(box.min) >= vec_x(samples.min) - 1e-5
+                          && vec_y(box.min) >= vec_y(samples.min) - 1e-5
+                          && vec_x(box.max) <= vec_x(samples.max) + 1e-5
+                          && vec_y(box.max) <= vec_y(samples.max) + 1e-5));
+        }
+}
+
+// Tests whether two segments cross at a point inside both of them.
+static bool test_segments_cross(const vec2d *a,
+                                const vec2d *b,
+                                const vec2d *c,
+                                const vec2d *d)
+{
+        return orient2d(a, b, c) * orient2d(a, b, d) < 0
+            && orient2d(c, d, a) * orient2d(c, d, b) < 0;
+}
+
+static void test_simplify(void)
+{
+        static vec2d polyline[512], out[array_size(polyline)];
+        static SimplifyRange stack[array_size(polyline)];
+        static SimplifyVertex aux[array_size(polyline)];
+        const vec2d *p, *q, *end;
+        size_t n = array_size(polyline), count, last_count, i, j;
+        double tolerance, area, dx, dy;
+        uint64_t seed = 4;
+        bool crossed;
+
+        // a jagged line strip that doesn't intersect itself
+        for (i = 0; i < n; ++i) {
+                vec_x(polyline[i]) = i + test_random(&seed) * 0.5;
+                vec_y(polyline[i]) = sin(i * 0.05) * 20
+                                   + test_random(&seed) * 4;
+        }
+
+        for (tolerance = 0.5; tolerance < 64; tolerance *= 2) {
+                end = polyline_simplify(
+                        n, polyline, out, stack, tolerance, true);
+                check(end - out >= 2 && end - out <= (ptrdiff_t)n);
+                check(!memcmp(&out[0], &polyline[0], sizeof(*out))
+                      && !memcmp(&end[-1], &polyline[n - 1], sizeof(*out)));
+                // the output is a part of the input, and every vertex that
+                // was dropped is close to the segment that replaced it
+                for (p = out, i = 0; p + 1 < end; ++p, i = j) {
+                        dx = vec_x(p[1]) - vec_x(p[0]);
+                        dy = vec_y(p[1]) - vec_y(p[0]);
+                        for (j = i + 1;
+                             j < n && memcmp(&polyline[j], p + 1, sizeof(*p));
+                             ++j) {
+                                check(fabs(dx * (vec_y(polyline[j])
+                                                 - vec_y(p[0]))
+                                           - dy * (vec_x(polyline[j])
+                                                   - vec_x(p[0])))
+                                      <= tolerance * sqrt(dx * dx + dy * dy)
+                                                 * (1 + 0x1p-40));
+                        }
+                        check(j < n);
+                }
+                crossed = false;
+                for (p = out; p + 1 < end; ++p) {
+                        for (q = p + 2; q + 1 < end; ++q) {
+                                crossed |= test_segments_cross(
+                                        p, p + 1, q, q + 1);
+                        }
+                }
+                check(!crossed);
+        }
+
+        // larger areas drop more vertices, but never the endpoints
+        last_count = n;
+        for (area = 0; area < 1024; area = area * 2 + 1) {
+                end = polyline_simplify_by_area(n, polyline, out, aux, area);
+                count = end - out;
+                check(count >= 2 && count <= last_count);
+                check(!memcmp(&out[0], &polyline[0], sizeof(*out))
+                      && !memcmp(&end[-1], &polyline[n - 1], sizeof(*out)));
+                last_count = count;
+        }
+        check(polyline_simplify_by_area(n, polyline, out, aux, 1e9) == out + 2);
+        for (i = 1; i < 3; ++i) {
+                check(polyline_simplify_by_area(i, polyline, out, aux, 1e9)
+                              == out + i
+                      && !memcmp(out, polyline, i * sizeof(*out)));
+        }
+}
+
+// The squared distance from a point to the closest of the points sampled
+// from a bezier curve.
+static double test_bezier_sqrdist(size_t n,
+                                  const vec2d bezier[static n],
+                                  const vec2d *q)
+{
+        double d = DBL_MAX;
+        vec2d p;
+        size_t i;
+
+        for (i = 0; i <= 1024; ++i) {
+                p = test_bezier_point(n, bezier, i / 1024.0);
+                sub_vec2d(&p, q);
+                d = min(d, sqrmag_vec2d(&p));
+        }
+
+        return d;
+}
+
+static void test_closest(void)
+{
+        static vec2d controls[8 * 4];
+        static size_t offsets[8 + 1];
+        static vec2d queries[64];
+        static ClosestPoint out[array_size(queries)];
+        vec2d aux[OBJECT_MAX_CONTROL_POINTS], p;
+        size_t curve, n, i;
+        uint64_t seed = 5;
+        ClosestPoint c;
+        double best;
+
+        offsets[0] = 0;
+        for (curve = 0; curve + 1 < array_size(offsets); ++curve) {
+                n = 2 + curve % 3;
+                offsets[curve + 1] = offsets[curve] + n;
+                for (i = offsets[curve]; i < offsets[curve + 1]; ++i) {
+                        vec_x(controls[i]) = 10 * test_random(&seed);
+                        vec_y(controls[i]) = 10 * test_random(&seed);
+                }
+        }
+        for (i = 0; i < array_size(queries); ++i) {
+                vec_x(queries[i]) = 12 * test_random(&seed) - 1;
+                vec_y(queries[i]) = 12 * test_random(&seed) - 1;
+        }
+
+        // the point found is on the curve and no further than any sample
+        for (curve = 0; curve + 1 < array_size(offsets); ++curve) {
+                n = offsets[curve + 1] - offsets[curve];
+                for (i = 0; i < array_size(queries); ++i) {
+                        bezier_closest_point(n,
+                                             &controls[offsets[curve]],
+                                             &queries[i],
+                                             aux,
+                                             &c);
+                        p = test_bezier_point(
+                                n, &controls[offsets[curve]], c.t);
+                        sub_vec2d(&p, &c.point);
+                        check(c.curve == 0 && c.t >= 0 && c.t <= 1
+                              && sqrmag_vec2d(&p) <= 1e-18);
+                        check(c.sqrdist
+                              <= test_bezier_sqrdist(n,
+                                                     &controls[offsets[curve]],
+                                                     &queries[i])
+                                         + 1e-12);
+                }
+        }
+
+        bezier_closest_points(array_size(offsets) - 1,
+                              offsets,
+                              controls,
+                              array_size(queries),
+                              queries,
+                              DBL_MAX,
+                              out,
+                              aux);
+        for (i = 0; i < array_size(queries); ++i) {
+                best = DBL_MAX;
+                for (curve = 0; curve + 1 < array_size(offsets); ++curve) {
+                        best = min(best,
+                                   test_bezier_sqrdist(
+                                           offsets[curve + 1] - offsets[curve],
+                                           &controls[offsets[curve]],
+                                           &queries[i]));
+                }
+                check(out[i].curve < array_size(offsets) - 1
+                      && out[i].sqrdist <= best + 1e-12);
+        }
+
+        // nothing is that close to a point far away
+        vec_x(queries[0]) = 100;
+        vec_y(queries[0]) = 100;
+        bezier_closest_points(array_size(offsets) - 1,
+                              offsets,
+                              controls,
+                              1,
+                              queries,
+                              1,
+                              out,
+                              aux);
+        check(out[0].curve == CLOSEST_NONE);
+}
+
+static void test_curve_fit(void)
+{
+        static CurveFitter fitter;
+        vec2d sample, *curve;
+        double t, best;
+        size_t i;
+
+        curve_fit_init(&fitter, 0.05, 1, tie_malloc(1, sizeof(vec2d)));
+        // a spiral, long enough to take several curves
+        for (i = 0; i < 1024; ++i) {
+                t = i * 0.02;
+                vec_x(sample) = cos(t) * (1 + t);
+                vec_y(sample) = sin(t) * (1 + t);
+                check(curve_fit_add(&fitter,
+                                    &sample,
+                                    auxiliary_reallocator,
+                                    NULL)
+                      == 0);
+        }
+        check(curve_fit_finish(&fitter, auxiliary_reallocator, NULL) == 0);
+        check(fitter.out_count > 4 && fitter.out_count % 3 == 1);
+        check(vec_x(fitter.out[0]) == 1 && vec_y(fitter.out[0]) == 0);
+        check(!memcmp(&fitter.out[fitter.out_count - 1],
+                      &sample,
+                      sizeof(sample)));
+
+        // every sample is within the error of some curve, up to the
+        // sampling of the curves
+        for (i = 0; i < 1024; ++i) {
+                t = i * 0.02;
+                vec_x(sample) = cos(t) * (1 + t);
+                vec_y(sample) = sin(t) * (1 + t);
+                best = DBL_MAX;
+                for (curve = fitter.out;
+                     curve + 3 < fitter.out + fitter.out_count;
+                     curve += 3) {
+                        best = min(best,
+                                   test_bezier_sqrdist(4, curve, &sample));
+                }
+                check(sqrt(best) <= 0.05 + 0.01);
+        }
+
+        tie_free(fitter.out);
+}
+
+static void test_bernstein(void)
+{
+        enum { N = 7 };
+        double roots[N - 1], power[N], b[N], c[N + 1], left[N], right[N];
+        double found[N - 1], aux[BERNSTEIN_ROOTS_AUX(N)], t[16], values[16];
+        double *end, s, value, slope, term;
+        uint64_t seed = 6;
+        size_t n, i, j, k;
+
+        for (i = 0; i < 64; ++i) {
+                n = 2 + i % (N - 1);
+                // roots spread out over (0, 1), in increasing order, and
+                // their product of (t - root) in the power basis
+                memset(power, 0, sizeof(power));
+                power[0] = 1;
+                for (j = 0; j + 1 < n; ++j) {
+                        roots[j] = (j + 0.1 + 0.8 * test_random(&seed))
+                                 / (n - 1);
+                        for (k = j + 1; k > 0; --k) {
+                                power[k] = power[k - 1] - roots[j] * power[k];
+                        }
+                        power[0] *= -roots[j];
+                }
+                bernstein_from_power(n, power, b);
+
+                end = bernstein_roots(n, b, found, aux);
+                check((size_t)(end - found) == n - 1);
+                for (j = 0; j + 1 < n && found + j < end; ++j) {
+                        check(fabs(found[j] - roots[j]) <= 1e-9);
+                }
+
+                for (j = 0; j < array_size(t); ++j) {
+                        t[j] = test_random(&seed);
+                }
+                bernstein_eval_many(n, b, array_size(t), t, values);
+                bernstein_derivative(n, b, c);
+                for (j = 0; j < array_size(t); ++j) {
+                        value = 1;
+                        slope = 0;
+                        for (k = 0; k + 1 < n; ++k) {
+                                slope = slope * (t[j] - roots[k]) + value;
+                                value *= t[j] - roots[k];
+                        }
+                        check(fabs(bernstein_eval(n, b, t[j]) - value)
+                              <= 1e-12);
+                        check(fabs(values[j] - value) <= 1e-12);
+                        check(fabs(bernstein_eval(n - 1, c, t[j]) - slope)
+                              <= 1e-10);
+                }
+
+                // elevating and reducing again changes nothing, and both
+                // halves of a split follow the polynomial
+                bernstein_elevate(n, b, c);
+                bernstein_reduce(n + 1, c, left);
+                for (j = 0; j < n; ++j) {
+                        check(fabs(left[j] - b[j]) <= 1e-12);
+                }
+                s = test_random(&seed);
+                bernstein_split(n, b, s, left, right);
+                for (j = 0; j < array_size(t); ++j) {
+                        term = bernstein_eval(n, b, s * t[j]);
+                        check(fabs(bernstein_eval(n, left, t[j]) - term)
+                              <= 1e-12);
+                        term = bernstein_eval(n, b, s + (1 - s) * t[j]);
+                        check(fabs(bernstein_eval(n, right, t[j]) - term)
+                              <= 1e-12);
+                }
+        }
+}
+
+static void test_arclength(void)
+{
+        // a straight line with evenly spaced control points, whose length
+        // grows linearly with the parameter, and a curvy cubic
+        static const vec2d line[] = {
+                { .v = { 0, 0 } }, { .v = { 1, 2 } }, { .v = { 2, 4 } },
+                { .v = { 3, 6 } },
+        };
+        static const vec2d curve[] = {
+                { .v = { 0, 0 } }, { .v = { 2, 3 } }, { .v = { -1, 3 } },
+                { .v = { 1, 0 } },
+        };
+        double params[9], length, total, l, t;
+        ArcLengthTable table;
+        vec2d p, q;
+        size_t i;
+
+        arclength_build(4, line, &table);
+        for (i = 0; i <= 8; ++i) {
+                t = i / 8.0;
+                check(fabs(arclength_length(4, line, &table, t)
+                           - t * sqrt(45))
+                      <= 1e-12);
+        }
+
+        // the curve against a fine polyline
+        arclength_build(4, curve, &table);
+        total = arclength_length(4, curve, &table, 1);
+        length = 0;
+        p = curve[0];
+        for (i = 1; i <= 1 << 14; ++i) {
+                q = test_bezier_point(4, curve, i / (double)(1 << 14));
+                sub_vec2d(&p, &q);
+                length += sqrt(sqrmag_vec2d(&p));
+                p = q;
+        }
+        check(fabs(total - length) <= 1e-6 * total);
+
+        for (i = 0; i <= 16; ++i) {
+                l = total * i / 16;
+                t = arclength_param(4, curve, &table, l);
+                check(t >= 0 && t <= 1
+                      && fabs(arclength_length(4, curve, &table, t) - l)
+                                 <= 1e-9 * total);
+        }
+        check(arclength_param(4, curve, &table, 2 * total) == 1);
+
+        arclength_uniform_params(
+                4, curve, &table, array_size(params), params);
+        check(params[0] == 0 && params[array_size(params) - 1] == 1);
+        for (i = 0; i < array_size(params); ++i) {
+                check(fabs(arclength_length(4, curve, &table, params[i])
+                           - total * i / (array_size(params) - 1))
+                      <= 1e-9 * total);
+        }
+}
+
+// The squared distance from a point to a segment.
+static double test_segment_sqrdist(const vec2d *p,
+                                   const vec2d *a,
+                                   const vec2d *b)
+{
+        vec2d ab = *b, ap = *p;
+        double t = 0;
+
+        sub_vec2d(&ab, a);
+        sub_vec2d(&ap, a);
+        if (dot_vec2d(&ab, &ab) > 0) {
+                t = dot_vec2d(&ap, &ab) / dot_vec2d(&ab, &ab);
+                t = min(max(t, 0), 1);
+        }
+        scale_vec2d(&ab, t);
+        sub_vec2d(&ap, &ab);
+
+        return sqrmag_vec2d(&ap);
+}
+
+// Tests whether a point is covered by one of the triangles of the buffers,
+// which may be of either orientation.
+static bool test_stroke_covers(const StrokeBuffers *restrict buffers,
+                               const vec2d *p)
+{
+        const uint32_t *i;
+        const vec2d *v = buffers->vertices;
+        double a, b, c;
+
+        for (i = buffers->indices; i < buffers->indices + buffers->index_count;
+             i += 3) {
+                a = orient2d(&v[i[0]], &v[i[1]], p);
+                b = orient2d(&v[i[1]], &v[i[2]], p);
+                c = orient2d(&v[i[2]], &v[i[0]], p);
+                if ((a >= 0 && b >= 0 && c >= 0)
+                    || (a <= 0 && b <= 0 && c <= 0)) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+static void test_stroke(void)
+{
+        static const vec2d zigzag[] = {
+                { .v = { 0, 0 } }, { .v = { 4, 0 } }, { .v = { 4, 0 } },
+                { .v = { 1, 3 } }, { .v = { 6, 3 } }, { .v = { 6.5, -1 } },
+        };
+        static const vec2d segment[] = { { .v = { 0, 0 } },
+                                         { .v = { 3, 4 } } };
+        StrokeStyle style = { .width = 0.5,
+                              .miter_limit = 4,
+                              .tolerance = 1e-3 };
+        StrokeBuffers buffers;
+        const uint32_t *i;
+        uint64_t seed = 7;
+        size_t j, k, vertex_count, index_count;
+        double d, reach, near, area;
+        vec2d p, e1, e2;
+
+        stroke_buffers_init(&buffers);
+        for (style.join = STROKE_JOIN_MITER; style.join <= STROKE_JOIN_BEVEL;
+             ++style.join) {
+                for (style.cap = STROKE_CAP_BUTT;
+                     style.cap <= STROKE_CAP_SQUARE;
+                     ++style.cap) {
+                        stroke_buffers_clear(&buffers);
+                        check(stroke_polyline(array_size(zigzag),
+                                              zigzag,
+                                              &style,
+                                              &buffers,
+                                              auxiliary_reallocator,
+                                              NULL)
+                              == 0);
+                        check(buffers.index_count > 0
+                              && buffers.index_count % 3 == 0);
+                        traverse(i,
+                                 buffers.indices,
+                                 buffers.indices + buffers.index_count) {
+                                check(*i < buffers.vertex_count);
+                        }
+
+                        // nothing reaches further than a miter or a square
+                        // cap, and points close to the line strip are
+                        // covered
+                        reach = style.join == STROKE_JOIN_MITER
+                                      ? style.miter_limit * style.width / 2
+                                      : style.width / 2 * sqrt(2);
+                        // bevels cut the outside of the sharpest joins,
+                        // which turn by 135 degrees, down to cos(67.5) of
+                        // the half width
+                        near = style.width / 2
+                             * (style.join == STROKE_JOIN_BEVEL ? 0.35 : 0.9);
+                        for (j = 0; j < buffers.vertex_count; ++j) {
+                                d = DBL_MAX;
+                                for (k = 0; k + 1 < array_size(zigzag); ++k) {
+                                        d = min(d,
+                                                test_segment_sqrdist(
+                                                        &buffers.vertices[j],
+                                                        &zigzag[k],
+                                                        &zigzag[k + 1]));
+                                }
+                                check(sqrt(d) <= reach + 1e-9);
+                        }
+                        for (j = 0; j < 256; ++j) {
+                                k = splitmix64(&seed)
+                                  % (array_size(zigzag) - 1);
+                                p = zigzag[k + 1];
+                                sub_vec2d(&p, &zigzag[k]);
+                                scale_vec2d(&p, test_random(&seed));
+                                add_vec2d(&p, &zigzag[k]);
+                                vec_x(p) += (test_random(&seed) - 0.5) * 0.3;
+                                vec_y(p) += (test_random(&seed) - 0.5) * 0.3;
+                                d = DBL_MAX;
+                                for (k = 0; k + 1 < array_size(zigzag); ++k) {
+                                        d = min(d,
+                                                test_segment_sqrdist(
+                                                        &p,
+                                                        &zigzag[k],
+                                                        &zigzag[k + 1]));
+                                }
+                                // away from the butt caps at the ends
+                                if (sqrt(d) < near
+                                    && vec_x(p) > 0.3 && vec_y(p) > -0.9) {
+                                        check(test_stroke_covers(&buffers,
+                                                                 &p));
+                                }
+                        }
+                }
+        }
+
+        // a single segment with butt caps is a rectangle
+        style.cap = STROKE_CAP_BUTT;
+        stroke_buffers_clear(&buffers);
+        check(stroke_polyline(2,
+                              segment,
+                              &style,
+                              &buffers,
+                              auxiliary_reallocator,
+                              NULL)
+              == 0);
+        area = 0;
+        for (i = buffers.indices; i < buffers.indices + buffers.index_count;
+             i += 3) {
+                e1 = buffers.vertices[i[1]];
+                e2 = buffers.vertices[i[2]];
+                sub_vec2d(&e1, &buffers.vertices[i[0]]);
+                sub_vec2d(&e2, &buffers.vertices[i[0]]);
+                area += fabs(cross_vec2d(&e1, &e2)) / 2;
+        }
+        check(fabs(area - 5 * style.width) <= 1e-12);
+
+        // a single point is a dot with round caps only
+        stroke_buffers_clear(&buffers);
+        check(stroke_polyline(1,
+                              segment,
+                              &style,
+                              &buffers,
+                              auxiliary_reallocator,
+                              NULL)
+              == 0);
+        check(buffers.index_count == 0);
+        style.cap = STROKE_CAP_ROUND;
+        check(stroke_polyline(1,
+                              segment,
+                              &style,
+                              &buffers,
+                              auxiliary_reallocator,
+                              NULL)
+              == 0);
+        check(buffers.index_count > 0 && test_stroke_covers(&buffers, segment));
+
+        // curves are covered along their length
+        stroke_buffers_clear(&buffers);
+        check(stroke_bezier(array_size(zigzag),
+                            zigzag,
+                            &style,
+                            &buffers,
+                            auxiliary_reallocator,
+                            NULL)
+              == 0);
+        for (j = 0; j <= 16; ++j) {
+                p = test_bezier_point(array_size(zigzag), zigzag, j / 16.0);
+                check(test_stroke_covers(&buffers, &p));
+        }
+
+        // without room, nothing is appended
+        vertex_count = buffers.vertex_count;
+        index_count = buffers.index_count;
+        check(stroke_polyline(array_size(zigzag),
+                              zigzag,
+                              &style,
+                              &buffers,
+                              NULL,
+                              NULL)
+              == -1);
+        check(buffers.vertex_count == vertex_count
+              && buffers.index_count == index_count);
+
+        tie_free(buffers.vertices);
+        tie_free(buffers.indices);
+        tie_free(buffers.points);
+        tie_free(buffers.aux);
+}
+
+// Connects two vertices of an arrangement with a line.
+static uint32_t test_arrangement_line(Arrangement *restrict arr,
+                                      uint32_t u,
+                                      uint32_t v)
+{
+        const vec2d line[] = { arr->vertices[u].position,
+                               arr->vertices[v].position };
+
+        return arrangement_add_edge(
+                arr, u, v, 2, line, 0, auxiliary_reallocator, NULL);
+}
+
+// The face of an arrangement containing a point.
+static uint32_t test_arrangement_locate(const Arrangement *restrict arr,
+                                        double x,
+                                        double y)
+{
+        const vec2d p = make_vec2d(x, y);
+
+        return arrangement_locate(arr, &p);
+}
+
+// The area of the outer boundary of the face containing a point.
+static double test_arrangement_area(const Arrangement *restrict arr,
+                                    double x,
+                                    double y)
+{
+        uint32_t face = test_arrangement_locate(arr, x, y);
+
+        return face == ARRANGEMENT_UNBOUNDED
+                     ? 0
+                     : arrangement_cycle_area(arr, arr->faces[face].outer);
+}
+
+static void test_arrangement(void)
+{
+        static const vec2d corners[] = {
+                { .v = { 0, 0 } },       { .v = { 2, 0 } },
+                { .v = { 2, 2 } },       { .v = { 0, 2 } },
+                { .v = { 0.25, 0.25 } }, { .v = { 0.75, 0.25 } },
+                { .v = { 0.75, 0.75 } }, { .v = { 0.25, 0.75 } },
+        };
+        const vec2d bulge[] = { corners[1], make_vec2d(3, 1), corners[2] };
+        uint32_t v[array_size(corners)], bottom, top, middle, i;
+        Arrangement arr;
+
+        arrangement_init(&arr, 1, tie_malloc(1, sizeof(ArrangementFace)));
+        for (i = 0; i < array_size(corners); ++i) {
+                v[i] = arrangement_add_vertex(&arr,
+                                              &corners[i],
+                                              auxiliary_reallocator,
+                                              NULL);
+                check(v[i] == i);
+        }
+
+        // a square
+        for (i = 0; i < 4; ++i) {
+                check(test_arrangement_line(&arr, v[i], v[(i + 1) % 4])
+                      != ARRANGEMENT_NIL);
+        }
+        check(fabs(test_arrangement_area(&arr, 1, 1) - 4) <= 1e-12);
+        check(test_arrangement_area(&arr, 3, 3) == 0);
+
+        // cut in halves through points split off its sides
+        bottom = arrangement_split_edge(
+                &arr, 0, 0.5, auxiliary_reallocator, NULL);
+        top = arrangement_split_edge(&arr, 2, 0.5, auxiliary_reallocator, NULL);
+        check(bottom != ARRANGEMENT_NIL && top != ARRANGEMENT_NIL);
+        middle = test_arrangement_line(&arr, bottom, top);
+        check(middle != ARRANGEMENT_NIL);
+        check(fabs(test_arrangement_area(&arr, 0.5, 1) - 2) <= 1e-12
+              && fabs(test_arrangement_area(&arr, 1.5, 1) - 2) <= 1e-12);
+        check(test_arrangement_locate(&arr, 0.5, 1)
+              != test_arrangement_locate(&arr, 1.5, 1));
+
+        // a hole in the left half
+        for (i = 4; i < 8; ++i) {
+                check(test_arrangement_line(&arr, v[i], v[4 + (i + 1) % 4])
+                      != ARRANGEMENT_NIL);
+        }
+        check(fabs(test_arrangement_area(&arr, 0.5, 0.5) - 0.25) <= 1e-12);
+        i = test_arrangement_locate(&arr, 0.5, 1.5);
+        check(arr.faces[i].hole != ARRANGEMENT_NIL);
+
+        // the halves merge again, hole and all
+        arrangement_remove_edge(&arr, middle / 2);
+        check(fabs(test_arrangement_area(&arr, 0.5, 1.5) - 4) <= 1e-12);
+        check(test_arrangement_locate(&arr, 1.5, 1) == i
+              && arr.faces[i].hole != ARRANGEMENT_NIL);
+        check(fabs(test_arrangement_area(&arr, 0.5, 0.5) - 0.25) <= 1e-12);
+
+        // a curve bounds a face of its own
+        check(arrangement_add_edge(&arr,
+                                   v[1],
+                                   v[2],
+                                   array_size(bulge),
+                                   bulge,
+                                   0,
+                                   auxiliary_reallocator,
+                                   NULL)
+              != ARRANGEMENT_NIL);
+        check(fabs(test_arrangement_area(&arr, 2.25, 1) - 2 / 3.0) <= 1e-2);
+        check(fabs(test_arrangement_area(&arr, 1.5, 1) - 4) <= 1e-12);
+
+        tie_free(arr.vertices);
+        tie_free(arr.edges);
+        tie_free(arr.faces);
+}
+
+static void test_metrics(void)
+{
+        // a rectangle far from the origin, the same one clockwise, a circle
+        // further away still and a lone point
+        static vec2d points[4 + 4 + 1024 + 1];
+        static const size_t offsets[] = { 0, 4, 8, 8 + 1024, 8 + 1024 + 1 };
+        PolygonMetrics out[array_size(offsets) - 1];
+        const double x = 1e8, y = -3e8, w = 3, h = 2, r = 5, c = 1e9;
+        const double pi = acos(-1);
+        double area = 0, t;
+        size_t i;
+
+        points[0] = (vec2d){ .v = { x, y } };
+        points[1] = (vec2d){ .v = { x + w, y } };
+        points[2] = (vec2d){ .v = { x + w, y + h } };
+        points[3] = (vec2d){ .v = { x, y + h } };
+        for (i = 0; i < 4; ++i) {
+                points[4 + i] = points[3 - i];
+        }
+        for (i = 0; i < 1024; ++i) {
+                t = 2 * pi * i / 1024;
+                vec_x(points[8 + i]) = c + r * cos(t);
+                vec_y(points[8 + i]) = c + r * sin(t);
+        }
+        // the same polygon at the origin, where moving it is exact
+        for (i = 0; i < 1024; ++i) {
+                area += ((vec_x(points[8 + i]) - c)
+                                 * (vec_y(points[8 + (i + 1) % 1024]) - c)
+                         - (vec_x(points[8 + (i + 1) % 1024]) - c)
+                                   * (vec_y(points[8 + i]) - c))
+                      / 2;
+        }
+        points[8 + 1024] = (vec2d){ .v = { x, y } };
+
+        polygon_metrics(array_size(out), offsets, points, out);
+        check(out[0].area == w * h && out[1].area == -w * h);
+        for (i = 0; i < 2; ++i) {
+                check(out[i].perimeter == 2 * (w + h));
+                check(vec_x(out[i].centroid) == x + w / 2
+                      && vec_y(out[i].centroid) == y + h / 2);
+                check(fabs(out[i].ixx - w * h * h * h / 12) <= 1e-12
+                      && fabs(out[i].iyy - h * w * w * w / 12) <= 1e-12
+                      && fabs(out[i].ixy) <= 1e-12);
+        }
+        check(fabs(out[2].area - area) <= 1e-12 * area);
+        check(fabs(vec_x(out[2].centroid) - c) <= 1e-6
+              && fabs(vec_y(out[2].centroid) - c) <= 1e-6);
+        check(fabs(out[2].ixx - out[2].iyy) <= 1e-9 * out[2].ixx
+              && fabs(out[2].ixx - pi * r * r * r * r / 4)
+                         <= 1e-3 * out[2].ixx);
+        check(out[3].area == 0 && out[3].perimeter == 0
+              && vec_x(out[3].centroid) == x && vec_y(out[3].centroid) == y);
+}
+
+PURE_FUNC static inline bool test_delaunay_live(const DelaunayVertex *v)
+{
+        return v->triangle != DELAUNAY_NIL && v->triangle != DELAUNAY_PENDING;
+}
+
+// Checks that the triangles of a triangulation fit together and that no
+// vertex lies inside the circumcircle of a triangle.
+static void test_delaunay_check(const Delaunay *restrict d)
+{
+        const DelaunayVertex *v, *vertices = d->vertices;
+        const DelaunayTriangle *t, *n, *triangles = d->triangles;
+        uint32_t count = d->triangle_count, i, j;
+
+        traverse(v, vertices, vertices + d->vertex_count) {
+                if (!test_delaunay_live(v)) {
+                        continue;
+                }
+                check(v->triangle < count);
+                t = &triangles[v->triangle % count];
+                j = v - vertices;
+                check(t->vertex[0] == j || t->vertex[1] == j
+                      || t->vertex[2] == j);
+        }
+
+        traverse(t, triangles, triangles + count) {
+                if (t->vertex[0] == DELAUNAY_NIL) {
+                        continue;
+                }
+                j = t - triangles;
+                for (i = 0; i < 3; ++i) {
+                        check(t->neighbor[i] < count);
+                        n = &triangles[t->neighbor[i] % count];
+                        check(n->vertex[0] != DELAUNAY_NIL
+                              && (n->neighbor[0] == j || n->neighbor[1] == j
+                                  || n->neighbor[2] == j));
+                }
+                if (delaunay_is_ghost(t)) {
+                        continue;
+                }
+
+                check(orient2d(&vertices[t->vertex[0]].position,
+                               &vertices[t->vertex[1]].position,
+                               &vertices[t->vertex[2]].position)
+                      > 0);
+                traverse(v, vertices, vertices + d->vertex_count) {
+                        i = v - vertices;
+                        if (!test_delaunay_live(v) || i == t->vertex[0]
+                            || i == t->vertex[1] || i == t->vertex[2]) {
+                                continue;
+                        }
+                        check(incircle(&vertices[t->vertex[0]].position,
+                                       &vertices[t->vertex[1]].position,
+                                       &vertices[t->vertex[2]].position,
+                                       &v->position)
+                              <= 0);
+                }
+        }
+}
+
+static void test_delaunay(void)
+{
+        static vec2d points[192];
+        static uint32_t ids[array_size(points)];
+        uint64_t seed = 3;
+        uint32_t id;
+        Delaunay d;
+        vec2d p;
+        size_t i;
+
+        delaunay_init(&d);
+        // a line first, which stays pending until the grid arrives
+        for (i = 0; i < 8; ++i) {
+                vec_x(p) = i * 12.5;
+                vec_y(p) = i * 12.5;
+                check(delaunay_insert(&d, &p, auxiliary_reallocator, NULL)
+                      != DELAUNAY_NIL);
+        }
+        // a grid, whose points are cocircular four at a time
+        for (i = 0; i < 64; ++i) {
+                vec_x(p) = i % 8 * 12.5;
+                vec_y(p) = i / 8 * 12.5;
+                id = delaunay_insert(&d, &p, auxiliary_reallocator, NULL);
+                check(id != DELAUNAY_NIL);
+                check(i % 9 != 0 || id == i / 9);
+        }
+        test_delaunay_check(&d);
+
+        for (i = 0; i < array_size(points); ++i) {
+                vec_x(points[i]) = 100 * test_random(&seed);
+                vec_y(points[i]) = 100 * test_random(&seed);
+        }
+        check(delaunay_insert_points(&d,
+                                     array_size(points),
+                                     points,
+                                     ids,
+                                     auxiliary_reallocator,
+                                     NULL)
+              == 0);
+        test_delaunay_check(&d);
+
+        // half of the random points, then every other vertex left
+        for (i = 0; i < array_size(points); i += 2) {
+                check(delaunay_remove(&d, ids[i], auxiliary_reallocator, NULL)
+                      == 0);
+                check(d.vertices[ids[i]].triangle == DELAUNAY_NIL);
+        }
+        for (i = 0; i < d.vertex_count; i += 2) {
+                if (d.vertices[i].triangle != DELAUNAY_NIL) {
+                        check(delaunay_remove(
+                                      &d, i, auxiliary_reallocator, NULL)
+                              == 0);
+                }
+        }
+        test_delaunay_check(&d);
+
+        tie_free(d.vertices);
+        tie_free(d.triangles);
+        tie_free(d.scratch);
+}
+
+// Discretizes the curve of test_discretize_view() through a view scaling it
+// by `scale`, seeing the part of it in (-visible, visible)^2 on screen, and
+// returns the amount of points.
+static size_t test_discretize_view(double scale,
+                                   double visible,
+                                   double error,
+                                   size_t *restrict out_sz,
+                                   vec2d *restrict *restrict out,
+                                   size_t *restrict aux_sz,
+                                   vec2d *restrict *restrict aux)
+{
+        static const vec2d bezier[] = {
+                { .v = { 0, 0 } },
+                { .v = { 0.1, 1 } },
+                { .v = { 1, -0.5 } },
+                { .v = { 1, 1 } },
+        };
+        const View view = {
+                .matrix = { .cols = { make_vec2d(scale, 0),
+                                      make_vec2d(0, scale) } },
+                .offset = make_vec2d(0, 0),
+                .viewport = { .min = make_vec2d(-visible, -visible),
+                              .max = make_vec2d(visible, visible) },
+        };
+        vec2d *end = bezier_discretize_view(array_size(bezier),
+                                            bezier,
+                                            &view,
+                                            out_sz,
+                                            out,
+                                            aux_sz,
+                                            aux,
+                                            error,
+                                            auxiliary_reallocator,
+                                            NULL);
+        const vec2d *p;
+        vec2d q;
+        double d;
+        size_t i;
+
+        check(end != NULL);
+        if (!end) {
+                return 0;
+        }
+        check(!memcmp(&(*out)[0], &bezier[0], sizeof(*bezier))
+              && !memcmp(&end[-1], &bezier[3], sizeof(*bezier)));
+
+        // the curve stays within the error on screen of the line strip
+        // where it's visible
+        for (i = 0; i <= 256 && scale > 0; ++i) {
+                q = test_bezier_point(array_size(bezier), bezier, i / 256.0);
+                if (fabs(vec_x(q)) * scale >= visible
+                    || fabs(vec_y(q)) * scale >= visible) {
+                        continue;
+                }
+                d = DBL_MAX;
+                for (p = *out; p + 1 < end; ++p) {
+                        d = min(d, test_segment_sqrdist(&q, p, p + 1));
+                }
+                check(sqrt(d) * scale <= error * (1 + 1e-9));
+        }
+
+        return end - *out;
+}
+
+static void test_discretize(void)
+{
+        static const vec2d bezier[] = {
+                { .v = { 0, 0 } },
+                { .v = { 0.1, 1 } },
+                { .v = { 1, -0.5 } },
+                { .v = { 1, 1 } },
+        };
+        size_t out_sz = 1, aux_sz = 4, zoomed_out, zoomed_in, partial;
+        vec2d *out = tie_malloc(out_sz, sizeof(*out));
+        vec2d *aux = tie_malloc(aux_sz, sizeof(*aux));
+
+        zoomed_out = test_discretize_view(
+                10, 10, 0.5, &out_sz, &out, &aux_sz, &aux);
+        zoomed_in = test_discretize_view(
+                1000, 1000, 0.5, &out_sz, &out, &aux_sz, &aux);
+        partial = test_discretize_view(
+                1000, 250, 0.5, &out_sz, &out, &aux_sz, &aux);
+        check(zoomed_out < zoomed_in && partial < zoomed_in);
+
+        // nothing to refine out of sight or in a view collapsing everything
+        check(test_discretize_view(
+                      1000, -1, 0.5, &out_sz, &out, &aux_sz, &aux)
+              == 2);
+        check(test_discretize_view(0, 10, 0.5, &out_sz, &out, &aux_sz, &aux)
+              == 2);
+
+        // the error of a view that changes nothing is in document units
+        check(test_discretize_view(1, 10, 1e-3, &out_sz, &out, &aux_sz, &aux)
+              == (size_t)(bezier_discretize(array_size(bezier),
+                                            bezier,
+                                            &out_sz,
+                                            &out,
+                                            &aux_sz,
+                                            &aux,
+                                            1e-3,
+                                            auxiliary_reallocator,
+                                            NULL)
+                          - out));
+
+        tie_free(out);
+        tie_free(aux);
+}
+
+// Sets a few random objects of a version in a new edit: points, and lines
+// between random slots.
+static void test_store_edit(ObjectStore *restrict store,
+                            ObjectVersion *restrict version,
+                            uint64_t *restrict seed,
+                            Reallocator *reallocator,
+                            void *user)
+{
+        ObjectID id, children[2];
+        Object value;
+        int i;
+
+        object_store_begin(store);
+        for (i = 0; i < 4; ++i) {
+                // a new slot now and then
+                id.index = splitmix64(seed) % min(version->count + 1, 64);
+                id.generation = splitmix64(seed) % 4;
+                children[0] = (ObjectID){ .index = splitmix64(seed) % 64 };
+                children[1] = (ObjectID){ .index = splitmix64(seed) % 64 };
+                value = (Object){ .type = splitmix64(seed) % 2 ? LINE : POINT };
+                if (value.type == LINE) {
+                        value.child_count = 2;
+                        value.children.address = children;
+                }
+                vec_x(value.transform.position) = splitmix64(seed) % 1000;
+                check(object_store_set(
+                              store, version, id, &value, reallocator, user)
+                      == 0);
+        }
+}
+
+// Checks that a version of a store holds the same objects as one of
+// another store.
+static void test_store_compare(const ObjectStore *restrict expected,
+                               ObjectVersion expected_version,
+                               const ObjectStore *restrict store,
+                               ObjectVersion version)
+{
+        const Object *p, *q;
+        uint32_t i, j;
+
+        check(version.count == expected_version.count);
+        for (i = 0; i < min(version.count, expected_version.count); ++i) {
+                p = object_store_get(expected, expected_version, i);
+                q = object_store_get(store, version, i);
+                check(p->type == q->type && p->child_count == q->child_count
+                      && vec_x(p->transform.position)
+                                 == vec_x(q->transform.position)
+                      && expected->generations[object_store_locate(
+                                 expected, expected_version, i)]
+                                 == store->generations[object_store_locate(
+                                         store, version, i)]);
+                for (j = 0; j < min(p->child_count, q->child_count); ++j) {
+                        check(object_store_children(expected, p)[j].index
+                              == object_store_children(store, q)[j].index);
+                }
+        }
+}
+
+static void test_store_free(ObjectStore *restrict store)
+{
+        tie_free(store->nodes);
+        tie_free(store->objects);
+        tie_free(store->generations);
+        tie_free(store->links);
+        tie_free(store->checks);
+}
+
+// Adds an empty linear history, branching off a parent after some of its
+// entries.
+static uint32_t test_history_branch(History *restrict history,
+                                    uint32_t parent,
+                                    uint64_t offset)
+{
+        LinearHistory *linear;
+
+        if (history_reserve(history,
+                            history->size + 1,
+                            history->tree_size + 1,
+                            auxiliary_reallocator,
+                            NULL)) {
+                abort();
+        }
+        linear = history->tree.address + history->tree_size;
+        linear->size = 0;
+        linear->entries.address = history->entries.address + history->size;
+        linear->offset = offset;
+        linear->parent = parent;
+
+        return history->tree_size++;
+}
+
+// Appends an entry to the last linear history and makes it the current one.
+static uint64_t test_history_append(History *restrict history,
+                                    const vec2d *restrict cursor,
+                                    ObjectVersion objects)
+{
+        HistoryEntry *entry;
+
+        if (history_reserve(history,
+                            history->size + 1,
+                            history->tree_size,
+                            auxiliary_reallocator,
+                            NULL)) {
+                abort();
+        }
+        entry = history->entries.address + history->size;
+        entry->cursor_position = *cursor;
+        entry->objects = objects;
+        entry->selection_stack = 0;
+        ++history->tree.address[history->tree_size - 1].size;
+        history->current_entry = history->size;
+
+        return history->size++;
+}
+
+// Grows a history by random entries and branches, each entry editing the
+// objects of the current one, recording them in a journal if there's one.
+static void test_history_grow(History *restrict history,
+                              ObjectStore *restrict store,
+                              uint64_t n,
+                              Journal *restrict journal,
+                              uint64_t *restrict seed)
+{
+        const LinearHistory *tree;
+        ObjectVersion objects;
+        uint64_t entry, offset;
+        uint32_t parent;
+        vec2d cursor;
+
+        while (n-- > 0) {
+                tree = history->tree.address;
+                if (history->tree_size == 0 || splitmix64(seed) % 8 == 0) {
+                        parent = history->tree_size > 0
+                                       ? splitmix64(seed) % history->tree_size
+                                       : 0;
+                        offset = history->tree_size > 0
+                                       ? splitmix64(seed)
+                                                 % (tree[parent].size + 1)
+                                       : 0;
+                        test_history_branch(history, parent, offset);
+                        check(!journal
+                              || journal_append_tree(journal,
+                                                     history,
+                                                     history->tree_size - 1)
+                                         == TIEFILE_OK);
+                }
+                if (history->size > 0 && splitmix64(seed) % 8 == 0) {
+                        history->current_entry =
+                                splitmix64(seed) % history->size;
+                        check(!journal
+                              || journal_append_current(journal,
+                                                        history->current_entry)
+                                         == TIEFILE_OK);
+                }
+                objects = history->size > 0
+                                ? history->entries
+                                          .address[history->current_entry]
+                                          .objects
+                                : OBJECT_VERSION_EMPTY;
+                test_store_edit(
+                        store, &objects, seed, auxiliary_reallocator, NULL);
+                vec_x(cursor) = test_random(seed);
+                vec_y(cursor) = test_random(seed);
+                entry = test_history_append(history, &cursor, objects);
+                check(!journal
+                      || journal_append_entry(journal,
+                                              history->tree_size - 1,
+                                              history->entries.address + entry,
+                                              store)
+                                 == TIEFILE_OK);
+        }
+}
+
+static void test_history_compare(const History *restrict expected,
+                                 const History *restrict history)
+{
+        const LinearHistory *a, *b;
+        const HistoryEntry *p, *q;
+        uint64_t i;
+
+        check(history->size == expected->size
+              && history->tree_size == expected->tree_size
+              && history->current_entry == expected->current_entry);
+        for (i = 0; i < min(history->tree_size, expected->tree_size); ++i) {
+                a = expected->tree.address + i;
+                b = history->tree.address + i;
+                check(a->size == b->size && a->offset == b->offset
+                      && a->parent == b->parent
+                      && a->entries.address - expected->entries.address
+                                 == b->entries.address
+                                            - history->entries.address);
+        }
+        for (i = 0; i < min(history->size, expected->size); ++i) {
+                p = expected->entries.address + i;
+                q = history->entries.address + i;
+                check(vec_x(p->cursor_position) == vec_x(q->cursor_position)
+                      && vec_y(p->cursor_position) == vec_y(q->cursor_position)
+                      && p->selection_stack == q->selection_stack);
+        }
+}
+
+static long test_file_size(const char *path)
+{
+        FILE *file = fopen(path, "rb");
+        long size = -1;
+
+        if (file) {
+                if (!fseek(file, 0, SEEK_END)) {
+                        size = ftell(file);
+                }
+                fclose(file);
+        }
+
+        return size;
+}
+
+// Overwrites bytes of a file, like a stray write.
+static bool test_file_patch(const char *path,
+                            long offset,
+                            const void *bytes,
+                            size_t size)
+{
+        FILE *file = fopen(path, "r+b");
+        bool ok;
+
+        if (!file) {
+                return false;
+        }
+        ok = !fseek(file, offset, SEEK_SET)
+          && fwrite(bytes, 1, size, file) == size;
+
+        return fclose(file) == 0 && ok;
+}
+
+// Cuts a file short, like a crash in the middle of a write.
+static bool test_file_truncate(const char *path, long size)
+{
+        unsigned char *bytes = tie_malloc(size, 1);
+        bool ok = false;
+        FILE *file;
+
+        if (bytes && (file = fopen(path, "rb"))) {
+                ok = fread(bytes, 1, size, file) == (size_t)size;
+                fclose(file);
+        }
+        if (ok && (file = fopen(path, "wb"))) {
+                ok = fwrite(bytes, 1, size, file) == (size_t)size;
+                ok &= fclose(file) == 0;
+        }
+        tie_free(bytes);
+
+        return ok;
+}
+
+static void test_tiefile(void)
+{
+        static const char path[] = "tie-test.tie";
+        static const char spill[] = "tie-test.spill";
+        static const uint8_t garbage = 0;
+        ObjectStore store, loaded_store;
+        History history, loaded;
+        ObjectVersion version;
+        TieFileHeader header;
+        HistoryPager pager;
+        uint64_t seed = 8, i;
+        uint32_t line;
+        Object object;
+        TieFile file;
+        FILE *stream;
+        long size;
+
+        history_init(&history);
+        object_store_init(&store);
+        test_history_grow(&history, &store, 128, NULL, &seed);
+        check(tiefile_save(path, &history, &store, NULL, NULL) == TIEFILE_OK);
+        size = test_file_size(path);
+
+        // every entry comes back with its objects, which may then be edited
+        check(tiefile_open(&file, path) == TIEFILE_OK);
+        check(history_pager_open(&pager, spill, 1 << 20, 1 << 24)
+              == TIEFILE_OK);
+        history_init(&loaded);
+        object_store_init(&loaded_store);
+        check(tiefile_load(&file, &loaded, &loaded_store, &pager)
+              == TIEFILE_OK);
+        tiefile_close(&file);
+        test_history_compare(&history, &loaded);
+        for (i = 0; i < min(history.size, loaded.size); ++i) {
+                version = loaded.entries.address[i].objects;
+                check(object_store_check(&loaded_store, version) == 0);
+                test_store_compare(&store,
+                                   history.entries.address[i].objects,
+                                   &loaded_store,
+                                   version);
+        }
+        version = loaded.entries.address[loaded.current_entry].objects;
+        test_store_edit(&loaded_store,
+                        &version,
+                        &seed,
+                        history_pager_reallocator,
+                        &pager);
+        test_store_compare(&store,
+                           history.entries.address[history.current_entry]
+                                   .objects,
+                           &loaded_store,
+                           loaded.entries.address[loaded.current_entry]
+                                   .objects);
+        history_pager_close(&pager);
+
+        // a line of the current entry with a third endpoint is caught
+        stream = fopen(path, "rb");
+        check(stream && fread(&header, sizeof(header), 1, stream) == 1);
+        if (stream) {
+                fclose(stream);
+        }
+        version = history.entries.address[history.current_entry].objects;
+        for (line = 0; line < version.count
+                       && object_store_get(&store, version, line)->type != LINE;
+             ++line) {
+        }
+        check(line < version.count);
+        if (line < version.count) {
+                object = *object_store_get(&store, version, line);
+                object.child_count = 3;
+                check(test_file_patch(
+                        path,
+                        header.objects.objects.offset
+                                + object_store_locate(&store, version, line)
+                                          * sizeof(object),
+                        &object,
+                        sizeof(object)));
+                check(tiefile_open(&file, path) == TIEFILE_OK);
+                check(history_pager_open(&pager, spill, 1 << 20, 1 << 24)
+                      == TIEFILE_OK);
+                history_init(&loaded);
+                object_store_init(&loaded_store);
+                check(tiefile_load(&file, &loaded, &loaded_store, &pager)
+                      == TIEFILE_INVALID);
+                check(loaded.size == 0 && loaded_store.object_count == 0);
+                tiefile_close(&file);
+                history_pager_close(&pager);
+        }
+
+        // files of another kind or cut short aren't opened at all
+        check(test_file_patch(path, 0, &garbage, 1));
+        check(tiefile_open(&file, path) == TIEFILE_INVALID);
+        check(test_file_patch(path, 0, &header.magic_byte, 1));
+        check(test_file_truncate(path, size / 2));
+        check(tiefile_open(&file, path) == TIEFILE_INVALID);
+
+        tie_free(history.tree.address);
+        tie_free(history.entries.address);
+        test_store_free(&store);
+        remove(path);
+}
+
+// Checks that a journal replays a history and its objects onto an empty
+// document, and frees what it replayed.
+static void test_journal_replay(Journal *restrict journal,
+                                const char *restrict path,
+                                const History *restrict expected,
+                                const ObjectStore *restrict expected_store)
+{
+        static const JournalPosition start = { 0 };
+        ObjectStore store;
+        History history;
+        uint64_t i;
+
+        history_init(&history);
+        object_store_init(&store);
+        check(journal_open(journal,
+                           path,
+                           4,
+                           start,
+                           &history,
+                           &store,
+                           auxiliary_reallocator,
+                           NULL)
+              == TIEFILE_OK);
+        check(journal_close(journal) == TIEFILE_OK);
+        test_history_compare(expected, &history);
+        for (i = 0; i < min(history.size, expected->size); ++i) {
+                test_store_compare(expected_store,
+                                   expected->entries.address[i].objects,
+                                   &store,
+                                   history.entries.address[i].objects);
+        }
+
+        tie_free(history.tree.address);
+        tie_free(history.entries.address);
+        test_store_free(&store);
+}
+
+static void test_journal(void)
+{
+        static const char path[] = "tie-test.jnl";
+        static const JournalPosition start = { 0 };
+        static Journal journal;
+        ObjectStore store;
+        ObjectVersion objects;
+        History history;
+        uint64_t seed = 7, entry;
+        long committed, size;
+        vec2d cursor;
+
+        remove(path);
+        history_init(&history);
+        object_store_init(&store);
+        check(journal_open(&journal,
+                           path,
+                           4,
+                           start,
+                           &history,
+                           &store,
+                           auxiliary_reallocator,
+                           NULL)
+              == TIEFILE_OK);
+        test_history_grow(&history, &store, 256, &journal, &seed);
+        check(journal_commit(&journal) == TIEFILE_OK);
+        committed = test_file_size(path);
+        // one more entry, which a crash tears
+        objects = history.entries.address[history.current_entry].objects;
+        test_store_edit(&store, &objects, &seed, auxiliary_reallocator, NULL);
+        vec_x(cursor) = 0.5;
+        vec_y(cursor) = 0.5;
+        entry = test_history_append(&history, &cursor, objects);
+        check(journal_append_entry(&journal,
+                                   history.tree_size - 1,
+                                   history.entries.address + entry,
+                                   &store)
+              == TIEFILE_OK);
+        check(journal_close(&journal) == TIEFILE_OK);
+        size = test_file_size(path);
+        test_journal_replay(&journal, path, &history, &store);
+
+        // a torn record is cut off along with those after it, here the
+        // first of the last entry, and the rest replayed
+        check(committed > 0 && size > committed
+              && test_file_truncate(path, committed + 1));
+        --history.size;
+        --history.tree.address[history.tree_size - 1].size;
+        history.current_entry = history.size - 1;
+        test_journal_replay(&journal, path, &history, &store);
+        check(test_file_size(path) == committed);
+
+        tie_free(history.tree.address);
+        tie_free(history.entries.address);
+        test_store_free(&store);
+        remove(path);
+}
+
+static void test_object_store(void)
+{
+        // the value, generation and links of every object in every version
+        static struct {
+                double x;
+                uint32_t generation;
+                uint32_t child_count;
+                ObjectID children[4];
+        } model[33][128];
+        static ObjectVersion versions[array_size(model)];
+        ObjectVersion version = OBJECT_VERSION_EMPTY;
+        const ObjectID *children;
+        const Object *object;
+        ObjectStore store;
+        uint64_t seed = 4;
+        ObjectID id;
+        Object value;
+        size_t edit, i, j, k;
+
+        object_store_init(&store);
+        versions[0] = version;
+        for (edit = 1; edit < array_size(model); ++edit) {
+                object_store_begin(&store);
+                memcpy(model[edit], model[edit - 1], sizeof(model[edit]));
+                for (i = 0; i < 16; ++i) {
+                        // a new slot now and then
+                        id.index = splitmix64(&seed)
+                                 % min(version.count + 1,
+                                       array_size(model[edit]));
+                        j = id.index;
+                        if (j < version.count && splitmix64(&seed) % 2) {
+                                // the object itself, or a copy linking into
+                                // the store, while the store grows
+                                id.generation = model[edit][j].generation;
+                                object = object_store_get(&store, version, j);
+                                value = object_store_resolve(&store, object);
+                                if (splitmix64(&seed) % 2) {
+                                        check(object_store_set(
+                                                      &store,
+                                                      &version,
+                                                      id,
+                                                      &value,
+                                                      auxiliary_reallocator,
+                                                      NULL)
+                                              == 0);
+                                        continue;
+                                }
+                        } else {
+                                id.generation = splitmix64(&seed) % 4;
+                                model[edit][j].generation = id.generation;
+                                model[edit][j].child_count =
+                                        splitmix64(&seed) % 5;
+                                for (k = 0; k < model[edit][j].child_count;
+                                     ++k) {
+                                        model[edit][j].children[k] =
+                                                (ObjectID){
+                                                        .index = splitmix64(
+                                                                &seed),
+                                                        .generation = k,
+                                                };
+                                }
+                                value = (Object){
+                                        .type = BEZIER,
+                                        .child_count =
+                                                model[edit][j].child_count,
+                                        .children.address =
+                                                model[edit][j].children,
+                                };
+                        }
+                        model[edit][j].x = splitmix64(&seed) % 1000;
+                        vec_x(value.transform.position) = model[edit][j].x;
+                        check(object_store_set(&store,
+                                               &version,
+                                               id,
+                                               &value,
+                                               auxiliary_reallocator,
+                                               NULL)
+                              == 0);
+                }
+                versions[edit] = version;
+        }
+
+        // every version still holds what it held when it was made
+        for (edit = 0; edit < array_size(model); ++edit) {
+                version = versions[edit];
+                for (j = 0; j < version.count; ++j) {
+                        id.index = j;
+                        id.generation = model[edit][j].generation;
+                        object = object_store_identify(&store, version, &id);
+                        check(object == object_store_get(&store, version, j));
+                        check(object->type == BEZIER
+                              && vec_x(object->transform.position)
+                                         == model[edit][j].x
+                              && object->child_count
+                                         == model[edit][j].child_count);
+                        children = object_store_children(&store, object);
+                        for (k = 0; k < object->child_count; ++k) {
+                                check(children[k].index
+                                              == model[edit][j]
+                                                         .children[k]
+                                                         .index
+                                      && children[k].generation == k);
+                        }
+                        ++id.generation;
+                        check(!object_store_identify(&store, version, &id));
+                }
+                id.index = version.count;
+                check(!object_store_identify(&store, version, &id));
+        }
+
+        test_store_free(&store);
+}
+
+static void test_table_free(ObjectTable *restrict table)
+{
+        tie_free(table->types);
+        tie_free(table->generations);
+        tie_free(table->cached);
+        tie_free(table->transforms);
+        tie_free(table->bounds);
+        tie_free(table->arclengths);
+        tie_free(table->link_first);
+        tie_free(table->parent_counts);
+        tie_free(table->child_counts);
+        tie_free(table->links);
+        tie_free(table->spare_links);
+}
+
+static void test_object_table(void)
+{
+        // what every slot holds, or held if it's free
+        static struct {
+                ObjectID id;
+                bool used;
+                bool live;
+                double x;
+                uint32_t parent_count;
+                uint32_t child_count;
+                ObjectID links[6];
+        } model[64];
+        const ObjectID *parents, *children;
+        uint64_t seed = 9, links;
+        ObjectTable table;
+        Transform transform = { 0 };
+        ObjectID id, stale;
+        uint32_t slot, slots, count = 0, i, j;
+
+        object_table_init(&table);
+        for (i = 0; i < 4096; ++i) {
+                slot = splitmix64(&seed) % array_size(model);
+                if (!model[slot].live && count < array_size(model)) {
+                        // free slots are reused before the table grows, with
+                        // the next generation
+                        vec_x(transform.position) = splitmix64(&seed) % 1000;
+                        slots = table.count;
+                        id = object_table_insert(&table,
+                                                 POINT,
+                                                 &transform,
+                                                 0,
+                                                 NULL,
+                                                 0,
+                                                 NULL,
+                                                 auxiliary_reallocator,
+                                                 NULL);
+                        check(id.index < array_size(model)
+                              && table.count == slots + (count == slots));
+                        if (id.index >= array_size(model)) {
+                                break;
+                        }
+                        check(!model[id.index].live
+                              && (!model[id.index].used
+                                  || id.generation
+                                             == model[id.index].id.generation
+                                                        + 1));
+                        model[id.index].used = true;
+                        model[id.index].id = id;
+                        model[id.index].live = true;
+                        model[id.index].x = vec_x(transform.position);
+                        model[id.index].parent_count = 0;
+                        model[id.index].child_count = 0;
+                        ++count;
+                } else if (model[slot].live && splitmix64(&seed) % 3 == 0) {
+                        check(object_table_remove(&table, model[slot].id));
+                        check(!object_table_remove(&table, model[slot].id));
+                        model[slot].live = false;
+                        --count;
+                } else if (model[slot].live) {
+                        model[slot].parent_count = splitmix64(&seed) % 4;
+                        model[slot].child_count = splitmix64(&seed) % 3;
+                        for (j = 0; j < 6; ++j) {
+                                model[slot].links[j] = (ObjectID){
+                                        .index = splitmix64(&seed) % 64,
+                                        .generation = j,
+                                };
+                        }
+                        check(object_table_set_links(
+                                      &table,
+                                      slot,
+                                      model[slot].parent_count,
+                                      model[slot].links,
+                                      model[slot].child_count,
+                                      model[slot].links
+                                              + model[slot].parent_count,
+                                      auxiliary_reallocator,
+                                      NULL)
+                              == 0);
+                }
+                if (i % 1024 == 1023) {
+                        check(object_table_compact(
+                                      &table, auxiliary_reallocator, NULL)
+                              == 0);
+                        check(table.link_gaps == 0);
+                }
+
+                // live IDs resolve to their object, stale ones to nothing
+                links = 0;
+                for (slot = 0; slot < array_size(model); ++slot) {
+                        id = model[slot].id;
+                        if (!model[slot].live) {
+                                check(!model[slot].used
+                                      || object_table_resolve(&table, id)
+                                                 == OBJECT_TABLE_NIL);
+                                continue;
+                        }
+                        check(object_table_resolve(&table, id) == slot);
+                        stale = id;
+                        ++stale.generation;
+                        check(object_table_resolve(&table, stale)
+                              == OBJECT_TABLE_NIL);
+                        check(table.types[slot] == POINT
+                              && vec_x(table.transforms[slot].position)
+                                         == model[slot].x
+                              && table.parent_counts[slot]
+                                         == model[slot].parent_count
+                              && table.child_counts[slot]
+                                         == model[slot].child_count);
+                        parents = object_table_parents(&table, slot);
+                        children = object_table_children(&table, slot);
+                        for (j = 0; j < model[slot].parent_count; ++j) {
+                                check(!memcmp(&parents[j],
+                                              &model[slot].links[j],
+                                              sizeof(*parents)));
+                        }
+                        for (j = 0; j < model[slot].child_count; ++j) {
+                                check(!memcmp(&children[j],
+                                              &model[slot].links
+                                                       [model[slot].parent_count
+                                                        + j],
+                                              sizeof(*children)));
+                        }
+                        links += model[slot].parent_count
+                               + model[slot].child_count;
+                }
+                check(table.link_count - table.link_gaps == links);
+        }
+
+        test_table_free(&table);
+}
+
+#define TEST_DEP_GRAPH_SIZE 128
+
+// What a recomputation did to every slot of a table.
+typedef struct {
+        uint32_t clock;
+        // The recomputation that fails, counting from 1, or 0 if none does.
+        uint32_t fail;
+        uint32_t stamps[TEST_DEP_GRAPH_SIZE]; // when a slot was recomputed
+        uint32_t counts[TEST_DEP_GRAPH_SIZE]; // how often
+} TestRecompute;
+
+static int test_recompute(ObjectTable *restrict table,
+                          uint32_t slot,
+                          void *user)
+{
+        TestRecompute *recompute = user;
+
+        ++recompute->counts[slot];
+        recompute->stamps[slot] = ++recompute->clock;
+
+        return recompute->clock == recompute->fail ? -1 : 0;
+}
+
+// Fills a table with an acyclic graph, where every object has up to three
+// children among the objects before it, and removes a few of them.
+static void test_dep_graph_build(ObjectTable *restrict table,
+                                 uint64_t *restrict seed)
+{
+        static ObjectID children[TEST_DEP_GRAPH_SIZE][3];
+        static ObjectID parents[TEST_DEP_GRAPH_SIZE][TEST_DEP_GRAPH_SIZE];
+        static uint32_t child_counts[TEST_DEP_GRAPH_SIZE];
+        static uint32_t parent_counts[TEST_DEP_GRAPH_SIZE];
+        const Transform transform = { 0 };
+        ObjectID id;
+        uint32_t slot, i, child;
+
+        for (slot = 0; slot < TEST_DEP_GRAPH_SIZE; ++slot) {
+                id = object_table_insert(table,
+                                         POINT,
+                                         &transform,
+                                         0,
+                                         NULL,
+                                         0,
+                                         NULL,
+                                         auxiliary_reallocator,
+                                         NULL);
+                check(id.index == slot);
+                parent_counts[slot] = 0;
+                child_counts[slot] = slot > 0 ? splitmix64(seed) % 4 : 0;
+                for (i = 0; i < child_counts[slot]; ++i) {
+                        child = splitmix64(seed) % slot;
+                        children[slot][i] = object_table_id(table, child);
+                        parents[child][parent_counts[child]++] = id;
+                }
+        }
+        for (slot = 0; slot < TEST_DEP_GRAPH_SIZE; ++slot) {
+                check(object_table_set_links(table,
+                                             slot,
+                                             parent_counts[slot],
+                                             parents[slot],
+                                             child_counts[slot],
+                                             children[slot],
+                                             auxiliary_reallocator,
+                                             NULL)
+                      == 0);
+        }
+        for (slot = 5; slot < TEST_DEP_GRAPH_SIZE; slot += 16) {
+                check(object_table_remove(table,
+                                          object_table_id(table, slot)));
+        }
+}
+
+// Marks random objects, some of them twice, and finds the objects affected
+// by them the hard way. Returns the amount of affected objects.
+static uint32_t test_dep_graph_mark(DepGraph *restrict graph,
+                                    const ObjectTable *restrict table,
+                                    bool *restrict affected,
+                                    uint64_t *restrict seed)
+{
+        const ObjectID *parents;
+        uint32_t slot, count = 0, n, i, parent;
+
+        memset(affected, 0, TEST_DEP_GRAPH_SIZE * sizeof(*affected));
+        for (n = 1 + splitmix64(seed) % 8; n > 0; --n) {
+                slot = splitmix64(seed) % TEST_DEP_GRAPH_SIZE;
+                if (table->types[slot] == DELETED) {
+                        continue;
+                }
+                for (i = splitmix64(seed) % 2; i < 2; ++i) {
+                        check(dep_graph_mark(
+                                      graph, slot, auxiliary_reallocator, NULL)
+                              == 0);
+                }
+                affected[slot] = true;
+        }
+        // parents come after their children
+        for (slot = 0; slot < TEST_DEP_GRAPH_SIZE; ++slot) {
+                if (!affected[slot]) {
+                        continue;
+                }
+                ++count;
+                parents = object_table_parents(table, slot);
+                for (i = 0; i < table->parent_counts[slot]; ++i) {
+                        parent = object_table_resolve(table, parents[i]);
+                        if (parent != OBJECT_TABLE_NIL) {
+                                affected[parent] = true;
+                        }
+                }
+        }
+
+        return count;
+}
+
+// Checks that the affected objects, and only them, were recomputed once,
+// after their affected children.
+static void test_dep_graph_check(const ObjectTable *restrict table,
+                                 const bool *restrict affected,
+                                 const TestRecompute *restrict recompute)
+{
+        const ObjectID *children;
+        uint32_t slot, i, child;
+
+        for (slot = 0; slot < TEST_DEP_GRAPH_SIZE; ++slot) {
+                check(recompute->counts[slot] == affected[slot]);
+                if (!affected[slot]) {
+                        continue;
+                }
+                children = object_table_children(table, slot);
+                for (i = 0; i < table->child_counts[slot]; ++i) {
+                        child = object_table_resolve(table, children[i]);
+                        check(child == OBJECT_TABLE_NIL || !affected[child]
+                              || recompute->stamps[child]
+                                         < recompute->stamps[slot]);
+                }
+        }
+}
+
+static void test_dep_graph(void)
+{
+        static bool affected[TEST_DEP_GRAPH_SIZE];
+        static uint32_t rounds[TEST_DEP_GRAPH_SIZE];
+        static TestRecompute recompute;
+        const ObjectID *children;
+        uint64_t seed = 10;
+        ObjectTable table;
+        DepGraph graph;
+        uint32_t batch, count, level, slot, i, child;
+
+        object_table_init(&table);
+        dep_graph_init(&graph);
+        test_dep_graph_build(&table, &seed);
+
+        for (batch = 0; batch < 32; ++batch) {
+                count = test_dep_graph_mark(&graph, &table, affected, &seed);
+                memset(&recompute, 0, sizeof(recompute));
+                if (batch % 4 == 3 && count > 0) {
+                        // a failure keeps the batch for the next update
+                        recompute.fail = 1 + splitmix64(&seed) % count;
+                        check(dep_graph_update(&graph,
+                                               &table,
+                                               test_recompute,
+                                               &recompute,
+                                               auxiliary_reallocator,
+                                               NULL)
+                              == -1);
+                        memset(&recompute, 0, sizeof(recompute));
+                }
+                check(dep_graph_update(&graph,
+                                       &table,
+                                       test_recompute,
+                                       &recompute,
+                                       auxiliary_reallocator,
+                                       NULL)
+                      == 0);
+                test_dep_graph_check(&table, affected, &recompute);
+        }
+
+        // every round only depends on the ones before it
+        count = test_dep_graph_mark(&graph, &table, affected, &seed);
+        check(dep_graph_sort(&graph, &table, auxiliary_reallocator, NULL)
+              == 0);
+        check(graph.order_count == count && graph.level_count > 0
+              && graph.levels[graph.level_count - 1] == count);
+        memset(rounds, 0, sizeof(rounds));
+        for (level = 0; level < graph.level_count; ++level) {
+                for (i = level > 0 ? graph.levels[level - 1] : 0;
+                     i < graph.levels[level];
+                     ++i) {
+                        slot = graph.order[i];
+                        check(slot < TEST_DEP_GRAPH_SIZE && affected[slot]
+                              && !rounds[slot]);
+                        if (slot < TEST_DEP_GRAPH_SIZE) {
+                                rounds[slot] = level + 1;
+                        }
+                }
+        }
+        for (slot = 0; slot < TEST_DEP_GRAPH_SIZE; ++slot) {
+                children = object_table_children(&table, slot);
+                for (i = 0; i < table.child_counts[slot]; ++i) {
+                        child = object_table_resolve(&table, children[i]);
+                        check(!rounds[slot] || child == OBJECT_TABLE_NIL
+                              || !affected[child]
+                              || rounds[child] < rounds[slot]);
+                }
+        }
+
+        tie_free(graph.marks);
+        tie_free(graph.edits);
+        tie_free(graph.order);
+        tie_free(graph.levels);
+        tie_free(graph.results);
+        tie_free(graph.pending);
+        test_table_free(&table);
+}
+
+// Computes the slot of an object as its result, as the compute function of
+// dep_graph_update_parallel().
+static int test_recompute_compute(const ObjectTable *restrict table,
+                                  uint32_t slot,
+                                  ScratchArena *restrict scratch,
+                                  void **restrict result,
+                                  void *user)
+{
+        uint32_t *p = scratch_alloc(scratch, sizeof(*p), alignof(uint32_t));
+
+        if (!p) {
+                return -1;
+        }
+        *p = slot;
+        *result = p;
+
+        return 0;
+}
+
+static int test_recompute_commit(ObjectTable *restrict table,
+                                 uint32_t slot,
+                                 void *result,
+                                 void *user)
+{
+        check(*(const uint32_t *)result == slot);
+
+        return test_recompute(table, slot, user);
+}
+
+// Marks every object, as when the whole document changes.
+static uint32_t test_dep_graph_mark_all(DepGraph *restrict graph,
+                                        const ObjectTable *restrict table,
+                                        bool *restrict affected)
+{
+        uint32_t slot, count = 0;
+
+        for (slot = 0; slot < TEST_DEP_GRAPH_SIZE; ++slot) {
+                affected[slot] = table->types[slot] != DELETED;
+                if (affected[slot]) {
+                        check(dep_graph_mark(
+                                      graph, slot, auxiliary_reallocator, NULL)
+                              == 0);
+                        ++count;
+                }
+        }
+
+        return count;
+}
+
+static void test_dep_graph_parallel(void)
+{
+        // one thread with room for everything, and four with room for
+        // a few results each, whose rounds are run in parts
+        static const struct {
+                uint32_t thread_count;
+                size_t scratch_size;
+        } setups[] = {
+                { 1, 1 << 16 },
+                { 4, 64 },
+        };
+        static bool affected[TEST_DEP_GRAPH_SIZE];
+        static TestRecompute recompute;
+        static WorkerPool pool;
+        uint64_t seed = 11;
+        ObjectTable table;
+        DepGraph graph;
+        uint32_t setup, batch, count;
+
+        object_table_init(&table);
+        dep_graph_init(&graph);
+        test_dep_graph_build(&table, &seed);
+
+        for (setup = 0; setup < array_size(setups); ++setup) {
+                check(worker_pool_init(&pool,
+                                       setups[setup].thread_count,
+                                       setups[setup].scratch_size)
+                      == 0);
+                for (batch = 0; batch < 32; ++batch) {
+                        // the first batch changes everything
+                        count = batch > 0 ? test_dep_graph_mark(&graph,
+                                                                &table,
+                                                                affected,
+                                                                &seed)
+                                          : test_dep_graph_mark_all(
+                                                    &graph, &table, affected);
+                        memset(&recompute, 0, sizeof(recompute));
+                        if (batch % 4 == 3 && count > 0) {
+                                recompute.fail = 1 + splitmix64(&seed) % count;
+                                check(dep_graph_update_parallel(
+                                              &graph,
+                                              &table,
+                                              &pool,
+                                              test_recompute_compute,
+                                              test_recompute_commit,
+                                              16,
+                                              &recompute,
+                                              auxiliary_reallocator,
+                                              NULL)
+                                      == -1);
+                                memset(&recompute, 0, sizeof(recompute));
+                        }
+                        check(dep_graph_update_parallel(
+                                      &graph,
+                                      &table,
+                                      &pool,
+                                      test_recompute_compute,
+                                      test_recompute_commit,
+                                      16,
+                                      &recompute,
+                                      auxiliary_reallocator,
+                                      NULL)
+                              == 0);
+                        test_dep_graph_check(&table, affected, &recompute);
+                }
+                worker_pool_destroy(&pool);
+        }
+
+        tie_free(graph.marks);
+        tie_free(graph.edits);
+        tie_free(graph.order);
+        tie_free(graph.levels);
+        tie_free(graph.results);
+        tie_free(graph.pending);
+        test_table_free(&table);
+}
+
+// Returns the entry that an entry was made from, the hard way.
+static uint64_t test_history_parent(const History *restrict history,
+                                    uint64_t entry)
+{
+        const LinearHistory *tree = history->tree.address;
+        uint64_t first;
+        uint32_t linear = 0;
+
+        while (linear + 1 < history->tree_size
+               && (uint64_t)(tree[linear + 1].entries.address
+                             - history->entries.address)
+                          <= entry) {
+                ++linear;
+        }
+        first = tree[linear].entries.address - history->entries.address;
+        if (entry > first) {
+                return entry - 1;
+        }
+        // a branch before the first entry of its parent shares what that
+        // entry was made from
+        while (tree[linear].parent != linear && tree[linear].offset == 0) {
+                linear = tree[linear].parent;
+        }
+        if (tree[linear].parent == linear) {
+                return HISTORY_NIL;
+        }
+
+        return tree[tree[linear].parent].entries.address
+             - history->entries.address + tree[linear].offset - 1;
+}
+
+static void test_history(void)
+{
+        static uint64_t parents[384], depths[array_size(parents)];
+        uint64_t seed = 6, a, b, common, undos, redos, i, j;
+        ObjectStore store;
+        HistoryNav nav, added;
+        History history;
+
+        history_init(&history);
+        object_store_init(&store);
+        history_nav_init(&nav);
+        history_nav_init(&added);
+        test_history_grow(
+                &history, &store, array_size(parents), NULL, &seed);
+        check(history_nav_build(&nav, &history, auxiliary_reallocator, NULL)
+              == 0);
+        // branching as it happens indexes the same
+        for (i = 0; i < history.tree_size; ++i) {
+                check(history_nav_add(&added,
+                                      &history,
+                                      i,
+                                      auxiliary_reallocator,
+                                      NULL)
+                      == 0);
+        }
+        check(added.count == nav.count
+              && !memcmp(added.nodes,
+                         nav.nodes,
+                         nav.count * sizeof(*nav.nodes)));
+
+        for (a = 0; a < history.size; ++a) {
+                parents[a] = test_history_parent(&history, a);
+                depths[a] = parents[a] == HISTORY_NIL ? 0
+                                                      : depths[parents[a]] + 1;
+                check(history_depth(&nav, &history, a) == depths[a]);
+                for (b = a, i = 0; b != HISTORY_NIL; b = parents[b], ++i) {
+                        check(history_ancestor(&nav, &history, a, i) == b);
+                }
+                check(history_ancestor(&nav, &history, a, i) == HISTORY_NIL);
+        }
+
+        for (i = 0; i < history.size; ++i) {
+                for (j = 0; j < history.size; ++j) {
+                        a = i;
+                        b = j;
+                        while (a != HISTORY_NIL && depths[a] > depths[b]) {
+                                a = parents[a];
+                        }
+                        while (b != HISTORY_NIL && depths[b] > depths[a]) {
+                                b = parents[b];
+                        }
+                        while (a != b) {
+                                a = parents[a];
+                                b = parents[b];
+                        }
+                        common = history_common_ancestor(&nav, &history, i, j);
+                        check(common == a);
+                        undos = redos = HISTORY_NIL;
+                        check(history_path(
+                                      &nav, &history, i, j, &undos, &redos)
+                              == a);
+                        check(a == HISTORY_NIL
+                              || (undos == depths[i] - depths[a]
+                                  && redos == depths[j] - depths[a]));
+                }
+        }
+
+        tie_free(nav.nodes);
+        tie_free(added.nodes);
+        tie_free(history.tree.address);
+        tie_free(history.entries.address);
+        test_store_free(&store);
+}
+
+// Counts the resident pages of a part of an array of a pager.
+static uint64_t test_pager_resident(const HistoryPager *restrict pager,
+                                    const void *p,
+                                    size_t size)
+{
+        static unsigned char vec[1 << 12];
+        uintptr_t first = (uintptr_t)p / pager->page_size * pager->page_size;
+        size_t n = ((uintptr_t)p + size - first + pager->page_size - 1)
+                 / pager->page_size;
+        uint64_t count = 0;
+        size_t i;
+
+        if (size == 0) {
+                return 0;
+        }
+        check(n <= array_size(vec)
+              && !mincore((void *)first, n * pager->page_size, vec));
+        for (i = 0; i < min(n, array_size(vec)); ++i) {
+                count += vec[i] & 1;
+        }
+
+        return count;
+}
+
+// Counts the resident pages of the arrays of a history and its store.
+static uint64_t test_pager_total(const HistoryPager *restrict pager,
+                                 const History *restrict history,
+                                 const ObjectStore *restrict store)
+{
+        return test_pager_resident(pager,
+                                   history->tree.address,
+                                   history->tree_size
+                                           * sizeof(*history->tree.address))
+             + test_pager_resident(pager,
+                                   history->entries.address,
+                                   history->size
+                                           * sizeof(*history->entries.address))
+             + test_pager_resident(pager,
+                                   store->nodes,
+                                   store->node_count * sizeof(*store->nodes))
+             + test_pager_resident(pager,
+                                   store->objects,
+                                   store->object_count
+                                           * sizeof(*store->objects))
+             + test_pager_resident(pager,
+                                   store->generations,
+                                   store->object_count
+                                           * sizeof(*store->generations));
+}
+
+// Appends an entry whose version sets every object of a small document,
+// through a pager.
+static void test_pager_append(HistoryPager *restrict pager,
+                              History *restrict history,
+                              ObjectStore *restrict store,
+                              ObjectVersion objects,
+                              uint64_t stamp)
+{
+        ObjectID id;
+        Object value = { .type = POINT };
+        uint32_t i;
+
+        object_store_begin(store);
+        for (i = 0; i < 64; ++i) {
+                id.index = i;
+                id.generation = 0;
+                vec_x(value.transform.position) = stamp;
+                check(object_store_set(store,
+                                       &objects,
+                                       id,
+                                       &value,
+                                       history_pager_reallocator,
+                                       pager)
+                      == 0);
+        }
+        check(history_reserve(history,
+                              history->size + 1,
+                              history->tree_size,
+                              history_pager_reallocator,
+                              pager)
+              == 0);
+        history->entries.address[history->size] = (HistoryEntry){
+                .objects = objects,
+        };
+        ++history->tree.address[history->tree_size - 1].size;
+        history->current_entry = history->size++;
+}
+
+static void test_pager(void)
+{
+        static const char spill[] = "tie-test.spill";
+        const uint64_t budget = 1 << 20, recent = 4;
+        const LinearHistory *linear;
+        const HistoryEntry *entry;
+        const Object *object;
+        HistoryPager pager;
+        ObjectStore store;
+        History history;
+        uint64_t i, tip;
+
+        check(history_pager_open(&pager, spill, budget, 1 << 26)
+              == TIEFILE_OK);
+        history_init(&history);
+        object_store_init(&store);
+        check(history_reserve(&history,
+                              1,
+                              2,
+                              history_pager_reallocator,
+                              &pager)
+              == 0);
+
+        // a long history, and a branch off its first hundred entries
+        history.tree.address[0] = (LinearHistory){
+                .entries.address = history.entries.address,
+        };
+        history.tree_size = 1;
+        for (i = 0; i < 300; ++i) {
+                test_pager_append(&pager,
+                                  &history,
+                                  &store,
+                                  i > 0 ? history.entries.address[i - 1].objects
+                                        : OBJECT_VERSION_EMPTY,
+                                  i);
+        }
+        tip = history.size - 1;
+        history.tree.address[1] = (LinearHistory){
+                .entries.address = history.entries.address + history.size,
+                .offset = 100,
+        };
+        history.tree_size = 2;
+        for (i = 0; i < 100; ++i) {
+                test_pager_append(
+                        &pager,
+                        &history,
+                        &store,
+                        history.entries.address[i > 0 ? history.size - 1 : 99]
+                                .objects,
+                        1000 + i);
+        }
+        history.current_entry = 50;
+        check(test_pager_total(&pager, &history, &store) * pager.page_size
+              > budget);
+
+        // the rest is paged out until it fits in the budget, but for what
+        // the current entry, the recent ones and the tips reach
+        check(history_pager_trim(&pager, &history, &store, recent)
+              == TIEFILE_OK);
+        check(test_pager_total(&pager, &history, &store) * pager.page_size
+              <= budget);
+        for (i = 0; i < recent + 2; ++i) {
+                entry = history.entries.address
+                      + (i < recent ? history.size - 1 - i
+                         : i == recent ? tip
+                                       : history.current_entry);
+                object = &store.objects[object_store_locate(
+                        &store, entry->objects, entry->objects.count - 1)];
+                check(test_pager_resident(&pager, object, sizeof(*object))
+                      == 1);
+        }
+
+        // and everything reads back
+        traverse(linear, history.tree.address, history.tree.address + 2) {
+                traverse(entry,
+                         linear->entries.address,
+                         linear->entries.address + linear->size) {
+                        i = entry - linear->entries.address;
+                        if (linear > history.tree.address) {
+                                i += 1000;
+                        }
+                        object = object_store_get(&store, entry->objects, 63);
+                        check(vec_x(object->transform.position) == i);
+                }
+        }
+
+        history_pager_close(&pager);
+}
+
+// Waits for the save in progress, if any, and returns the outcome of the
+// last one.
+static TieFileStatus test_autosave_wait(Autosave *restrict autosave,
+                                        uint64_t *restrict psaves)
+{
+        TieFileStatus status;
+        bool busy;
+
+        for (;;) {
+                status = autosave_poll(autosave, psaves, &busy);
+                if (!busy) {
+                        return status;
+                }
+                thrd_yield();
+        }
+}
+
+static void test_autosave(void)
+{
+        static const char path[] = "tie-test.tie";
+        static const char journal_path[] = "tie-test.jnl";
+        static const char spill[] = "tie-test.spill";
+        static const JournalPosition start = { 0 };
+        static Autosave autosave;
+        static Journal journal;
+        ObjectStore store, loaded_store;
+        HistoryPager pager, loaded_pager;
+        History history, loaded;
+        TieFileStatus status;
+        uint64_t saves, i;
+        TieFile file;
+
+        remove(path);
+        remove(journal_path);
+        check(history_pager_open(&pager, spill, 1 << 24, 1 << 26)
+              == TIEFILE_OK);
+        history_init(&history);
+        object_store_init(&store);
+        check(journal_open(&journal,
+                           journal_path,
+                           4,
+                           start,
+                           &history,
+                           &store,
+                           history_pager_reallocator,
+                           &pager)
+              == TIEFILE_OK);
+        check(autosave_start(&autosave, path, &journal, &pager)
+              == TIEFILE_OK);
+        check(history_reserve(&history,
+                              1,
+                              1,
+                              history_pager_reallocator,
+                              &pager)
+              == 0);
+        history.tree.address[0] = (LinearHistory){
+                .entries.address = history.entries.address,
+        };
+        history.tree_size = 1;
+        check(journal_append_tree(&journal, &history, 0) == TIEFILE_OK);
+
+        // the history keeps changing while it's saved
+        for (i = 0; i < 256; ++i) {
+                test_pager_append(&pager,
+                                  &history,
+                                  &store,
+                                  i > 0 ? history.entries.address[i - 1].objects
+                                        : OBJECT_VERSION_EMPTY,
+                                  i);
+                check(journal_append_entry(&journal,
+                                           0,
+                                           history.entries.address + i,
+                                           &store)
+                      == TIEFILE_OK);
+                if (i % 32 == 0) {
+                        status = autosave_request(&autosave, &history, &store);
+                        check(status == TIEFILE_OK || status == TIEFILE_BUSY);
+                }
+        }
+        check(test_autosave_wait(&autosave, NULL) == TIEFILE_OK);
+        check(autosave_request(&autosave, &history, &store) == TIEFILE_OK);
+        check(test_autosave_wait(&autosave, &saves) == TIEFILE_OK);
+        check(saves >= 2);
+        autosave_stop(&autosave);
+        check(journal_close(&journal) == TIEFILE_OK);
+
+        // the file holds the whole history, and the journal nothing more
+        check(tiefile_open(&file, path) == TIEFILE_OK);
+        check(tiefile_header(&file)->history.size == history.size);
+        check(history_pager_open(&loaded_pager, spill, 1 << 24, 1 << 26)
+              == TIEFILE_OK);
+        history_init(&loaded);
+        object_store_init(&loaded_store);
+        check(tiefile_load(&file, &loaded, &loaded_store, &loaded_pager)
+              == TIEFILE_OK);
+        check(journal_open(&journal,
+                           journal_path,
+                           4,
+                           tiefile_header(&file)->journal,
+                           &loaded,
+                           &loaded_store,
+                           history_pager_reallocator,
+                           &loaded_pager)
+              == TIEFILE_OK);
+        tiefile_close(&file);
+        check(journal_close(&journal) == TIEFILE_OK);
+        test_history_compare(&history, &loaded);
+        for (i = 0; i < min(history.size, loaded.size); ++i) {
+                check(object_store_check(&loaded_store,
+                                         loaded.entries.address[i].objects)
+                      == 0);
+                test_store_compare(&store,
+                                   history.entries.address[i].objects,
+                                   &loaded_store,
+                                   loaded.entries.address[i].objects);
+        }
+
+        history_pager_close(&loaded_pager);
+        history_pager_close(&pager);
+        remove(path);
+        remove(journal_path);
+}
+
+// Checks the queries of a tree against brute force over the items that
+// weren't removed.
+static void test_rtree_queries(const RTree *restrict tree,
+                               size_t n,
+                               const aabb2d boxes[static n],
+                               const bool alive[static n],
+                               uint64_t *restrict seed)
+{
+        static bool seen[256 * 256];
+        size_t out_sz = 1, aux_sz = 1, pairs_sz = 1, stack_sz = 1, i, j;
+        size_t count, found, live = 0;
+        uint32_t *out = tie_malloc(out_sz, sizeof(*out)), *id, *end, a, b;
+        RTreeCandidate *aux = tie_malloc(aux_sz, sizeof(*aux));
+        RTreePair *pairs = tie_malloc(pairs_sz, sizeof(*pairs));
+        RTreePair *stack = tie_malloc(stack_sz, sizeof(*stack));
+        RTreePair *pair, *pairs_end;
+        RTreeNeighbour near[8], *neighbour, *near_end;
+        aabb2d window;
+        vec2d p;
+
+        assert(n * n <= array_size(seen));
+        for (i = 0; i < n; ++i) {
+                live += alive[i];
+        }
+
+        for (i = 0; i < 64; ++i) {
+                vec_x(window.min) = 100 * test_random(seed);
+                vec_y(window.min) = 100 * test_random(seed);
+                // every eighth window is a point
+                vec_x(window.max) = vec_x(window.min)
+                                  + (i % 8 ? 20 * test_random(seed) : 0);
+                vec_y(window.max) = vec_y(window.min)
+                                  + (i % 8 ? 20 * test_random(seed) : 0);
+                end = rtree_search(tree,
+                                   &window,
+                                   &out_sz,
+                                   &out,
+                                   auxiliary_reallocator,
+                                   NULL);
+                check(end != NULL);
+                if (!end) {
+                        continue;
+                }
+                memset(seen, 0, n);
+                traverse(id, out, end) {
+                        check(*id < n && alive[*id] && !seen[*id]
+                              && overlaps_aabb2d(&boxes[*id], &window));
+                        seen[*id % n] = true;
+                }
+                count = 0;
+                for (j = 0; j < n; ++j) {
+                        count += alive[j]
+                              && overlaps_aabb2d(&boxes[j], &window);
+                }
+                check((size_t)(end - out) == count);
+
+                vec_x(p) = 100 * test_random(seed);
+                vec_y(p) = 100 * test_random(seed);
+                near_end = rtree_nearest(tree,
+                                         &p,
+                                         array_size(near),
+                                         near,
+                                         &aux_sz,
+                                         &aux,
+                                         auxiliary_reallocator,
+                                         NULL);
+                check(near_end != NULL);
+                if (!near_end) {
+                        continue;
+                }
+                found = near_end - near;
+                check(found == min(array_size(near), live));
+                memset(seen, 0, n);
+                traverse(neighbour, near, near_end) {
+                        check(neighbour->id < n && alive[neighbour->id]
+                              && !seen[neighbour->id]
+                              && neighbour->sqrdist
+                                         == sqrdist_aabb2d(
+                                                 &boxes[neighbour->id], &p));
+                        check(neighbour == near
+                              || neighbour[-1].sqrdist <= neighbour->sqrdist);
+                        seen[neighbour->id % n] = true;
+                }
+                // no item that was left out is closer than the last one found
+                for (j = 0; found > 0 && j < n; ++j) {
+                        check(!alive[j] || seen[j]
+                              || sqrdist_aabb2d(&boxes[j], &p)
+                                         >= near_end[-1].sqrdist);
+                }
+        }
+
+        pairs_end = rtree_overlapping_pairs(tree,
+                                            &pairs_sz,
+                                            &pairs,
+                                            &stack_sz,
+                                            &stack,
+                                            auxiliary_reallocator,
+                                            NULL);
+        check(pairs_end != NULL);
+        if (pairs_end) {
+                memset(seen, 0, n * n);
+                traverse(pair, pairs, pairs_end) {
+                        a = min(pair->a, pair->b);
+                        b = max(pair->a, pair->b);
+                        check(a != b && b < n && alive[a] && alive[b]
+                              && !seen[a * n + b]
+                              && overlaps_aabb2d(&boxes[a], &boxes[b]));
+                        seen[(a * n + b) % (n * n)] = true;
+                }
+                count = 0;
+                for (i = 0; i < n; ++i) {
+                        for (j = i + 1; j < n; ++j) {
+                                count += alive[i] && alive[j]
+                                      && overlaps_aabb2d(&boxes[i], &boxes[j]);
+                        }
+                }
+                check((size_t)(pairs_end - pairs) == count);
+        }
+
+        tie_free(out);
+        tie_free(aux);
+        tie_free(pairs);
+        tie_free(stack);
+}
+
+static void test_rtree(void)
+{
+        static aabb2d boxes[256];
+        static bool alive[array_size(boxes)];
+        static RTreeEntry entries[array_size(boxes)];
+        uint64_t seed = 2;
+        size_t i, n = 0;
+        RTree tree;
+
+        rtree_init(&tree, 1, tie_malloc(1, sizeof(RTreeNode)));
+        for (i = 0; i < array_size(boxes); ++i) {
+                vec_x(boxes[i].min) = 100 * test_random(&seed);
+                vec_y(boxes[i].min) = 100 * test_random(&seed);
+                // every fourth item is a point
+                vec_x(boxes[i].max) = vec_x(boxes[i].min)
+                                    + (i % 4 ? 8 * test_random(&seed) : 0);
+                vec_y(boxes[i].max) = vec_y(boxes[i].min)
+                                    + (i % 4 ? 8 * test_random(&seed) : 0);
+                alive[i] = true;
+                check(rtree_insert(&tree,
+                                   &boxes[i],
+                                   i,
+                                   auxiliary_reallocator,
+                                   NULL)
+                      == 0);
+        }
+        test_rtree_queries(&tree, array_size(boxes), boxes, alive, &seed);
+
+        for (i = 0; i < array_size(boxes); i += 3) {
+                check(rtree_remove(&tree, &boxes[i], i));
+                check(!rtree_remove(&tree, &boxes[i], i));
+                alive[i] = false;
+        }
+        test_rtree_queries(&tree, array_size(boxes), boxes, alive, &seed);
+
+        for (i = 0; i < array_size(boxes); ++i) {
+                if (alive[i]) {
+                        entries[n++] = (RTreeEntry){ .bounds = boxes[i],
+                                                     .id = i };
+                }
+        }
+        check(rtree_bulk_load(&tree, n, entries, auxiliary_reallocator, NULL)
+              == 0);
+        test_rtree_queries(&tree, array_size(boxes), boxes, alive, &seed);
+
+        tie_free(tree.nodes);
+}
+
+// Clips two sets of contours and compares the result to them at random
+// points in [-1, size + 1)^2. The result must cover each point once or not
+// at all.
+static void test_clip_sample(Clipper *restrict clipper,
+                             ClipOperation op,
+                             FillRule rule,
+                             size_t subject_count,
+                             const size_t subject_offsets[],
+                             const vec2d subject[],
+                             size_t clip_count,
+                             const size_t clip_offsets[],
+                             const vec2d clip[],
+                             double size,
+                             uint64_t *restrict seed)
+{
+        bool a, b, inside;
+        int32_t result;
+        vec2d p;
+        size_t i;
+
+        check(polygon_clip(clipper,
+                           op,
+                           rule,
+                           subject_count,
+                           subject_offsets,
+                           subject,
+                           clip_count,
+                           clip_offsets,
+                           clip,
+                           auxiliary_reallocator,
+                           NULL)
+              == 0);
+        for (i = 0; i < 64; ++i) {
+                vec_x(p) = test_random(seed) * (size + 2) - 1;
+                vec_y(p) = test_random(seed) * (size + 2) - 1;
+                a = fill_rule_inside(rule,
+                                     test_winding(subject_count,
+                                                  subject_offsets,
+                                                  subject,
+                                                  &p));
+                b = fill_rule_inside(rule,
+                                     test_winding(clip_count,
+                                                  clip_offsets,
+                                                  clip,
+                                                  &p));
+                inside = op == CLIP_UNION          ? a || b
+                       : op == CLIP_INTERSECTION ? a && b
+                       : op == CLIP_DIFFERENCE   ? a && !b
+                                                 : a != b;
+                result = test_winding(clipper->contour_count,
+                                      clipper->offsets,
+                                      clipper->points,
+                                      &p);
+                check(result == inside);
+        }
+}
+
+static void test_clip(void)
+{
+        // a contour touching itself at a vertex and running back along
+        // part of an edge
+        static const vec2d subject[] = {
+                { .v = { 2, 3 } }, { .v = { 1, 3 } }, { .v = { 2, 1 } },
+                { .v = { 0, 1 } }, { .v = { 2, 3 } }, { .v = { 1, 2 } },
+                { .v = { 0, 2 } },
+        };
+        static const vec2d clip[] = {
+                { .v = { 3, 0 } },
+                { .v = { 3, 2 } },
+                { .v = { 2, 1 } },
+                { .v = { 0, 2 } },
+        };
+        static const size_t subject_offsets[] = { 0, array_size(subject) };
+        static const size_t clip_offsets[] = { 0, array_size(clip) };
+        static const vec2d inside = { .v = { 1.5, 2.8 } };
+        size_t offsets[2][4], count[2], i, j, k, m;
+        vec2d points[2][32];
+        uint64_t seed = 1;
+        Clipper clipper;
+        ClipOperation op;
+        FillRule rule;
+
+        clipper_init(&clipper);
+        check(polygon_clip(&clipper,
+                           CLIP_UNION,
+                           FILL_NONZERO,
+                           1,
+                           subject_offsets,
+                           subject,
+                           1,
+                           clip_offsets,
+                           clip,
+                           auxiliary_reallocator,
+                           NULL)
+              == 0);
+        check(test_winding(clipper.contour_count,
+                           clipper.offsets,
+                           clipper.points,
+                           &inside)
+              == 1);
+
+        // contours on a small grid touch themselves and each other and
+        // share edges all the time
+        for (i = 0; i < 256; ++i) {
+                for (j = 0; j < 2; ++j) {
+                        count[j] = 1 + splitmix64(&seed) % 3;
+                        offsets[j][0] = 0;
+                        for (k = 0; k < count[j]; ++k) {
+                                offsets[j][k + 1] = offsets[j][k] + 3
+                                                  + splitmix64(&seed) % 8;
+                                for (m = offsets[j][k]; m < offsets[j][k + 1];
+                                     ++m) {
+                                        vec_x(points[j][m]) =
+                                                splitmix64(&seed) % 5;
+                                        vec_y(points[j][m]) =
+                                                splitmix64(&seed) % 5;
+                                }
+                        }
+                }
+                for (op = CLIP_UNION; op <= CLIP_XOR; ++op) {
+                        for (rule = FILL_NONZERO; rule <= FILL_EVENODD;
+                             ++rule) {
+                                test_clip_sample(&clipper,
+                                                 op,
+                                                 rule,
+                                                 count[0],
+                                                 offsets[0],
+                                                 points[0],
+                                                 count[1],
+                                                 offsets[1],
+                                                 points[1],
+                                                 4,
+                                                 &seed);
+                        }
+                }
+        }
+
+        tie_free(clipper.offsets);
+        tie_free(clipper.points);
+        tie_free(clipper.segments);
+        tie_free(clipper.events);
+}
+
 int main(void)
 {
         static vec2d line_strip[SZ];
@@ -70,6 +2939,30 @@ int main(void)
         size_t out_sz = SZ, aux_sz = SZ;
         Uint64 start, end;
 
+        test_predicates();
+        test_bezier_bounds();
+        test_simplify();
+        test_closest();
+        test_curve_fit();
+        test_bernstein();
+        test_arclength();
+        test_stroke();
+        test_arrangement();
+        test_metrics();
+        test_delaunay();
+        test_discretize();
+        test_tiefile();
+        test_journal();
+        test_object_store();
+        test_object_table();
+        test_dep_graph();
+        test_dep_graph_parallel();
+        test_history();
+        test_pager();
+        test_autosave();
+        test_rtree();
+        test_clip();
+
         start = SDL_GetPerformanceCounter();
         out_end = bezier_discretize(4,
                                     bezier,
@@ -86,5 +2979,5 @@ int main(void)
                 "took %lfms, resulting in %ld points\n",
                 (end - start) / ((double)SDL_GetPerformanceFrequency() / 1000),
                 out_end - out);
-        return 0;
+        return failures != 0;
 }
@@ -166,7 +166,7 @@ static inline size_t auxiliary_reallocator(void **restrict p,
 {
         assert(!mul_overflow(log2size, n, (size_t)3));
         *p = tie_realloc(*p, max(new_n, n * 3 / 2), sz);
-        return n * 3 / 2;
+        return max(new_n, n * 3 / 2);
 }
 
 #endif
@@ -0,0 +1,212 @@
+#include <math.h>
+
+#include "arclength.h"
+#include "array.h"
+#include "attrib.h"
+#include "bernstein.h"
+#include "math.h"
+#include "numeric.h"
+
+#define ARCLENGTH_MAX_ITERATIONS 8
+
+// Nodes and weights of the 5-point Gauss-Legendre rule on [-1, 1]. The
+// speed isn't a polynomial, but it's smooth enough within a segment for the
+// rule to converge quickly.
+static const double gauss_nodes[] = {
+        0.0,
+        -0.5384693101056831,
+        0.5384693101056831,
+        -0.9061798459386640,
+        0.9061798459386640,
+};
+static const double gauss_weights[] = {
+        0.5688888888888889,
+        0.4786286704993665,
+        0.4786286704993665,
+        0.2369268850561891,
+        0.2369268850561891,
+};
+
+// The derivative of the curve, one coordinate at a time.
+typedef struct {
+        size_t n;
+        double x[ARCLENGTH_MAX_CONTROL_POINTS - 1];
+        double y[ARCLENGTH_MAX_CONTROL_POINTS - 1];
+} Hodograph;
+
+static void arclength_hodograph(size_t n,
+                                const vec2d bezier[static restrict n],
+                                Hodograph *restrict out)
+{
+        size_t i;
+
+        assert(n > 0);
+        assert(n <= ARCLENGTH_MAX_CONTROL_POINTS);
+
+        out->n = n - 1;
+        for (i = 0; i + 1 < n; ++i) {
+                out->x[i] = (n - 1) * (vec_x(bezier[i + 1]) - vec_x(bezier[i]));
+                out->y[i] = (n - 1) * (vec_y(bezier[i + 1]) - vec_y(bezier[i]));
+        }
+}
+
+PURE_FUNC static inline double arclength_speed(const Hodograph *restrict h,
+                                               double t)
+{
+        if (h->n == 0) {
+                return 0;
+        }
+        return hypot(bernstein_eval(h->n, h->x, t),
+                     bernstein_eval(h->n, h->y, t));
+}
+
+// Integrates the speed over [a, b].
+PURE_FUNC static double arclength_integrate(const Hodograph *restrict h,
+                                            double a,
+                                            double b)
+{
+        double half = (b - a) / 2, mid = (a + b) / 2, sum = 0;
+        size_t i;
+
+        for (i = 0; i < array_size(gauss_nodes); ++i) {
+                sum += gauss_weights[i]
+                     * arclength_speed(h, mid + half * gauss_nodes[i]);
+        }
+
+        return sum * half;
+}
+
+// Finds the parameter in segment i at which the length reaches the given
+// one, which must lie within the segment.
+PURE_FUNC static double arclength_invert(const Hodograph *restrict h,
+                                         const ArcLengthTable *restrict table,
+                                         size_t i,
+                                         double length)
+{
+        const double *lengths = table->lengths;
+        double lo = (double)i / ARCLENGTH_SEGMENTS;
+        double hi = (double)(i + 1) / ARCLENGTH_SEGMENTS;
+        double start = lo, t, f, speed;
+        int k;
+
+        if (lengths[i + 1] <= lengths[i]) {
+                return lo;
+        }
+
+        // the length is close to linear within a segment
+        t = lo + (hi - lo) * (length - lengths[i])
+                         / (lengths[i + 1] - lengths[i]);
+        for (k = 0; k < ARCLENGTH_MAX_ITERATIONS; ++k) {
+                f = lengths[i] + arclength_integrate(h, start, t) - length;
+                if (fabs(f) <= DBL_EPSILON * lengths[ARCLENGTH_SEGMENTS]) {
+                        break;
+                }
+                if (f > 0) {
+                        hi = t;
+                } else {
+                        lo = t;
+                }
+                speed = arclength_speed(h, t);
+                // Newton, unless the step leaves the bracket
+                t = speed > 0 ? t - f / speed : lo;
+                if (t <= lo || t >= hi) {
+                        t = (lo + hi) / 2;
+                }
+        }
+
+        return t;
+}
+
+void arclength_build(size_t n,
+                     const vec2d bezier[static restrict n],
+                     ArcLengthTable *restrict table)
+{
+        Hodograph h;
+        size_t i;
+
+        arclength_hodograph(n, bezier, &h);
+
+        table->lengths[0] = 0;
+        for (i = 0; i < ARCLENGTH_SEGMENTS; ++i) {
+                table->lengths[i + 1] =
+                        table->lengths[i]
+                        + arclength_integrate(&h,
+                                              (double)i / ARCLENGTH_SEGMENTS,
+                                              (double)(i + 1)
+                                                      / ARCLENGTH_SEGMENTS);
+        }
+}
+
+PURE_FUNC double arclength_length(size_t n,
+                                  const vec2d bezier[static restrict n],
+                                  const ArcLengthTable *restrict table,
+                                  double t)
+{
+        Hodograph h;
+        size_t i;
+
+        assert(t >= 0 && t <= 1);
+
+        i = min((size_t)(t * ARCLENGTH_SEGMENTS), ARCLENGTH_SEGMENTS - 1);
+        arclength_hodograph(n, bezier, &h);
+
+        return table->lengths[i]
+             + arclength_integrate(&h, (double)i / ARCLENGTH_SEGMENTS, t);
+}
+
+PURE_FUNC double arclength_param(size_t n,
+                                 const vec2d bezier[static restrict n],
+                                 const ArcLengthTable *restrict table,
+                                 double length)
+{
+        const double *lengths = table->lengths;
+        size_t lo = 0, hi = ARCLENGTH_SEGMENTS, mid;
+        Hodograph h;
+
+        if (length <= 0) {
+                return 0;
+        }
+        if (length >= lengths[ARCLENGTH_SEGMENTS]) {
+                return 1;
+        }
+
+        // the segment i with lengths[i] <= length < lengths[i + 1]
+        while (hi - lo > 1) {
+                mid = lo + (hi - lo) / 2;
+                if (lengths[mid] <= length) {
+                        lo = mid;
+                } else {
+                        hi = mid;
+                }
+        }
+
+        arclength_hodograph(n, bezier, &h);
+        return arclength_invert(&h, table, lo, length);
+}
+
+void arclength_uniform_params(size_t n,
+                              const vec2d bezier[static restrict n],
+                              const ArcLengthTable *restrict table,
+                              size_t m,
+                              double out[static restrict m])
+{
+        const double *lengths = table->lengths;
+        const double total = lengths[ARCLENGTH_SEGMENTS];
+        double length;
+        Hodograph h;
+        size_t i, k;
+
+        assert(m >= 2);
+
+        arclength_hodograph(n, bezier, &h);
+
+        out[0] = 0;
+        for (k = 1, i = 0; k + 1 < m; ++k) {
+                length = total * k / (m - 1);
+                while (i + 1 < ARCLENGTH_SEGMENTS && lengths[i + 1] <= length) {
+                        ++i;
+                }
+                out[k] = arclength_invert(&h, table, i, length);
+        }
+        out[m - 1] = 1;
+}
@@ -0,0 +1,98 @@
+/*! \file arclength.h
+ *  \brief Arc length parameterization of bezier curves
+ *
+ *  Dashed strokes, text on a path and uniform resampling all need points at
+ *  equal distances along a curve, which its parameter doesn't provide. An
+ *  arc length table stores the length of a curve at
+ *  #ARCLENGTH_SEGMENTS + 1 evenly spaced parameters, each integrated from
+ *  the speed of the curve with Gauss-Legendre quadrature. Lengths at other
+ *  parameters are integrated from the closest entry, and the parameter at a
+ *  given length is found by binary search in the table followed by Newton
+ *  iterations within a single segment.
+ *
+ *  The table doesn't store the curve, so every routine taking a table has to
+ *  be given the same control points the table was built from.
+ */
+#ifndef TIE_ARCLENGTH_H
+#define TIE_ARCLENGTH_H
+
+#include "attrib.h"
+#include "math.h"
+
+#define ARCLENGTH_SEGMENTS 16
+#define ARCLENGTH_MAX_CONTROL_POINTS 32
+
+typedef struct {
+        double lengths[ARCLENGTH_SEGMENTS + 1];
+} ArcLengthTable;
+
+/*! \brief Builds the arc length table of a bezier curve.
+ *
+ *  Runs in \f$O(n)\f$.
+ *
+ *  \param[in] n The amount of control points. Must be positive and at most
+ *  #ARCLENGTH_MAX_CONTROL_POINTS.
+ *  \param[in] bezier The control points of the curve.
+ *  \param[out] table The table.
+ */
+extern void arclength_build(size_t n,
+                            const vec2d bezier[static restrict n],
+                            ArcLengthTable *restrict table);
+
+/*! \brief Computes the length of a bezier curve up to a parameter.
+ *
+ *  Runs in \f$O(n)\f$.
+ *
+ *  \param[in] n The amount of control points.
+ *  \param[in] bezier The control points of the curve.
+ *  \param[in] table The arc length table of the curve.
+ *  \param[in] t The parameter. Must be in the [0, 1] range.
+ *
+ *  \return The length of the curve over [0, t].
+ *
+ *  \sa arclength_build()
+ */
+extern PURE_FUNC double arclength_length(size_t n,
+                                         const vec2d bezier[static restrict n],
+                                         const ArcLengthTable *restrict table,
+                                         double t);
+
+/*! \brief Finds the parameter at which a bezier curve reaches a length.
+ *
+ *  Runs in \f$O(\log s + n)\f$, where \f$s\f$ is #ARCLENGTH_SEGMENTS.
+ *
+ *  \param[in] n The amount of control points.
+ *  \param[in] bezier The control points of the curve.
+ *  \param[in] table The arc length table of the curve.
+ *  \param[in] length The length. Clamped to the length of the curve.
+ *
+ *  \return The parameter t at which the length of the curve over [0, t] is
+ *  `length`.
+ *
+ *  \sa arclength_build()
+ */
+extern PURE_FUNC double arclength_param(size_t n,
+                                        const vec2d bezier[static restrict n],
+                                        const ArcLengthTable *restrict table,
+                                        double length);
+
+/*! \brief Splits a bezier curve into pieces of equal length.
+ *
+ *  Same as calling arclength_param() at `m` evenly spaced lengths from zero
+ *  to the length of the curve, but walks the table instead of searching it.
+ *
+ *  \param[in] n The amount of control points.
+ *  \param[in] bezier The control points of the curve.
+ *  \param[in] table The arc length table of the curve.
+ *  \param[in] m The amount of parameters. Must be at least 2.
+ *  \param[out] out The parameters, starting at 0 and ending at 1.
+ *
+ *  \sa arclength_build()
+ */
+extern void arclength_uniform_params(size_t n,
+                                     const vec2d bezier[static restrict n],
+                                     const ArcLengthTable *restrict table,
+                                     size_t m,
+                                     double out[static restrict m]);
+
+#endif
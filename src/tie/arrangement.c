@@ -0,0 +1,764 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arrangement.h"
+#include "array.h"
+#include "attrib.h"
+#include "bernstein.h"
+#include "functional.h"
+#include "geometry.h"
+#include "math.h"
+
+#define ARRANGEMENT_PI 3.14159265358979323846
+// Amount of line segments curves are approximated with when testing
+// cycles. Lines are never subdivided.
+#define ARRANGEMENT_FLATTEN_STEPS 16
+
+// Approximates half-edge h with a line strip, returning the amount of
+// segments.
+static size_t arrangement_flatten(
+        const Arrangement *restrict arr,
+        uint32_t h,
+        vec2d out[static ARRANGEMENT_FLATTEN_STEPS + 1])
+{
+        const ArrangementEdge *e = &arr->edges[h >> 1];
+        const size_t steps = e->count == 2 ? 1 : ARRANGEMENT_FLATTEN_STEPS;
+        double x[ARRANGEMENT_MAX_CONTROL_POINTS];
+        double y[ARRANGEMENT_MAX_CONTROL_POINTS];
+        double t;
+        size_t i;
+
+        for (i = 0; i < e->count; ++i) {
+                x[i] = vec_x(e->control[i]);
+                y[i] = vec_y(e->control[i]);
+        }
+        for (i = 0; i <= steps; ++i) {
+                t = (double)i / steps;
+                if (h & 1) {
+                        t = 1 - t;
+                }
+                vec_x(out[i]) = bernstein_eval(e->count, x, t);
+                vec_y(out[i]) = bernstein_eval(e->count, y, t);
+        }
+
+        return steps;
+}
+
+PURE_FUNC double arrangement_cycle_area(const Arrangement *restrict arr,
+                                        uint32_t h)
+{
+        vec2d points[ARRANGEMENT_FLATTEN_STEPS + 1];
+        double area = 0;
+        uint32_t g = h;
+        size_t steps, i;
+
+        do {
+                steps = arrangement_flatten(arr, g, points);
+                for (i = 0; i < steps; ++i) {
+                        area += vec_x(points[i]) * vec_y(points[i + 1])
+                              - vec_x(points[i + 1]) * vec_y(points[i]);
+                }
+                g = arrangement_half(arr, g)->next;
+        } while (g != h);
+
+        return area / 2;
+}
+
+// The winding number of the cycle through h around q, see winding_number().
+PURE_FUNC static int32_t arrangement_cycle_winding(
+        const Arrangement *restrict arr,
+        uint32_t h,
+        const vec2d *restrict q)
+{
+        vec2d points[ARRANGEMENT_FLATTEN_STEPS + 1];
+        const vec2d *a, *b;
+        int32_t winding = 0;
+        uint32_t g = h;
+        double side;
+        size_t steps, i;
+
+        do {
+                steps = arrangement_flatten(arr, g, points);
+                for (i = 0; i < steps; ++i) {
+                        a = &points[i];
+                        b = &points[i + 1];
+                        side = (vec_x(*b) - vec_x(*a))
+                                     * (vec_y(*q) - vec_y(*a))
+                             - (vec_y(*b) - vec_y(*a))
+                                       * (vec_x(*q) - vec_x(*a));
+                        if (vec_y(*a) <= vec_y(*q)) {
+                                winding += vec_y(*b) > vec_y(*q) && side > 0;
+                        } else {
+                                winding -= vec_y(*b) <= vec_y(*q) && side < 0;
+                        }
+                }
+                g = arrangement_half(arr, g)->next;
+        } while (g != h);
+
+        return winding;
+}
+
+// Direction in which half-edge h leaves its origin.
+PURE_FUNC static double arrangement_angle(const Arrangement *restrict arr,
+                                          uint32_t h)
+{
+        const ArrangementEdge *e = &arr->edges[h >> 1];
+        const size_t last = e->count - 1;
+        const vec2d *origin = &e->control[h & 1 ? last : 0];
+        vec2d d = *origin;
+        size_t i;
+
+        // the first control point apart from the origin gives the tangent
+        for (i = 1; i <= last; ++i) {
+                d = e->control[h & 1 ? last - i : i];
+                sub_vec2d(&d, origin);
+                if (vec_x(d) != 0 || vec_y(d) != 0) {
+                        break;
+                }
+        }
+
+        return atan2(vec_y(d), vec_x(d));
+}
+
+// Finds the outgoing half-edge at vertex v right before the given direction
+// in counter-clockwise order. The wedge between the two lies in its face.
+PURE_FUNC static uint32_t arrangement_wedge(const Arrangement *restrict arr,
+                                            uint32_t v,
+                                            double angle)
+{
+        const uint32_t first = arr->vertices[v].edge;
+        uint32_t g = first, best = first;
+        double delta, best_delta = DBL_MAX;
+
+        do {
+                delta = angle - arrangement_angle(arr, g);
+                if (delta <= 0) {
+                        delta += 2 * ARRANGEMENT_PI;
+                }
+                if (delta < best_delta) {
+                        best_delta = delta;
+                        best = g;
+                }
+                g = arrangement_half(arr, g ^ 1)->next;
+        } while (g != first);
+
+        return best;
+}
+
+// Finds the half-edge that stands for the cycle through h in its face: the
+// outer half-edge of the face if it's the outer boundary, the list entry if
+// it's a hole.
+PURE_FUNC static uint32_t arrangement_cycle_rep(const Arrangement *restrict arr,
+                                                uint32_t h)
+{
+        const uint32_t f = arrangement_half(arr, h)->face;
+        const ArrangementFace *face = &arr->faces[f];
+        uint32_t g = h;
+
+        do {
+                if (g == face->outer
+                    || arrangement_half(arr, g)->next_hole != ARRANGEMENT_NIL) {
+                        return g;
+                }
+                g = arrangement_half(arr, g)->next;
+        } while (g != h);
+
+        assert(false);
+        return ARRANGEMENT_NIL;
+}
+
+// Assigns the cycle through h to face f, returning its length.
+static size_t arrangement_cycle_set_face(Arrangement *restrict arr,
+                                         uint32_t h,
+                                         uint32_t f)
+{
+        uint32_t g = h;
+        size_t length = 0;
+
+        do {
+                arrangement_half(arr, g)->face = f;
+                g = arrangement_half(arr, g)->next;
+                ++length;
+        } while (g != h);
+
+        return length;
+}
+
+PURE_FUNC static size_t arrangement_cycle_length(
+        const Arrangement *restrict arr,
+        uint32_t h)
+{
+        uint32_t g = h;
+        size_t length = 0;
+
+        do {
+                g = arrangement_half(arr, g)->next;
+                ++length;
+        } while (g != h);
+
+        return length;
+}
+
+PURE_FUNC static bool arrangement_cycle_contains(
+        const Arrangement *restrict arr,
+        uint32_t h,
+        uint32_t target)
+{
+        uint32_t g = h;
+
+        do {
+                if (g == target) {
+                        return true;
+                }
+                g = arrangement_half(arr, g)->next;
+        } while (g != h);
+
+        return false;
+}
+
+static void arrangement_hole_add(Arrangement *restrict arr,
+                                 uint32_t f,
+                                 uint32_t h)
+{
+        ArrangementFace *face = &arr->faces[f];
+        ArrangementHalfEdge *half = arrangement_half(arr, h), *head;
+
+        if (face->hole == ARRANGEMENT_NIL) {
+                half->next_hole = h;
+                half->prev_hole = h;
+                face->hole = h;
+                return;
+        }
+
+        head = arrangement_half(arr, face->hole);
+        half->next_hole = face->hole;
+        half->prev_hole = head->prev_hole;
+        arrangement_half(arr, head->prev_hole)->next_hole = h;
+        head->prev_hole = h;
+}
+
+static void arrangement_hole_remove(Arrangement *restrict arr,
+                                    uint32_t f,
+                                    uint32_t h)
+{
+        ArrangementFace *face = &arr->faces[f];
+        ArrangementHalfEdge *half = arrangement_half(arr, h);
+
+        if (half->next_hole == h) {
+                face->hole = ARRANGEMENT_NIL;
+        } else {
+                arrangement_half(arr, half->prev_hole)->next_hole =
+                        half->next_hole;
+                arrangement_half(arr, half->next_hole)->prev_hole =
+                        half->prev_hole;
+                if (face->hole == h) {
+                        face->hole = half->next_hole;
+                }
+        }
+        half->next_hole = ARRANGEMENT_NIL;
+        half->prev_hole = ARRANGEMENT_NIL;
+}
+
+// Moves the holes of face f that lie inside the cycle through h to face g,
+// or all of them if h is ARRANGEMENT_NIL.
+static void arrangement_move_holes(Arrangement *restrict arr,
+                                   uint32_t f,
+                                   uint32_t g,
+                                   uint32_t h)
+{
+        const uint32_t head = arr->faces[f].hole;
+        ArrangementHalfEdge *half;
+        uint32_t r = head, next;
+
+        if (head == ARRANGEMENT_NIL) {
+                return;
+        }
+
+        // holes don't touch the cycle, so any of their vertices will do
+        arr->faces[f].hole = ARRANGEMENT_NIL;
+        do {
+                half = arrangement_half(arr, r);
+                next = half->next_hole;
+                half->next_hole = ARRANGEMENT_NIL;
+                half->prev_hole = ARRANGEMENT_NIL;
+                if (h == ARRANGEMENT_NIL
+                    || arrangement_cycle_winding(
+                               arr,
+                               h,
+                               &arr->vertices[half->origin].position)) {
+                        arrangement_cycle_set_face(arr, r, g);
+                        arrangement_hole_add(arr, g, r);
+                } else {
+                        arrangement_hole_add(arr, f, r);
+                }
+                r = next;
+        } while (r != head);
+}
+
+// Makes sure that an edge and a face can be allocated.
+static int arrangement_reserve(Arrangement *restrict arr,
+                               Reallocator *reallocator,
+                               void *user)
+{
+        size_t edges_sz = arr->edges_sz, faces_sz = arr->faces_sz;
+        ArrangementEdge *edges = arr->edges;
+        ArrangementFace *faces = arr->faces;
+
+        assert(arr->edge_count < UINT32_MAX / 2);
+        if (arr->free_edge == ARRANGEMENT_NIL && arr->edge_count == edges_sz
+            && !auxiliary_realloc(reallocator,
+                                  &edges_sz,
+                                  &edges,
+                                  &arr->edges_sz,
+                                  &arr->edges,
+                                  edges_sz + 1,
+                                  user)) {
+                return -1;
+        }
+        if (arr->free_face == ARRANGEMENT_NIL && arr->face_count == faces_sz
+            && !auxiliary_realloc(reallocator,
+                                  &faces_sz,
+                                  &faces,
+                                  &arr->faces_sz,
+                                  &arr->faces,
+                                  faces_sz + 1,
+                                  user)) {
+                return -1;
+        }
+
+        return 0;
+}
+
+// Hands out an edge; arrangement_reserve() must have been called.
+static uint32_t arrangement_new_edge(Arrangement *restrict arr)
+{
+        uint32_t e = arr->free_edge;
+
+        if (e == ARRANGEMENT_NIL) {
+                return arr->edge_count++;
+        }
+        arr->free_edge = arr->edges[e].half[0].next;
+        return e;
+}
+
+// Hands out a face; arrangement_reserve() must have been called.
+static uint32_t arrangement_new_face(Arrangement *restrict arr)
+{
+        uint32_t f = arr->free_face;
+
+        if (f == ARRANGEMENT_NIL) {
+                f = arr->face_count++;
+        } else {
+                arr->free_face = arr->faces[f].hole;
+        }
+        arr->faces[f].outer = ARRANGEMENT_NIL;
+        arr->faces[f].hole = ARRANGEMENT_NIL;
+        return f;
+}
+
+void arrangement_init(Arrangement *restrict arr,
+                      size_t faces_sz,
+                      ArrangementFace faces[static restrict faces_sz])
+{
+        assert(faces_sz >= 1);
+
+        arr->vertex_count = 0;
+        arr->edge_count = 0;
+        arr->face_count = 1;
+        arr->free_edge = ARRANGEMENT_NIL;
+        arr->free_face = ARRANGEMENT_NIL;
+        arr->vertices_sz = 0;
+        arr->vertices = NULL;
+        arr->edges_sz = 0;
+        arr->edges = NULL;
+        arr->faces_sz = faces_sz;
+        arr->faces = faces;
+        faces[ARRANGEMENT_UNBOUNDED].outer = ARRANGEMENT_NIL;
+        faces[ARRANGEMENT_UNBOUNDED].hole = ARRANGEMENT_NIL;
+}
+
+uint32_t arrangement_add_vertex(Arrangement *restrict arr,
+                                const vec2d *restrict position,
+                                Reallocator *reallocator,
+                                void *user)
+{
+        size_t vertices_sz = arr->vertices_sz;
+        ArrangementVertex *vertices = arr->vertices;
+
+        assert(arr->vertex_count < ARRANGEMENT_NIL);
+        if (arr->vertex_count == vertices_sz
+            && !auxiliary_realloc(reallocator,
+                                  &vertices_sz,
+                                  &vertices,
+                                  &arr->vertices_sz,
+                                  &arr->vertices,
+                                  vertices_sz + 1,
+                                  user)) {
+                return ARRANGEMENT_NIL;
+        }
+
+        arr->vertices[arr->vertex_count].position = *position;
+        arr->vertices[arr->vertex_count].edge = ARRANGEMENT_NIL;
+        return arr->vertex_count++;
+}
+
+// Inserts the outgoing half-edge h and its twin into the rotation at the
+// origin of h, returning the incoming half-edge now followed by h.
+static uint32_t arrangement_link(Arrangement *restrict arr, uint32_t h)
+{
+        ArrangementHalfEdge *half = arrangement_half(arr, h);
+        ArrangementVertex *v = &arr->vertices[half->origin];
+        uint32_t g, p;
+
+        if (v->edge == ARRANGEMENT_NIL) {
+                // a dangling end turns around
+                v->edge = h;
+                half->prev = h ^ 1;
+                arrangement_half(arr, h ^ 1)->next = h;
+                return ARRANGEMENT_NIL;
+        }
+
+        g = arrangement_wedge(arr, half->origin, arrangement_angle(arr, h));
+        p = arrangement_half(arr, g)->prev;
+        arrangement_half(arr, p)->next = h;
+        half->prev = p;
+        arrangement_half(arr, h ^ 1)->next = g;
+        arrangement_half(arr, g)->prev = h ^ 1;
+
+        return p;
+}
+
+uint32_t arrangement_add_edge(Arrangement *restrict arr,
+                              uint32_t u,
+                              uint32_t v,
+                              size_t n,
+                              const vec2d control[static restrict n],
+                              uint32_t curve,
+                              Reallocator *reallocator,
+                              void *user)
+{
+        ArrangementEdge *edge;
+        ArrangementHalfEdge *half;
+        uint32_t e, h, t, f, g, pu, pv, ru, rv, keep, split;
+        bool closes;
+        double area_h, area_t;
+        size_t i;
+
+        assert(u != v);
+        assert(n >= 2 && n <= ARRANGEMENT_MAX_CONTROL_POINTS);
+
+        if (arrangement_reserve(arr, reallocator, user)) {
+                return ARRANGEMENT_NIL;
+        }
+
+        e = arrangement_new_edge(arr);
+        h = 2 * e;
+        t = h ^ 1;
+        edge = &arr->edges[e];
+        for (i = 0; i < n; ++i) {
+                edge->control[i] = control[i];
+        }
+        edge->count = n;
+        edge->curve = curve;
+        traverse_array(half, edge->half) {
+                half->next_hole = ARRANGEMENT_NIL;
+                half->prev_hole = ARRANGEMENT_NIL;
+        }
+        edge->half[0].origin = u;
+        edge->half[1].origin = v;
+
+        // find the face the edge runs through, and whether the wedges at
+        // both ends belong to the same cycle before anything is relinked
+        pu = pv = ARRANGEMENT_NIL;
+        if (arr->vertices[u].edge != ARRANGEMENT_NIL) {
+                g = arrangement_wedge(arr, u, arrangement_angle(arr, h));
+                pu = arrangement_half(arr, g)->prev;
+        }
+        if (arr->vertices[v].edge != ARRANGEMENT_NIL) {
+                g = arrangement_wedge(arr, v, arrangement_angle(arr, t));
+                pv = arrangement_half(arr, g)->prev;
+        }
+        if (pu != ARRANGEMENT_NIL) {
+                f = arrangement_half(arr, pu)->face;
+        } else if (pv != ARRANGEMENT_NIL) {
+                f = arrangement_half(arr, pv)->face;
+        } else {
+                f = arrangement_locate(arr, &arr->vertices[u].position);
+        }
+        assert(pu == ARRANGEMENT_NIL || pv == ARRANGEMENT_NIL
+               || arrangement_half(arr, pu)->face
+                          == arrangement_half(arr, pv)->face);
+
+        ru = rv = ARRANGEMENT_NIL;
+        closes = false;
+        if (pu != ARRANGEMENT_NIL && pv != ARRANGEMENT_NIL) {
+                closes = arrangement_cycle_contains(arr, pu, pv);
+                ru = arrangement_cycle_rep(arr, pu);
+                if (!closes) {
+                        rv = arrangement_cycle_rep(arr, pv);
+                }
+        }
+
+        edge->half[0].face = f;
+        edge->half[1].face = f;
+        edge->half[0].next = t;
+        edge->half[1].prev = h;
+        edge->half[1].next = h;
+        edge->half[0].prev = t;
+        arrangement_link(arr, h);
+        arrangement_link(arr, t);
+
+        if (pu == ARRANGEMENT_NIL && pv == ARRANGEMENT_NIL) {
+                // a new component
+                arrangement_hole_add(arr, f, h);
+                return h;
+        }
+        if (!closes) {
+                // Two cycles were joined, at most one of which was the outer
+                // boundary. Otherwise one end was dangling and the cycle
+                // just grew.
+                if (rv != ARRANGEMENT_NIL) {
+                        arrangement_hole_remove(arr,
+                                                f,
+                                                ru == arr->faces[f].outer ? rv
+                                                                          : ru);
+                }
+                return h;
+        }
+
+        // The cycle was closed, and the new face goes to one of the two
+        // cycles now through h and t.
+        g = arrangement_new_face(arr);
+        if (ru == arr->faces[f].outer) {
+                // the old face keeps the longer boundary
+                if (arrangement_cycle_length(arr, h)
+                    < arrangement_cycle_length(arr, t)) {
+                        keep = t;
+                        split = h;
+                } else {
+                        keep = h;
+                        split = t;
+                }
+                arr->faces[f].outer = keep;
+                arr->faces[g].outer = split;
+                arrangement_cycle_set_face(arr, split, g);
+                arrangement_move_holes(arr, f, g, split);
+                return h;
+        }
+
+        // A hole was closed into a loop: the counter-clockwise cycle bounds
+        // the new face, the other one remains a hole.
+        arrangement_hole_remove(arr, f, ru);
+        area_h = arrangement_cycle_area(arr, h);
+        area_t = arrangement_cycle_area(arr, t);
+        keep = area_h > area_t ? t : h;
+        split = area_h > area_t ? h : t;
+        arr->faces[g].outer = split;
+        arrangement_cycle_set_face(arr, split, g);
+        arrangement_move_holes(arr, f, g, split);
+        arrangement_hole_add(arr, f, keep);
+
+        return h;
+}
+
+uint32_t arrangement_split_edge(Arrangement *restrict arr,
+                                uint32_t e,
+                                double t,
+                                Reallocator *reallocator,
+                                void *user)
+{
+        ArrangementEdge *edge, *next_edge;
+        ArrangementHalfEdge *h0, *h1, *g0, *g1;
+        vec2d left[ARRANGEMENT_MAX_CONTROL_POINTS];
+        vec2d right[ARRANGEMENT_MAX_CONTROL_POINTS];
+        uint32_t w, e2, b, x, q;
+        size_t i;
+
+        assert(t > 0 && t < 1);
+
+        edge = &arr->edges[e];
+        for (i = 0; i < edge->count; ++i) {
+                right[i] = edge->control[i];
+        }
+        de_casteljau(t, edge->count, right, left);
+        if (arrangement_reserve(arr, reallocator, user)) {
+                return ARRANGEMENT_NIL;
+        }
+        w = arrangement_add_vertex(arr, &right[0], reallocator, user);
+        if (w == ARRANGEMENT_NIL) {
+                return ARRANGEMENT_NIL;
+        }
+
+        e2 = arrangement_new_edge(arr);
+        edge = &arr->edges[e];
+        next_edge = &arr->edges[e2];
+        next_edge->count = edge->count;
+        next_edge->curve = edge->curve;
+        for (i = 0; i < edge->count; ++i) {
+                edge->control[i] = left[i];
+                next_edge->control[i] = right[i];
+        }
+
+        // e now runs from its origin a to w, e2 from w to b
+        h0 = &edge->half[0];
+        h1 = &edge->half[1];
+        g0 = &next_edge->half[0];
+        g1 = &next_edge->half[1];
+        b = h1->origin;
+        x = h0->next == 2 * e + 1 ? 2 * e2 + 1 : h0->next;
+        q = h1->prev == 2 * e ? 2 * e2 : h1->prev;
+
+        g0->origin = w;
+        g0->face = h0->face;
+        g0->next_hole = ARRANGEMENT_NIL;
+        g0->prev_hole = ARRANGEMENT_NIL;
+        g1->origin = b;
+        g1->face = h1->face;
+        g1->next_hole = ARRANGEMENT_NIL;
+        g1->prev_hole = ARRANGEMENT_NIL;
+        h1->origin = w;
+
+        g0->next = x;
+        arrangement_half(arr, x)->prev = 2 * e2;
+        g1->prev = q;
+        arrangement_half(arr, q)->next = 2 * e2 + 1;
+        h0->next = 2 * e2;
+        g0->prev = 2 * e;
+        g1->next = 2 * e + 1;
+        h1->prev = 2 * e2 + 1;
+
+        if (arr->vertices[b].edge == 2 * e + 1) {
+                arr->vertices[b].edge = 2 * e2 + 1;
+        }
+        arr->vertices[w].edge = 2 * e2;
+
+        return w;
+}
+
+// Takes the half-edge h and its twin out of the rotation at the origin of h,
+// returning the incoming half-edge that preceded h, or ARRANGEMENT_NIL if
+// the origin is left isolated.
+static uint32_t arrangement_unlink(Arrangement *restrict arr, uint32_t h)
+{
+        ArrangementHalfEdge *half = arrangement_half(arr, h);
+        ArrangementVertex *v = &arr->vertices[half->origin];
+        uint32_t p = half->prev, n = arrangement_half(arr, h ^ 1)->next;
+
+        if (p == (h ^ 1)) {
+                v->edge = ARRANGEMENT_NIL;
+                return ARRANGEMENT_NIL;
+        }
+
+        arrangement_half(arr, p)->next = n;
+        arrangement_half(arr, n)->prev = p;
+        v->edge = n;
+
+        return p;
+}
+
+void arrangement_remove_edge(Arrangement *restrict arr, uint32_t e)
+{
+        const uint32_t h = 2 * e, t = h ^ 1;
+        const uint32_t fh = arrangement_half(arr, h)->face;
+        const uint32_t ft = arrangement_half(arr, t)->face;
+        uint32_t rh, rt, keep, drop, pu, pv, rep;
+        bool hole;
+        double area_u, area_v;
+
+        assert(arr->edges[e].count > 0);
+
+        rh = arrangement_cycle_rep(arr, h);
+        if (fh != ft) {
+                // The cycles on both sides are merged. If one of them is a
+                // hole, the other side is the face inside it, and the merged
+                // cycle remains a hole of the outside face.
+                rt = arrangement_cycle_rep(arr, t);
+                hole = rh != arr->faces[fh].outer || rt != arr->faces[ft].outer;
+                if (rh != arr->faces[fh].outer) {
+                        keep = fh;
+                        drop = ft;
+                        arrangement_hole_remove(arr, fh, rh);
+                } else if (rt != arr->faces[ft].outer) {
+                        keep = ft;
+                        drop = fh;
+                        arrangement_hole_remove(arr, ft, rt);
+                } else {
+                        keep = fh;
+                        drop = ft;
+                }
+                arrangement_cycle_set_face(arr, arr->faces[drop].outer, keep);
+                arrangement_move_holes(arr, drop, keep, ARRANGEMENT_NIL);
+                arr->faces[drop].outer = ARRANGEMENT_NIL;
+                arr->faces[drop].hole = arr->free_face;
+                arr->free_face = drop;
+
+                pu = arrangement_unlink(arr, h);
+                pv = arrangement_unlink(arr, t);
+                rep = pu != ARRANGEMENT_NIL ? pu : pv;
+                if (hole) {
+                        arrangement_hole_add(arr, keep, rep);
+                } else {
+                        arr->faces[keep].outer = rep;
+                }
+        } else {
+                // The cycle falls apart into the parts at both ends. An
+                // outer boundary keeps the part enclosing the other one,
+                // which becomes a hole.
+                hole = rh != arr->faces[fh].outer;
+                if (hole) {
+                        arrangement_hole_remove(arr, fh, rh);
+                } else {
+                        arr->faces[fh].outer = ARRANGEMENT_NIL;
+                }
+                pu = arrangement_unlink(arr, h);
+                pv = arrangement_unlink(arr, t);
+                if (!hole && pu != ARRANGEMENT_NIL && pv != ARRANGEMENT_NIL) {
+                        area_u = arrangement_cycle_area(arr, pu);
+                        area_v = arrangement_cycle_area(arr, pv);
+                        if (area_u < area_v) {
+                                swap(pu, pv, rep);
+                        }
+                        arr->faces[fh].outer = pu;
+                        arrangement_hole_add(arr, fh, pv);
+                } else if (!hole) {
+                        assert(pu != ARRANGEMENT_NIL || pv != ARRANGEMENT_NIL);
+                        arr->faces[fh].outer = pu != ARRANGEMENT_NIL ? pu : pv;
+                } else {
+                        if (pu != ARRANGEMENT_NIL) {
+                                arrangement_hole_add(arr, fh, pu);
+                        }
+                        if (pv != ARRANGEMENT_NIL) {
+                                arrangement_hole_add(arr, fh, pv);
+                        }
+                }
+        }
+
+        arr->edges[e].count = 0;
+        arr->edges[e].half[0].next = arr->free_edge;
+        arr->free_edge = e;
+}
+
+PURE_FUNC uint32_t arrangement_locate(const Arrangement *restrict arr,
+                                      const vec2d *restrict point)
+{
+        uint32_t f, best = ARRANGEMENT_UNBOUNDED;
+        double area, best_area = DBL_MAX;
+
+        // the smallest outer boundary around the point is the face's own
+        for (f = 0; f < arr->face_count; ++f) {
+                if (arr->faces[f].outer == ARRANGEMENT_NIL
+                    || !arrangement_cycle_winding(arr,
+                                                  arr->faces[f].outer,
+                                                  point)) {
+                        continue;
+                }
+                area = arrangement_cycle_area(arr, arr->faces[f].outer);
+                if (area < best_area) {
+                        best_area = area;
+                        best = f;
+                }
+        }
+
+        return best;
+}
@@ -0,0 +1,216 @@
+/*! \file arrangement.h
+ *  \brief Planar arrangement of subcurves
+ *
+ *  Keeps the faces cut out of the plane by a set of curves, so that the
+ *  areas between curves are known without recomputing them after every
+ *  edit. The arrangement is a doubly connected edge list: every edge is a
+ *  bezier curve between two vertices and is made of two half-edges running
+ *  in opposite directions, each of which bounds the face on its left. The
+ *  half-edges around a face form cycles: one for its outer boundary, which
+ *  runs counter-clockwise, and one for each hole in it, which runs
+ *  clockwise. The unbounded face has no outer boundary.
+ *
+ *  Edges must not cross each other or pass through vertices; curves are
+ *  split at their intersections with arrangement_split_edge() before they
+ *  are connected. Inserting or removing an edge only walks the cycles it
+ *  touches: a face is split in two when an edge closes a cycle and merged
+ *  when such an edge is removed, and only the holes of the affected face are
+ *  tested for which side they end up on. Only inserting an edge between two
+ *  isolated vertices needs to locate its face among all faces.
+ *
+ *  Half-edge `h` belongs to edge `h / 2`, and its twin is `h ^ 1`. Half-edge
+ *  `2 * e` runs from the first control point of edge `e` to its last one.
+ *  Vertices, edges and faces are kept in arrays owned by the user, grown
+ *  through the usual reallocator protocol (see algo.h). Removed edges and
+ *  faces are recycled; vertices stay until the arrangement is dropped.
+ */
+#ifndef TIE_ARRANGEMENT_H
+#define TIE_ARRANGEMENT_H
+
+#include <stdint.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "math.h"
+
+#define ARRANGEMENT_NIL UINT32_MAX
+#define ARRANGEMENT_MAX_CONTROL_POINTS 4
+// The unbounded face, which always exists.
+#define ARRANGEMENT_UNBOUNDED 0
+
+typedef struct {
+        vec2d position;
+        uint32_t edge; // an outgoing half-edge, ARRANGEMENT_NIL if isolated
+} ArrangementVertex;
+
+typedef struct {
+        uint32_t origin;
+        uint32_t next; // the next half-edge around the face
+        uint32_t prev;
+        uint32_t face; // the face on the left
+        // Circular list of the holes of the face, through one half-edge of
+        // each hole. ARRANGEMENT_NIL for all other half-edges.
+        uint32_t next_hole;
+        uint32_t prev_hole;
+} ArrangementHalfEdge;
+
+typedef struct {
+        vec2d control[ARRANGEMENT_MAX_CONTROL_POINTS];
+        uint32_t count; // amount of control points, 0 if free
+        uint32_t curve; // user ID of the curve, e.g. the subcurve object
+        ArrangementHalfEdge half[2];
+} ArrangementEdge;
+
+typedef struct {
+        // A half-edge of the outer boundary. ARRANGEMENT_NIL for the
+        // unbounded face and for free faces.
+        uint32_t outer;
+        // A half-edge of the first hole, ARRANGEMENT_NIL if there are none.
+        // The next free face if free.
+        uint32_t hole;
+} ArrangementFace;
+
+typedef struct {
+        uint32_t vertex_count;
+        uint32_t edge_count; // edges handed out from `edges` so far
+        uint32_t face_count; // faces handed out from `faces` so far
+        uint32_t free_edge; // head of the free edge list
+        uint32_t free_face; // head of the free face list
+        size_t vertices_sz;
+        ArrangementVertex *vertices;
+        size_t edges_sz;
+        ArrangementEdge *edges;
+        size_t faces_sz;
+        ArrangementFace *faces;
+} Arrangement;
+
+/*! \brief Returns a half-edge of an arrangement by its ID.
+ */
+PURE_FUNC static inline ArrangementHalfEdge *arrangement_half(
+        const Arrangement *arr,
+        uint32_t h)
+{
+        return &arr->edges[h >> 1].half[h & 1];
+}
+
+/*! \brief Initializes an arrangement with just the unbounded face.
+ *
+ *  \param[out] arr The arrangement to initialize.
+ *  \param[in] faces_sz Size of the `faces` array. Must be at least 1.
+ *  \param[in] faces The face array. Must come from an allocator compatible
+ *  with the reallocator later passed to the modifying routines. The vertex
+ *  and edge arrays start out empty.
+ */
+extern void arrangement_init(Arrangement *restrict arr,
+                             size_t faces_sz,
+                             ArrangementFace faces[static restrict faces_sz]);
+
+/*! \brief Adds an isolated vertex.
+ *
+ *  \param[in,out] arr The arrangement.
+ *  \param[in] position The position of the vertex.
+ *  \param[in] reallocator Reallocator for the arrays of the arrangement.
+ *  May be NULL, in which case the function fails when they become full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return The ID of the vertex, or #ARRANGEMENT_NIL on allocation failure.
+ */
+extern uint32_t arrangement_add_vertex(Arrangement *restrict arr,
+                                       const vec2d *restrict position,
+                                       Reallocator *reallocator,
+                                       void *user);
+
+/*! \brief Connects two vertices with a curve.
+ *
+ *  The curve must not cross any edge or pass through any vertex of the
+ *  arrangement other than at its endpoints, which must differ. If it closes
+ *  a cycle, the face it runs through is split in two; the part on the
+ *  left of the returned half-edge keeps the old face unless that part is a
+ *  new bounded region inside a hole. Runs in time linear in the length of
+ *  the boundaries it touches and the amount of holes in its face, or in the
+ *  size of the arrangement if both vertices are isolated.
+ *
+ *  \param[in,out] arr The arrangement.
+ *  \param[in] u The vertex at the start of the curve.
+ *  \param[in] v The vertex at the end of the curve.
+ *  \param[in] n The amount of control points. Must be at least 2 and at
+ *  most #ARRANGEMENT_MAX_CONTROL_POINTS.
+ *  \param[in] control The control points. The first one must be the
+ *  position of `u` and the last one the position of `v`.
+ *  \param[in] curve User ID of the curve.
+ *  \param[in] reallocator See arrangement_add_vertex().
+ *  \param[in,out] user See arrangement_add_vertex().
+ *
+ *  \return The half-edge from `u` to `v`, or #ARRANGEMENT_NIL on
+ *  allocation failure, in which case the arrangement is left unchanged.
+ */
+extern uint32_t arrangement_add_edge(Arrangement *restrict arr,
+                                     uint32_t u,
+                                     uint32_t v,
+                                     size_t n,
+                                     const vec2d control[static restrict n],
+                                     uint32_t curve,
+                                     Reallocator *reallocator,
+                                     void *user);
+
+/*! \brief Splits an edge in two at a parameter of its curve.
+ *
+ *  The edge keeps the part before the parameter and a new edge with the
+ *  same curve ID takes the part after it. Faces don't change. Runs in
+ *  constant time.
+ *
+ *  \param[in,out] arr The arrangement.
+ *  \param[in] e The edge.
+ *  \param[in] t The parameter, strictly between 0 and 1.
+ *  \param[in] reallocator See arrangement_add_vertex().
+ *  \param[in,out] user See arrangement_add_vertex().
+ *
+ *  \return The new vertex, or #ARRANGEMENT_NIL on allocation failure, in
+ *  which case the arrangement is left unchanged.
+ */
+extern uint32_t arrangement_split_edge(Arrangement *restrict arr,
+                                       uint32_t e,
+                                       double t,
+                                       Reallocator *reallocator,
+                                       void *user);
+
+/*! \brief Removes an edge.
+ *
+ *  If the faces on both sides of the edge differ, they're merged into one.
+ *  Runs in time linear in the length of the boundaries it touches and the
+ *  amount of holes in the faces. Never allocates.
+ *
+ *  \param[in,out] arr The arrangement.
+ *  \param[in] e The edge.
+ */
+extern void arrangement_remove_edge(Arrangement *restrict arr, uint32_t e);
+
+/*! \brief Finds the face containing a point.
+ *
+ *  Tests the point against the outer boundary of every face, so it runs in
+ *  time linear in the size of the arrangement. The point must not lie on an
+ *  edge.
+ *
+ *  \param[in] arr The arrangement.
+ *  \param[in] point The point.
+ *
+ *  \return The face.
+ */
+extern PURE_FUNC uint32_t arrangement_locate(const Arrangement *restrict arr,
+                                             const vec2d *restrict point);
+
+/*! \brief Computes the signed area enclosed by the cycle through a half-edge.
+ *
+ *  Curves are approximated by line strips, which is exact enough to tell
+ *  outer boundaries from holes. Runs in time linear in the length of the
+ *  cycle.
+ *
+ *  \param[in] arr The arrangement.
+ *  \param[in] h The half-edge.
+ *
+ *  \return The area, positive for outer boundaries.
+ */
+extern PURE_FUNC double arrangement_cycle_area(const Arrangement *restrict arr,
+                                               uint32_t h);
+
+#endif
@@ -0,0 +1,214 @@
+#include <assert.h>
+#include <string.h>
+
+#include "algo.h"
+#include "autosave.h"
+#include "memalloc.h"
+
+// Tests whether an array stays where it is while it grows (see autosave.h).
+// Arrays that were never grown are NULL.
+static inline bool autosave_pinned(const Autosave *restrict autosave,
+                                   const void *p)
+{
+        return !p || history_pager_owns(autosave->pager, p);
+}
+
+static int autosave_main(void *arg)
+{
+        Autosave *autosave = arg;
+        TieFileStatus status;
+
+        mtx_lock(&autosave->lock);
+        for (;;) {
+                while (!autosave->busy && !autosave->quit) {
+                        cnd_wait(&autosave->wake, &autosave->lock);
+                }
+                if (!autosave->busy) {
+                        break;
+                }
+                mtx_unlock(&autosave->lock);
+
+                // the view is only changed by autosave_request() once the
+                // save is done
+                status = tiefile_write_temporary(autosave->temporary,
+                                                 &autosave->snapshot,
+                                                 &autosave->store,
+                                                 &autosave->position,
+                                                 NULL);
+                if (status == TIEFILE_OK) {
+                        status = autosave->journal
+                                       ? journal_replace(autosave->journal,
+                                                         autosave->temporary,
+                                                         autosave->path)
+                                       : tiefile_replace(autosave->temporary,
+                                                         autosave->path);
+                }
+
+                mtx_lock(&autosave->lock);
+                autosave->status = status;
+                ++autosave->saves;
+                autosave->busy = false;
+                cnd_broadcast(&autosave->wake);
+        }
+        mtx_unlock(&autosave->lock);
+
+        return 0;
+}
+
+TieFileStatus autosave_start(Autosave *restrict autosave,
+                             const char *restrict path,
+                             Journal *journal,
+                             const HistoryPager *pager)
+{
+        size_t length = strlen(path);
+
+        autosave->path = tie_malloc(length + 1, 1);
+        // distinct from the temporary file of tiefile_save(), which a
+        // checkpoint may be writing meanwhile
+        autosave->temporary = tie_malloc(length + sizeof(".autosave"), 1);
+        // the reallocator grows arrays from a nonzero size
+        autosave->tree_sz = 1;
+        autosave->tree = tie_malloc(autosave->tree_sz,
+                                    sizeof(*autosave->tree));
+        if (!autosave->path || !autosave->temporary || !autosave->tree) {
+                tie_free(autosave->tree);
+                tie_free(autosave->path);
+                tie_free(autosave->temporary);
+                return TIEFILE_NO_MEMORY;
+        }
+        memcpy(autosave->path, path, length + 1);
+        memcpy(autosave->temporary, path, length);
+        memcpy(autosave->temporary + length,
+               ".autosave",
+               sizeof(".autosave"));
+        autosave->journal = journal;
+        autosave->pager = pager;
+        autosave->position = (JournalPosition){ 0 };
+        autosave->quit = false;
+        autosave->busy = false;
+        autosave->status = TIEFILE_OK;
+        autosave->saves = 0;
+
+        if (mtx_init(&autosave->lock, mtx_plain) != thrd_success) {
+                tie_free(autosave->tree);
+                tie_free(autosave->temporary);
+                tie_free(autosave->path);
+                return TIEFILE_NO_MEMORY;
+        }
+        if (cnd_init(&autosave->wake) != thrd_success) {
+                mtx_destroy(&autosave->lock);
+                tie_free(autosave->tree);
+                tie_free(autosave->temporary);
+                tie_free(autosave->path);
+                return TIEFILE_NO_MEMORY;
+        }
+        if (thrd_create(&autosave->thread, autosave_main, autosave)
+            != thrd_success) {
+                cnd_destroy(&autosave->wake);
+                mtx_destroy(&autosave->lock);
+                tie_free(autosave->tree);
+                tie_free(autosave->temporary);
+                tie_free(autosave->path);
+                return TIEFILE_NO_MEMORY;
+        }
+
+        return TIEFILE_OK;
+}
+
+void autosave_stop(Autosave *restrict autosave)
+{
+        mtx_lock(&autosave->lock);
+        autosave->quit = true;
+        cnd_broadcast(&autosave->wake);
+        mtx_unlock(&autosave->lock);
+
+        thrd_join(autosave->thread, NULL);
+        cnd_destroy(&autosave->wake);
+        mtx_destroy(&autosave->lock);
+        tie_free(autosave->tree);
+        tie_free(autosave->temporary);
+        tie_free(autosave->path);
+}
+
+TieFileStatus autosave_request(Autosave *restrict autosave,
+                               const History *restrict history,
+                               ObjectStore *restrict store)
+{
+        Reallocator *reallocator = auxiliary_reallocator;
+        TieFileStatus status;
+        size_t tree_sz;
+        LinearHistory *tree;
+        bool busy;
+
+        assert(autosave_pinned(autosave, history->entries.address));
+        assert(autosave_pinned(autosave, history->tree.address));
+        assert(autosave_pinned(autosave, store->nodes));
+        assert(autosave_pinned(autosave, store->objects));
+        assert(autosave_pinned(autosave, store->generations));
+        assert(autosave_pinned(autosave, store->links));
+
+        mtx_lock(&autosave->lock);
+        busy = autosave->busy;
+        mtx_unlock(&autosave->lock);
+        // only this thread starts saves, so the view is free from here on
+        if (busy) {
+                return TIEFILE_BUSY;
+        }
+        if (autosave->journal) {
+                status = journal_mark(autosave->journal, &autosave->position);
+                if (status != TIEFILE_OK) {
+                        return status;
+                }
+        }
+
+        if (history->tree_size > autosave->tree_sz) {
+                tree_sz = autosave->tree_sz;
+                tree = autosave->tree;
+                if (!auxiliary_realloc(reallocator,
+                                       &tree_sz,
+                                       &tree,
+                                       &autosave->tree_sz,
+                                       &autosave->tree,
+                                       history->tree_size,
+                                       NULL)) {
+                        return TIEFILE_NO_MEMORY;
+                }
+        }
+        if (history->tree_size > 0) {
+                memcpy(autosave->tree,
+                       history->tree.address,
+                       history->tree_size * sizeof(*autosave->tree));
+        }
+        autosave->snapshot = *history;
+        autosave->snapshot.capacity = history->size;
+        autosave->snapshot.tree.address = autosave->tree;
+        autosave->snapshot.tree_capacity = history->tree_size;
+        object_store_begin(store);
+        autosave->store = *store;
+
+        mtx_lock(&autosave->lock);
+        autosave->busy = true;
+        cnd_broadcast(&autosave->wake);
+        mtx_unlock(&autosave->lock);
+
+        return TIEFILE_OK;
+}
+
+TieFileStatus autosave_poll(Autosave *restrict autosave,
+                            uint64_t *restrict psaves,
+                            bool *restrict pbusy)
+{
+        TieFileStatus status;
+
+        mtx_lock(&autosave->lock);
+        status = autosave->status;
+        if (psaves) {
+                *psaves = autosave->saves;
+        }
+        if (pbusy) {
+                *pbusy = autosave->busy;
+        }
+        mtx_unlock(&autosave->lock);
+
+        return status;
+}
@@ -0,0 +1,118 @@
+/*! \file autosave.h
+ *  \brief Saving the history in the background
+ *
+ *  Autosaving rewrites the .tie file of a document with tiefile_save() on a
+ *  thread of its own, while the editor keeps changing the history. The
+ *  history and its object store only grow: entries, nodes and objects are
+ *  appended, and those of earlier edits never change afterwards (see
+ *  objectstore.h). A consistent view of them is therefore the header of the
+ *  history, a copy of its tree of linear histories, which are few, the
+ *  counts of the store, and their first items where they lie. Taking that
+ *  view pauses the editor for the time it takes to copy the tree, whatever
+ *  the amount of entries and objects.
+ *
+ *  A save goes through the journal of the document, if any (see journal.h):
+ *  the view is taken at a mark of the journal, which the saved file
+ *  remembers, so that reopening the document replays exactly the records
+ *  added while the save was running. Once the file is replaced, the
+ *  records it holds are dropped from the journal. Saves are written to a
+ *  temporary file of their own, and only replace the file if no checkpoint
+ *  saved a later history meanwhile.
+ *
+ *  Since the view is read where it lies, the arrays of the history and of
+ *  the store must not move while they're being saved: they must be grown
+ *  with history_pager_reallocator() (see pager.h) of the pager the autosave
+ *  is started with, which autosave_request() checks.
+ */
+#ifndef TIE_AUTOSAVE_H
+#define TIE_AUTOSAVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include "core.h"
+#include "journal.h"
+#include "objectstore.h"
+#include "pager.h"
+#include "tiefile.h"
+
+typedef struct {
+        char *path;
+        char *temporary;
+        Journal *journal;
+        const HistoryPager *pager;
+        thrd_t thread;
+        mtx_t lock;
+        cnd_t wake;
+        bool quit;
+        bool busy; // a save was requested and isn't done yet
+        TieFileStatus status; // of the last save
+        uint64_t saves; // amount of saves done
+        // The view being saved, whose tree is a copy.
+        History snapshot;
+        ObjectStore store;
+        JournalPosition position;
+        size_t tree_sz;
+        LinearHistory *tree;
+} Autosave;
+
+/*! \brief Starts the thread of an autosave.
+ *
+ *  \param[out] autosave The autosave, to be stopped with autosave_stop().
+ *  Its thread refers to it, so it must not be moved.
+ *  \param[in] path The path of the .tie file, which is copied.
+ *  \param[in,out] journal The journal of the document, which must outlive
+ *  the autosave. May be NULL if there's none.
+ *  \param[in] pager The pager that grows the arrays of the history and of
+ *  its object store, which must outlive the autosave.
+ *
+ *  \return #TIEFILE_OK on success, #TIEFILE_NO_MEMORY if memory or the thread
+ *  couldn't be obtained.
+ */
+extern TieFileStatus autosave_start(Autosave *restrict autosave,
+                                    const char *restrict path,
+                                    Journal *journal,
+                                    const HistoryPager *pager);
+
+/*! \brief Waits for the save in progress, if any, and stops the thread.
+ */
+extern void autosave_stop(Autosave *restrict autosave);
+
+/*! \brief Starts saving a history in the background.
+ *
+ *  Takes a consistent view of the history and its objects in \f$O(t)\f$
+ *  for \f$t\f$ linear histories, and returns. The history and the store may
+ *  be changed as soon as this returns.
+ *
+ *  \param[in,out] autosave The autosave.
+ *  \param[in] history The history, in memory (see history.h), whose
+ *  changes must all be recorded in the journal, if any. Its arrays must
+ *  have been made by the pager of the autosave.
+ *  \param[in,out] store The object store of the history, in which an edit
+ *  begins, so that the objects being saved aren't changed in place. Its
+ *  arrays must have been made by the pager of the autosave.
+ *
+ *  \return #TIEFILE_OK if the save was started, #TIEFILE_BUSY if the
+ *  previous one is still in progress, in which case nothing happens,
+ *  #TIEFILE_NO_MEMORY if the tree couldn't be copied, or an error of
+ *  journal_mark() if the records of the journal couldn't be committed.
+ */
+extern TieFileStatus autosave_request(Autosave *restrict autosave,
+                                      const History *restrict history,
+                                      ObjectStore *restrict store);
+
+/*! \brief Reports on the last save.
+ *
+ *  \param[in,out] autosave The autosave.
+ *  \param[out] psaves The amount of saves done so far. May be NULL.
+ *  \param[out] pbusy Whether a save is in progress. May be NULL.
+ *
+ *  \return The outcome of the last save, #TIEFILE_OK before the first one.
+ */
+extern TieFileStatus autosave_poll(Autosave *restrict autosave,
+                                   uint64_t *restrict psaves,
+                                   bool *restrict pbusy);
+
+#endif
@@ -0,0 +1,383 @@
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "array.h"
+#include "attrib.h"
+#include "bernstein.h"
+#include "numeric.h"
+
+// Parameters evaluated together by bernstein_eval_many().
+#define BERNSTEIN_BLOCK 8
+// Roots closer than this are reported once. Rounding splits a double root
+// into a pair about the square root of the machine epsilon apart.
+#define BERNSTEIN_EPSILON 0x1p-24
+#define BERNSTEIN_MAX_ITERATIONS 64
+
+// An interval of the root isolation stack. Its coefficients are stored
+// separately in the auxiliary array.
+typedef struct {
+        double a;
+        double b;
+        unsigned depth;
+        bool root_at_start;
+} BernsteinRange;
+
+PURE_FUNC double bernstein_eval(size_t n,
+                                const double b[static restrict n],
+                                double t)
+{
+        double s = 1 - t, power = 1, binom = 1, acc = b[0];
+        size_t i;
+
+        // acc = sum of b[i] * binom(d, i) * t^i * s^(d - i), accumulating
+        // the powers of s by multiplying the partial sum on every step
+        for (i = 1; i < n; ++i) {
+                power *= t;
+                binom = binom * (n - i) / i;
+                acc = acc * s + power * binom * b[i];
+        }
+
+        return acc;
+}
+
+void bernstein_eval_many(size_t n,
+                         const double b[static restrict n],
+                         size_t m,
+                         const double t[static restrict m],
+                         double out[static restrict m])
+{
+        double s[BERNSTEIN_BLOCK], power[BERNSTEIN_BLOCK];
+        double acc[BERNSTEIN_BLOCK];
+        double binom;
+        size_t i, j, k, block;
+
+        for (k = 0; k < m; k += BERNSTEIN_BLOCK) {
+                block = min(m - k, (size_t)BERNSTEIN_BLOCK);
+                for (j = 0; j < BERNSTEIN_BLOCK; ++j) {
+                        // pad the last block with a harmless parameter
+                        s[j] = 1 - (j < block ? t[k + j] : 0);
+                        power[j] = 1;
+                        acc[j] = b[0];
+                }
+                binom = 1;
+                for (i = 1; i < n; ++i) {
+                        binom = binom * (n - i) / i;
+                        for (j = 0; j < BERNSTEIN_BLOCK; ++j) {
+                                power[j] *= 1 - s[j];
+                                acc[j] = acc[j] * s[j]
+                                       + power[j] * binom * b[i];
+                        }
+                }
+                for (j = 0; j < block; ++j) {
+                        out[k + j] = acc[j];
+                }
+        }
+}
+
+void bernstein_derivative(size_t n,
+                          const double b[static restrict n],
+                          double out[static restrict n - 1])
+{
+        size_t i;
+
+        assert(n >= 2);
+
+        for (i = 0; i + 1 < n; ++i) {
+                out[i] = (n - 1) * (b[i + 1] - b[i]);
+        }
+}
+
+void bernstein_elevate(size_t n,
+                       const double b[static restrict n],
+                       double out[static restrict n + 1])
+{
+        double r;
+        size_t i;
+
+        out[0] = b[0];
+        for (i = 1; i < n; ++i) {
+                r = (double)i / n;
+                out[i] = r * b[i - 1] + (1 - r) * b[i];
+        }
+        out[n] = b[n - 1];
+}
+
+// Solves the elevation b[i] = (i * c[i - 1] + (d - i) * c[i]) / d for c[i],
+// given c[i - 1].
+static inline double bernstein_reduce_forward(size_t d,
+                                              const double b[static d + 1],
+                                              const double c[static d],
+                                              size_t i)
+{
+        return i == 0 ? b[0] : (d * b[i] - i * c[i - 1]) / (d - i);
+}
+
+// Solves the same for c[i], given c[i + 1].
+static inline double bernstein_reduce_backward(size_t d,
+                                               const double b[static d + 1],
+                                               const double c[static d],
+                                               size_t i)
+{
+        return i == d - 1 ? b[d]
+                          : (d * b[i + 1] - (d - i - 1) * c[i + 1]) / (i + 1);
+}
+
+void bernstein_reduce(size_t n,
+                      const double b[static restrict n],
+                      double out[static restrict n - 1])
+{
+        const size_t d = n - 1;
+        size_t i;
+
+        assert(n >= 2);
+
+        // Each direction amplifies its errors towards the other end, so the
+        // two are only used for their own half, and averaged in the middle.
+        for (i = 0; i < d / 2; ++i) {
+                out[i] = bernstein_reduce_forward(d, b, out, i);
+        }
+        for (i = d; i-- > (d + 1) / 2;) {
+                out[i] = bernstein_reduce_backward(d, b, out, i);
+        }
+        if (d % 2) {
+                i = d / 2;
+                out[i] = (bernstein_reduce_forward(d, b, out, i)
+                          + bernstein_reduce_backward(d, b, out, i))
+                       / 2;
+        }
+}
+
+void bernstein_split(size_t n,
+                     const double b[static restrict n],
+                     double t,
+                     double left[static restrict n],
+                     double right[static restrict n])
+{
+        size_t i, j;
+
+        // Right doubles as the de Casteljau scratch space. The last point of
+        // each level is left in place, which is where it belongs in the
+        // right half.
+        memcpy(right, b, n * sizeof(*b));
+        for (i = 0; i < n; ++i) {
+                left[i] = right[0];
+                for (j = 0; j + 1 < n - i; ++j) {
+                        right[j] += t * (right[j + 1] - right[j]);
+                }
+        }
+}
+
+void bernstein_to_power(size_t n,
+                        const double b[static restrict n],
+                        double out[static restrict n])
+{
+        double binom_d = 1, binom_j, sum;
+        size_t i, j;
+
+        // out[j] = binom(d, j) * sum of (-1)^(j - i) binom(j, i) b[i]
+        for (j = 0; j < n; ++j) {
+                binom_j = 1;
+                sum = 0;
+                for (i = j + 1; i-- > 0;) {
+                        sum += (j - i) % 2 ? -binom_j * b[i] : binom_j * b[i];
+                        binom_j = binom_j * i / (j - i + 1);
+                }
+                out[j] = binom_d * sum;
+                binom_d = binom_d * (n - 1 - j) / (j + 1);
+        }
+}
+
+void bernstein_from_power(size_t n,
+                          const double a[static restrict n],
+                          double out[static restrict n])
+{
+        double binom_i, binom_d, sum;
+        size_t i, j;
+
+        // out[i] = sum of binom(i, j) / binom(d, j) a[j]
+        for (i = 0; i < n; ++i) {
+                binom_i = binom_d = 1;
+                sum = 0;
+                for (j = 0; j <= i; ++j) {
+                        sum += binom_i / binom_d * a[j];
+                        binom_i = binom_i * (i - j) / (j + 1);
+                        binom_d = binom_d * (n - 1 - j) / (j + 1);
+                }
+                out[i] = sum;
+        }
+}
+
+// Counts sign changes, ignoring zero coefficients.
+static unsigned bernstein_variations(size_t n,
+                                     const double b[static n],
+                                     double *restrict first,
+                                     double *restrict last)
+{
+        const double *p;
+        unsigned variations = 0;
+
+        *first = *last = 0;
+        traverse(p, b, b + n) {
+                if (*p == 0) {
+                        continue;
+                }
+                if (*first == 0) {
+                        *first = *p;
+                } else if ((*p > 0) != (*last > 0)) {
+                        ++variations;
+                }
+                *last = *p;
+        }
+
+        return variations;
+}
+
+// Computes the value and derivative of a polynomial at t.
+static double bernstein_eval_derivative(size_t n,
+                                        const double b[static restrict n],
+                                        double t,
+                                        double *restrict derivative)
+{
+        double s = 1 - t, power = 1, binom = 1, acc = b[0], dacc = 0;
+        size_t i;
+
+        if (n > 1) {
+                dacc = b[1] - b[0];
+        }
+        for (i = 1; i < n; ++i) {
+                power *= t;
+                binom = binom * (n - i) / i;
+                acc = acc * s + power * binom * b[i];
+        }
+        // the derivative has the differences as coefficients, scaled by d
+        power = binom = 1;
+        for (i = 1; i + 1 < n; ++i) {
+                power *= t;
+                binom = binom * (n - 1 - i) / i;
+                dacc = dacc * s + power * binom * (b[i + 1] - b[i]);
+        }
+        *derivative = (n - 1) * dacc;
+
+        return acc;
+}
+
+// Refines the single root of a polynomial in (0, 1), whose coefficients
+// start with the sign of first.
+static double bernstein_refine(size_t n,
+                               const double b[static restrict n],
+                               double first)
+{
+        double lo = 0, hi = 1, t = 0.5, f, df, next;
+        int i;
+
+        for (i = 0; i < BERNSTEIN_MAX_ITERATIONS && hi - lo > DBL_EPSILON;
+             ++i) {
+                f = bernstein_eval_derivative(n, b, t, &df);
+                if (f == 0) {
+                        break;
+                }
+                if ((f > 0) == (first > 0)) {
+                        lo = t;
+                } else {
+                        hi = t;
+                }
+                // take the Newton step if it stays in the bracket
+                next = df != 0 ? t - f / df : lo;
+                if (next <= lo || next >= hi) {
+                        next = (lo + hi) / 2;
+                }
+                if (fabs(next - t) <= DBL_EPSILON) {
+                        t = next;
+                        break;
+                }
+                t = next;
+        }
+
+        return t;
+}
+
+static inline double *bernstein_emit(double *restrict result,
+                                     const double out[],
+                                     double t)
+{
+        if (result == out || t - result[-1] > BERNSTEIN_EPSILON) {
+                *result++ = t;
+        }
+        return result;
+}
+
+double *bernstein_roots(size_t n,
+                        const double b[static restrict n],
+                        double out[restrict],
+                        double aux[static restrict n])
+{
+        BernsteinRange stack[BERNSTEIN_MAX_DEPTH + 1], range, *top = stack;
+        double *coeffs, *scratch = aux + (BERNSTEIN_MAX_DEPTH + 1) * n;
+        double *result = out, first, last, mid;
+        unsigned variations;
+
+        assert(n > 0);
+
+        // An identically zero polynomial has no isolated roots to report.
+        // Otherwise, the coefficients at the ends are the values there.
+        bernstein_variations(n, b, &first, &last);
+        if (first == 0) {
+                return out;
+        }
+
+        // Every range on the stack has its coefficients in the slot of the
+        // auxiliary array with the same index. Ranges are popped left to
+        // right, so the roots come out sorted.
+        memcpy(aux, b, n * sizeof(*b));
+        top->a = 0;
+        top->b = 1;
+        top->depth = 0;
+        top->root_at_start = b[0] == 0;
+        ++top;
+        while (top != stack) {
+                range = *--top;
+                coeffs = aux + (top - stack) * n;
+                if (range.root_at_start) {
+                        result = bernstein_emit(result, out, range.a);
+                }
+
+                variations = bernstein_variations(n, coeffs, &first, &last);
+                if (variations == 0) {
+                        continue;
+                }
+                if (variations == 1) {
+                        mid = bernstein_refine(n, coeffs, first);
+                        mid = range.a + mid * (range.b - range.a);
+                        result = bernstein_emit(result, out, mid);
+                        continue;
+                }
+                mid = (range.a + range.b) / 2;
+                if (range.depth == BERNSTEIN_MAX_DEPTH) {
+                        // a cluster of roots too close to tell apart
+                        result = bernstein_emit(result, out, mid);
+                        continue;
+                }
+
+                // the right half goes below the left one
+                memcpy(scratch, coeffs, n * sizeof(*coeffs));
+                bernstein_split(n, scratch, 0.5, coeffs + n, coeffs);
+                top->a = mid;
+                top->b = range.b;
+                top->depth = range.depth + 1;
+                top->root_at_start = coeffs[0] == 0;
+                ++top;
+                top->a = range.a;
+                top->b = mid;
+                top->depth = range.depth + 1;
+                top->root_at_start = false;
+                ++top;
+        }
+
+        if (b[n - 1] == 0) {
+                result = bernstein_emit(result, out, 1);
+        }
+
+        return result;
+}
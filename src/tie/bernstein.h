@@ -0,0 +1,169 @@
+/*! \file bernstein.h
+ *  \brief Polynomials in Bernstein form
+ *
+ *  A polynomial of degree \f$d\f$ in Bernstein form is given by its
+ *  \f$n = d + 1\f$ coefficients \f$b_i\f$ as
+ *  \f$\sum_{i=0}^{d} b_i \binom{d}{i} t^i (1 - t)^{d - i}\f$. A single
+ *  coordinate of a bezier curve is such a polynomial, with the control points
+ *  as its coefficients, so bounding boxes, inflection points, intersections
+ *  with lines and arc lengths all reduce to the operations in this file.
+ *
+ *  Unlike de_casteljau(), evaluation here runs in \f$O(n)\f$ per parameter.
+ */
+#ifndef TIE_BERNSTEIN_H
+#define TIE_BERNSTEIN_H
+
+#include <stddef.h>
+
+#include "attrib.h"
+
+// Intervals of root isolation are halved at most this many times, which
+// takes them to the precision of a double.
+#define BERNSTEIN_MAX_DEPTH 52
+// Size of the auxiliary array of bernstein_roots() for n coefficients.
+#define BERNSTEIN_ROOTS_AUX(n) ((n) * (BERNSTEIN_MAX_DEPTH + 2))
+
+/*! \brief Evaluates a polynomial.
+ *
+ *  Uses a Horner-like scheme; runs in \f$O(n)\f$.
+ *
+ *  \param[in] n The amount of coefficients. Must be positive.
+ *  \param[in] b The coefficients.
+ *  \param[in] t The parameter.
+ *
+ *  \return The value of the polynomial at `t`.
+ */
+extern PURE_FUNC double bernstein_eval(size_t n,
+                                       const double b[static restrict n],
+                                       double t);
+
+/*! \brief Evaluates a polynomial at many parameters.
+ *
+ *  Same as calling bernstein_eval() for every parameter, but processes the
+ *  parameters in small blocks, so that the compiler can vectorize the work
+ *  across them.
+ *
+ *  \param[in] n The amount of coefficients. Must be positive.
+ *  \param[in] b The coefficients.
+ *  \param[in] m The amount of parameters.
+ *  \param[in] t The parameters.
+ *  \param[out] out The values of the polynomial at the parameters.
+ */
+extern void bernstein_eval_many(size_t n,
+                                const double b[static restrict n],
+                                size_t m,
+                                const double t[static restrict m],
+                                double out[static restrict m]);
+
+/*! \brief Computes the derivative of a polynomial.
+ *
+ *  \param[in] n The amount of coefficients. Must be at least 2.
+ *  \param[in] b The coefficients.
+ *  \param[out] out The `n - 1` coefficients of the derivative.
+ */
+extern void bernstein_derivative(size_t n,
+                                 const double b[static restrict n],
+                                 double out[static restrict n - 1]);
+
+/*! \brief Raises the degree of a polynomial by one without changing it.
+ *
+ *  \param[in] n The amount of coefficients. Must be positive.
+ *  \param[in] b The coefficients.
+ *  \param[out] out The `n + 1` coefficients of the same polynomial.
+ */
+extern void bernstein_elevate(size_t n,
+                              const double b[static restrict n],
+                              double out[static restrict n + 1]);
+
+/*! \brief Lowers the degree of a polynomial by one.
+ *
+ *  Exact if the polynomial is of a lower degree than its coefficients
+ *  allow, e.g. after bernstein_elevate(). Otherwise approximates it,
+ *  interpolating it at both ends: the first half of the coefficients is
+ *  taken from inverting the elevation from the left, the other half from
+ *  the right.
+ *
+ *  \param[in] n The amount of coefficients. Must be at least 2.
+ *  \param[in] b The coefficients.
+ *  \param[out] out The `n - 1` coefficients of the reduced polynomial.
+ *
+ *  \sa bernstein_elevate()
+ */
+extern void bernstein_reduce(size_t n,
+                             const double b[static restrict n],
+                             double out[static restrict n - 1]);
+
+/*! \brief Splits a polynomial into two at a parameter.
+ *
+ *  The coefficients of each half are relative to its own [0, 1] range.
+ *  Runs in \f$O(n^2)\f$.
+ *
+ *  \param[in] n The amount of coefficients. Must be positive.
+ *  \param[in] b The coefficients.
+ *  \param[in] t The split point.
+ *  \param[out] left Coefficients of the polynomial over [0, t].
+ *  \param[out] right Coefficients of the polynomial over [t, 1].
+ *
+ *  \sa de_casteljau()
+ */
+extern void bernstein_split(size_t n,
+                            const double b[static restrict n],
+                            double t,
+                            double left[static restrict n],
+                            double right[static restrict n]);
+
+/*! \brief Converts a polynomial to the power basis.
+ *
+ *  Runs in \f$O(n^2)\f$. Note that the power basis is much worse conditioned
+ *  than the Bernstein basis on [0, 1].
+ *
+ *  \param[in] n The amount of coefficients. Must be positive.
+ *  \param[in] b The coefficients.
+ *  \param[out] out The coefficients \f$a_i\f$ of \f$\sum a_i t^i\f$.
+ *
+ *  \sa bernstein_from_power()
+ */
+extern void bernstein_to_power(size_t n,
+                               const double b[static restrict n],
+                               double out[static restrict n]);
+
+/*! \brief Converts a polynomial from the power basis.
+ *
+ *  Runs in \f$O(n^2)\f$.
+ *
+ *  \param[in] n The amount of coefficients. Must be positive.
+ *  \param[in] a The coefficients \f$a_i\f$ of \f$\sum a_i t^i\f$.
+ *  \param[out] out The coefficients in Bernstein form.
+ *
+ *  \sa bernstein_to_power()
+ */
+extern void bernstein_from_power(size_t n,
+                                 const double a[static restrict n],
+                                 double out[static restrict n]);
+
+/*! \brief Finds the roots of a polynomial in [0, 1].
+ *
+ *  By the variation diminishing property, the polynomial has at most as
+ *  many roots in its range as its coefficients have sign changes. Ranges
+ *  without sign changes are dropped, ranges with one are refined with
+ *  Newton's method safeguarded by bisection, and the rest are split in
+ *  half. Roots closer to each other than about \f$10^{-7}\f$, which
+ *  includes multiple roots split apart by rounding, are reported once. Roots
+ *  where the polynomial touches zero without changing its sign are only
+ *  found if they're exact.
+ *
+ *  \param[in] n The amount of coefficients. Must be positive.
+ *  \param[in] b The coefficients.
+ *  \param[out] out The roots, in increasing order. There are at most
+ *  `n - 1` of them, none if the polynomial is identically zero.
+ *  \param aux Auxiliary array of BERNSTEIN_ROOTS_AUX(n) elements, used as
+ *  the subdivision stack.
+ *
+ *  \return A pointer one past the last root.
+ */
+extern double *bernstein_roots(size_t n,
+                               const double b[static restrict n],
+                               double out[restrict],
+                               double aux[static restrict n]);
+
+#endif
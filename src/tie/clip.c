@@ -0,0 +1,1035 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "clip.h"
+#include "functional.h"
+#include "math.h"
+#include "predicates.h"
+#include "random.h"
+
+#define CLIP_NIL UINT32_MAX
+#define CLIP_SEED 0x436C6970706572
+
+// Events are the endpoints of segments: 2 s for the left endpoint of
+// segment s and 2 s + 1 for the right one.
+#define clip_event(s, right) ((s) << 1 | (right))
+#define clip_event_segment(e) ((e) >> 1)
+#define clip_event_right(e) ((e) & 1)
+
+// Orders points by x, then by y.
+PURE_FUNC static inline int clip_compare_points(const vec2d *p, const vec2d *q)
+{
+        return vec_x(*p) != vec_x(*q) ? compare(vec_x(*p), vec_x(*q))
+                                      : compare(vec_y(*p), vec_y(*q));
+}
+
+PURE_FUNC static inline bool clip_equal(const vec2d *p, const vec2d *q)
+{
+        return vec_x(*p) == vec_x(*q) && vec_y(*p) == vec_y(*q);
+}
+
+PURE_FUNC static inline const vec2d *clip_event_point(const Clipper *c,
+                                                      uint32_t e)
+{
+        const ClipSegment *s = &c->segments[clip_event_segment(e)];
+
+        return clip_event_right(e) ? &s->right : &s->left;
+}
+
+// Orders events by their point. At the same point, segments end before
+// others begin, and begin from bottom to top. Only the left endpoint of a
+// segment changes, and only once its left event is gone, so the order of
+// events in the queue never changes.
+PURE_FUNC static int clip_compare_events(const Clipper *c,
+                                         uint32_t e,
+                                         uint32_t f)
+{
+        const ClipSegment *s = &c->segments[clip_event_segment(e)];
+        const ClipSegment *t = &c->segments[clip_event_segment(f)];
+        int order = clip_compare_points(clip_event_point(c, e),
+                                        clip_event_point(c, f));
+        double side;
+
+        if (order != 0) {
+                return order;
+        }
+        if (clip_event_right(e) != clip_event_right(f)) {
+                return clip_event_right(e) ? -1 : 1;
+        }
+        if (!clip_event_right(e)) {
+                side = orient2d(&s->left, &s->right, &t->right);
+                if (side != 0) {
+                        return side > 0 ? -1 : 1;
+                }
+        }
+        return compare(e, f);
+}
+
+static int clip_push(Clipper *restrict c,
+                     uint32_t e,
+                     Reallocator *reallocator,
+                     void *user)
+{
+        size_t events_sz = c->events_sz, i = c->event_count, parent;
+        uint32_t *events = c->events;
+
+        if (i == events_sz
+            && !auxiliary_realloc(reallocator,
+                                  &events_sz,
+                                  &events,
+                                  &c->events_sz,
+                                  &c->events,
+                                  i + 1,
+                                  user)) {
+                return -1;
+        }
+
+        while (i > 0) {
+                parent = (i - 1) / 2;
+                if (clip_compare_events(c, c->events[parent], e) <= 0) {
+                        break;
+                }
+                c->events[i] = c->events[parent];
+                i = parent;
+        }
+        c->events[i] = e;
+        ++c->event_count;
+
+        return 0;
+}
+
+static uint32_t clip_pop(Clipper *restrict c)
+{
+        const uint32_t top = c->events[0], e = c->events[--c->event_count];
+        const size_t n = c->event_count;
+        size_t i = 0, child;
+
+        while ((child = 2 * i + 1) < n) {
+                if (child + 1 < n
+                    && clip_compare_events(c,
+                                           c->events[child + 1],
+                                           c->events[child])
+                               < 0) {
+                        ++child;
+                }
+                if (clip_compare_events(c, e, c->events[child]) <= 0) {
+                        break;
+                }
+                c->events[i] = c->events[child];
+                i = child;
+        }
+        c->events[i] = e;
+
+        return top;
+}
+
+// Adds a segment outside the tree, returning CLIP_NIL on failure.
+static uint32_t clip_new_segment(Clipper *restrict c,
+                                 vec2d left,
+                                 vec2d right,
+                                 int32_t wind0,
+                                 int32_t wind1,
+                                 Reallocator *reallocator,
+                                 void *user)
+{
+        size_t segments_sz = c->segments_sz;
+        ClipSegment *segments = c->segments, *s;
+
+        assert(c->segment_count < CLIP_NIL / 2);
+        if (c->segment_count == segments_sz
+            && !auxiliary_realloc(reallocator,
+                                  &segments_sz,
+                                  &segments,
+                                  &c->segments_sz,
+                                  &c->segments,
+                                  segments_sz + 1,
+                                  user)) {
+                return CLIP_NIL;
+        }
+
+        s = &c->segments[c->segment_count];
+        s->left = left;
+        s->right = right;
+        s->line[0] = left;
+        s->line[1] = right;
+        s->wind[0] = wind0;
+        s->wind[1] = wind1;
+        s->parent = CLIP_NIL;
+        s->child[0] = CLIP_NIL;
+        s->child[1] = CLIP_NIL;
+        s->priority = (uint32_t)splitmix64(&c->seed);
+        s->skip = false;
+        return c->segment_count++;
+}
+
+// Tests whether segment s lies below segment t on the sweep line, where at
+// least one of them has just been inserted.
+PURE_FUNC static bool clip_below(const Clipper *restrict c,
+                                 uint32_t s,
+                                 uint32_t t)
+{
+        const ClipSegment *a = &c->segments[s], *b = &c->segments[t];
+        const double left = orient2d(&b->left, &b->right, &a->left);
+        const double right = orient2d(&b->left, &b->right, &a->right);
+        double side;
+
+        if (left == 0 && right == 0) {
+                return s < t;
+        }
+        if (clip_equal(&a->left, &b->left)) {
+                return right < 0;
+        }
+        // compare at the left endpoint of the one inserted later
+        if (clip_compare_points(&a->left, &b->left) > 0) {
+                return left != 0 ? left < 0 : right < 0;
+        }
+        side = orient2d(&a->left, &a->right, &b->left);
+        return side != 0 ? side > 0
+                         : orient2d(&a->left, &a->right, &b->right) > 0;
+}
+
+// Rotates node s of the tree above its parent.
+static void clip_rotate(Clipper *restrict c, uint32_t s)
+{
+        ClipSegment *seg = c->segments;
+        const uint32_t p = seg[s].parent, g = seg[p].parent;
+        const size_t side = seg[p].child[1] == s;
+        const uint32_t inner = seg[s].child[!side];
+
+        seg[p].child[side] = inner;
+        if (inner != CLIP_NIL) {
+                seg[inner].parent = p;
+        }
+        seg[s].child[!side] = p;
+        seg[p].parent = s;
+        seg[s].parent = g;
+        if (g == CLIP_NIL) {
+                c->root = s;
+        } else {
+                seg[g].child[seg[g].child[1] == p] = s;
+        }
+}
+
+static void clip_insert(Clipper *restrict c, uint32_t s)
+{
+        ClipSegment *seg = c->segments;
+        uint32_t p = CLIP_NIL, t = c->root;
+        size_t side = 0;
+
+        while (t != CLIP_NIL) {
+                p = t;
+                side = !clip_below(c, s, t);
+                t = seg[t].child[side];
+        }
+        seg[s].parent = p;
+        seg[s].child[0] = CLIP_NIL;
+        seg[s].child[1] = CLIP_NIL;
+        if (p == CLIP_NIL) {
+                c->root = s;
+        } else {
+                seg[p].child[side] = s;
+        }
+
+        while (seg[s].parent != CLIP_NIL
+               && seg[seg[s].parent].priority > seg[s].priority) {
+                clip_rotate(c, s);
+        }
+}
+
+static void clip_remove(Clipper *restrict c, uint32_t s)
+{
+        ClipSegment *seg = c->segments;
+        uint32_t l, r, p;
+
+        // rotate it down to a leaf, keeping the heap order of priorities
+        for (;;) {
+                l = seg[s].child[0];
+                r = seg[s].child[1];
+                if (l == CLIP_NIL && r == CLIP_NIL) {
+                        break;
+                }
+                if (r == CLIP_NIL
+                    || (l != CLIP_NIL && seg[l].priority < seg[r].priority)) {
+                        clip_rotate(c, l);
+                } else {
+                        clip_rotate(c, r);
+                }
+        }
+
+        p = seg[s].parent;
+        if (p == CLIP_NIL) {
+                c->root = CLIP_NIL;
+        } else {
+                seg[p].child[seg[p].child[1] == s] = CLIP_NIL;
+        }
+        seg[s].parent = CLIP_NIL;
+}
+
+// Puts segment t in place of segment s in the tree.
+static void clip_replace(Clipper *restrict c, uint32_t s, uint32_t t)
+{
+        ClipSegment *seg = c->segments;
+        const uint32_t p = seg[s].parent;
+        size_t i;
+
+        seg[t].parent = p;
+        seg[t].priority = seg[s].priority;
+        for (i = 0; i < 2; ++i) {
+                seg[t].child[i] = seg[s].child[i];
+                if (seg[t].child[i] != CLIP_NIL) {
+                        seg[seg[t].child[i]].parent = t;
+                }
+                seg[s].child[i] = CLIP_NIL;
+        }
+        if (p == CLIP_NIL) {
+                c->root = t;
+        } else {
+                seg[p].child[seg[p].child[1] == s] = t;
+        }
+        seg[s].parent = CLIP_NIL;
+}
+
+// The neighbor of segment s in the tree, below it if side is 0 and above it
+// otherwise.
+PURE_FUNC static uint32_t clip_neighbor(const Clipper *restrict c,
+                                        uint32_t s,
+                                        size_t side)
+{
+        const ClipSegment *seg = c->segments;
+        uint32_t t = seg[s].child[side];
+
+        if (t != CLIP_NIL) {
+                while (seg[t].child[!side] != CLIP_NIL) {
+                        t = seg[t].child[!side];
+                }
+                return t;
+        }
+        while (seg[s].parent != CLIP_NIL
+               && seg[seg[s].parent].child[side] == s) {
+                s = seg[s].parent;
+        }
+        return seg[s].parent;
+}
+
+// Splits segment s of the tree at p, strictly between its endpoints. A new
+// segment takes over the part up to p in the tree, while s keeps the part
+// from p on and is inserted again at p, so that its pending right event
+// stays valid. Notes whether p is off the segment, which bends it. Returns
+// the new segment, or CLIP_NIL on failure.
+static uint32_t clip_split(Clipper *restrict c,
+                           uint32_t s,
+                           vec2d p,
+                           Reallocator *reallocator,
+                           void *user)
+{
+        const ClipSegment *seg = &c->segments[s];
+        const bool bent = orient2d(&seg->left, &seg->right, &p) != 0;
+        const uint32_t t = clip_new_segment(c,
+                                            seg->left,
+                                            p,
+                                            seg->wind[0],
+                                            seg->wind[1],
+                                            reallocator,
+                                            user);
+
+        if (t == CLIP_NIL) {
+                return CLIP_NIL;
+        }
+        c->segments[t].line[0] = c->segments[s].line[0];
+        c->segments[t].line[1] = c->segments[s].line[1];
+        c->bent |= bent;
+        clip_replace(c, s, t);
+        c->segments[s].left = p;
+        if (clip_push(c, clip_event(t, 1), reallocator, user) < 0
+            || clip_push(c, clip_event(s, 0), reallocator, user) < 0) {
+                return CLIP_NIL;
+        }
+        return t;
+}
+
+// Handles colinear segments s and t, adjacent in the tree. Where they
+// overlap, the one beginning first is split where the other begins; the
+// rest of it comes back at that point. Segments beginning together are
+// split where the shorter one ends and their identical parts merged into
+// s. Sets t to CLIP_NIL if it was merged.
+static int clip_overlap(Clipper *restrict c,
+                        uint32_t *restrict s,
+                        uint32_t *restrict t,
+                        Reallocator *reallocator,
+                        void *user)
+{
+        const ClipSegment *a = &c->segments[*s], *b = &c->segments[*t];
+        const int left = clip_compare_points(&a->left, &b->left);
+        const int right = clip_compare_points(&a->right, &b->right);
+        ClipSegment *keep;
+
+        if (clip_compare_points(&a->right, &b->left) <= 0
+            || clip_compare_points(&b->right, &a->left) <= 0) {
+                return 0;
+        }
+
+        if (left < 0) {
+                *s = clip_split(c, *s, b->left, reallocator, user);
+                return *s == CLIP_NIL ? -1 : 0;
+        }
+        if (left > 0) {
+                *t = clip_split(c, *t, a->left, reallocator, user);
+                return *t == CLIP_NIL ? -1 : 0;
+        }
+
+        if (right < 0) {
+                *t = clip_split(c, *t, a->right, reallocator, user);
+        } else if (right > 0) {
+                *s = clip_split(c, *s, b->right, reallocator, user);
+        }
+        if (*s == CLIP_NIL || *t == CLIP_NIL) {
+                return -1;
+        }
+
+        keep = &c->segments[*s];
+        keep->wind[0] += c->segments[*t].wind[0];
+        keep->wind[1] += c->segments[*t].wind[1];
+        c->segments[*t].skip = true;
+        clip_remove(c, *t);
+        *t = CLIP_NIL;
+        return 0;
+}
+
+PURE_FUNC static int clip_compare_lines(const vec2d a[static 2],
+                                        const vec2d b[static 2])
+{
+        const int order = clip_compare_points(&a[0], &b[0]);
+
+        return order != 0 ? order : clip_compare_points(&a[1], &b[1]);
+}
+
+// Intersects the lines through a and b, computed the same whichever comes
+// first, so that all segments split where the same two lines cross meet at
+// the same point. The point is put exactly on vertical and horizontal
+// lines, since rounding it past a vertical segment would move it to an end
+// of the segment when it's kept within it. Returns false if the lines are
+// parallel.
+static bool clip_crossing(const vec2d a[static 2],
+                          const vec2d b[static 2],
+                          vec2d *restrict p)
+{
+        const vec2d *temp;
+        vec2d da, db, w;
+        double det;
+        size_t i;
+
+        if (clip_compare_lines(a, b) > 0) {
+                swap(a, b, temp);
+        }
+        da = a[1];
+        sub_vec2d(&da, &a[0]);
+        db = b[1];
+        sub_vec2d(&db, &b[0]);
+        det = cross_vec2d(&da, &db);
+        if (det == 0) {
+                return false;
+        }
+        w = b[0];
+        sub_vec2d(&w, &a[0]);
+        *p = da;
+        scale_vec2d(p, cross_vec2d(&w, &db) / det);
+        add_vec2d(p, &a[0]);
+        for (i = 0; i < 2; ++i) {
+                if (a[0].v[i] == a[1].v[i]) {
+                        p->v[i] = a[0].v[i];
+                } else if (b[0].v[i] == b[1].v[i]) {
+                        p->v[i] = b[0].v[i];
+                }
+        }
+        return true;
+}
+
+// Where to split segment s to put the rounded point p on it. Moving the
+// part before p onto p must not move it across the sweep point, since the
+// segments beginning there were ordered against it; in that case s is split
+// at the sweep point, and its rest meets p when it comes back there.
+PURE_FUNC static const vec2d *clip_pivot(const ClipSegment *s,
+                                         const vec2d *p,
+                                         const vec2d *sweep)
+{
+        double before, after;
+
+        if (clip_compare_points(sweep, &s->left) <= 0
+            || clip_compare_points(sweep, p) >= 0) {
+                return p;
+        }
+        before = orient2d(&s->left, &s->right, sweep);
+        after = orient2d(&s->left, p, sweep);
+        return compare(before, 0) == compare(after, 0) ? p : sweep;
+}
+
+// Splits segments s and t, adjacent in the tree, where they cross or touch,
+// so that they only meet at their endpoints. s and t are updated to the
+// parts in the tree; t is set to CLIP_NIL if it was merged into s.
+static int clip_intersect(Clipper *restrict c,
+                          uint32_t *restrict s,
+                          uint32_t *restrict t,
+                          const vec2d *restrict sweep,
+                          Reallocator *reallocator,
+                          void *user)
+{
+        const ClipSegment *a = &c->segments[*s], *b = &c->segments[*t];
+        const double o1 = orient2d(&a->left, &a->right, &b->left);
+        const double o2 = orient2d(&a->left, &a->right, &b->right);
+        const double o3 = orient2d(&b->left, &b->right, &a->left);
+        const double o4 = orient2d(&b->left, &b->right, &a->right);
+        vec2d p, lo, hi, sa[2], sb[2];
+
+        if (o1 == 0 && o2 == 0) {
+                return clip_overlap(c, s, t, reallocator, user);
+        }
+        if ((o1 < 0 && o2 < 0) || (o1 > 0 && o2 > 0) || (o3 < 0 && o4 < 0)
+            || (o3 > 0 && o4 > 0)) {
+                return 0;
+        }
+
+        if (o1 == 0) {
+                p = b->left;
+        } else if (o2 == 0) {
+                p = b->right;
+        } else if (o3 == 0) {
+                p = a->left;
+        } else if (o4 == 0) {
+                p = a->right;
+        } else {
+                // segments on the same input line may cross after being
+                // split at rounded points, so nearly parallel that their
+                // crossing can't be computed either; they're then within
+                // rounding of each other all along, and split where the
+                // first one ends
+                hi = clip_compare_points(&a->right, &b->right) < 0 ? a->right
+                                                                  : b->right;
+                if (!clip_crossing(a->line, b->line, &p)) {
+                        sa[0] = a->left;
+                        sa[1] = a->right;
+                        sb[0] = b->left;
+                        sb[1] = b->right;
+                        if (!clip_crossing(sa, sb, &p)) {
+                                p = hi;
+                        }
+                }
+
+                // keep the rounded point within both segments and ahead of
+                // the sweep line
+                lo = *sweep;
+                if (clip_compare_points(&p, &lo) < 0) {
+                        p = lo;
+                } else if (clip_compare_points(&p, &hi) > 0) {
+                        p = hi;
+                }
+        }
+
+        if (!clip_equal(&p, &a->left) && !clip_equal(&p, &a->right)) {
+                *s = clip_split(c,
+                                *s,
+                                *clip_pivot(a, &p, sweep),
+                                reallocator,
+                                user);
+                if (*s == CLIP_NIL) {
+                        return -1;
+                }
+        }
+        b = &c->segments[*t];
+        if (!clip_equal(&p, &b->left) && !clip_equal(&p, &b->right)) {
+                *t = clip_split(c,
+                                *t,
+                                *clip_pivot(b, &p, sweep),
+                                reallocator,
+                                user);
+                if (*t == CLIP_NIL) {
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+// Adds the edges of a set of contours as segments of operand k.
+static int clip_add_operand(Clipper *restrict c,
+                            size_t k,
+                            size_t count,
+                            const size_t offsets[static restrict count + 1],
+                            const vec2d points[restrict],
+                            Reallocator *reallocator,
+                            void *user)
+{
+        const vec2d *p, *q;
+        size_t i, j, n;
+        uint32_t s;
+        int order;
+
+        for (i = 0; i < count; ++i) {
+                n = offsets[i + 1] - offsets[i];
+                for (j = 0; j < n; ++j) {
+                        p = &points[offsets[i] + j];
+                        q = &points[offsets[i] + (j + 1 == n ? 0 : j + 1)];
+                        order = clip_compare_points(p, q);
+                        if (order == 0) {
+                                continue;
+                        }
+                        // upwards across an edge running to the right means
+                        // entering a counter-clockwise contour
+                        s = clip_new_segment(c,
+                                             order < 0 ? *p : *q,
+                                             order < 0 ? *q : *p,
+                                             k == 0 ? -order : 0,
+                                             k == 1 ? -order : 0,
+                                             reallocator,
+                                             user);
+                        if (s == CLIP_NIL) {
+                                return -1;
+                        }
+                }
+        }
+
+        return 0;
+}
+
+// Queues the events of all segments and empties the tree for a sweep.
+static int clip_queue(Clipper *restrict c,
+                      Reallocator *reallocator,
+                      void *user)
+{
+        uint32_t s;
+
+        c->root = CLIP_NIL;
+        for (s = 0; s < c->segment_count; ++s) {
+                if (!c->segments[s].skip
+                    && (clip_push(c, clip_event(s, 0), reallocator, user) < 0
+                        || clip_push(c, clip_event(s, 1), reallocator, user)
+                                   < 0)) {
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+// Sweeps the segments once, splitting them where they cross.
+static int clip_pass(Clipper *restrict c,
+                     Reallocator *reallocator,
+                     void *user)
+{
+        uint32_t e, s, t, below;
+        vec2d sweep;
+
+        if (clip_queue(c, reallocator, user) < 0) {
+                return -1;
+        }
+
+        while (c->event_count > 0) {
+                e = clip_pop(c);
+                s = clip_event_segment(e);
+                if (c->segments[s].skip) {
+                        continue;
+                }
+                sweep = *clip_event_point(c, e);
+
+                if (clip_event_right(e)) {
+                        below = clip_neighbor(c, s, 0);
+                        t = clip_neighbor(c, s, 1);
+                        clip_remove(c, s);
+                        if (below != CLIP_NIL && t != CLIP_NIL
+                            && clip_intersect(c,
+                                              &below,
+                                              &t,
+                                              &sweep,
+                                              reallocator,
+                                              user)
+                                       < 0) {
+                                return -1;
+                        }
+                        continue;
+                }
+
+                clip_insert(c, s);
+                t = clip_neighbor(c, s, 1);
+                if (t != CLIP_NIL
+                    && clip_intersect(c, &s, &t, &sweep, reallocator, user)
+                               < 0) {
+                        return -1;
+                }
+                below = clip_neighbor(c, s, 0);
+                if (below != CLIP_NIL
+                    && clip_intersect(c, &below, &s, &sweep, reallocator, user)
+                               < 0) {
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+// Splits the segments where they cross. Splitting a segment at a rounded
+// point bends the part of it behind the sweep line, which may then cross
+// segments already passed, e.g. at a vertex that lay on the segment before,
+// where its contour touches itself. Such crossings would give a segment
+// different winding numbers along its length, so the segments are swept
+// again until a sweep bends none of them.
+static int clip_sweep(Clipper *restrict c,
+                      Reallocator *reallocator,
+                      void *user)
+{
+        do {
+                c->bent = false;
+                if (clip_pass(c, reallocator, user) < 0) {
+                        return -1;
+                }
+        } while (c->bent);
+
+        return 0;
+}
+
+// Sweeps the split segments again to find the winding numbers below each of
+// them. This is kept apart from splitting, so that the order seen here is
+// the one of the final segments.
+static int clip_wind(Clipper *restrict c,
+                     Reallocator *reallocator,
+                     void *user)
+{
+        uint32_t e, s, below;
+        ClipSegment *seg;
+
+        if (clip_queue(c, reallocator, user) < 0) {
+                return -1;
+        }
+
+        while (c->event_count > 0) {
+                e = clip_pop(c);
+                s = clip_event_segment(e);
+                if (clip_event_right(e)) {
+                        clip_remove(c, s);
+                        continue;
+                }
+                // segments beginning at the same point come from bottom to
+                // top, so only s needs its winding numbers
+                clip_insert(c, s);
+                seg = c->segments;
+                below = clip_neighbor(c, s, 0);
+                seg[s].below[0] = below == CLIP_NIL
+                                        ? 0
+                                        : seg[below].below[0]
+                                                  + seg[below].wind[0];
+                seg[s].below[1] = below == CLIP_NIL
+                                        ? 0
+                                        : seg[below].below[1]
+                                                  + seg[below].wind[1];
+        }
+
+        return 0;
+}
+
+PURE_FUNC static bool clip_inside(ClipOperation op,
+                                  FillRule rule,
+                                  int32_t subject,
+                                  int32_t clip)
+{
+        const bool a = fill_rule_inside(rule, subject);
+        const bool b = fill_rule_inside(rule, clip);
+
+        switch (op) {
+        case CLIP_UNION:
+                return a || b;
+        case CLIP_INTERSECTION:
+                return a && b;
+        case CLIP_DIFFERENCE:
+                return a && !b;
+        case CLIP_XOR:
+                return a != b;
+        }
+        return false;
+}
+
+// Keeps the segments separating the inside of the result from the outside
+// at the front of the segment array, directed with the inside on their
+// left. Returns their amount.
+static uint32_t clip_select(Clipper *restrict c,
+                            ClipOperation op,
+                            FillRule rule)
+{
+        ClipSegment *seg = c->segments, temp;
+        uint32_t i, n = 0;
+        bool below, above;
+
+        for (i = 0; i < c->segment_count; ++i) {
+                if (seg[i].skip) {
+                        continue;
+                }
+                below = clip_inside(op, rule, seg[i].below[0], seg[i].below[1]);
+                above = clip_inside(op,
+                                    rule,
+                                    seg[i].below[0] + seg[i].wind[0],
+                                    seg[i].below[1] + seg[i].wind[1]);
+                if (below == above) {
+                        continue;
+                }
+                seg[n] = seg[i];
+                if (below) {
+                        swap(seg[n].left, seg[n].right, temp.left);
+                }
+                ++n;
+        }
+
+        return n;
+}
+
+static int clip_compare_starts(const void *a, const void *b)
+{
+        return clip_compare_points(&((const ClipSegment *)a)->left,
+                                   &((const ClipSegment *)b)->left);
+}
+
+// Whether edge t, which begins where edge s ends, lies in the second half
+// of a clockwise turn from the reverse of s, i.e. past straight ahead.
+PURE_FUNC static bool clip_turn_half(const ClipSegment *s,
+                                     const ClipSegment *t)
+{
+        const double side = orient2d(&s->right, &s->left, &t->right);
+
+        if (side != 0) {
+                return side > 0;
+        }
+        // straight ahead is the end of the first half, going back along s
+        // the end of the second one
+        return clip_compare_points(&t->right, &s->right)
+            == clip_compare_points(&s->left, &s->right);
+}
+
+// Tests whether edge t takes a sharper clockwise turn than edge u from the
+// reverse of edge s, where both begin where s ends. This is exact, since
+// edges meeting at a point where a contour touches itself may be apart by
+// less than any rounded angle.
+PURE_FUNC static bool clip_sharper(const ClipSegment *s,
+                                   const ClipSegment *t,
+                                   const ClipSegment *u)
+{
+        const bool t_half = clip_turn_half(s, t);
+        const bool u_half = clip_turn_half(s, u);
+
+        if (t_half != u_half) {
+                return u_half;
+        }
+        // within half a turn, u comes later if it's clockwise from t
+        return orient2d(&s->right, &t->right, &u->right) < 0;
+}
+
+// Appends a point to the current contour, dropping points colinear with
+// their neighbors.
+static int clip_emit(Clipper *restrict c,
+                     size_t first,
+                     size_t *restrict count,
+                     const vec2d *restrict p,
+                     Reallocator *reallocator,
+                     void *user)
+{
+        size_t points_sz = c->points_sz;
+        vec2d *points = c->points;
+
+        while (*count >= first + 2
+               && orient2d(&c->points[*count - 2], &c->points[*count - 1], p)
+                          == 0) {
+                --*count;
+        }
+        if (*count == points_sz
+            && !auxiliary_realloc(reallocator,
+                                  &points_sz,
+                                  &points,
+                                  &c->points_sz,
+                                  &c->points,
+                                  points_sz + 1,
+                                  user)) {
+                return -1;
+        }
+        c->points[(*count)++] = *p;
+        return 0;
+}
+
+// Closes the contour beginning at point first, which has count points so
+// far, dropping colinear points around the seam.
+static void clip_close(Clipper *restrict c,
+                       size_t first,
+                       size_t *restrict count)
+{
+        vec2d *p = c->points;
+        size_t i;
+
+        while (*count - first >= 3
+               && orient2d(&p[*count - 2], &p[*count - 1], &p[first]) == 0) {
+                --*count;
+        }
+        while (*count - first >= 3
+               && orient2d(&p[*count - 1], &p[first], &p[first + 1]) == 0) {
+                for (i = first; i + 1 < *count; ++i) {
+                        p[i] = p[i + 1];
+                }
+                --*count;
+        }
+        if (*count - first < 3) {
+                *count = first;
+        }
+}
+
+// Links the selected segments into contours. At a point where several
+// contours meet, each incoming edge continues with the outgoing edge next
+// to it clockwise, i.e. the one bounding the same wedge of the inside.
+static int clip_link(Clipper *restrict c,
+                     uint32_t n,
+                     Reallocator *reallocator,
+                     void *user)
+{
+        size_t offsets_sz = c->offsets_sz, count = 0, first, lo, hi, mid;
+        size_t *offsets = c->offsets;
+        ClipSegment *seg = c->segments;
+        uint32_t start, s, t, best;
+
+        qsort(seg, n, sizeof(*seg), clip_compare_starts);
+        c->contour_count = 0;
+
+        for (start = 0; start < n; ++start) {
+                if (seg[start].skip) {
+                        continue;
+                }
+                first = count;
+                seg[start].skip = true;
+                s = start;
+                do {
+                        if (clip_emit(c,
+                                      first,
+                                      &count,
+                                      &seg[s].left,
+                                      reallocator,
+                                      user)
+                            < 0) {
+                                return -1;
+                        }
+
+                        lo = 0;
+                        hi = n;
+                        while (lo < hi) {
+                                mid = lo + (hi - lo) / 2;
+                                if (clip_compare_points(&seg[mid].left,
+                                                        &seg[s].right)
+                                    < 0) {
+                                        lo = mid + 1;
+                                } else {
+                                        hi = mid;
+                                }
+                        }
+
+                        best = CLIP_NIL;
+                        for (t = lo; t < n
+                                     && clip_equal(&seg[t].left, &seg[s].right);
+                             ++t) {
+                                if (seg[t].skip && t != start) {
+                                        continue;
+                                }
+                                if (best == CLIP_NIL
+                                    || clip_sharper(&seg[s],
+                                                    &seg[t],
+                                                    &seg[best])) {
+                                        best = t;
+                                }
+                        }
+                        if (best == CLIP_NIL) {
+                                best = start;
+                        }
+                        s = best;
+                        seg[s].skip = true;
+                } while (s != start);
+
+                clip_close(c, first, &count);
+                if (count == first) {
+                        continue;
+                }
+                if (c->contour_count + 2 > offsets_sz
+                    && !auxiliary_realloc(reallocator,
+                                          &offsets_sz,
+                                          &offsets,
+                                          &c->offsets_sz,
+                                          &c->offsets,
+                                          c->contour_count + 2,
+                                          user)) {
+                        return -1;
+                }
+                c->offsets[c->contour_count] = first;
+                c->offsets[++c->contour_count] = count;
+        }
+
+        return 0;
+}
+
+void clipper_init(Clipper *restrict clipper)
+{
+        clipper->contour_count = 0;
+        clipper->offsets_sz = 0;
+        clipper->offsets = NULL;
+        clipper->points_sz = 0;
+        clipper->points = NULL;
+        clipper->segment_count = 0;
+        clipper->event_count = 0;
+        clipper->root = CLIP_NIL;
+        clipper->bent = false;
+        clipper->seed = CLIP_SEED;
+        clipper->segments_sz = 0;
+        clipper->segments = NULL;
+        clipper->events_sz = 0;
+        clipper->events = NULL;
+}
+
+int polygon_clip(
+        Clipper *restrict clipper,
+        ClipOperation op,
+        FillRule rule,
+        size_t subject_count,
+        const size_t subject_offsets[static restrict subject_count + 1],
+        const vec2d subject[restrict],
+        size_t clip_count,
+        const size_t clip_offsets[static restrict clip_count + 1],
+        const vec2d clip[restrict],
+        Reallocator *reallocator,
+        void *user)
+{
+        uint32_t n;
+
+        clipper->contour_count = 0;
+        clipper->segment_count = 0;
+        clipper->event_count = 0;
+        clipper->root = CLIP_NIL;
+        clipper->seed = CLIP_SEED;
+
+        if (clip_add_operand(clipper,
+                             0,
+                             subject_count,
+                             subject_offsets,
+                             subject,
+                             reallocator,
+                             user)
+                    < 0
+            || clip_add_operand(clipper,
+                                1,
+                                clip_count,
+                                clip_offsets,
+                                clip,
+                                reallocator,
+                                user)
+                       < 0
+            || clip_sweep(clipper, reallocator, user) < 0
+            || clip_wind(clipper, reallocator, user) < 0) {
+                clipper->contour_count = 0;
+                return -1;
+        }
+
+        n = clip_select(clipper, op, rule);
+        if (clip_link(clipper, n, reallocator, user) < 0) {
+                clipper->contour_count = 0;
+                return -1;
+        }
+
+        return 0;
+}
@@ -0,0 +1,143 @@
+/*! \file clip.h
+ *  \brief Boolean operations on polygons
+ *
+ *  Combines two sets of closed line strips, the subject and the clip, into
+ *  the contours of their union, intersection, difference or symmetric
+ *  difference, so that shape builder tools don't need to export to external
+ *  tools. Each set may hold any amount of contours, which may cross
+ *  themselves and each other; what they cover is decided by a fill rule.
+ *  Merging many shapes at once doesn't need a chain of pairwise unions:
+ *  pass them all as the subject with an empty clip.
+ *
+ *  Edges are processed in a sweep from left to right, which keeps the edges
+ *  crossing the sweep line in a balanced tree ordered from bottom to top.
+ *  Edges are split wherever they cross or touch an edge next to them in the
+ *  tree; edges lying on top of each other are merged into one. Splitting an
+ *  edge at a rounded intersection point bends it slightly, which may make
+ *  it cross an edge the sweep already passed, e.g. where a contour touches
+ *  itself, so the sweep is repeated until it bends nothing, after which no
+ *  two edges cross. This rarely takes more than two sweeps. Another sweep
+ *  over the split edges then finds the winding numbers of both sets just
+ *  below each edge, which are those above the edge below it when it enters
+ *  the tree; this tells whether the edge separates the inside of the result
+ *  from the outside. Each sweep runs in \f$O((n + k) \log n)\f$, where
+ *  \f$n\f$ is the total amount of vertices and \f$k\f$ the amount of
+ *  intersections. The remaining edges are finally linked into contours,
+ *  turning as sharply as possible at vertices shared by several contours,
+ *  so that contours may touch but never cross.
+ *
+ *  The results are oriented: outer boundaries run counter-clockwise and
+ *  holes clockwise, so either fill rule fills them the same. Colinear
+ *  vertices are dropped. Intersection points are rounded to the nearest
+ *  representable point, but all decisions on the order of edges are exact
+ *  (see predicates.h).
+ */
+#ifndef TIE_CLIP_H
+#define TIE_CLIP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "math.h"
+#include "winding.h"
+
+typedef enum {
+        CLIP_UNION,
+        CLIP_INTERSECTION,
+        CLIP_DIFFERENCE, // the subject without the clip
+        CLIP_XOR
+} ClipOperation;
+
+/*! \brief An edge of the sweep, from its left endpoint to its right one.
+ *
+ *  Endpoints are ordered by x, then by y.
+ */
+typedef struct {
+        vec2d left;
+        vec2d right;
+        // The input edge it lies on, from which intersections are computed
+        // so that splitting doesn't move them.
+        vec2d line[2];
+        // Change of the winding numbers of the subject and the clip when
+        // crossing the edge upwards.
+        int32_t wind[2];
+        int32_t below[2]; // winding numbers just below the edge
+        // Node of the tree of edges crossing the sweep line.
+        uint32_t parent;
+        uint32_t child[2];
+        uint32_t priority;
+        // Merged into another edge during the sweep, or already linked into
+        // a contour.
+        bool skip;
+} ClipSegment;
+
+typedef struct {
+        size_t contour_count;
+        // Contour `i` is `points[offsets[i]]` through
+        // `points[offsets[i + 1] - 1]`.
+        size_t offsets_sz;
+        size_t *offsets;
+        size_t points_sz;
+        vec2d *points;
+        // Working memory.
+        uint32_t segment_count;
+        uint32_t event_count;
+        uint32_t root;
+        bool bent; // whether the sweep split a segment off its line
+        uint64_t seed;
+        size_t segments_sz;
+        ClipSegment *segments;
+        size_t events_sz;
+        uint32_t *events;
+} Clipper;
+
+/*! \brief Initializes a clipper without any memory.
+ *
+ *  \param[out] clipper The clipper to initialize. Its arrays must be freed
+ *  by the user once it's no longer needed. They're reused by every call to
+ *  polygon_clip().
+ */
+extern void clipper_init(Clipper *restrict clipper);
+
+/*! \brief Combines two sets of polygons.
+ *
+ *  Each set is stored like in polygon_metrics(): contour `i` of the subject
+ *  is `subject[subject_offsets[i]]` through
+ *  `subject[subject_offsets[i + 1] - 1]`, and its last vertex is implicitly
+ *  connected to its first. Same for the clip.
+ *
+ *  \param[in,out] clipper The clipper, which receives the resulting contours
+ *  in `contour_count`, `offsets` and `points`.
+ *  \param[in] op The operation.
+ *  \param[in] rule The fill rule of both sets.
+ *  \param[in] subject_count The amount of contours of the subject.
+ *  \param[in] subject_offsets Offsets of the contours in `subject`, followed
+ *  by the total amount of vertices.
+ *  \param[in] subject The vertices of the subject.
+ *  \param[in] clip_count The amount of contours of the clip.
+ *  \param[in] clip_offsets Offsets of the contours in `clip`, followed by
+ *  the total amount of vertices.
+ *  \param[in] clip The vertices of the clip.
+ *  \param[in] reallocator Reallocator for the arrays of the clipper. May be
+ *  NULL, in which case the function fails when they become full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case no
+ *  contours are returned.
+ */
+extern int polygon_clip(
+        Clipper *restrict clipper,
+        ClipOperation op,
+        FillRule rule,
+        size_t subject_count,
+        const size_t subject_offsets[static restrict subject_count + 1],
+        const vec2d subject[restrict],
+        size_t clip_count,
+        const size_t clip_offsets[static restrict clip_count + 1],
+        const vec2d clip[restrict],
+        Reallocator *reallocator,
+        void *user);
+
+#endif
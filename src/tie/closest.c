@@ -0,0 +1,271 @@
+#include <math.h>
+
+#include "array.h"
+#include "attrib.h"
+#include "closest.h"
+#include "math.h"
+
+#define CLOSEST_MAX_ITERATIONS 32
+#define CLOSEST_MAX_HALVINGS 32
+// Refinement stops once a step moves the parameter by less than this.
+#define CLOSEST_EPSILON 0x1p-40
+// Curve samples per control polygon edge used as additional seeds.
+#define CLOSEST_SAMPLES 4
+
+// Evaluates the curve and its first two derivatives at t in a single de
+// Casteljau pass: the derivatives are scaled differences of the last three
+// and two intermediate points.
+static void closest_eval(size_t n,
+                         const vec2d bezier[static restrict n],
+                         double t,
+                         vec2d aux[static restrict n],
+                         vec2d out[static restrict 3])
+{
+        const double degree = n - 1;
+        const vec2d zero = make_vec2d(0, 0);
+        vec2d *p, temp;
+        size_t m;
+
+        for (m = 0; m < n; ++m) {
+                aux[m] = bezier[m];
+        }
+        out[1] = out[2] = zero;
+
+        for (m = n - 1; m > 0; --m) {
+                if (m == 2) {
+                        // B''(t) = d(d - 1)(a[2] - 2a[1] + a[0])
+                        out[2] = aux[2];
+                        sub_vec2d(&out[2], &aux[1]);
+                        sub_vec2d(&out[2], &aux[1]);
+                        add_vec2d(&out[2], &aux[0]);
+                        scale_vec2d(&out[2], degree * (degree - 1));
+                } else if (m == 1) {
+                        // B'(t) = d(a[1] - a[0])
+                        out[1] = aux[1];
+                        sub_vec2d(&out[1], &aux[0]);
+                        scale_vec2d(&out[1], degree);
+                }
+                traverse(p, aux, aux + m) {
+                        temp = p[1];
+                        sub_vec2d(&temp, p);
+                        scale_vec2d(&temp, t);
+                        add_vec2d(p, &temp);
+                }
+        }
+
+        out[0] = aux[0];
+}
+
+// Runs safeguarded Newton iterations from t and updates *best if they end up
+// closer than it. Returns whether *best was updated.
+static bool closest_refine(size_t n,
+                           const vec2d bezier[static restrict n],
+                           const vec2d *restrict q,
+                           vec2d aux[static restrict n],
+                           double t,
+                           ClosestPoint *restrict best)
+{
+        vec2d eval[3], next[3], diff;
+        double f, df, step, sqrdist, next_t, next_sqrdist;
+        int i, j;
+
+        closest_eval(n, bezier, t, aux, eval);
+        diff = eval[0];
+        sub_vec2d(&diff, q);
+        sqrdist = sqrmag_vec2d(&diff);
+
+        for (i = 0; i < CLOSEST_MAX_ITERATIONS; ++i) {
+                // f is half the derivative of the squared distance
+                f = dot_vec2d(&eval[1], &diff);
+                df = dot_vec2d(&eval[2], &diff) + sqrmag_vec2d(&eval[1]);
+                if (df <= 0) {
+                        // not convex here, Newton could head for a maximum
+                        df = sqrmag_vec2d(&eval[1]);
+                        if (df <= 0) {
+                                break;
+                        }
+                }
+
+                step = -f / df;
+                for (j = 0; j < CLOSEST_MAX_HALVINGS; ++j, step *= 0.5) {
+                        next_t = fmin(fmax(t + step, 0), 1);
+                        closest_eval(n, bezier, next_t, aux, next);
+                        diff = next[0];
+                        sub_vec2d(&diff, q);
+                        next_sqrdist = sqrmag_vec2d(&diff);
+                        if (next_sqrdist <= sqrdist) {
+                                break;
+                        }
+                }
+                if (j == CLOSEST_MAX_HALVINGS) {
+                        break;
+                }
+
+                step = fabs(next_t - t);
+                t = next_t;
+                sqrdist = next_sqrdist;
+                eval[0] = next[0];
+                eval[1] = next[1];
+                eval[2] = next[2];
+                if (step < CLOSEST_EPSILON) {
+                        break;
+                }
+        }
+
+        if (sqrdist >= best->sqrdist) {
+                return false;
+        }
+        best->point = eval[0];
+        best->t = t;
+        best->sqrdist = sqrdist;
+        return true;
+}
+
+// Refines every local minimum of the distance to the control polygon.
+static bool closest_curve(size_t n,
+                          const vec2d bezier[static restrict n],
+                          const vec2d *restrict q,
+                          vec2d aux[static restrict n],
+                          ClosestPoint *restrict best)
+{
+        double s, prev_sqrdist = DBL_MAX, sqrdist, next_sqrdist, len;
+        double seed = 0, next_seed = 0;
+        vec2d edge, diff, eval[3];
+        bool found = false;
+        size_t i, m;
+
+        // The endpoints lie on the curve and may be closer than any interior
+        // minimum, which the refinement won't move past.
+        for (i = 0; i < 2; ++i) {
+                diff = bezier[i * (n - 1)];
+                sub_vec2d(&diff, q);
+                sqrdist = sqrmag_vec2d(&diff);
+                if (sqrdist < best->sqrdist) {
+                        best->point = bezier[i * (n - 1)];
+                        best->t = i;
+                        best->sqrdist = sqrdist;
+                        found = true;
+                }
+        }
+        if (n == 1) {
+                return found;
+        }
+
+        // seed and distance of edge i, then the next edge, by projecting q
+        sqrdist = DBL_MAX;
+        for (i = 0; i < n; ++i) {
+                if (i + 1 < n) {
+                        edge = bezier[i + 1];
+                        sub_vec2d(&edge, &bezier[i]);
+                        diff = *q;
+                        sub_vec2d(&diff, &bezier[i]);
+                        len = sqrmag_vec2d(&edge);
+                        s = len > 0 ? dot_vec2d(&diff, &edge) / len : 0;
+                        s = fmin(fmax(s, 0), 1);
+                        scale_vec2d(&edge, s);
+                        sub_vec2d(&diff, &edge);
+                        next_sqrdist = sqrmag_vec2d(&diff);
+                        next_seed = (i + s) / (n - 1);
+                } else {
+                        next_sqrdist = DBL_MAX;
+                }
+
+                if (i > 0 && sqrdist <= prev_sqrdist
+                    && sqrdist < next_sqrdist) {
+                        found |= closest_refine(n, bezier, q, aux, seed, best);
+                }
+
+                prev_sqrdist = sqrdist;
+                sqrdist = next_sqrdist;
+                seed = next_seed;
+        }
+
+        // The control polygon can stray far from the curve where the curve
+        // turns sharply, so local minima among samples of the curve itself
+        // are refined as well.
+        m = CLOSEST_SAMPLES * (n - 1);
+        prev_sqrdist = sqrdist = DBL_MAX;
+        for (i = 0; i <= m + 1; ++i) {
+                if (i <= m) {
+                        next_seed = (double)i / m;
+                        closest_eval(n, bezier, next_seed, aux, eval);
+                        diff = eval[0];
+                        sub_vec2d(&diff, q);
+                        next_sqrdist = sqrmag_vec2d(&diff);
+                } else {
+                        next_sqrdist = DBL_MAX;
+                }
+
+                if (i > 1 && i <= m && sqrdist <= prev_sqrdist
+                    && sqrdist < next_sqrdist) {
+                        found |= closest_refine(n, bezier, q, aux, seed, best);
+                }
+
+                prev_sqrdist = sqrdist;
+                sqrdist = next_sqrdist;
+                seed = next_seed;
+        }
+
+        return found;
+}
+
+void bezier_closest_point(size_t n,
+                          const vec2d bezier[static restrict n],
+                          const vec2d *restrict q,
+                          vec2d aux[static restrict n],
+                          ClosestPoint *restrict out)
+{
+        assert(n > 0);
+
+        out->sqrdist = DBL_MAX;
+        closest_curve(n, bezier, q, aux, out);
+        out->curve = 0;
+}
+
+void bezier_closest_points(size_t curve_count,
+                           const size_t offsets[static curve_count + 1],
+                           const vec2d controls[],
+                           size_t query_count,
+                           const vec2d queries[static query_count],
+                           double max_dist,
+                           ClosestPoint out[static query_count],
+                           vec2d aux[])
+{
+        const vec2d *bezier, *p;
+        double sqrdist;
+        ClosestPoint *best;
+        aabb2d box;
+        size_t c, i, n;
+
+        sqrdist = max_dist < sqrt(DBL_MAX) ? max_dist * max_dist : DBL_MAX;
+        traverse(best, out, out + query_count) {
+                best->sqrdist = sqrdist;
+                best->curve = CLOSEST_NONE;
+        }
+
+        // Curves in the outer loop, so that each control box is computed
+        // only once; the best candidates so far live in the output.
+        for (c = 0; c < curve_count; ++c) {
+                bezier = controls + offsets[c];
+                n = offsets[c + 1] - offsets[c];
+                assert(n > 0);
+
+                empty_aabb2d(&box);
+                traverse(p, bezier, bezier + n) {
+                        extend_aabb2d(&box, p);
+                }
+
+                for (i = 0; i < query_count; ++i) {
+                        // the curve lies in the convex hull of its control
+                        // points, so this is a lower bound on its distance
+                        if (sqrdist_aabb2d(&box, &queries[i])
+                            > out[i].sqrdist) {
+                                continue;
+                        }
+                        if (closest_curve(
+                                    n, bezier, &queries[i], aux, &out[i])) {
+                                out[i].curve = c;
+                        }
+                }
+        }
+}
@@ -0,0 +1,87 @@
+/*! \file closest.h
+ *  \brief Closest points on bezier curves
+ *
+ *  Routines that find the point of a bezier curve closest to a query point,
+ *  e.g. for snapping to or hit testing curves under the cursor, without
+ *  discretizing the curves first.
+ *
+ *  The squared distance from the query point to the curve is minimized with
+ *  Newton's method on \f$B'(t) \cdot (B(t) - q) = 0\f$. Its initial guesses
+ *  come from the local minima of the distance to the control polygon, which
+ *  the curve usually follows closely, and to a few samples of the curve for
+ *  where it doesn't. Every step is safeguarded: it falls back to a
+ *  Gauss-Newton step where the Newton step wouldn't descend, stays in the
+ *  [0, 1] range and is halved until the distance actually decreases.
+ */
+#ifndef TIE_CLOSEST_H
+#define TIE_CLOSEST_H
+
+#include <stdint.h>
+
+#include "attrib.h"
+#include "math.h"
+
+#define CLOSEST_NONE UINT32_MAX
+
+/*! \brief The closest point found for a single query.
+ */
+typedef struct {
+        vec2d point;
+        double t; // parameter of `point` on the curve
+        double sqrdist; // squared distance to the query point
+        uint32_t curve; // index of the curve, or CLOSEST_NONE
+} ClosestPoint;
+
+/*! \brief Finds the point of a bezier curve closest to a given point.
+ *
+ *  Runs in \f$O(n^2)\f$ per curve evaluation, of which there are
+ *  \f$O(n)\f$ for seeding and a few per Newton iteration.
+ *
+ *  \param[in] n The amount of control points. Must be positive.
+ *  \param[in] bezier The control points of the curve.
+ *  \param[in] q The query point.
+ *  \param aux Auxiliary array for evaluating the curve.
+ *  \param[out] out The closest point; `out->curve` is set to 0.
+ *
+ *  \sa bezier_closest_points()
+ */
+extern void bezier_closest_point(size_t n,
+                                 const vec2d bezier[static restrict n],
+                                 const vec2d *restrict q,
+                                 vec2d aux[static restrict n],
+                                 ClosestPoint *restrict out);
+
+/*! \brief Finds the closest curve and point on it for many query points.
+ *
+ *  The curves are stored back to back: the control points of curve `i` are
+ *  `controls[offsets[i]]` through `controls[offsets[i + 1] - 1]`. Every
+ *  curve is matched against every query point, but a curve is skipped for a
+ *  query point as soon as the bounding box of its control points is further
+ *  away than the best candidate found so far, so only the few curves near
+ *  each query point are actually solved for.
+ *
+ *  \param[in] curve_count The amount of curves.
+ *  \param[in] offsets Offsets of the curves in `controls`, followed by the
+ *  total amount of control points. Every curve must have at least one
+ *  control point.
+ *  \param[in] controls The control points of all curves.
+ *  \param[in] query_count The amount of query points.
+ *  \param[in] queries The query points.
+ *  \param[in] max_dist Curves further than this from a query point are
+ *  ignored for that point. May be `DBL_MAX`.
+ *  \param[out] out The closest point for every query point. If no curve is
+ *  within `max_dist`, the `curve` field is set to `CLOSEST_NONE` and the
+ *  other fields are unspecified.
+ *  \param aux Auxiliary array for evaluating the curves. Must be large
+ *  enough to hold the control points of any single curve.
+ */
+extern void bezier_closest_points(size_t curve_count,
+                                  const size_t offsets[static curve_count + 1],
+                                  const vec2d controls[],
+                                  size_t query_count,
+                                  const vec2d queries[static query_count],
+                                  double max_dist,
+                                  ClosestPoint out[static query_count],
+                                  vec2d aux[]);
+
+#endif
@@ -6,32 +6,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arclength.h"
+#include "core.h"
+#include "depgraph.h"
+#include "geometry.h"
 #include "math.h"
-
-typedef uint32_t HistoryID;
-
-#define HISTORYID_MAX UINT32_MAX
-
-typedef struct {
-        uint32_t flagged_index;
-} ObjectID;
-
-typedef enum {
-        POINT,
-        LINE
-} ObjectType;
-
-typedef struct {
-        mat2d matrix;
-        vec2d position;
-} Transform;
-
-typedef struct {
-        ObjectType type;
-        Transform transform;
-        ObjectID *parents;
-        ObjectID *children;
-} Object;
+#include "memalloc.h"
+#include "objecttable.h"
+#include "rtree.h"
 
 // history changes include:
 // * modification of global state:
@@ -153,104 +135,225 @@ typedef struct {
 // Currently this algorithm takes n * (n - 1) / 2
 // vector subtractions, multiplications, summations and scalar comparisons.
 
-logint_decl(uint32_t, loguint32);
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
 
-static inline uint32_t dyn_object_stack_size(const uint32_t *stack)
+static inline void object_control_points(
+        const ObjectTable *restrict table,
+        uint32_t slot,
+        vec2d out[static OBJECT_MAX_CONTROL_POINTS])
 {
-        return stack[0];
+        const ObjectID *id, *children = object_table_children(table, slot);
+        uint32_t child;
+
+        assert(table->types[slot] == BEZIER);
+        assert(table->child_counts[slot] > 0);
+        assert(table->child_counts[slot] <= OBJECT_MAX_CONTROL_POINTS);
+        traverse(id, children, children + table->child_counts[slot]) {
+                child = object_table_resolve(table, *id);
+                assert(child != OBJECT_TABLE_NIL);
+                out[id - children] = table->transforms[child].position;
+        }
 }
 
-static inline int dyn_object_stack_push(uint32_t item, uint32_t *stack)
+// Points are degenerate boxes at their position, lines are bounded by their
+// endpoints, bezier curves by their curve and deleted objects are empty.
+static inline void object_compute_bounds(aabb2d *restrict out,
+                                         const ObjectTable *restrict table,
+                                         uint32_t slot)
 {
-        uint32_t *new_stack_data;
-        size_t sz = dyn_object_stack_size(stack);
+        vec2d control[OBJECT_MAX_CONTROL_POINTS];
+        const ObjectID *id, *children = object_table_children(table, slot);
+        uint32_t child;
 
-        if (sz >= 15 && BIT(loguint32(sz + 1)) == sz + 1) {
-                new_stack_data = realloc(stack, 2 * (sz + 1) * sizeof(*stack));
-                if (!new_stack_data) {
-                        return -1;
+        empty_aabb2d(out);
+        switch (table->types[slot]) {
+        case POINT:
+                extend_aabb2d(out, &table->transforms[slot].position);
+                break;
+        case LINE:
+                traverse(id, children, children + table->child_counts[slot]) {
+                        child = object_table_resolve(table, *id);
+                        assert(child != OBJECT_TABLE_NIL);
+                        extend_aabb2d(out, &table->transforms[child].position);
                 }
+                break;
+        case BEZIER:
+                object_control_points(table, slot, control);
+                bezier_bounds(table->child_counts[slot], control, out);
+                break;
+        case DELETED:
+                break;
         }
+}
 
-        stack[sz + 1] = item;
-        stack[0] += 1;
+static inline const aabb2d *object_bounds(ObjectTable *restrict table,
+                                          uint32_t slot)
+{
+        if (!(table->cached[slot] & OBJECT_CACHED_BOUNDS)) {
+                object_compute_bounds(&table->bounds[slot], table, slot);
+                table->cached[slot] |= OBJECT_CACHED_BOUNDS;
+        }
 
-        return 0;
+        return &table->bounds[slot];
 }
 
-static inline uint32_t dyn_object_stack_peek(const uint32_t *stack)
+// Returns the arc length table of a bezier curve, rebuilding it if it's out
+// of date. The table stays allocated when the object is invalidated, so that
+// rebuilding it doesn't allocate. Returns NULL on allocation failure.
+static inline const ArcLengthTable *object_arclength(
+        ObjectTable *restrict table,
+        uint32_t slot)
 {
-        return stack[dyn_object_stack_size(stack)];
+        vec2d control[OBJECT_MAX_CONTROL_POINTS];
+        ArcLengthTable **arclength = &table->arclengths[slot];
+
+        assert(table->types[slot] == BEZIER);
+        if (table->cached[slot] & OBJECT_CACHED_ARCLENGTH) {
+                return *arclength;
+        }
+        if (!*arclength) {
+                *arclength = tie_malloc(1, sizeof(**arclength));
+                if (!*arclength) {
+                        return NULL;
+                }
+        }
+
+        object_control_points(table, slot, control);
+        arclength_build(table->child_counts[slot], control, *arclength);
+        table->cached[slot] |= OBJECT_CACHED_ARCLENGTH;
+
+        return *arclength;
 }
 
-static inline Object *identify_object(const ObjectID *id,
-                                      Object *historical,
-                                      const uint32_t *latest)
+// Drops the cached data of an object and of everything built on top of it.
+// Must be called whenever the object's transform or control points change.
+// Parents that were removed are skipped.
+static inline void object_invalidate(ObjectTable *restrict table,
+                                     uint32_t slot)
 {
-        if (id->flagged_index & RBIT(id->flagged_index, 0)) {
-                return historical
-                     + dyn_object_stack_peek(
-                               &latest[id->flagged_index
-                                       & ~RBIT(id->flagged_index, 0)]);
+        const ObjectID *id, *parents = object_table_parents(table, slot);
+        uint32_t parent;
+
+        table->cached[slot] = 0;
+        traverse(id, parents, parents + table->parent_counts[slot]) {
+                parent = object_table_resolve(table, *id);
+                if (parent != OBJECT_TABLE_NIL) {
+                        object_invalidate(table, parent);
+                }
         }
-        return historical + id->flagged_index;
 }
 
-#define Location(ptr_type)                                                     \
-        union {                                                                \
-                ptr_type *address;                                             \
-                uint64_t offset;                                               \
+// Recomputes the cached data of an object whose children changed, as the
+// evaluator of dep_graph_update(). Arc length tables are only rebuilt for
+// curves that had one up to date.
+static inline int object_recompute(ObjectTable *restrict table,
+                                   uint32_t slot,
+                                   void *user)
+{
+        bool arclength = table->cached[slot] & OBJECT_CACHED_ARCLENGTH;
+
+        table->cached[slot] = 0;
+        if (table->types[slot] == DELETED) {
+                return 0;
         }
-#define location_make_absolute(base, location)                                 \
-        ((location)->address =                                                 \
-                 (void *)((unsigned char *)(base) + (location)->offset))
-#define location_make_relative(base, location)                                 \
-        ((location)->offset = (unsigned char *)(location)->address             \
-                            - (unsigned char *)(base))
+        object_bounds(table, slot);
 
-#define Stack(n) int
+        return arclength && !object_arclength(table, slot) ? -1 : 0;
+}
 
 typedef struct {
-        alignas(16) vec2d cursor_position;
-        Location(Object) object_tree;
-        Stack(BTreeRoot(ObjectID)) selection_stack;
-} HistoryEntry;
+        aabb2d bounds;
+        ArcLengthTable *arclength; // NULL if it isn't rebuilt
+} ObjectDerived;
 
-#define min(a, b) ((a) < (b) ? (a) : (b))
-#define max(a, b) ((a) > (b) ? (a) : (b))
+// The most scratch memory object_derive() takes for an object, as the result
+// size of dep_graph_update_parallel().
+#define OBJECT_DERIVED_SIZE                                                    \
+        (sizeof(ObjectDerived) + alignof(ObjectDerived)                        \
+         + sizeof(ArcLengthTable) + alignof(ArcLengthTable))
 
-#define MAX_LINEAR_HISTORIES UINT32_MAX
+// Computes what object_recompute() does without changing the table, as the
+// compute function of dep_graph_update_parallel().
+static inline int object_derive(const ObjectTable *restrict table,
+                                uint32_t slot,
+                                ScratchArena *restrict scratch,
+                                void **restrict result,
+                                void *user)
+{
+        vec2d control[OBJECT_MAX_CONTROL_POINTS];
+        ObjectDerived *d = scratch_alloc(scratch,
+                                         sizeof(*d),
+                                         alignof(ObjectDerived));
+
+        if (!d) {
+                return -1;
+        }
+        object_compute_bounds(&d->bounds, table, slot);
+        d->arclength = NULL;
+        if (table->types[slot] == BEZIER
+            && table->cached[slot] & OBJECT_CACHED_ARCLENGTH) {
+                d->arclength = scratch_alloc(scratch,
+                                             sizeof(*d->arclength),
+                                             alignof(ArcLengthTable));
+                if (!d->arclength) {
+                        return -1;
+                }
+                object_control_points(table, slot, control);
+                arclength_build(table->child_counts[slot],
+                                control,
+                                d->arclength);
+        }
+        *result = d;
 
-typedef struct LinearHistory_ LinearHistory;
+        return 0;
+}
 
-struct LinearHistory_ {
-        uint64_t size;
-        Location(HistoryEntry) entries;
-        uint32_t parent; // root if refers to itself
-        uint32_t children[2]; // not a child if refers to itself
-};
-#ifdef CACHE_LINE_SIZE
-static_assert(sizeof(LinearHistory) <= CACHE_LINE_SIZE);
-#endif
+// Stores the data computed by object_derive(), as the commit function of
+// dep_graph_update_parallel().
+static inline int object_commit(ObjectTable *restrict table,
+                                uint32_t slot,
+                                void *result,
+                                void *user)
+{
+        const ObjectDerived *d = result;
+        ArcLengthTable **arclength = &table->arclengths[slot];
 
-//
+        table->bounds[slot] = d->bounds;
+        table->cached[slot] = OBJECT_CACHED_BOUNDS;
+        if (d->arclength) {
+                if (!*arclength) {
+                        *arclength = tie_malloc(1, sizeof(**arclength));
+                        if (!*arclength) {
+                                return -1;
+                        }
+                }
+                **arclength = *d->arclength;
+                table->cached[slot] |= OBJECT_CACHED_ARCLENGTH;
+        }
 
-typedef struct History_ History;
+        return 0;
+}
 
-struct History_ {
-        uint64_t size;
-        uint64_t capacity;
-        Location(LinearHistory) tree;
-        Location(HistoryEntry) entries;
-        uint64_t current_entry;
-};
+// Bulk loads a spatial index over all objects, identified by their slot.
+// The scratch array needs room for an entry per slot.
+static inline int object_index_build(RTree *restrict index,
+                                     ObjectTable *restrict table,
+                                     RTreeEntry scratch[static restrict 1],
+                                     Reallocator *reallocator,
+                                     void *user)
+{
+        RTreeEntry *e = scratch;
+        uint32_t slot;
 
-typedef struct TieFileHeader_ TieFileHeader;
+        for (slot = 0; slot < table->count; ++slot) {
+                if (table->types[slot] == DELETED) {
+                        continue;
+                }
+                e->id = slot;
+                e->bounds = *object_bounds(table, slot);
+                ++e;
+        }
 
-struct TieFileHeader_ {
-        uint8_t magic_byte; // 0x83
-        int8_t tie_string[3];
-        uint16_t major;
-        uint16_t minor;
-        History history;
-};
+        return rtree_bulk_load(index, e - scratch, scratch, reallocator, user);
+}
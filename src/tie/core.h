@@ -0,0 +1,184 @@
+/*! \file core.h
+ *  \brief The document model
+ *
+ *  Objects, their history and the layout of .tie files. Every structure
+ *  stored in a file refers to others through a #Location, which holds an
+ *  offset from the start of the file on disk and may hold an address in
+ *  memory, so that files can be used where they are mapped (see tiefile.h).
+ *  Files are stored in the byte order of the machine that wrote them.
+ */
+#ifndef TIE_CORE_H
+#define TIE_CORE_H
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+
+#include "arclength.h"
+#include "math.h"
+
+typedef uint32_t HistoryID;
+
+#define HISTORYID_MAX UINT32_MAX
+
+// Identifies an object by its slot in an #ObjectTable. The generation of a
+// slot changes whenever its object is removed, so IDs of removed objects
+// can be told apart from those of objects that reuse their slot.
+typedef struct {
+        uint32_t index;
+        uint32_t generation;
+} ObjectID;
+
+typedef enum {
+        POINT,
+        LINE,
+        BEZIER, // the children are the control points, in order
+        DELETED // the slot of an object that no longer exists
+} ObjectType;
+
+// Derived data that objects cache, as flags for ObjectTable.cached (see
+// objecttable.h).
+enum {
+        OBJECT_CACHED_BOUNDS = 1 << 0,
+        OBJECT_CACHED_ARCLENGTH = 1 << 1
+};
+
+#define OBJECT_MAX_CONTROL_POINTS 32
+static_assert(OBJECT_MAX_CONTROL_POINTS <= ARCLENGTH_MAX_CONTROL_POINTS);
+
+#define Location(ptr_type)                                                     \
+        union {                                                                \
+                ptr_type *address;                                             \
+                uint64_t offset;                                               \
+        }
+#define location_make_absolute(base, location)                                 \
+        ((location)->address =                                                 \
+                 (void *)((unsigned char *)(base) + (location)->offset))
+#define location_make_relative(base, location)                                 \
+        ((location)->offset = (unsigned char *)(location)->address             \
+                            - (unsigned char *)(base))
+// Resolves an offset without storing the address, so that read-only
+// mappings aren't written to.
+#define location_resolve(base, location)                                       \
+        ((void *)((unsigned char *)(base) + (location).offset))
+
+typedef struct {
+        mat2d matrix;
+        vec2d position;
+} Transform;
+
+// In an object store, the links are offsets from the start of the links of
+// the store (see objectstore.h).
+typedef struct {
+        ObjectType type;
+        Transform transform;
+        uint32_t parent_count;
+        uint32_t child_count;
+        Location(ObjectID) parents;
+        Location(ObjectID) children;
+} Object;
+
+#define OBJECT_STORE_BITS 5
+#define OBJECT_STORE_WIDTH (1 << OBJECT_STORE_BITS)
+#define OBJECT_STORE_NIL UINT32_MAX
+// The version without any objects.
+#define OBJECT_VERSION_EMPTY                                                   \
+        ((ObjectVersion){ .root = OBJECT_STORE_NIL, .count = 0, .height = 0 })
+
+// A node of the trie of an object store (see objectstore.h).
+typedef struct {
+        uint32_t edit; // the edit that created the node
+        // Child nodes, or objects in leaves, #OBJECT_STORE_NIL if unused.
+        uint32_t slots[OBJECT_STORE_WIDTH];
+} ObjectStoreNode;
+
+// A version of all objects in an object store, e.g. of a history entry.
+typedef struct {
+        uint32_t root; // #OBJECT_STORE_NIL if there are no objects
+        uint32_t count; // amount of object slots
+        uint32_t height; // amount of levels above the leaves
+} ObjectVersion;
+
+#define Stack(n) int
+
+typedef struct {
+        alignas(16) vec2d cursor_position;
+        ObjectVersion objects; // in the object store of the document
+        Stack(BTreeRoot(ObjectID)) selection_stack;
+} HistoryEntry;
+
+#define MAX_LINEAR_HISTORIES UINT32_MAX
+
+typedef struct LinearHistory_ LinearHistory;
+
+// A linear history branches off its parent after a number of the parent's
+// entries, its first entry being made from the last of them. Branching
+// leaves the parent as it is, and a linear history may have any amount of
+// children.
+struct LinearHistory_ {
+        uint64_t size;
+        Location(HistoryEntry) entries; // a range of History.entries
+        uint64_t offset; // amount of entries of the parent before the branch
+        uint32_t parent; // root if refers to itself
+};
+#ifdef CACHE_LINE_SIZE
+static_assert(sizeof(LinearHistory) <= CACHE_LINE_SIZE);
+#endif
+
+typedef struct History_ History;
+
+// Linear histories are numbered by their index in the tree, the root being
+// the first one, and every other one coming after its parent. Entries are
+// numbered by their index in the entries of all linear histories, which
+// hold them in the same order: only the last linear history can grow, and a
+// new one starts after the entries of all others.
+struct History_ {
+        uint64_t size; // amount of entries
+        uint64_t capacity; // room for entries, the same as `size` in files
+        Location(LinearHistory) tree;
+        Location(HistoryEntry) entries;
+        uint64_t current_entry;
+        uint32_t tree_size; // amount of linear histories
+        uint32_t tree_capacity; // the same as `tree_size` in files
+};
+
+// The object store of a file, laid out like the arrays of an object store,
+// whose objects it holds as they are.
+typedef struct {
+        uint32_t edit; // the last edit of the store
+        uint32_t node_count;
+        uint32_t object_count;
+        uint64_t link_count;
+        Location(ObjectStoreNode) nodes;
+        Location(Object) objects;
+        Location(uint32_t) generations;
+        Location(ObjectID) links;
+} StoredObjects;
+
+// How far a file got in the journal of its document (see journal.h): the
+// first `records` records of the journal of the given generation are in it.
+typedef struct {
+        uint64_t generation;
+        uint64_t records;
+} JournalPosition;
+
+#define TIE_MAGIC_BYTE 0x83
+#define TIE_STRING "TIE"
+// Files of another major version can't be read; minor versions only add to
+// the format.
+#define TIE_MAJOR 3
+#define TIE_MINOR 0
+
+typedef struct TieFileHeader_ TieFileHeader;
+
+struct TieFileHeader_ {
+        uint8_t magic_byte; // 0x83
+        int8_t tie_string[3];
+        uint16_t major;
+        uint16_t minor;
+        History history;
+        StoredObjects objects;
+        JournalPosition journal;
+};
+
+#endif
@@ -0,0 +1,361 @@
+#include <math.h>
+#include <string.h>
+
+#include "array.h"
+#include "attrib.h"
+#include "curve_fit.h"
+#include "geometry.h"
+#include "math.h"
+
+// Reparameterization passes before giving up on a fit.
+#define CURVE_FIT_ITERATIONS 4
+// Fits this much worse than the tolerance may still be fixed by
+// reparameterization; worse ones are given up on right away.
+#define CURVE_FIT_ITERATION_FACTOR 4
+
+static inline vec2d curve_fit_eval(size_t n,
+                                   const vec2d bezier[static restrict n],
+                                   double t)
+{
+        // the left split is unused, but passing NULL for an array with a
+        // bound is diagnosed once inlined
+        vec2d temp[4], left[4];
+        size_t i;
+
+        for (i = 0; i < n; ++i) {
+                temp[i] = bezier[i];
+        }
+        de_casteljau(t, n, temp, left);
+
+        return temp[0];
+}
+
+// Assigns each sample its relative distance along the polyline.
+static void curve_fit_chord_params(size_t m,
+                                   const vec2d samples[static restrict m],
+                                   double params[static restrict m])
+{
+        vec2d diff;
+        size_t i;
+
+        params[0] = 0;
+        for (i = 1; i < m; ++i) {
+                diff = samples[i];
+                sub_vec2d(&diff, &samples[i - 1]);
+                params[i] = params[i - 1] + sqrt(sqrmag_vec2d(&diff));
+        }
+        for (i = 1; i < m; ++i) {
+                params[i] /= params[m - 1];
+        }
+}
+
+// Places the inner control points along the tangents at a third of the
+// chord, which is what a straight line would use.
+static void curve_fit_heuristic(size_t m,
+                                const vec2d samples[static restrict m],
+                                const vec2d *restrict t1,
+                                const vec2d *restrict t2,
+                                vec2d bezier[static restrict 4])
+{
+        vec2d diff;
+        double alpha;
+
+        diff = samples[m - 1];
+        sub_vec2d(&diff, &samples[0]);
+        alpha = sqrt(sqrmag_vec2d(&diff)) / 3;
+
+        bezier[0] = samples[0];
+        bezier[3] = samples[m - 1];
+        bezier[1] = *t1;
+        scale_vec2d(&bezier[1], alpha);
+        add_vec2d(&bezier[1], &bezier[0]);
+        bezier[2] = *t2;
+        scale_vec2d(&bezier[2], alpha);
+        add_vec2d(&bezier[2], &bezier[3]);
+}
+
+// Finds the distances of the inner control points along the unit tangents
+// that minimize the squared distances of the samples from the curve at
+// their parameters.
+static void curve_fit_least_squares(size_t m,
+                                    const vec2d samples[static restrict m],
+                                    const double params[static restrict m],
+                                    const vec2d *restrict t1,
+                                    const vec2d *restrict t2,
+                                    vec2d bezier[static restrict 4])
+{
+        double c00 = 0, c01 = 0, c11 = 0, x0 = 0, x1 = 0;
+        double u, s, b0, b1, b2, b3, det, alpha1, alpha2, eps;
+        vec2d a1, a2, tmp, end;
+        size_t i;
+
+        for (i = 0; i < m; ++i) {
+                u = params[i];
+                s = 1 - u;
+                b0 = s * s * s;
+                b1 = 3 * u * s * s;
+                b2 = 3 * u * u * s;
+                b3 = u * u * u;
+
+                a1 = *t1;
+                scale_vec2d(&a1, b1);
+                a2 = *t2;
+                scale_vec2d(&a2, b2);
+                c00 += dot_vec2d(&a1, &a1);
+                c01 += dot_vec2d(&a1, &a2);
+                c11 += dot_vec2d(&a2, &a2);
+
+                // the sample minus the curve with zero length tangents
+                tmp = samples[0];
+                scale_vec2d(&tmp, -(b0 + b1));
+                end = samples[m - 1];
+                scale_vec2d(&end, b2 + b3);
+                sub_vec2d(&tmp, &end);
+                add_vec2d(&tmp, &samples[i]);
+                x0 += dot_vec2d(&a1, &tmp);
+                x1 += dot_vec2d(&a2, &tmp);
+        }
+
+        det = c00 * c11 - c01 * c01;
+        tmp = samples[m - 1];
+        sub_vec2d(&tmp, &samples[0]);
+        eps = 1e-6 * sqrt(sqrmag_vec2d(&tmp));
+        if (fabs(det) <= eps * eps * eps * eps) {
+                curve_fit_heuristic(m, samples, t1, t2, bezier);
+                return;
+        }
+        alpha1 = (x0 * c11 - x1 * c01) / det;
+        alpha2 = (c00 * x1 - c01 * x0) / det;
+        // negative or tiny lengths would produce loops or cusps
+        if (alpha1 < eps || alpha2 < eps) {
+                curve_fit_heuristic(m, samples, t1, t2, bezier);
+                return;
+        }
+
+        bezier[0] = samples[0];
+        bezier[3] = samples[m - 1];
+        bezier[1] = *t1;
+        scale_vec2d(&bezier[1], alpha1);
+        add_vec2d(&bezier[1], &bezier[0]);
+        bezier[2] = *t2;
+        scale_vec2d(&bezier[2], alpha2);
+        add_vec2d(&bezier[2], &bezier[3]);
+}
+
+// Returns the largest squared distance of a sample from the curve.
+PURE_FUNC static double curve_fit_max_error(
+        size_t m,
+        const vec2d samples[static restrict m],
+        const double params[static restrict m],
+        const vec2d bezier[static restrict 4])
+{
+        double sqrdist, max_sqrdist = 0;
+        vec2d diff;
+        size_t i;
+
+        for (i = 1; i + 1 < m; ++i) {
+                diff = curve_fit_eval(4, bezier, params[i]);
+                sub_vec2d(&diff, &samples[i]);
+                sqrdist = sqrmag_vec2d(&diff);
+                max_sqrdist = max(max_sqrdist, sqrdist);
+        }
+
+        return max_sqrdist;
+}
+
+// Moves each parameter one Newton step closer to the point of the curve
+// nearest to its sample.
+static void curve_fit_reparameterize(size_t m,
+                                     const vec2d samples[static restrict m],
+                                     double params[static restrict m],
+                                     const vec2d bezier[static restrict 4])
+{
+        vec2d d1[3], d2[2], q, q1, q2;
+        double numerator, denominator, u;
+        size_t i;
+
+        for (i = 0; i < 3; ++i) {
+                d1[i] = bezier[i + 1];
+                sub_vec2d(&d1[i], &bezier[i]);
+                scale_vec2d(&d1[i], 3);
+        }
+        for (i = 0; i < 2; ++i) {
+                d2[i] = d1[i + 1];
+                sub_vec2d(&d2[i], &d1[i]);
+                scale_vec2d(&d2[i], 2);
+        }
+
+        for (i = 1; i + 1 < m; ++i) {
+                q = curve_fit_eval(4, bezier, params[i]);
+                q1 = curve_fit_eval(3, d1, params[i]);
+                q2 = curve_fit_eval(2, d2, params[i]);
+                sub_vec2d(&q, &samples[i]);
+                numerator = dot_vec2d(&q, &q1);
+                denominator = dot_vec2d(&q1, &q1) + dot_vec2d(&q, &q2);
+                if (denominator != 0) {
+                        u = params[i] - numerator / denominator;
+                        params[i] = fmin(fmax(u, 0), 1);
+                }
+        }
+}
+
+// Fits the open samples with a single curve. Returns whether the fit is
+// within the tolerance.
+static bool curve_fit_samples(CurveFitter *restrict fitter,
+                              vec2d bezier[static restrict 4])
+{
+        const size_t m = fitter->sample_count;
+        const vec2d *samples = fitter->samples;
+        double *params = fitter->params;
+        const double sqrerror = fitter->error * fitter->error;
+        double sqrdist;
+        vec2d t1, t2;
+        int i;
+
+        assert(m >= 2);
+
+        t1 = fitter->tangent;
+        if (sqrmag_vec2d(&t1) == 0) {
+                t1 = samples[1];
+                sub_vec2d(&t1, &samples[0]);
+                normalize_vec2d(&t1);
+        }
+        t2 = samples[m - 2];
+        sub_vec2d(&t2, &samples[m - 1]);
+        normalize_vec2d(&t2);
+
+        curve_fit_chord_params(m, samples, params);
+
+        // straight runs are common and need no least squares
+        if (colinear(m, samples, fitter->error)) {
+                curve_fit_heuristic(m, samples, &t1, &t2, bezier);
+                if (curve_fit_max_error(m, samples, params, bezier)
+                    <= sqrerror) {
+                        return true;
+                }
+        }
+
+        for (i = 0; i < CURVE_FIT_ITERATIONS; ++i) {
+                curve_fit_least_squares(m, samples, params, &t1, &t2, bezier);
+                sqrdist = curve_fit_max_error(m, samples, params, bezier);
+                if (sqrdist <= sqrerror) {
+                        return true;
+                }
+                if (sqrdist > sqrerror * CURVE_FIT_ITERATION_FACTOR) {
+                        break;
+                }
+                curve_fit_reparameterize(m, samples, params, bezier);
+        }
+
+        return false;
+}
+
+// Appends the open curve to the output.
+static int curve_fit_commit(CurveFitter *restrict fitter,
+                            Reallocator *reallocator,
+                            void *user)
+{
+        vec2d *out = fitter->out;
+        size_t out_sz = fitter->out_sz;
+        size_t needed = fitter->out_count + (fitter->out_count ? 3 : 4);
+
+        if (needed > out_sz
+            && !auxiliary_realloc(reallocator,
+                                  &out_sz,
+                                  &out,
+                                  &fitter->out_sz,
+                                  &fitter->out,
+                                  needed,
+                                  user)) {
+                return -1;
+        }
+
+        if (fitter->out_count == 0) {
+                out[fitter->out_count++] = fitter->open[0];
+        }
+        out[fitter->out_count++] = fitter->open[1];
+        out[fitter->out_count++] = fitter->open[2];
+        out[fitter->out_count++] = fitter->open[3];
+
+        return 0;
+}
+
+void curve_fit_init(CurveFitter *restrict fitter,
+                    double error,
+                    size_t out_sz,
+                    vec2d out[static restrict out_sz])
+{
+        assert(error > 0);
+        assert(out_sz > 0);
+
+        fitter->error = error;
+        vec_x(fitter->tangent) = vec_y(fitter->tangent) = 0;
+        fitter->sample_count = 0;
+        fitter->out_count = 0;
+        fitter->out_sz = out_sz;
+        fitter->out = out;
+}
+
+int curve_fit_add(CurveFitter *restrict fitter,
+                  const vec2d *restrict sample,
+                  Reallocator *reallocator,
+                  void *user)
+{
+        vec2d bezier[4], *last;
+        size_t m = fitter->sample_count;
+
+        if (m > 0) {
+                last = &fitter->samples[m - 1];
+                if (vec_x(*last) == vec_x(*sample)
+                    && vec_y(*last) == vec_y(*sample)) {
+                        return 0;
+                }
+        }
+
+        if (m < CURVE_FIT_MAX_SAMPLES) {
+                fitter->samples[fitter->sample_count++] = *sample;
+                if (fitter->sample_count < 2) {
+                        return 0;
+                }
+                if (curve_fit_samples(fitter, bezier)) {
+                        memcpy(fitter->open, bezier, sizeof(bezier));
+                        return 0;
+                }
+                fitter->sample_count = m;
+        }
+
+        // The open curve can't take the new sample, so it's committed as it
+        // is and a new one starts at its end.
+        if (curve_fit_commit(fitter, reallocator, user)) {
+                return -1;
+        }
+        fitter->tangent = fitter->open[3];
+        sub_vec2d(&fitter->tangent, &fitter->open[2]);
+        if (sqrmag_vec2d(&fitter->tangent) > 0) {
+                normalize_vec2d(&fitter->tangent);
+        }
+        fitter->samples[0] = fitter->samples[m - 1];
+        fitter->samples[1] = *sample;
+        fitter->sample_count = 2;
+        // two samples always fit
+        curve_fit_samples(fitter, fitter->open);
+
+        return 0;
+}
+
+int curve_fit_finish(CurveFitter *restrict fitter,
+                     Reallocator *reallocator,
+                     void *user)
+{
+        if (fitter->sample_count >= 2) {
+                if (curve_fit_commit(fitter, reallocator, user)) {
+                        return -1;
+                }
+        } else if (fitter->sample_count == 1 && fitter->out_count == 0) {
+                // a single dot, the output array has room for at least one
+                fitter->out[fitter->out_count++] = fitter->samples[0];
+        }
+        fitter->sample_count = 0;
+
+        return 0;
+}
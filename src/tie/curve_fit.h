@@ -0,0 +1,100 @@
+/*! \file curve_fit.h
+ *  \brief Incremental fitting of freehand input with cubic beziers
+ *
+ *  Turns a stream of input samples, e.g. pen or mouse positions, into a
+ *  piecewise cubic bezier curve that stays within a given distance of every
+ *  sample. Each curve is fit with Schneider's algorithm from "An Algorithm
+ *  for Automatically Fitting Digitized Curves": least squares for the
+ *  tangent lengths, followed by Newton reparameterization of the samples.
+ *
+ *  Fitting is incremental. Only the samples since the last committed curve
+ *  are kept and refit when a new sample arrives; as soon as they can't be
+ *  fit by a single curve anymore, the last good fit is committed and a new
+ *  curve is started from its end, with its tangent for G1 continuity. The
+ *  amount of kept samples is bounded by #CURVE_FIT_MAX_SAMPLES, which bounds
+ *  the work per sample. The only allocations are for the committed curves,
+ *  through the usual reallocator protocol (see algo.h), so preallocating the
+ *  output makes adding samples allocation-free.
+ */
+#ifndef TIE_CURVE_FIT_H
+#define TIE_CURVE_FIT_H
+
+#include "algo.h"
+#include "attrib.h"
+#include "math.h"
+
+// The open curve is committed once it spans this many samples.
+#define CURVE_FIT_MAX_SAMPLES 128
+
+/*! \brief State of an incremental fit.
+ *
+ *  The result is a line strip of control points `out[0]` through
+ *  `out[out_count - 1]`, where every curve shares its first control point
+ *  with the last one of the previous curve, followed by the open curve if
+ *  there are at least two samples. The open curve already fits all of the
+ *  samples, but may still change as new samples arrive.
+ */
+typedef struct {
+        double error;
+        vec2d tangent; // unit start tangent of the open curve, or zero
+        vec2d open[4]; // the open curve
+        size_t sample_count; // samples in the open curve
+        size_t out_count;
+        size_t out_sz;
+        vec2d *out;
+        double params[CURVE_FIT_MAX_SAMPLES];
+        vec2d samples[CURVE_FIT_MAX_SAMPLES];
+} CurveFitter;
+
+/*! \brief Starts a new fit.
+ *
+ *  \param[out] fitter The fitter to initialize.
+ *  \param[in] error Maximal distance of a sample from the fitted curve. Must
+ *  be positive.
+ *  \param[in] out_sz Size of the `out` array. Must be at least 1.
+ *  \param[in] out The output array for the committed curves. Must come from
+ *  an allocator compatible with the reallocator passed to the other
+ *  routines.
+ */
+extern void curve_fit_init(CurveFitter *restrict fitter,
+                           double error,
+                           size_t out_sz,
+                           vec2d out[static restrict out_sz]);
+
+/*! \brief Adds a sample to a fit.
+ *
+ *  Runs in \f$O(m)\f$, where \f$m\f$ is the amount of samples in the open
+ *  curve, which is at most #CURVE_FIT_MAX_SAMPLES. Samples equal to the
+ *  previous one are ignored.
+ *
+ *  \param[in,out] fitter The fitter.
+ *  \param[in] sample The new sample.
+ *  \param[in] reallocator Reallocator for `fitter->out`. May be NULL, in
+ *  which case the function fails when the output array becomes full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure. On failure the fitter is
+ *  left unchanged.
+ */
+extern int curve_fit_add(CurveFitter *restrict fitter,
+                         const vec2d *restrict sample,
+                         Reallocator *reallocator,
+                         void *user);
+
+/*! \brief Commits the open curve, ending the fit.
+ *
+ *  Afterwards `fitter->out` holds the whole fit. The fitter has to be
+ *  initialized again before adding more samples.
+ *
+ *  \param[in,out] fitter The fitter.
+ *  \param[in] reallocator See curve_fit_add().
+ *  \param[in,out] user See curve_fit_add().
+ *
+ *  \return 0 on success, -1 on allocation failure. On failure the fitter is
+ *  left unchanged.
+ */
+extern int curve_fit_finish(CurveFitter *restrict fitter,
+                            Reallocator *reallocator,
+                            void *user);
+
+#endif
@@ -0,0 +1,813 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "delaunay.h"
+#include "functional.h"
+#include "math.h"
+#include "predicates.h"
+#include "random.h"
+
+// Bits per coordinate of the Hilbert curve ordering each round of a bulk
+// insertion. Leaves 5 bits for the round and 32 for the point in a key.
+#define DELAUNAY_HILBERT_ORDER 13
+#define DELAUNAY_ROUNDS 32
+#define DELAUNAY_SEED 0x44656C61756E6179
+
+#define delaunay_next(i) ((i) == 2 ? 0 : (i) + 1)
+#define delaunay_prev(i) ((i) == 0 ? 2 : (i) - 1)
+
+// Index of vertex v in triangle t.
+PURE_FUNC static inline size_t delaunay_index(const DelaunayTriangle *t,
+                                              uint32_t v)
+{
+        return t->vertex[0] == v ? 0 : t->vertex[1] == v ? 1 : 2;
+}
+
+// Index of the vertex of triangle t that is neither a nor b, i.e. of the
+// neighbor across the edge between them.
+PURE_FUNC static inline size_t delaunay_opposite(const DelaunayTriangle *t,
+                                                 uint32_t a,
+                                                 uint32_t b)
+{
+        size_t i;
+
+        for (i = 0; i < 2; ++i) {
+                if (t->vertex[i] != a && t->vertex[i] != b) {
+                        break;
+                }
+        }
+        return i;
+}
+
+static inline void delaunay_set(DelaunayTriangle *restrict t,
+                                uint32_t a,
+                                uint32_t b,
+                                uint32_t c,
+                                uint32_t na,
+                                uint32_t nb,
+                                uint32_t nc)
+{
+        t->vertex[0] = a;
+        t->vertex[1] = b;
+        t->vertex[2] = c;
+        t->neighbor[0] = na;
+        t->neighbor[1] = nb;
+        t->neighbor[2] = nc;
+}
+
+// Makes triangle t point to `to` instead of `from`.
+static inline void delaunay_replace(Delaunay *restrict d,
+                                    uint32_t t,
+                                    uint32_t from,
+                                    uint32_t to)
+{
+        uint32_t *n = d->triangles[t].neighbor;
+
+        n[n[0] == from ? 0 : n[1] == from ? 1 : 2] = to;
+}
+
+// Points vertex v at triangle t, unless it's the infinite vertex.
+static inline void delaunay_attach(Delaunay *restrict d, uint32_t v, uint32_t t)
+{
+        if (v != DELAUNAY_INFINITE) {
+                d->vertices[v].triangle = t;
+        }
+}
+
+// Hands out a triangle. The invariant kept by the insertion routines, that
+// there's room for two triangles per vertex, makes sure there is one.
+static uint32_t delaunay_new_triangle(Delaunay *restrict d)
+{
+        uint32_t t = d->free_triangle;
+
+        if (t == DELAUNAY_NIL) {
+                assert(d->triangle_count < d->triangles_sz);
+                return d->triangle_count++;
+        }
+        d->free_triangle = d->triangles[t].neighbor[0];
+        return t;
+}
+
+static void delaunay_free_triangle(Delaunay *restrict d, uint32_t t)
+{
+        d->triangles[t].vertex[0] = DELAUNAY_NIL;
+        d->triangles[t].neighbor[0] = d->free_triangle;
+        d->free_triangle = t;
+}
+
+static inline const vec2d *delaunay_position(const Delaunay *restrict d,
+                                             uint32_t v)
+{
+        return &d->vertices[v].position;
+}
+
+// Tests whether point w lies strictly inside segment ab, all three being
+// colinear.
+PURE_FUNC static bool delaunay_between(const vec2d *a,
+                                       const vec2d *b,
+                                       const vec2d *w)
+{
+        if (vec_x(*a) != vec_x(*b)) {
+                return (vec_x(*a) < vec_x(*w)) == (vec_x(*w) < vec_x(*b));
+        }
+        return (vec_y(*a) < vec_y(*w)) == (vec_y(*w) < vec_y(*b));
+}
+
+// Tests whether vertex w lies strictly inside the circumcircle of triangle
+// abc, counter-clockwise. The circumcircle of a ghost triangle is the open
+// half-plane beyond its hull edge, together with the inside of that edge.
+// The infinite vertex lies inside no circle.
+PURE_FUNC static bool delaunay_in_circle(const Delaunay *restrict d,
+                                         uint32_t a,
+                                         uint32_t b,
+                                         uint32_t c,
+                                         uint32_t w)
+{
+        const vec2d *p, *q, *r;
+        double side;
+
+        if (w == DELAUNAY_INFINITE) {
+                return false;
+        }
+        r = delaunay_position(d, w);
+
+        // rotate the hull edge of ghost triangles to pq
+        if (c == DELAUNAY_INFINITE) {
+                p = delaunay_position(d, a);
+                q = delaunay_position(d, b);
+        } else if (a == DELAUNAY_INFINITE) {
+                p = delaunay_position(d, b);
+                q = delaunay_position(d, c);
+        } else if (b == DELAUNAY_INFINITE) {
+                p = delaunay_position(d, c);
+                q = delaunay_position(d, a);
+        } else {
+                return incircle(delaunay_position(d, a),
+                                delaunay_position(d, b),
+                                delaunay_position(d, c),
+                                r)
+                     > 0;
+        }
+
+        side = orient2d(p, q, r);
+        return side > 0 || (side == 0 && delaunay_between(p, q, r));
+}
+
+// Tests whether the edge opposite vertex p of triangle pxy must be flipped
+// because the apex of the triangle on its other side lies inside the
+// circumcircle. Points on the circle don't flip, nor do points on the line
+// of a hull edge, which would create a flat triangle.
+PURE_FUNC static bool delaunay_must_flip(const Delaunay *restrict d,
+                                         uint32_t p,
+                                         uint32_t x,
+                                         uint32_t y,
+                                         uint32_t apex)
+{
+        if (apex == DELAUNAY_INFINITE) {
+                return false;
+        }
+        if (x == DELAUNAY_INFINITE) {
+                return orient2d(delaunay_position(d, y),
+                                delaunay_position(d, p),
+                                delaunay_position(d, apex))
+                     > 0;
+        }
+        if (y == DELAUNAY_INFINITE) {
+                return orient2d(delaunay_position(d, p),
+                                delaunay_position(d, x),
+                                delaunay_position(d, apex))
+                     > 0;
+        }
+        return incircle(delaunay_position(d, p),
+                        delaunay_position(d, x),
+                        delaunay_position(d, y),
+                        delaunay_position(d, apex))
+             > 0;
+}
+
+typedef enum {
+        DELAUNAY_IN_FACE,
+        DELAUNAY_ON_EDGE, // on the edge opposite the returned index
+        DELAUNAY_ON_VERTEX // at the vertex of the returned index
+} DelaunayLocation;
+
+// Walks from the last triangle touched towards p, crossing any edge p lies
+// beyond, until p lies in the current triangle or outside the convex hull.
+// Such a walk always ends in a Delaunay triangulation.
+static uint32_t delaunay_walk(const Delaunay *restrict d,
+                              const vec2d *restrict p,
+                              DelaunayLocation *restrict where,
+                              size_t *restrict index)
+{
+        const DelaunayTriangle *tri = &d->triangles[d->last];
+        uint32_t t = d->last, a, b;
+        size_t zeros, zero_sum, i;
+        double side;
+
+        if (delaunay_is_ghost(tri)) {
+                t = tri->neighbor[delaunay_index(tri, DELAUNAY_INFINITE)];
+        }
+
+        for (;;) {
+                tri = &d->triangles[t];
+                zeros = 0;
+                zero_sum = 0;
+                for (i = 0; i < 3; ++i) {
+                        a = tri->vertex[delaunay_next(i)];
+                        b = tri->vertex[delaunay_prev(i)];
+                        side = orient2d(delaunay_position(d, a),
+                                        delaunay_position(d, b),
+                                        p);
+                        if (side < 0) {
+                                break;
+                        }
+                        if (side == 0) {
+                                ++zeros;
+                                zero_sum += i;
+                        }
+                }
+                if (i == 3) {
+                        break;
+                }
+                t = tri->neighbor[i];
+                if (delaunay_is_ghost(&d->triangles[t])) {
+                        *where = DELAUNAY_IN_FACE;
+                        return t;
+                }
+        }
+
+        if (zeros == 0) {
+                *where = DELAUNAY_IN_FACE;
+        } else if (zeros == 1) {
+                *where = DELAUNAY_ON_EDGE;
+                *index = zero_sum;
+        } else {
+                *where = DELAUNAY_ON_VERTEX;
+                *index = 3 - zero_sum;
+        }
+        return t;
+}
+
+// Splits triangle abc into abp, bcp and cap.
+static void delaunay_split_face(Delaunay *restrict d, uint32_t t, uint32_t p)
+{
+        const DelaunayTriangle *tri = &d->triangles[t];
+        const uint32_t a = tri->vertex[0], b = tri->vertex[1];
+        const uint32_t c = tri->vertex[2], na = tri->neighbor[0];
+        const uint32_t nb = tri->neighbor[1], nc = tri->neighbor[2];
+        const uint32_t u = delaunay_new_triangle(d);
+        const uint32_t w = delaunay_new_triangle(d);
+
+        delaunay_set(&d->triangles[t], a, b, p, u, w, nc);
+        delaunay_set(&d->triangles[u], b, c, p, w, t, na);
+        delaunay_set(&d->triangles[w], c, a, p, t, u, nb);
+        delaunay_replace(d, na, t, u);
+        delaunay_replace(d, nb, t, w);
+        delaunay_attach(d, c, u);
+        delaunay_attach(d, p, t);
+}
+
+// Splits triangle abc, where a has index i, and the triangle ecb on the other
+// side of bc into abp, apc, ecp and epb.
+static void delaunay_split_edge(Delaunay *restrict d,
+                                uint32_t t,
+                                size_t i,
+                                uint32_t p)
+{
+        const DelaunayTriangle *tri = &d->triangles[t];
+        const uint32_t a = tri->vertex[i], b = tri->vertex[delaunay_next(i)];
+        const uint32_t c = tri->vertex[delaunay_prev(i)], s = tri->neighbor[i];
+        const uint32_t nca = tri->neighbor[delaunay_next(i)];
+        const uint32_t nab = tri->neighbor[delaunay_prev(i)];
+        const DelaunayTriangle *other = &d->triangles[s];
+        const size_t j = delaunay_opposite(other, b, c);
+        const uint32_t e = other->vertex[j];
+        const uint32_t nbe = other->neighbor[delaunay_next(j)];
+        const uint32_t nec = other->neighbor[delaunay_prev(j)];
+        const uint32_t u = delaunay_new_triangle(d);
+        const uint32_t w = delaunay_new_triangle(d);
+
+        delaunay_set(&d->triangles[t], a, b, p, w, u, nab);
+        delaunay_set(&d->triangles[u], a, p, c, s, nca, t);
+        delaunay_set(&d->triangles[s], e, c, p, u, w, nec);
+        delaunay_set(&d->triangles[w], e, p, b, t, nbe, s);
+        delaunay_replace(d, nca, t, u);
+        delaunay_replace(d, nbe, s, w);
+        delaunay_attach(d, b, t);
+        delaunay_attach(d, c, u);
+        delaunay_attach(d, p, t);
+}
+
+// Flips the edge opposite index i of triangle t, turning triangle pxy and
+// the triangle dyx on the other side into pxd and pdy.
+static void delaunay_flip(Delaunay *restrict d, uint32_t t, size_t i)
+{
+        const DelaunayTriangle *tri = &d->triangles[t];
+        const uint32_t p = tri->vertex[i], x = tri->vertex[delaunay_next(i)];
+        const uint32_t y = tri->vertex[delaunay_prev(i)], u = tri->neighbor[i];
+        const uint32_t npx = tri->neighbor[delaunay_prev(i)];
+        const uint32_t nyp = tri->neighbor[delaunay_next(i)];
+        const DelaunayTriangle *other = &d->triangles[u];
+        const size_t j = delaunay_opposite(other, x, y);
+        const uint32_t apex = other->vertex[j];
+        const uint32_t nxd = other->neighbor[delaunay_next(j)];
+        const uint32_t ndy = other->neighbor[delaunay_prev(j)];
+
+        delaunay_set(&d->triangles[t], p, x, apex, nxd, u, npx);
+        delaunay_set(&d->triangles[u], p, apex, y, ndy, nyp, t);
+        delaunay_replace(d, nxd, u, t);
+        delaunay_replace(d, nyp, t, u);
+        delaunay_attach(d, x, t);
+        delaunay_attach(d, y, u);
+}
+
+// Restores the Delaunay property around a new vertex p of the given degree,
+// starting from its triangle t. The triangles around p are visited
+// counter-clockwise; flipping the edge opposite p adds a triangle, which is
+// visited next, and all other edges stay unaffected. So once as many
+// triangles in a row as there are around p need no flip, all is done.
+static void delaunay_legalize(Delaunay *restrict d,
+                              uint32_t t,
+                              uint32_t p,
+                              size_t degree)
+{
+        const DelaunayTriangle *tri, *other;
+        size_t good = 0, i;
+        uint32_t x, y, apex;
+
+        while (good < degree) {
+                tri = &d->triangles[t];
+                i = delaunay_index(tri, p);
+                x = tri->vertex[delaunay_next(i)];
+                y = tri->vertex[delaunay_prev(i)];
+                other = &d->triangles[tri->neighbor[i]];
+                apex = other->vertex[delaunay_opposite(other, x, y)];
+                if (delaunay_must_flip(d, p, x, y, apex)) {
+                        delaunay_flip(d, t, i);
+                        ++degree;
+                } else {
+                        ++good;
+                        t = tri->neighbor[delaunay_next(i)];
+                }
+        }
+}
+
+// Inserts vertex v into an existing triangulation, returning the vertex
+// already at its position if there is one.
+static uint32_t delaunay_insert_vertex(Delaunay *restrict d, uint32_t v)
+{
+        DelaunayLocation where;
+        size_t i = 0;
+        uint32_t t;
+
+        t = delaunay_walk(d, delaunay_position(d, v), &where, &i);
+        switch (where) {
+        case DELAUNAY_ON_VERTEX:
+                return d->triangles[t].vertex[i];
+        case DELAUNAY_ON_EDGE:
+                delaunay_split_edge(d, t, i, v);
+                delaunay_legalize(d, t, v, 4);
+                break;
+        case DELAUNAY_IN_FACE:
+                delaunay_split_face(d, t, v);
+                delaunay_legalize(d, t, v, 3);
+                break;
+        }
+
+        d->last = d->vertices[v].triangle;
+        return v;
+}
+
+// Builds the first triangle abc, closed by three ghost triangles.
+static void delaunay_start(Delaunay *restrict d,
+                           uint32_t a,
+                           uint32_t b,
+                           uint32_t c)
+{
+        const uint32_t t = delaunay_new_triangle(d);
+        const uint32_t gab = delaunay_new_triangle(d);
+        const uint32_t gbc = delaunay_new_triangle(d);
+        const uint32_t gca = delaunay_new_triangle(d);
+        const uint32_t inf = DELAUNAY_INFINITE;
+        uint32_t tmp;
+
+        if (orient2d(delaunay_position(d, a),
+                     delaunay_position(d, b),
+                     delaunay_position(d, c))
+            < 0) {
+                swap(a, b, tmp);
+        }
+
+        delaunay_set(&d->triangles[t], a, b, c, gbc, gca, gab);
+        delaunay_set(&d->triangles[gab], b, a, inf, gca, gbc, t);
+        delaunay_set(&d->triangles[gbc], c, b, inf, gab, gca, t);
+        delaunay_set(&d->triangles[gca], a, c, inf, gbc, gab, t);
+        delaunay_attach(d, a, t);
+        delaunay_attach(d, b, t);
+        delaunay_attach(d, c, t);
+        d->last = t;
+}
+
+// Adds vertex v while there are no triangles. The vertices are kept pending
+// while they're colinear; once v lies off their line, the triangulation is
+// started with v and two of them, and the others are inserted into it.
+static uint32_t delaunay_add_pending(Delaunay *restrict d, uint32_t v)
+{
+        const vec2d *p = delaunay_position(d, v), *q;
+        uint32_t a = DELAUNAY_NIL, b = DELAUNAY_NIL, w;
+
+        for (w = 0; w < v; ++w) {
+                if (d->vertices[w].triangle != DELAUNAY_PENDING) {
+                        continue;
+                }
+                q = delaunay_position(d, w);
+                if (vec_x(*q) == vec_x(*p) && vec_y(*q) == vec_y(*p)) {
+                        return w;
+                }
+                if (a == DELAUNAY_NIL) {
+                        a = w;
+                } else if (b == DELAUNAY_NIL) {
+                        b = w;
+                }
+        }
+        if (b == DELAUNAY_NIL
+            || orient2d(delaunay_position(d, a), delaunay_position(d, b), p)
+                       == 0) {
+                return v;
+        }
+
+        delaunay_start(d, a, b, v);
+        for (w = 0; w < v; ++w) {
+                if (d->vertices[w].triangle == DELAUNAY_PENDING) {
+                        delaunay_insert_vertex(d, w);
+                }
+        }
+        return v;
+}
+
+// Drops all triangles once the vertices have become colinear, leaving the
+// vertices pending.
+static void delaunay_reset(Delaunay *restrict d)
+{
+        uint32_t v;
+
+        for (v = 0; v < d->vertex_count; ++v) {
+                if (d->vertices[v].triangle != DELAUNAY_NIL) {
+                        d->vertices[v].triangle = DELAUNAY_PENDING;
+                }
+        }
+        d->triangle_count = 0;
+        d->free_triangle = DELAUNAY_NIL;
+        d->last = DELAUNAY_NIL;
+}
+
+// Adds a point; delaunay_reserve() must have made room for it.
+static uint32_t delaunay_add(Delaunay *restrict d, const vec2d *restrict point)
+{
+        const uint32_t v = d->vertex_count++;
+        uint32_t r;
+
+        d->vertices[v].position = *point;
+        d->vertices[v].triangle = DELAUNAY_PENDING;
+        if (d->last == DELAUNAY_NIL) {
+                r = delaunay_add_pending(d, v);
+        } else {
+                r = delaunay_insert_vertex(d, v);
+        }
+        if (r != v) {
+                --d->vertex_count;
+        }
+        return r;
+}
+
+// Makes room for n more vertices. Every vertex adds at most two triangles,
+// so room for twice as many triangles as vertices ever added is kept.
+static int delaunay_reserve(Delaunay *restrict d,
+                            size_t n,
+                            Reallocator *reallocator,
+                            void *user)
+{
+        size_t vertices_sz = d->vertices_sz, triangles_sz = d->triangles_sz;
+        DelaunayVertex *vertices = d->vertices;
+        DelaunayTriangle *triangles = d->triangles;
+        const size_t count = d->vertex_count + n;
+
+        assert(count < DELAUNAY_PENDING / 2);
+        if ((count > vertices_sz
+             && !auxiliary_realloc(reallocator,
+                                   &vertices_sz,
+                                   &vertices,
+                                   &d->vertices_sz,
+                                   &d->vertices,
+                                   count,
+                                   user))
+            || (2 * count > triangles_sz
+                && !auxiliary_realloc(reallocator,
+                                      &triangles_sz,
+                                      &triangles,
+                                      &d->triangles_sz,
+                                      &d->triangles,
+                                      2 * count,
+                                      user))) {
+                return -1;
+        }
+
+        return 0;
+}
+
+void delaunay_init(Delaunay *restrict d)
+{
+        d->vertex_count = 0;
+        d->triangle_count = 0;
+        d->free_triangle = DELAUNAY_NIL;
+        d->last = DELAUNAY_NIL;
+        d->vertices_sz = 0;
+        d->vertices = NULL;
+        d->triangles_sz = 0;
+        d->triangles = NULL;
+        d->scratch_sz = 0;
+        d->scratch = NULL;
+}
+
+uint32_t delaunay_insert(Delaunay *restrict d,
+                         const vec2d *restrict point,
+                         Reallocator *reallocator,
+                         void *user)
+{
+        if (delaunay_reserve(d, 1, reallocator, user) < 0) {
+                return DELAUNAY_NIL;
+        }
+        return delaunay_add(d, point);
+}
+
+// Position of cell (x, y) along a Hilbert curve through a square grid with
+// 2^DELAUNAY_HILBERT_ORDER cells per side.
+CONST_FUNC static uint32_t delaunay_hilbert(uint32_t x, uint32_t y)
+{
+        const uint32_t n = UINT32_C(1) << DELAUNAY_HILBERT_ORDER;
+        uint32_t rx, ry, s, t, h = 0;
+
+        for (s = n / 2; s > 0; s /= 2) {
+                rx = (x & s) != 0;
+                ry = (y & s) != 0;
+                h += s * s * ((3 * rx) ^ ry);
+                if (ry == 0) {
+                        if (rx == 1) {
+                                x = n - 1 - x;
+                                y = n - 1 - y;
+                        }
+                        swap(x, y, t);
+                }
+        }
+
+        return h;
+}
+
+static int delaunay_compare_keys(const void *a, const void *b)
+{
+        return compare(*(const uint64_t *)a, *(const uint64_t *)b);
+}
+
+int delaunay_insert_points(Delaunay *restrict d,
+                           size_t n,
+                           const vec2d points[static restrict n],
+                           uint32_t out[static restrict n],
+                           Reallocator *reallocator,
+                           void *user)
+{
+        const double cells = (UINT32_C(1) << DELAUNAY_HILBERT_ORDER) - 1;
+        size_t scratch_sz = d->scratch_sz;
+        uint64_t *scratch = d->scratch;
+        uint64_t seed = DELAUNAY_SEED, bits, round;
+        uint32_t x, y;
+        double scale;
+        aabb2d box;
+        size_t i;
+
+        if (delaunay_reserve(d, n, reallocator, user) < 0
+            || (n > scratch_sz
+                && !auxiliary_realloc(reallocator,
+                                      &scratch_sz,
+                                      &scratch,
+                                      &d->scratch_sz,
+                                      &d->scratch,
+                                      n,
+                                      user))) {
+                return -1;
+        }
+
+        empty_aabb2d(&box);
+        for (i = 0; i < n; ++i) {
+                extend_aabb2d(&box, &points[i]);
+        }
+        scale = fmax(vec_x(box.max) - vec_x(box.min),
+                     vec_y(box.max) - vec_y(box.min));
+        scale = scale > 0 ? cells / scale : 0;
+
+        // Every point goes to the last round with probability 1/2, to the
+        // one before with probability 1/4 and so on. Rounds are inserted
+        // first to last, each along the Hilbert curve.
+        for (i = 0; i < n; ++i) {
+                x = fmin((vec_x(points[i]) - vec_x(box.min)) * scale, cells);
+                y = fmin((vec_y(points[i]) - vec_y(box.min)) * scale, cells);
+                bits = splitmix64(&seed);
+                for (round = DELAUNAY_ROUNDS - 1; round > 0 && (bits & 1);
+                     --round) {
+                        bits >>= 1;
+                }
+                d->scratch[i] = round << (2 * DELAUNAY_HILBERT_ORDER + 32)
+                              | (uint64_t)delaunay_hilbert(x, y) << 32 | i;
+        }
+        qsort(d->scratch, n, sizeof(*d->scratch), delaunay_compare_keys);
+
+        for (i = 0; i < n; ++i) {
+                x = (uint32_t)d->scratch[i];
+                out[x] = delaunay_add(d, &points[x]);
+        }
+
+        return 0;
+}
+
+// Tests whether the corner of the hole at node j, between nodes a and b, can
+// be cut off: its triangle must turn counter-clockwise, unless it's a ghost
+// triangle, and its circumcircle must not contain any other node.
+PURE_FUNC static bool delaunay_is_ear(const Delaunay *restrict d,
+                                      size_t k,
+                                      const uint32_t ring[static k],
+                                      uint32_t a,
+                                      uint32_t j,
+                                      uint32_t b)
+{
+        const uint32_t u = ring[a], v = ring[j], w = ring[b];
+        size_t i;
+
+        if (u != DELAUNAY_INFINITE && v != DELAUNAY_INFINITE
+            && w != DELAUNAY_INFINITE
+            && orient2d(delaunay_position(d, u),
+                        delaunay_position(d, v),
+                        delaunay_position(d, w))
+                       <= 0) {
+                return false;
+        }
+        for (i = 0; i < k; ++i) {
+                if (i != a && i != j && i != b
+                    && delaunay_in_circle(d, u, v, w, ring[i])) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+// Fills triangle t with vertices abc and links it to its neighbors, if
+// known, across the edges opposite each vertex.
+static void delaunay_fill(Delaunay *restrict d,
+                          uint32_t t,
+                          uint32_t a,
+                          uint32_t b,
+                          uint32_t c,
+                          uint32_t na,
+                          uint32_t nb,
+                          uint32_t nc)
+{
+        DelaunayTriangle *n;
+
+        delaunay_set(&d->triangles[t], a, b, c, na, nb, nc);
+        if (na != DELAUNAY_NIL) {
+                n = &d->triangles[na];
+                n->neighbor[delaunay_opposite(n, b, c)] = t;
+        }
+        if (nb != DELAUNAY_NIL) {
+                n = &d->triangles[nb];
+                n->neighbor[delaunay_opposite(n, c, a)] = t;
+        }
+        if (nc != DELAUNAY_NIL) {
+                n = &d->triangles[nc];
+                n->neighbor[delaunay_opposite(n, a, b)] = t;
+        }
+        delaunay_attach(d, a, t);
+        delaunay_attach(d, b, t);
+        delaunay_attach(d, c, t);
+}
+
+int delaunay_remove(Delaunay *restrict d,
+                    uint32_t v,
+                    Reallocator *reallocator,
+                    void *user)
+{
+        const uint32_t first = d->vertices[v].triangle;
+        size_t scratch_sz = d->scratch_sz;
+        uint64_t *scratch = d->scratch;
+        uint32_t *ring, *side, *star, *next, *prev;
+        const DelaunayTriangle *tri;
+        size_t k = 0, used = 0, count, i;
+        uint32_t t, a, b, j;
+
+        assert(v < d->vertex_count && first != DELAUNAY_NIL);
+        if (first == DELAUNAY_PENDING) {
+                d->vertices[v].triangle = DELAUNAY_NIL;
+                return 0;
+        }
+
+        t = first;
+        do {
+                tri = &d->triangles[t];
+                t = tri->neighbor[delaunay_next(delaunay_index(tri, v))];
+                ++k;
+        } while (t != first);
+
+        // the hole is a polygon of k nodes, each with five 32-bit words
+        if ((5 * k + 1) / 2 > scratch_sz
+            && !auxiliary_realloc(reallocator,
+                                  &scratch_sz,
+                                  &scratch,
+                                  &d->scratch_sz,
+                                  &d->scratch,
+                                  (5 * k + 1) / 2,
+                                  user)) {
+                return -1;
+        }
+        ring = (uint32_t *)d->scratch; // the vertices around v
+        side = ring + k; // the triangle beyond the edge to the next node
+        star = side + k; // the triangles around v, reused for the hole
+        next = star + k;
+        prev = next + k;
+
+        // node j is the vertex after v in the j-th triangle counter-clockwise
+        for (j = 0; j < k; ++j) {
+                tri = &d->triangles[t];
+                i = delaunay_index(tri, v);
+                ring[j] = tri->vertex[delaunay_next(i)];
+                side[j] = tri->neighbor[i];
+                star[j] = t;
+                next[j] = j + 1 == k ? 0 : j + 1;
+                prev[j] = j == 0 ? k - 1 : j - 1;
+                t = tri->neighbor[delaunay_next(i)];
+        }
+
+        // the new diagonal from a to b gets linked once it's cut off too
+        j = 0;
+        for (count = k; count > 3; --count) {
+                while (!delaunay_is_ear(d, k, ring, prev[j], j, next[j])) {
+                        j = next[j];
+                }
+                a = prev[j];
+                b = next[j];
+                delaunay_fill(d,
+                              star[used],
+                              ring[a],
+                              ring[j],
+                              ring[b],
+                              side[j],
+                              DELAUNAY_NIL,
+                              side[a]);
+                side[a] = star[used++];
+                next[a] = b;
+                prev[b] = a;
+                j = a;
+        }
+        a = prev[j];
+        b = next[j];
+        delaunay_fill(d,
+                      star[used],
+                      ring[a],
+                      ring[j],
+                      ring[b],
+                      side[j],
+                      side[b],
+                      side[a]);
+        for (++used; used < k; ++used) {
+                delaunay_free_triangle(d, star[used]);
+        }
+        d->vertices[v].triangle = DELAUNAY_NIL;
+        d->last = star[0];
+
+        // An edge between two ghost triangles means the convex hull is flat.
+        for (i = 0; i + 2 < k; ++i) {
+                tri = &d->triangles[star[i]];
+                if (delaunay_is_ghost(tri)) {
+                        t = tri->neighbor[delaunay_index(tri,
+                                                         DELAUNAY_INFINITE)];
+                        if (delaunay_is_ghost(&d->triangles[t])) {
+                                delaunay_reset(d);
+                        }
+                        break;
+                }
+        }
+
+        return 0;
+}
+
+PURE_FUNC uint32_t delaunay_locate(const Delaunay *restrict d,
+                                   const vec2d *restrict point)
+{
+        DelaunayLocation where;
+        size_t i;
+
+        if (d->last == DELAUNAY_NIL) {
+                return DELAUNAY_NIL;
+        }
+        return delaunay_walk(d, point, &where, &i);
+}
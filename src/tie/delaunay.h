@@ -0,0 +1,170 @@
+/*! \file delaunay.h
+ *  \brief Incremental Delaunay triangulation
+ *
+ *  Triangulates point sets such as scatter layers, which the polygon
+ *  triangulators don't handle, into the triangles that maximize the minimum
+ *  angle; these interpolate well, e.g. for gradient meshes. Points can be
+ *  inserted and removed at any time.
+ *
+ *  Points are inserted one at a time: the triangle containing the point is
+ *  found by walking from the last triangle touched, split, and then edges
+ *  are flipped until the triangulation is Delaunay again. Points inserted in
+ *  bulk are first put in a biased randomized insertion order, i.e. split in
+ *  rounds of doubling size which are each sorted along a Hilbert curve,
+ *  which keeps the walks short while preserving the expected \f$O(n \log
+ *  n)\f$ running time of a random order. Removing a point triangulates the
+ *  hole it leaves by clipping ears whose circumcircles are empty. All tests
+ *  use the robust predicates from predicates.h.
+ *
+ *  The convex hull is closed with ghost triangles, which connect every hull
+ *  edge to the infinite vertex #DELAUNAY_INFINITE, so that every triangle
+ *  has three neighbors. Triangle `t` lists its vertices in counter-clockwise
+ *  order, and its neighbor `i` lies across the edge opposite its vertex `i`.
+ *  Vertices and triangles are kept in arrays owned by the user, grown through
+ *  the usual reallocator protocol (see algo.h). Removed triangles are
+ *  recycled; removed vertices keep their slot.
+ *
+ *  While all vertices are colinear there are no triangles, and vertices are
+ *  kept pending until a point off their line arrives. Removing a point that
+ *  leaves all others colinear drops the triangles again.
+ */
+#ifndef TIE_DELAUNAY_H
+#define TIE_DELAUNAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "math.h"
+
+#define DELAUNAY_NIL UINT32_MAX
+// Vertex ID of the point at infinity shared by all ghost triangles.
+#define DELAUNAY_INFINITE (UINT32_MAX - 1)
+// Triangle of a vertex waiting for the triangulation to exist.
+#define DELAUNAY_PENDING (UINT32_MAX - 1)
+
+typedef struct {
+        vec2d position;
+        // An incident triangle, #DELAUNAY_PENDING if the vertex is waiting
+        // for the triangulation to exist and #DELAUNAY_NIL if removed.
+        uint32_t triangle;
+} DelaunayVertex;
+
+typedef struct {
+        // Counter-clockwise, #DELAUNAY_NIL in the first one if free.
+        uint32_t vertex[3];
+        // Across the edge opposite the vertex of the same index. The first
+        // one is the next free triangle if free.
+        uint32_t neighbor[3];
+} DelaunayTriangle;
+
+typedef struct {
+        uint32_t vertex_count;
+        uint32_t triangle_count; // triangles handed out from `triangles`
+        uint32_t free_triangle; // head of the free triangle list
+        uint32_t last; // where the next walk starts, DELAUNAY_NIL if none
+        size_t vertices_sz;
+        DelaunayVertex *vertices;
+        size_t triangles_sz;
+        DelaunayTriangle *triangles;
+        // Working memory for insertion orders and removal.
+        size_t scratch_sz;
+        uint64_t *scratch;
+} Delaunay;
+
+/*! \brief Tests whether a triangle lies outside the convex hull.
+ */
+PURE_FUNC static inline bool delaunay_is_ghost(const DelaunayTriangle *t)
+{
+        return t->vertex[0] == DELAUNAY_INFINITE
+            || t->vertex[1] == DELAUNAY_INFINITE
+            || t->vertex[2] == DELAUNAY_INFINITE;
+}
+
+/*! \brief Initializes an empty triangulation without any memory.
+ *
+ *  \param[out] d The triangulation to initialize. Its arrays must be freed by
+ *  the user once it's no longer needed.
+ */
+extern void delaunay_init(Delaunay *restrict d);
+
+/*! \brief Inserts a point.
+ *
+ *  Runs in \f$O(\log n)\f$ expected time for points close to the last one
+ *  touched, and in \f$O(\sqrt n)\f$ expected time for random ones.
+ *
+ *  \param[in,out] d The triangulation.
+ *  \param[in] point The point.
+ *  \param[in] reallocator Reallocator for the arrays of the triangulation.
+ *  May be NULL, in which case the function fails when they become full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return The ID of the new vertex, or of the existing vertex at the same
+ *  position, or #DELAUNAY_NIL on allocation failure, in which case the
+ *  triangulation is left unchanged.
+ */
+extern uint32_t delaunay_insert(Delaunay *restrict d,
+                                const vec2d *restrict point,
+                                Reallocator *reallocator,
+                                void *user);
+
+/*! \brief Inserts many points.
+ *
+ *  Inserts the points in a biased randomized insertion order, which makes
+ *  it run in \f$O(n \log n)\f$ expected time. The order is seeded
+ *  deterministically, so the same input always gives the same triangulation.
+ *
+ *  \param[in,out] d The triangulation.
+ *  \param[in] n The amount of points.
+ *  \param[in] points The points.
+ *  \param[out] out The vertex IDs of the points, as returned by
+ *  delaunay_insert().
+ *  \param[in] reallocator See delaunay_insert().
+ *  \param[in,out] user See delaunay_insert().
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the
+ *  triangulation is left unchanged.
+ */
+extern int delaunay_insert_points(Delaunay *restrict d,
+                                  size_t n,
+                                  const vec2d points[static restrict n],
+                                  uint32_t out[static restrict n],
+                                  Reallocator *reallocator,
+                                  void *user);
+
+/*! \brief Removes a vertex.
+ *
+ *  Runs in \f$O(k^3)\f$ in the worst case and in \f$O(k^2)\f$ typically,
+ *  where \f$k\f$ is the degree of the vertex, which is 6 on average.
+ *
+ *  \param[in,out] d The triangulation.
+ *  \param[in] v The vertex. Must not have been removed already.
+ *  \param[in] reallocator See delaunay_insert(); only the scratch memory
+ *  may need to grow.
+ *  \param[in,out] user See delaunay_insert().
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the
+ *  triangulation is left unchanged.
+ */
+extern int delaunay_remove(Delaunay *restrict d,
+                           uint32_t v,
+                           Reallocator *reallocator,
+                           void *user);
+
+/*! \brief Finds the triangle containing a point.
+ *
+ *  Walks from the last triangle touched. Points on an edge may be reported
+ *  in either triangle.
+ *
+ *  \param[in] d The triangulation.
+ *  \param[in] point The point.
+ *
+ *  \return The triangle, a ghost triangle whose hull edge faces the point
+ *  if it lies outside the convex hull, or #DELAUNAY_NIL if there are no
+ *  triangles.
+ */
+extern PURE_FUNC uint32_t delaunay_locate(const Delaunay *restrict d,
+                                          const vec2d *restrict point);
+
+#endif
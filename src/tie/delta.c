@@ -0,0 +1,362 @@
+#include <string.h>
+
+#include "delta.h"
+
+// Defines delta_reserve_<name>(), which makes room for `n` items in one of
+// the arrays of the store.
+#define delta_reserve_decl(type, name)                                         \
+        static bool delta_reserve_##name(DeltaStore *restrict store,           \
+                                         uint64_t n,                           \
+                                         Reallocator *reallocator,             \
+                                         void *user)                           \
+        {                                                                      \
+                size_t sz = store->name##_sz;                                  \
+                type *arr = store->name;                                       \
+                                                                               \
+                return n <= sz                                                 \
+                    || auxiliary_realloc(reallocator,                          \
+                                         &sz,                                  \
+                                         &arr,                                 \
+                                         &store->name##_sz,                    \
+                                         &store->name,                         \
+                                         n,                                    \
+                                         user);                                \
+        }                                                                      \
+        static bool delta_reserve_##name(DeltaStore *restrict store,           \
+                                         uint64_t n,                           \
+                                         Reallocator *reallocator,             \
+                                         void *user)
+
+delta_reserve_decl(DeltaEntry, entries);
+delta_reserve_decl(DeltaOp, ops);
+delta_reserve_decl(DeltaObject, objects);
+delta_reserve_decl(ObjectID, links);
+delta_reserve_decl(uint64_t, path);
+delta_reserve_decl(DeltaObject, work);
+
+void delta_store_init(DeltaStore *restrict store, uint32_t interval)
+{
+        assert(interval > 0);
+
+        memset(store, 0, sizeof(*store));
+        store->interval = interval;
+}
+
+// Converts an object, appending its links to those of the store, for which
+// there must be room.
+static inline void delta_object(DeltaStore *restrict store,
+                                const Object *restrict object,
+                                DeltaObject *restrict out)
+{
+        out->transform = object->transform;
+        out->type = object->type;
+        out->parent_count = object->parent_count;
+        out->child_count = object->child_count;
+        out->links = store->link_count;
+        if (object->parent_count > 0) {
+                memcpy(store->links + store->link_count,
+                       object->parents.address,
+                       object->parent_count * sizeof(ObjectID));
+                store->link_count += object->parent_count;
+        }
+        if (object->child_count > 0) {
+                memcpy(store->links + store->link_count,
+                       object->children.address,
+                       object->child_count * sizeof(ObjectID));
+                store->link_count += object->child_count;
+        }
+}
+
+uint64_t delta_begin(DeltaStore *restrict store,
+                     uint64_t previous,
+                     Reallocator *reallocator,
+                     void *user)
+{
+        DeltaEntry *e;
+
+        assert(previous == DELTA_NIL || previous < store->entry_count);
+        if (!delta_reserve_entries(store,
+                                   store->entry_count + 1,
+                                   reallocator,
+                                   user)) {
+                return DELTA_NIL;
+        }
+
+        e = &store->entries[store->entry_count];
+        e->previous = previous;
+        e->first = store->op_count;
+        e->count = 0;
+        e->distance = previous == DELTA_NIL
+                            ? 0
+                            : store->entries[previous].distance + 1;
+        e->keyframe = false;
+
+        return store->entry_count++;
+}
+
+static int delta_push(DeltaStore *restrict store,
+                      DeltaOpType type,
+                      uint32_t object,
+                      const Object *restrict value,
+                      Reallocator *reallocator,
+                      void *user)
+{
+        DeltaOp *op;
+        uint64_t links = value ? value->parent_count + value->child_count : 0;
+
+        assert(store->entry_count > 0);
+        if (!delta_reserve_ops(store, store->op_count + 1, reallocator, user)
+            || !delta_reserve_links(store,
+                                    store->link_count + links,
+                                    reallocator,
+                                    user)) {
+                return -1;
+        }
+
+        op = &store->ops[store->op_count++];
+        op->type = type;
+        op->object = object;
+        if (value) {
+                delta_object(store, value, &op->value);
+        }
+        ++store->entries[store->entry_count - 1].count;
+
+        return 0;
+}
+
+int delta_insert(DeltaStore *restrict store,
+                 uint32_t object,
+                 const Object *restrict value,
+                 Reallocator *reallocator,
+                 void *user)
+{
+        return delta_push(store,
+                          DELTA_INSERT,
+                          object,
+                          value,
+                          reallocator,
+                          user);
+}
+
+int delta_delete(DeltaStore *restrict store,
+                 uint32_t object,
+                 Reallocator *reallocator,
+                 void *user)
+{
+        return delta_push(store, DELTA_DELETE, object, NULL, reallocator, user);
+}
+
+int delta_transform(DeltaStore *restrict store,
+                    uint32_t object,
+                    const Transform *restrict transform,
+                    Reallocator *reallocator,
+                    void *user)
+{
+        if (delta_push(store,
+                       DELTA_TRANSFORM,
+                       object,
+                       NULL,
+                       reallocator,
+                       user)) {
+                return -1;
+        }
+        store->ops[store->op_count - 1].value.transform = *transform;
+
+        return 0;
+}
+
+int delta_links(DeltaStore *restrict store,
+                uint32_t object,
+                const Object *restrict value,
+                Reallocator *reallocator,
+                void *user)
+{
+        return delta_push(store, DELTA_LINKS, object, value, reallocator, user);
+}
+
+int delta_end(DeltaStore *restrict store,
+              uint32_t n,
+              const Object objects[static restrict n],
+              Reallocator *reallocator,
+              void *user)
+{
+        DeltaEntry *e = &store->entries[store->entry_count - 1];
+        const Object *o;
+        uint64_t links = 0;
+
+        if (e->previous != DELTA_NIL && e->distance < store->interval) {
+                return 0;
+        }
+
+        traverse(o, objects, objects + n) {
+                links += o->parent_count + o->child_count;
+        }
+        if (!delta_reserve_objects(store,
+                                   store->object_count + n,
+                                   reallocator,
+                                   user)
+            || !delta_reserve_links(store,
+                                    store->link_count + links,
+                                    reallocator,
+                                    user)) {
+                return -1;
+        }
+
+        // the changes are the last ones recorded, so their room is reclaimed
+        store->op_count = e->first;
+        e->first = store->object_count;
+        e->count = n;
+        e->distance = 0;
+        e->keyframe = true;
+        traverse(o, objects, objects + n) {
+                delta_object(store, o, &store->objects[store->object_count++]);
+        }
+
+        return 0;
+}
+
+// Applies the changes of an entry to the working objects, of which there
+// are `*count`.
+static bool delta_apply(DeltaStore *restrict store,
+                        const DeltaEntry *restrict e,
+                        uint64_t *restrict count,
+                        Reallocator *reallocator,
+                        void *user)
+{
+        const DeltaOp *op;
+        DeltaObject *w;
+
+        traverse(op, store->ops + e->first, store->ops + e->first + e->count) {
+                if (op->object >= *count) {
+                        if (!delta_reserve_work(store,
+                                                op->object + 1,
+                                                reallocator,
+                                                user)) {
+                                return false;
+                        }
+                        // slots skipped over are free
+                        memset(store->work + *count,
+                               0,
+                               (op->object + 1 - *count) * sizeof(*w));
+                        traverse(w,
+                                 store->work + *count,
+                                 store->work + op->object + 1) {
+                                w->type = DELETED;
+                        }
+                        *count = op->object + 1;
+                }
+
+                w = &store->work[op->object];
+                switch (op->type) {
+                case DELTA_INSERT:
+                        *w = op->value;
+                        break;
+                case DELTA_DELETE:
+                        w->type = DELETED;
+                        w->parent_count = 0;
+                        w->child_count = 0;
+                        break;
+                case DELTA_TRANSFORM:
+                        w->transform = op->value.transform;
+                        break;
+                case DELTA_LINKS:
+                        w->parent_count = op->value.parent_count;
+                        w->child_count = op->value.child_count;
+                        w->links = op->value.links;
+                        break;
+                }
+        }
+
+        return true;
+}
+
+int delta_checkout(DeltaStore *restrict store,
+                   uint64_t entry,
+                   uint32_t *restrict pcount,
+                   size_t *restrict pobjects_sz,
+                   Object *restrict *restrict pobjects,
+                   size_t *restrict plinks_sz,
+                   ObjectID *restrict *restrict plinks,
+                   Reallocator *reallocator,
+                   void *user)
+{
+        Object *objects = *pobjects, *o;
+        ObjectID *links = *plinks;
+        size_t objects_sz = *pobjects_sz, links_sz = *plinks_sz;
+        const DeltaEntry *e;
+        const DeltaObject *w;
+        uint64_t count = 0, link_count = 0, length = 0, i;
+
+        assert(entry < store->entry_count);
+
+        // walk back to the keyframe, remembering the way forward
+        for (i = entry; i != DELTA_NIL; i = e->previous) {
+                e = &store->entries[i];
+                if (e->keyframe) {
+                        break;
+                }
+                if (!delta_reserve_path(store, length + 1, reallocator, user)) {
+                        return -1;
+                }
+                store->path[length++] = i;
+        }
+        if (i != DELTA_NIL && e->count > 0) {
+                if (!delta_reserve_work(store, e->count, reallocator, user)) {
+                        return -1;
+                }
+                memcpy(store->work,
+                       store->objects + e->first,
+                       e->count * sizeof(*store->work));
+                count = e->count;
+        }
+        while (length > 0) {
+                e = &store->entries[store->path[--length]];
+                if (!delta_apply(store, e, &count, reallocator, user)) {
+                        return -1;
+                }
+        }
+
+        traverse(w, store->work, store->work + count) {
+                link_count += w->parent_count + w->child_count;
+        }
+        if ((count > objects_sz
+             && !auxiliary_realloc(reallocator,
+                                   &objects_sz,
+                                   &objects,
+                                   pobjects_sz,
+                                   pobjects,
+                                   count,
+                                   user))
+            || (link_count > links_sz
+                && !auxiliary_realloc(reallocator,
+                                      &links_sz,
+                                      &links,
+                                      plinks_sz,
+                                      plinks,
+                                      link_count,
+                                      user))) {
+                return -1;
+        }
+
+        link_count = 0;
+        o = objects;
+        traverse(w, store->work, store->work + count) {
+                o->type = w->type;
+                o->transform = w->transform;
+                o->parent_count = w->parent_count;
+                o->child_count = w->child_count;
+                o->parents.address = links + link_count;
+                o->children.address = o->parents.address + w->parent_count;
+                if (w->parent_count + w->child_count > 0) {
+                        memcpy(o->parents.address,
+                               store->links + w->links,
+                               (w->parent_count + w->child_count)
+                                       * sizeof(*links));
+                        link_count += w->parent_count + w->child_count;
+                }
+                ++o;
+        }
+        *pcount = count;
+
+        return 0;
+}
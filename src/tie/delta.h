@@ -0,0 +1,215 @@
+/*! \file delta.h
+ *  \brief Keyframe and delta storage of object trees
+ *
+ *  Storing the full object tree of every history entry makes the history
+ *  grow with the size of the document times the amount of edits. This store
+ *  instead keeps a full snapshot, a keyframe, only every `interval` entries
+ *  along each path of the history tree, and the changes made by an edit for
+ *  the entries in between: inserted and deleted objects, changed transforms
+ *  and changed links. The objects of any entry are rebuilt from the nearest
+ *  keyframe before it, replaying less than `interval` deltas, so the
+ *  interval trades memory for the time to undo or redo to an entry.
+ *
+ *  Entries are numbered like the entries of a #History and must be added in
+ *  the same order, each following the entry it was made from. Objects are
+ *  identified by the index of their slot; deleted objects keep their slot
+ *  with the #DELETED type. All arrays are owned by the user and grown
+ *  through the usual reallocator protocol (see algo.h).
+ *
+ *  Unlike the object store (see objectstore.h), which shares the unchanged
+ *  parts of every version so that any of them is read in place, this store
+ *  only keeps the changes between keyframes and rebuilds the objects of an
+ *  entry on demand, which takes less memory when edits change few objects
+ *  at a time, at the cost of replaying them.
+ */
+#ifndef TIE_DELTA_H
+#define TIE_DELTA_H
+
+#include <stdint.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "core.h"
+
+#define DELTA_NIL UINT64_MAX
+
+/*! \brief An object whose links are stored elsewhere.
+ */
+typedef struct {
+        Transform transform;
+        ObjectType type;
+        uint32_t parent_count;
+        uint32_t child_count;
+        // The index of the first parent in the links of the store, followed
+        // by the other parents and then the children.
+        uint64_t links;
+} DeltaObject;
+
+typedef enum {
+        DELTA_INSERT, // sets the whole object
+        DELTA_DELETE,
+        DELTA_TRANSFORM,
+        DELTA_LINKS // sets the parents and the children
+} DeltaOpType;
+
+typedef struct {
+        DeltaOpType type;
+        uint32_t object;
+        DeltaObject value; // only the parts changed by the type
+} DeltaOp;
+
+typedef struct {
+        uint64_t previous; // the entry it was made from, or #DELTA_NIL
+        // A keyframe keeps its objects, and other entries their changes.
+        uint64_t first; // in the objects or the ops of the store
+        uint32_t count;
+        uint32_t distance; // amount of deltas since the last keyframe
+        bool keyframe;
+} DeltaEntry;
+
+typedef struct {
+        uint32_t interval; // may be changed at any time
+        uint64_t entry_count;
+        uint64_t op_count;
+        uint64_t object_count;
+        uint64_t link_count;
+        size_t entries_sz;
+        DeltaEntry *entries;
+        size_t ops_sz;
+        DeltaOp *ops;
+        size_t objects_sz;
+        DeltaObject *objects; // of the keyframes
+        size_t links_sz;
+        ObjectID *links;
+        // Working memory for rebuilding objects.
+        size_t path_sz;
+        uint64_t *path;
+        size_t work_sz;
+        DeltaObject *work;
+} DeltaStore;
+
+/*! \brief Initializes an empty store without any memory.
+ *
+ *  \param[out] store The store to initialize. Its arrays must be freed by the
+ *  user once it's no longer needed.
+ *  \param[in] interval The maximal amount of entries from a keyframe to the
+ *  next, at least 1. 1 makes every entry a keyframe.
+ */
+extern void delta_store_init(DeltaStore *restrict store, uint32_t interval);
+
+/*! \brief Starts recording the changes of a new entry.
+ *
+ *  \param[in,out] store The store.
+ *  \param[in] previous The entry the new one was made from, or #DELTA_NIL
+ *  for the first entry of the history.
+ *  \param[in] reallocator Reallocator for the arrays of the store. May be
+ *  NULL, in which case the function fails when they become full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return The number of the new entry, or #DELTA_NIL on allocation
+ *  failure.
+ */
+extern uint64_t delta_begin(DeltaStore *restrict store,
+                            uint64_t previous,
+                            Reallocator *reallocator,
+                            void *user);
+
+/*! \brief Records an inserted object, or any change to an object.
+ *
+ *  \param[in,out] store The store.
+ *  \param[in] object The slot of the object.
+ *  \param[in] value The object.
+ *  \param[in] reallocator See delta_begin().
+ *  \param[in,out] user See delta_begin().
+ *
+ *  \return 0 on success, -1 on allocation failure.
+ */
+extern int delta_insert(DeltaStore *restrict store,
+                        uint32_t object,
+                        const Object *restrict value,
+                        Reallocator *reallocator,
+                        void *user);
+
+/*! \brief Records a deleted object.
+ *
+ *  \return See delta_insert().
+ */
+extern int delta_delete(DeltaStore *restrict store,
+                        uint32_t object,
+                        Reallocator *reallocator,
+                        void *user);
+
+/*! \brief Records a changed transform.
+ *
+ *  \return See delta_insert().
+ */
+extern int delta_transform(DeltaStore *restrict store,
+                           uint32_t object,
+                           const Transform *restrict transform,
+                           Reallocator *reallocator,
+                           void *user);
+
+/*! \brief Records changed parents or children of an object.
+ *
+ *  \param[in] value The object with its new links.
+ *
+ *  \return See delta_insert().
+ */
+extern int delta_links(DeltaStore *restrict store,
+                       uint32_t object,
+                       const Object *restrict value,
+                       Reallocator *reallocator,
+                       void *user);
+
+/*! \brief Finishes recording the changes of an entry.
+ *
+ *  Turns the entry into a keyframe if it's `interval` entries away from the
+ *  last one, or if it's the first entry, in which case its changes are
+ *  replaced by the objects.
+ *
+ *  \param[in,out] store The store.
+ *  \param[in] n The amount of objects after the changes.
+ *  \param[in] objects The objects after the changes.
+ *  \param[in] reallocator See delta_begin().
+ *  \param[in,out] user See delta_begin().
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the entry
+ *  keeps its changes.
+ */
+extern int delta_end(DeltaStore *restrict store,
+                     uint32_t n,
+                     const Object objects[static restrict n],
+                     Reallocator *reallocator,
+                     void *user);
+
+/*! \brief Rebuilds the objects of an entry.
+ *
+ *  Runs in \f$O(n + l + d)\f$, where \f$n\f$ is the amount of objects,
+ *  \f$l\f$ the amount of links and \f$d\f$ the amount of changes since the
+ *  nearest keyframe.
+ *
+ *  \param[in,out] store The store, whose working memory is used.
+ *  \param[in] entry The entry.
+ *  \param[out] pcount The amount of objects.
+ *  \param[in,out] pobjects_sz Size of the object array, modified on
+ *  reallocations.
+ *  \param[in,out] pobjects The objects.
+ *  \param[in,out] plinks_sz Size of the link array, modified on
+ *  reallocations.
+ *  \param[in,out] plinks The links the objects point into.
+ *  \param[in] reallocator Reallocator for the store and the output arrays.
+ *  \param[in,out] user See delta_begin().
+ *
+ *  \return 0 on success, -1 on allocation failure.
+ */
+extern int delta_checkout(DeltaStore *restrict store,
+                          uint64_t entry,
+                          uint32_t *restrict pcount,
+                          size_t *restrict pobjects_sz,
+                          Object *restrict *restrict pobjects,
+                          size_t *restrict plinks_sz,
+                          ObjectID *restrict *restrict plinks,
+                          Reallocator *reallocator,
+                          void *user);
+
+#endif
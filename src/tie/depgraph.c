@@ -0,0 +1,365 @@
+#include <string.h>
+
+#include "depgraph.h"
+
+// Defines dep_graph_reserve_<name>(), which makes room for `n` items in one
+// of the arrays of the engine.
+#define dep_graph_reserve_decl(type, name)                                     \
+        static bool dep_graph_reserve_##name(DepGraph *restrict graph,         \
+                                             uint64_t n,                       \
+                                             Reallocator *reallocator,         \
+                                             void *user)                       \
+        {                                                                      \
+                size_t sz = graph->name##_sz;                                  \
+                type *arr = graph->name;                                       \
+                                                                               \
+                return n <= sz                                                 \
+                    || auxiliary_realloc(reallocator,                          \
+                                         &sz,                                  \
+                                         &arr,                                 \
+                                         &graph->name##_sz,                    \
+                                         &graph->name,                         \
+                                         n,                                    \
+                                         user);                                \
+        }                                                                      \
+        static bool dep_graph_reserve_##name(DepGraph *restrict graph,         \
+                                             uint64_t n,                       \
+                                             Reallocator *reallocator,         \
+                                             void *user)
+
+dep_graph_reserve_decl(uint32_t, edits);
+dep_graph_reserve_decl(uint32_t, order);
+dep_graph_reserve_decl(uint32_t, pending);
+dep_graph_reserve_decl(uint32_t, levels);
+dep_graph_reserve_decl(void *, results);
+
+void dep_graph_init(DepGraph *restrict graph)
+{
+        memset(graph, 0, sizeof(*graph));
+        graph->epoch = 1;
+}
+
+// Makes room for the marks of `n` slots. New slots are unmarked.
+static bool dep_graph_reserve_marks(DepGraph *restrict graph,
+                                    uint64_t n,
+                                    Reallocator *reallocator,
+                                    void *user)
+{
+        size_t old = graph->marks_sz, sz = old;
+        uint32_t *marks = graph->marks;
+
+        if (n <= old) {
+                return true;
+        }
+        if (!auxiliary_realloc(reallocator,
+                               &sz,
+                               &marks,
+                               &graph->marks_sz,
+                               &graph->marks,
+                               n,
+                               user)) {
+                return false;
+        }
+        memset(marks + old, 0, (sz - old) * sizeof(*marks));
+
+        return true;
+}
+
+int dep_graph_mark(DepGraph *restrict graph,
+                   uint32_t slot,
+                   Reallocator *reallocator,
+                   void *user)
+{
+        if (!dep_graph_reserve_marks(graph,
+                                     (uint64_t)slot + 1,
+                                     reallocator,
+                                     user)) {
+                return -1;
+        }
+        if (graph->marks[slot] == graph->epoch) {
+                return 0;
+        }
+        if (!dep_graph_reserve_edits(graph,
+                                     graph->edit_count + 1,
+                                     reallocator,
+                                     user)) {
+                return -1;
+        }
+
+        graph->marks[slot] = graph->epoch;
+        graph->edits[graph->edit_count++] = slot;
+
+        return 0;
+}
+
+// Collects the affected slots into the order, in no particular order,
+// marking them. Returns their amount, or 0 on allocation failure, in which
+// case only the edited slots stay marked.
+static uint32_t dep_graph_collect(DepGraph *restrict graph,
+                                  const ObjectTable *restrict table,
+                                  Reallocator *reallocator,
+                                  void *user)
+{
+        const ObjectID *id, *parents;
+        uint32_t count = graph->edit_count, i, parent, *s;
+
+        if (!dep_graph_reserve_order(graph, count, reallocator, user)) {
+                return 0;
+        }
+        memcpy(graph->order, graph->edits, count * sizeof(*graph->order));
+
+        for (i = 0; i < count; ++i) {
+                parents = object_table_parents(table, graph->order[i]);
+                traverse(id,
+                         parents,
+                         parents + table->parent_counts[graph->order[i]]) {
+                        parent = object_table_resolve(table, *id);
+                        if (parent == OBJECT_TABLE_NIL
+                            || graph->marks[parent] == graph->epoch) {
+                                continue;
+                        }
+                        if (!dep_graph_reserve_order(graph,
+                                                     (uint64_t)count + 1,
+                                                     reallocator,
+                                                     user)) {
+                                traverse(s,
+                                         graph->order + graph->edit_count,
+                                         graph->order + count) {
+                                        graph->marks[*s] = 0;
+                                }
+                                return 0;
+                        }
+                        graph->marks[parent] = graph->epoch;
+                        graph->order[count++] = parent;
+                }
+        }
+
+        return count;
+}
+
+// Orders the batch without consuming it.
+static int dep_graph_order(DepGraph *restrict graph,
+                           const ObjectTable *restrict table,
+                           Reallocator *reallocator,
+                           void *user)
+{
+        const ObjectID *id, *links;
+        uint32_t count, i, end, slot, link;
+        const uint32_t *s;
+
+        graph->order_count = 0;
+        graph->level_count = 0;
+        if (graph->edit_count == 0) {
+                return 0;
+        }
+        if (!dep_graph_reserve_marks(graph, table->count, reallocator, user)
+            || !dep_graph_reserve_pending(graph,
+                                          table->count,
+                                          reallocator,
+                                          user)) {
+                return -1;
+        }
+        count = dep_graph_collect(graph, table, reallocator, user);
+        if (count == 0) {
+                return -1;
+        }
+        if (!dep_graph_reserve_levels(graph, count, reallocator, user)) {
+                traverse(s,
+                         graph->order + graph->edit_count,
+                         graph->order + count) {
+                        graph->marks[*s] = 0;
+                }
+                return -1;
+        }
+
+        // count the affected children of every affected slot
+        traverse(s, graph->order, graph->order + count) {
+                graph->pending[*s] = 0;
+                links = object_table_children(table, *s);
+                traverse(id, links, links + table->child_counts[*s]) {
+                        link = object_table_resolve(table, *id);
+                        graph->pending[*s] += link != OBJECT_TABLE_NIL
+                                           && graph->marks[link]
+                                                      == graph->epoch;
+                }
+        }
+
+        // the slots without affected children go first, and the others
+        // follow once their last affected child was ordered, which puts the
+        // rounds one after the other
+        for (i = 0; i < count; ++i) {
+                if (graph->pending[graph->order[i]] == 0) {
+                        graph->order[graph->order_count++] = graph->order[i];
+                }
+        }
+        end = graph->order_count;
+        for (i = 0; i < graph->order_count; ++i) {
+                if (i == end) {
+                        graph->levels[graph->level_count++] = end;
+                        end = graph->order_count;
+                }
+                slot = graph->order[i];
+                links = object_table_parents(table, slot);
+                traverse(id, links, links + table->parent_counts[slot]) {
+                        link = object_table_resolve(table, *id);
+                        if (link != OBJECT_TABLE_NIL
+                            && graph->marks[link] == graph->epoch
+                            && --graph->pending[link] == 0) {
+                                graph->order[graph->order_count++] = link;
+                        }
+                }
+        }
+        graph->levels[graph->level_count++] = end;
+        assert(graph->order_count == count);
+
+        return 0;
+}
+
+// Starts a new batch once the ordered one was recomputed.
+static void dep_graph_consume(DepGraph *restrict graph)
+{
+        graph->edit_count = 0;
+        if (++graph->epoch == 0) {
+                memset(graph->marks,
+                       0,
+                       graph->marks_sz * sizeof(*graph->marks));
+                graph->epoch = 1;
+        }
+}
+
+// Keeps the ordered batch after its recomputation failed, so that it's
+// recomputed as a whole next time: only the edited slots stay marked, as
+// if it had never been ordered.
+static void dep_graph_keep(DepGraph *restrict graph)
+{
+        const uint32_t *s;
+
+        traverse(s, graph->order, graph->order + graph->order_count) {
+                graph->marks[*s] = 0;
+        }
+        traverse(s, graph->edits, graph->edits + graph->edit_count) {
+                graph->marks[*s] = graph->epoch;
+        }
+}
+
+int dep_graph_sort(DepGraph *restrict graph,
+                   const ObjectTable *restrict table,
+                   Reallocator *reallocator,
+                   void *user)
+{
+        if (dep_graph_order(graph, table, reallocator, user)) {
+                return -1;
+        }
+        dep_graph_consume(graph);
+
+        return 0;
+}
+
+int dep_graph_update(DepGraph *restrict graph,
+                     ObjectTable *restrict table,
+                     DepGraphEval *eval,
+                     void *eval_user,
+                     Reallocator *reallocator,
+                     void *user)
+{
+        const uint32_t *s;
+
+        if (dep_graph_order(graph, table, reallocator, user)) {
+                return -1;
+        }
+        traverse(s, graph->order, graph->order + graph->order_count) {
+                if (eval(table, *s, eval_user)) {
+                        dep_graph_keep(graph);
+                        return -1;
+                }
+        }
+        dep_graph_consume(graph);
+
+        return 0;
+}
+
+typedef struct {
+        const ObjectTable *table;
+        const uint32_t *order; // of the round
+        void **results; // of the round
+        DepGraphCompute *compute;
+        void *user;
+        atomic_bool failed;
+} DepGraphRound;
+
+static void dep_graph_compute(uint32_t index,
+                              ScratchArena *restrict scratch,
+                              void *user)
+{
+        DepGraphRound *round = user;
+
+        if (round->compute(round->table,
+                           round->order[index],
+                           scratch,
+                           &round->results[index],
+                           round->user)) {
+                atomic_store_explicit(&round->failed,
+                                      true,
+                                      memory_order_relaxed);
+        }
+}
+
+int dep_graph_update_parallel(DepGraph *restrict graph,
+                              ObjectTable *restrict table,
+                              WorkerPool *restrict pool,
+                              DepGraphCompute *compute,
+                              DepGraphCommit *commit,
+                              size_t result_size,
+                              void *eval_user,
+                              Reallocator *reallocator,
+                              void *user)
+{
+        DepGraphRound round = { .table = table,
+                                .compute = compute,
+                                .user = eval_user };
+        // any thread may take a whole run, so rounds are run in parts whose
+        // results all fit in one arena
+        uint64_t step = max(pool->workers->scratch.size / result_size, 1);
+        uint32_t begin = 0, n, i;
+        const uint32_t *end;
+
+        assert(result_size > 0);
+
+        if (dep_graph_order(graph, table, reallocator, user)) {
+                return -1;
+        }
+        if (!dep_graph_reserve_results(graph,
+                                       graph->order_count,
+                                       reallocator,
+                                       user)) {
+                dep_graph_keep(graph);
+                return -1;
+        }
+
+        atomic_init(&round.failed, false);
+        traverse(end, graph->levels, graph->levels + graph->level_count) {
+                for (; begin < *end; begin += n) {
+                        n = min(*end - begin, step);
+                        round.order = graph->order + begin;
+                        round.results = graph->results + begin;
+                        worker_pool_run(pool, n, dep_graph_compute, &round);
+                        if (atomic_load_explicit(&round.failed,
+                                                 memory_order_relaxed)) {
+                                dep_graph_keep(graph);
+                                return -1;
+                        }
+                        for (i = begin; i < begin + n; ++i) {
+                                if (commit(table,
+                                           graph->order[i],
+                                           graph->results[i],
+                                           eval_user)) {
+                                        dep_graph_keep(graph);
+                                        return -1;
+                                }
+                        }
+                }
+        }
+        dep_graph_consume(graph);
+
+        return 0;
+}
@@ -0,0 +1,203 @@
+/*! \file depgraph.h
+ *  \brief Incremental recomputation of dependent objects
+ *
+ *  Objects depend on their children: lines on their endpoints, curves on
+ *  their control points, and so on up through their parents. When objects
+ *  are edited, only the objects that depend on them, directly or not, need
+ *  their derived data recomputed. This engine collects the objects edited
+ *  during a frame, finds the objects reachable from them through their
+ *  parents, orders them so that every object comes after its children, and
+ *  recomputes only those, each exactly once. The work is proportional to the
+ *  affected part of the graph rather than to the document, and editing the
+ *  same object many times in a frame costs one recomputation.
+ *
+ *  The order is built in rounds: the first round holds the affected objects
+ *  none of whose children are affected, and every following round the
+ *  objects whose affected children are all in earlier rounds. Objects of the
+ *  same round don't depend on each other, so they may be recomputed in
+ *  parallel, round by round, on a pool of workers (see workpool.h). The
+ *  parallel recomputation is split in two: computing, which only reads the
+ *  table and writes its results to the scratch arena of its thread, and
+ *  committing the results to the table, which is done on the calling thread
+ *  in the order of the recomputation, round by round, so that the table ends
+ *  up the same whichever way the work was spread.
+ *
+ *  The links must form a directed acyclic graph. Links to removed objects
+ *  are ignored. All arrays are owned by the user and grown through the usual
+ *  reallocator protocol (see algo.h).
+ */
+#ifndef TIE_DEPGRAPH_H
+#define TIE_DEPGRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "algo.h"
+#include "objecttable.h"
+#include "workpool.h"
+
+/*! \brief Function typedef for recomputing the derived data of an object.
+ *
+ *  Called once the object's children are up to date.
+ *
+ *  \return 0 on success, -1 on failure, which stops the recomputation.
+ */
+typedef int DepGraphEval(ObjectTable *restrict table,
+                         uint32_t slot,
+                         void *user);
+
+/*! \brief Function typedef for computing the derived data of an object
+ *  without changing the table, on any thread.
+ *
+ *  \param[in] table The table, whose objects of earlier rounds are up to
+ *  date.
+ *  \param[in] slot The slot of the object.
+ *  \param[in,out] scratch The arena to allocate the result from, at most
+ *  the result size given to dep_graph_update_parallel().
+ *  \param[out] result The result, passed to the commit function.
+ *  \param[in,out] user Private data passed to dep_graph_update_parallel().
+ *
+ *  \return 0 on success, -1 on failure, which stops the recomputation after
+ *  the current round.
+ */
+typedef int DepGraphCompute(const ObjectTable *restrict table,
+                            uint32_t slot,
+                            ScratchArena *restrict scratch,
+                            void **restrict result,
+                            void *user);
+
+/*! \brief Function typedef for storing a computed result in the table, on
+ *  the calling thread.
+ *
+ *  \return See #DepGraphEval.
+ */
+typedef int DepGraphCommit(ObjectTable *restrict table,
+                           uint32_t slot,
+                           void *result,
+                           void *user);
+
+typedef struct {
+        // Slots carrying the current epoch were edited or are affected.
+        uint32_t epoch;
+        uint32_t edit_count;
+        uint32_t order_count;
+        uint32_t level_count;
+        size_t marks_sz;
+        uint32_t *marks;
+        size_t edits_sz;
+        uint32_t *edits; // edited during the current batch
+        // The affected slots, in the order of their recomputation.
+        size_t order_sz;
+        uint32_t *order;
+        // The end of every round in the order.
+        size_t levels_sz;
+        uint32_t *levels;
+        // Results of the parallel recomputation, along the order.
+        size_t results_sz;
+        void **results;
+        // Amount of affected children of each slot not ordered yet.
+        size_t pending_sz;
+        uint32_t *pending;
+} DepGraph;
+
+/*! \brief Initializes an empty engine without any memory.
+ *
+ *  \param[out] graph The engine to initialize. Its arrays must be freed by
+ *  the user once it's no longer needed.
+ */
+extern void dep_graph_init(DepGraph *restrict graph);
+
+/*! \brief Records an edited object, to be recomputed with its dependents.
+ *
+ *  \param[in,out] graph The engine.
+ *  \param[in] slot The slot of the object in the table.
+ *  \param[in] reallocator Reallocator for the arrays of the engine. May be
+ *  NULL, in which case the function fails when they become full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure.
+ */
+extern int dep_graph_mark(DepGraph *restrict graph,
+                          uint32_t slot,
+                          Reallocator *reallocator,
+                          void *user);
+
+/*! \brief Orders the edited objects and their dependents.
+ *
+ *  Fills `order` with `order_count` slots, every slot after its affected
+ *  children, and `levels` with the end of each of the `level_count` rounds
+ *  in the order, and starts a new batch. Runs in \f$O(a + l)\f$, where \f$a\f$
+ *  is the amount of affected objects and \f$l\f$ the amount of their links.
+ *
+ *  \param[in,out] graph The engine.
+ *  \param[in] table The table the marked slots belong to.
+ *  \param[in] reallocator See dep_graph_mark().
+ *  \param[in,out] user See dep_graph_mark().
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the batch is
+ *  kept.
+ */
+extern int dep_graph_sort(DepGraph *restrict graph,
+                          const ObjectTable *restrict table,
+                          Reallocator *reallocator,
+                          void *user);
+
+/*! \brief Recomputes the edited objects and their dependents, e.g. once per
+ *  frame.
+ *
+ *  \param[in,out] graph The engine.
+ *  \param[in,out] table The table the marked slots belong to.
+ *  \param[in] eval The function recomputing an object.
+ *  \param[in,out] eval_user Private data to pass to `eval`.
+ *  \param[in] reallocator See dep_graph_mark().
+ *  \param[in,out] user See dep_graph_mark().
+ *
+ *  \return 0 on success, -1 on allocation failure or when `eval` fails, in
+ *  which case the batch is kept, to be recomputed as a whole by the next
+ *  update.
+ *
+ *  \sa dep_graph_sort()
+ */
+extern int dep_graph_update(DepGraph *restrict graph,
+                            ObjectTable *restrict table,
+                            DepGraphEval *eval,
+                            void *eval_user,
+                            Reallocator *reallocator,
+                            void *user);
+
+/*! \brief Recomputes the edited objects and their dependents on a pool of
+ *  workers, one round after the other.
+ *
+ *  The results of a round are committed in the order of the recomputation
+ *  once all of them were computed, before the next round starts. Rounds
+ *  whose results don't all fit in one arena, e.g. when the whole document
+ *  changed, are run in parts that do, each one committed before the next.
+ *
+ *  \param[in,out] graph The engine.
+ *  \param[in,out] table The table the marked slots belong to.
+ *  \param[in,out] pool The pool to run on, whose arenas are emptied.
+ *  \param[in] compute The function computing an object.
+ *  \param[in] commit The function storing its result.
+ *  \param[in] result_size The most bytes that `compute` allocates for an
+ *  object, padding for alignment included. The arenas of the pool must hold
+ *  at least this much.
+ *  \param[in,out] eval_user Private data to pass to both functions.
+ *  \param[in] reallocator See dep_graph_mark().
+ *  \param[in,out] user See dep_graph_mark().
+ *
+ *  \return 0 on success, -1 on allocation failure or when a function fails,
+ *  in which case the batch is kept, as by dep_graph_update().
+ *
+ *  \sa dep_graph_update()
+ */
+extern int dep_graph_update_parallel(DepGraph *restrict graph,
+                                     ObjectTable *restrict table,
+                                     WorkerPool *restrict pool,
+                                     DepGraphCompute *compute,
+                                     DepGraphCommit *commit,
+                                     size_t result_size,
+                                     void *eval_user,
+                                     Reallocator *reallocator,
+                                     void *user);
+
+#endif
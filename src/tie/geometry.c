@@ -12,6 +12,7 @@
 #include "heap.h"
 #include "math.h"
 #include "numeric_array.h"
+#include "predicates.h"
 
 sort_by_decl(vec2d,
              sort_vec2d_on_x,
@@ -46,7 +47,6 @@ PURE_FUNC static inline PTVertexType pt_get_vertex_type(
         const vec2d polygon[static n])
 {
         const vec2d *p, *q;
-        vec2d pv, vq;
 
         p = circular_pred(v, polygon, polygon + n);
         q = circular_succ(v, polygon, polygon + n);
@@ -57,19 +57,13 @@ PURE_FUNC static inline PTVertexType pt_get_vertex_type(
                 return PTVT_DOWN;
         }
 
-        pv = *v;
-        sub_vec2d(&pv, p);
-
-        vq = *q;
-        sub_vec2d(&vq, v);
-
         if (vec_y(*p) > vec_y(*v)) { // end or merge vertex
-                if (cross_vec2d(&pv, &vq) < 0)
+                if (orient2d(p, v, q) < 0)
                         return PTVT_MERGE;
                 return PTVT_END;
         }
 
-        if (cross_vec2d(&pv, &vq) < 0)
+        if (orient2d(p, v, q) < 0)
                 return PTVT_SPLIT;
 
         return PTVT_START;
@@ -80,7 +74,7 @@ vec2d *convex_hull_sorted(size_t n,
                           vec2d out[static restrict n])
 {
         const vec2d *r;
-        vec2d *result = out, pq, qr;
+        vec2d *result = out;
 
         assert(n > 2);
 
@@ -88,19 +82,9 @@ vec2d *convex_hull_sorted(size_t n,
                 *result++ = *r;
         }
 #define compute_next_r                                                         \
-        pq = result[-1];                                                       \
-        sub_vec2d(&pq, &result[-2]);                                           \
-        qr = *r;                                                               \
-        sub_vec2d(&qr, &result[-1]);                                           \
-        while (cross_vec2d(&pq, &qr) < 0) {                                    \
+        while (result - out > 1                                                \
+               && orient2d(&result[-2], &result[-1], r) < 0)                   \
                 --result;                                                      \
-                if (result - out == 1)                                         \
-                        break;                                                 \
-                pq = result[-1];                                               \
-                sub_vec2d(&pq, &result[-2]);                                   \
-                qr = *r;                                                       \
-                sub_vec2d(&qr, &result[-1]);                                   \
-        }                                                                      \
         *result++ = *r
 
         traverse(r, points + 2, points + n) {
@@ -186,7 +170,9 @@ PURE_FUNC static inline double pt_solve_lin(const vec2d *restrict p0,
         if (compare(vec_y(*p0), vec_y(*v)) != compare(vec_y(*v), vec_y(*p1)))
                 return double_min;
 
-        if (fabs(vec_y(*p1) - vec_y(*p0)) < 0x1.p-52)
+        // v lies strictly between the endpoints vertically unless the edge
+        // is horizontal, so the division below is safe otherwise
+        if (vec_y(*p1) == vec_y(*p0))
                 return double_min;
 
         x = (vec_y(*v) - vec_y(*p1)) * (vec_x(*p1) - vec_x(*p0))
@@ -346,50 +332,158 @@ void de_casteljau(double t,
         }
 }
 
+// Extends [*lo, *hi] by the extrema of one coordinate of a bezier curve of
+// degree 3 or less that lie strictly inside the parameter range.
+static inline void bezier_axis_extrema(size_t n,
+                                       const vec2d bezier[static restrict n],
+                                       int axis,
+                                       double *restrict lo,
+                                       double *restrict hi)
+{
+        double p0, p1, p2, p3, a, b, c, d, q, t[2], u, mu, x;
+        const double *r;
+        int roots = 0;
+
+        p0 = bezier[0].v[axis];
+        p1 = bezier[1].v[axis];
+        p2 = bezier[2].v[axis];
+        p3 = n == 4 ? bezier[3].v[axis] : 0;
+
+        if (n == 3) {
+                // B'(t) / 2 = (p1 - p0)(1 - t) + (p2 - p1)t
+                d = p0 - 2 * p1 + p2;
+                if (d != 0) {
+                        t[roots++] = (p0 - p1) / d;
+                }
+        } else {
+                // B'(t) / 3 = at^2 + bt + c in the power basis
+                a = -p0 + 3 * p1 - 3 * p2 + p3;
+                b = 2 * (p0 - 2 * p1 + p2);
+                c = p1 - p0;
+                if (fabs(a) <= 0x1p-40 * (fabs(b) + fabs(c))) {
+                        if (b != 0) {
+                                t[roots++] = -c / b;
+                        }
+                } else if ((d = b * b - 4 * a * c) >= 0) {
+                        // avoids the cancellation in -b + sqrt(d)
+                        q = -0.5 * (b + copysign(sqrt(d), b));
+                        t[roots++] = q / a;
+                        if (q != 0) {
+                                t[roots++] = c / q;
+                        }
+                }
+        }
+
+        traverse(r, t, t + roots) {
+                if (*r <= 0 || *r >= 1) {
+                        continue;
+                }
+                u = *r;
+                mu = 1 - u;
+                if (n == 3) {
+                        x = mu * mu * p0 + 2 * mu * u * p1 + u * u * p2;
+                } else {
+                        x = mu * mu * mu * p0 + 3 * mu * mu * u * p1
+                          + 3 * mu * u * u * p2 + u * u * u * p3;
+                }
+                *lo = fmin(*lo, x);
+                *hi = fmax(*hi, x);
+        }
+}
+
+void bezier_bounds(size_t n,
+                   const vec2d bezier[static restrict n],
+                   aabb2d *restrict out)
+{
+        const vec2d *p;
+        aabb2d hull;
+        int axis;
+
+        assert(n > 0);
+
+        empty_aabb2d(&hull);
+        traverse(p, bezier, bezier + n) {
+                extend_aabb2d(&hull, p);
+        }
+        if (n <= 2 || n > 4) {
+                *out = hull;
+                return;
+        }
+
+        empty_aabb2d(out);
+        extend_aabb2d(out, &bezier[0]);
+        extend_aabb2d(out, &bezier[n - 1]);
+        for (axis = 0; axis < 2; ++axis) {
+                // extrema can only lie past the endpoints if the control
+                // points do
+                if (hull.min.v[axis] < out->min.v[axis]
+                    || hull.max.v[axis] > out->max.v[axis]) {
+                        bezier_axis_extrema(n,
+                                            bezier,
+                                            axis,
+                                            &out->min.v[axis],
+                                            &out->max.v[axis]);
+                }
+        }
+}
+
 PURE_FUNC bool colinear(size_t n,
                         const vec2d points[static restrict n],
                         double error)
 {
         assert(error >= 0);
 
-        const double epsilon = 1.0 / (1 << 25);
-        const vec2d *p, *q;
+        const vec2d *p, *q, *r;
         vec2d diff;
-        double sine, cosine;
+        double sine, cosine, sqrdist, max_sqrdist = 0;
 
         if (n <= 2) {
                 return true;
         }
 
-        // This algorithm works by choosing two random points and rotating
+        // This algorithm works by choosing two points and rotating
         // all of the points so that the two points lie on the X axis.
         // The absolute value of the Y component of any of the points will be
         // less than error if the points are colinear, and larger otherwise.
 
+        // The second point is the one furthest from the first, which makes
+        // the rotation as well conditioned as it can be. If all of the points
+        // are within the error from the first one, they're trivially colinear
+        // and we exit early to avoid normalizing a (near) zero vector.
         p = points;
         q = points + 1;
-
-        // we can't choose a point near equal p, since
-        // we wouldn't be able to normalize their difference
-        // if all points turn out equal we exit early to avoid
-        // any floating point exceptions
-        do {
-                diff = *q;
+        traverse(r, points + 1, points + n) {
+                diff = *r;
                 sub_vec2d(&diff, p);
-                ++q;
-        } while (q < points + n && fabs(diff.v[0]) < epsilon
-                 && fabs(diff.v[1]) < epsilon);
-        if (q >= points + n) {
+                sqrdist = sqrmag_vec2d(&diff);
+                if (sqrdist > max_sqrdist) {
+                        max_sqrdist = sqrdist;
+                        q = r;
+                }
+        }
+        if (max_sqrdist <= error * error) {
                 return true;
         }
 
+        // without any tolerance, only exact colinearity will do
+        if (error == 0) {
+                traverse(r, points + 1, points + n) {
+                        if (orient2d(p, q, r) != 0) {
+                                return false;
+                        }
+                }
+                return true;
+        }
+
+        diff = *q;
+        sub_vec2d(&diff, p);
         normalize_vec2d(&diff);
 
         cosine = vec_x(diff);
         sine = vec_y(diff);
 
-        traverse(q, q, points + n) {
-                diff = *q;
+        traverse(r, points + 1, points + n) {
+                diff = *r;
                 sub_vec2d(&diff, p);
                 if (fabs(cosine * vec_y(diff) - sine * vec_x(diff)) > error) {
                         return false;
@@ -399,19 +493,42 @@ PURE_FUNC bool colinear(size_t n,
         return true;
 }
 
-vec2d *bezier_discretize(size_t n,
-                         const vec2d bezier[static restrict n],
-                         size_t *restrict pout_sz,
-                         vec2d *restrict *restrict pout,
-                         size_t *restrict paux_sz,
-                         vec2d *restrict *restrict paux,
-                         double error,
-                         Reallocator *reallocator,
-                         void *user)
+// Tests whether the control points of a curve may be visible in the view.
+PURE_FUNC static inline bool bezier_visible(
+        size_t n,
+        const vec2d bezier[static restrict n],
+        const View *restrict view)
+{
+        const vec2d *p;
+        vec2d q;
+        aabb2d box;
+
+        empty_aabb2d(&box);
+        traverse(p, bezier, bezier + n) {
+                q = transform_mat2d(p, &view->matrix);
+                add_vec2d(&q, &view->offset);
+                extend_aabb2d(&box, &q);
+        }
+
+        return overlaps_aabb2d(&box, &view->viewport);
+}
+
+// Subdivides a curve until its pieces are flat up to the error, or outside
+// the view if there is one.
+static vec2d *bezier_subdivide(size_t n,
+                               const vec2d bezier[static restrict n],
+                               const View *restrict view,
+                               size_t *restrict pout_sz,
+                               vec2d *restrict *restrict pout,
+                               size_t *restrict paux_sz,
+                               vec2d *restrict *restrict paux,
+                               double error,
+                               Reallocator *reallocator,
+                               void *user)
 {
         vec2d *aux = *paux, *out = *pout;
-        vec2d *result = out, *last = aux, *end = aux + n;
-        size_t out_sz = *pout_sz, aux_sz = *paux_sz;
+        vec2d *last = aux, *end = aux + n;
+        size_t out_sz = *pout_sz, aux_sz = *paux_sz, count = 0;
 
         assert(n > 0);
         assert(out_sz > 0);
@@ -419,11 +536,14 @@ vec2d *bezier_discretize(size_t n,
         assert(error >= 0);
 
         memcpy(aux, bezier, n * sizeof(*bezier));
-        *result++ = bezier[0];
+        out[count++] = bezier[0];
 
         do {
-                if (colinear(n, last, error)) {
-                        if ((size_t)(result - out) == out_sz
+                if (colinear(n, last, error)
+                    || (view && !bezier_visible(n, last, view))) {
+                        // counted rather than pointed to, since the output
+                        // moves when it's reallocated
+                        if (count == out_sz
                             && !auxiliary_realloc(reallocator,
                                                   &out_sz,
                                                   &out,
@@ -433,27 +553,109 @@ vec2d *bezier_discretize(size_t n,
                                                   user)) {
                                 return NULL;
                         }
-                        *result++ = end[-1];
+                        out[count++] = end[-1];
                         last -= n;
                         end -= n;
                         continue;
                 }
-                if (end - aux + n >= aux_sz
-                    && !auxiliary_realloc(reallocator,
-                                          &aux_sz,
-                                          &aux,
-                                          paux_sz,
-                                          paux,
-                                          end - aux + n,
-                                          user)) {
-                        return NULL;
+                if (end - aux + n >= aux_sz) {
+                        // the stack moves when it's reallocated
+                        size_t last_offset = last - aux, end_offset = end - aux;
+
+                        if (!auxiliary_realloc(reallocator,
+                                               &aux_sz,
+                                               &aux,
+                                               paux_sz,
+                                               paux,
+                                               end_offset + n,
+                                               user)) {
+                                return NULL;
+                        }
+                        last = aux + last_offset;
+                        end = aux + end_offset;
                 }
                 de_casteljau(0.5, n, last, end);
                 last += n;
                 end += n;
         } while (end != aux);
 
-        return result;
+        return out + count;
+}
+
+vec2d *bezier_discretize(size_t n,
+                         const vec2d bezier[static restrict n],
+                         size_t *restrict pout_sz,
+                         vec2d *restrict *restrict pout,
+                         size_t *restrict paux_sz,
+                         vec2d *restrict *restrict paux,
+                         double error,
+                         Reallocator *reallocator,
+                         void *user)
+{
+        return bezier_subdivide(n,
+                                bezier,
+                                NULL,
+                                pout_sz,
+                                pout,
+                                paux_sz,
+                                paux,
+                                error,
+                                reallocator,
+                                user);
+}
+
+vec2d *bezier_discretize_view(size_t n,
+                              const vec2d bezier[static restrict n],
+                              const View *restrict view,
+                              size_t *restrict pout_sz,
+                              vec2d *restrict *restrict pout,
+                              size_t *restrict paux_sz,
+                              vec2d *restrict *restrict paux,
+                              double error,
+                              Reallocator *reallocator,
+                              void *user)
+{
+        const vec2d *c = view->matrix.cols;
+        size_t out_sz = *pout_sz;
+        vec2d *out = *pout;
+        double sum, det, scale;
+
+        assert(error >= 0);
+
+        // The view stretches distances by at most the largest singular value
+        // of its matrix, so dividing by it keeps the error on screen within
+        // bounds in every direction.
+        sum = sqrmag_vec2d(&c[0]) + sqrmag_vec2d(&c[1]);
+        det = cross_vec2d(&c[0], &c[1]);
+        scale = sqrt(0.5 * (sum + sqrt(fmax(sum * sum - 4 * det * det, 0))));
+        if (scale == 0) {
+                // everything collapses to a single pixel, which the chord
+                // covers as well as any refinement
+                if (out_sz < 2
+                    && !auxiliary_realloc(reallocator,
+                                          &out_sz,
+                                          &out,
+                                          pout_sz,
+                                          pout,
+                                          2,
+                                          user)) {
+                        return NULL;
+                }
+                out[0] = bezier[0];
+                out[1] = bezier[n - 1];
+                return out + 2;
+        }
+
+        return bezier_subdivide(n,
+                                bezier,
+                                view,
+                                pout_sz,
+                                pout,
+                                paux_sz,
+                                paux,
+                                error / scale,
+                                reallocator,
+                                user);
 }
 
 void furthest_points_apart(const vec2d **restrict out1,
@@ -12,6 +12,16 @@
 #include "attrib.h"
 #include "math.h"
 
+/*! \brief A view of the document on screen.
+ */
+typedef struct {
+        // Maps document coordinates to pixels, applied with
+        // transform_mat2d() and followed by the offset.
+        mat2d matrix;
+        vec2d offset;
+        aabb2d viewport; // the visible rectangle, in pixels
+} View;
+
 /*! \brief Computes the signed area of a simple polygon using the shoelace
  *  formula.
  *
@@ -57,6 +67,22 @@ extern void de_casteljau(double t,
                          vec2d bezier[static restrict n],
                          vec2d left[restrict n]);
 
+/*! \brief Computes the bounding box of a bezier curve.
+ *
+ *  For curves of degree 3 or less the box is tight: the extrema of the curve
+ *  are found in closed form from the roots of its derivative. For higher
+ *  degrees the box of the control polygon is returned instead, which is
+ *  conservative, since the curve lies in the convex hull of its control
+ *  points. Runs in \f$O(n)\f$.
+ *
+ *  \param[in] n The amount of control points. Must be positive.
+ *  \param[in] bezier The control points of the curve.
+ *  \param[out] out The bounding box.
+ */
+extern void bezier_bounds(size_t n,
+                          const vec2d bezier[static restrict n],
+                          aabb2d *restrict out);
+
 /*! \brief Test if the given points are colinear up to a given error.
  *
  *  Runs in \f$O(n)\f$. For n <= 2 always returns true.
@@ -114,6 +140,47 @@ vec2d *bezier_discretize(size_t n,
                          Reallocator *reallocator,
                          void *user);
 
+/*! \brief Computes a line strip that approximately describes a bezier curve
+ *  as seen through a view.
+ *
+ *  Works like bezier_discretize(), except that the error is measured in
+ *  pixels on screen rather than in document units, so that zooming in only
+ *  refines the curves as much as can be seen. Subcurves whose control points
+ *  lie outside the viewport aren't subdivided any further and are replaced
+ *  by their chord, which stays outside the viewport as well, so curves that
+ *  are only partially visible are only refined where they are; curves that
+ *  are entirely outside, or a view that collapses everything to a point,
+ *  make a single line. The line strip is still
+ *  continuous and in document coordinates, so that shapes can be filled as
+ *  usual. Callers drawing strokes should grow the viewport by the stroke
+ *  width.
+ *
+ *  \param[in] n See bezier_discretize().
+ *  \param[in] bezier See bezier_discretize().
+ *  \param[in] view The view.
+ *  \param[in,out] pout_sz See bezier_discretize().
+ *  \param[out] pout See bezier_discretize().
+ *  \param[in,out] paux_sz See bezier_discretize().
+ *  \param paux See bezier_discretize().
+ *  \param[in] error The maximal deviation from the curve on screen, in
+ *  pixels. Must be nonnegative.
+ *  \param[in] reallocator See bezier_discretize().
+ *  \param[in,out] user See bezier_discretize().
+ *
+ *  \return Returns a pointer one past the last point of the line strip, or
+ *  NULL on allocation failure.
+ */
+vec2d *bezier_discretize_view(size_t n,
+                              const vec2d bezier[static restrict n],
+                              const View *restrict view,
+                              size_t *restrict pout_sz,
+                              vec2d *restrict *restrict pout,
+                              size_t *restrict paux_sz,
+                              vec2d *restrict *restrict paux,
+                              double error,
+                              Reallocator *reallocator,
+                              void *user);
+
 /*! \brief Puts the two furthest points in out1 and out2.
  *
  *  Currently this algorithm takes n * (n - 1) / 2
@@ -0,0 +1,355 @@
+#include "history.h"
+
+void history_init(History *restrict history)
+{
+        history->size = 0;
+        history->capacity = 0;
+        history->tree.address = NULL;
+        history->entries.address = NULL;
+        history->current_entry = 0;
+        history->tree_size = 0;
+        history->tree_capacity = 0;
+}
+
+int history_reserve(History *restrict history,
+                    uint64_t size,
+                    uint32_t tree_size,
+                    Reallocator *reallocator,
+                    void *user)
+{
+        LinearHistory *tree = history->tree.address, *linear;
+        HistoryEntry *entries = history->entries.address;
+        size_t tree_sz = history->tree_capacity, entries_sz = history->capacity;
+        size_t utree_sz = tree_sz, uentries_sz = entries_sz;
+        bool moved;
+
+        // the tree is grown first, so that nothing needs to be undone if
+        // growing the entries fails
+        if (tree_size > tree_sz) {
+                if (!auxiliary_realloc(reallocator,
+                                       &tree_sz,
+                                       &tree,
+                                       &utree_sz,
+                                       &history->tree.address,
+                                       tree_size,
+                                       user)) {
+                        return -1;
+                }
+                history->tree_capacity = min(utree_sz, UINT32_MAX);
+        }
+        if (size <= entries_sz) {
+                return 0;
+        }
+
+        // addresses into the old entries are meaningless once they move
+        traverse(linear, tree, tree + history->tree_size) {
+                location_make_relative(entries, &linear->entries);
+        }
+        moved = auxiliary_realloc(reallocator,
+                                  &entries_sz,
+                                  &entries,
+                                  &uentries_sz,
+                                  &history->entries.address,
+                                  size,
+                                  user);
+        traverse(linear, tree, tree + history->tree_size) {
+                location_make_absolute(history->entries.address,
+                                       &linear->entries);
+        }
+        if (!moved) {
+                return -1;
+        }
+        history->capacity = uentries_sz;
+
+        return 0;
+}
+
+// Returns the index of the first entry of a linear history.
+static inline uint64_t history_first(const History *restrict history,
+                                     uint32_t linear)
+{
+        const LinearHistory *tree = history->tree.address;
+
+        return tree[linear].entries.address - history->entries.address;
+}
+
+// Sets the index data of a linear history from that of its parent.
+static void history_nav_link(HistoryNav *restrict nav,
+                             const History *restrict history,
+                             uint32_t linear)
+{
+        const LinearHistory *tree = history->tree.address;
+        HistoryNavNode *node = &nav->nodes[linear];
+        const HistoryNavNode *parent, *jump;
+        uint32_t p = tree[linear].parent;
+
+        if (p == linear) {
+                node->depth = 0;
+                node->level = 0;
+                node->jump = linear;
+                return;
+        }
+
+        assert(p < linear && tree[linear].offset <= tree[p].size);
+        parent = &nav->nodes[p];
+        jump = &nav->nodes[parent->jump];
+        node->depth = parent->depth + tree[linear].offset;
+        node->level = parent->level + 1;
+        // jumps twice as far as the parent's when the parent's jump and its
+        // jump's jump span the same amount of levels
+        node->jump = parent->level - jump->level
+                                     == jump->level
+                                                - nav->nodes[jump->jump].level
+                           ? jump->jump
+                           : p;
+}
+
+void history_nav_init(HistoryNav *restrict nav)
+{
+        nav->count = 0;
+        nav->nodes_sz = 0;
+        nav->nodes = NULL;
+}
+
+// Makes room for `n` linear histories.
+static bool history_nav_reserve(HistoryNav *restrict nav,
+                                uint32_t n,
+                                Reallocator *reallocator,
+                                void *user)
+{
+        size_t nodes_sz = nav->nodes_sz;
+        HistoryNavNode *nodes = nav->nodes;
+
+        return n <= nodes_sz
+            || auxiliary_realloc(reallocator,
+                                 &nodes_sz,
+                                 &nodes,
+                                 &nav->nodes_sz,
+                                 &nav->nodes,
+                                 n,
+                                 user);
+}
+
+int history_nav_build(HistoryNav *restrict nav,
+                      const History *restrict history,
+                      Reallocator *reallocator,
+                      void *user)
+{
+        uint32_t linear;
+
+        nav->count = 0;
+        for (linear = 0; linear < history->tree_size; ++linear) {
+                if (history_nav_add(nav, history, linear, reallocator, user)) {
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+int history_nav_add(HistoryNav *restrict nav,
+                    const History *restrict history,
+                    uint32_t linear,
+                    Reallocator *reallocator,
+                    void *user)
+{
+        assert(linear == nav->count);
+        assert(linear < history->tree_size);
+        if (!history_nav_reserve(nav, linear + 1, reallocator, user)) {
+                return -1;
+        }
+
+        assert(linear == 0
+               || history_first(history, linear - 1)
+                                  + history->tree.address[linear - 1].size
+                          <= history_first(history, linear));
+        history_nav_link(nav, history, linear);
+        ++nav->count;
+
+        return 0;
+}
+
+uint32_t history_locate(const HistoryNav *restrict nav,
+                        const History *restrict history,
+                        uint64_t entry)
+{
+        const LinearHistory *tree = history->tree.address;
+        uint32_t lo = 0, hi = nav->count, mid;
+
+        // the last linear history starting at the entry or before it, which
+        // holds it, since later ones start after the entries of earlier ones
+        while (hi - lo > 1) {
+                mid = lo + (hi - lo) / 2;
+                if (history_first(history, mid) <= entry) {
+                        lo = mid;
+                } else {
+                        hi = mid;
+                }
+        }
+        assert(entry - history_first(history, lo) < tree[lo].size);
+
+        return lo;
+}
+
+uint64_t history_depth(const HistoryNav *restrict nav,
+                       const History *restrict history,
+                       uint64_t entry)
+{
+        uint32_t linear = history_locate(nav, history, entry);
+
+        return nav->nodes[linear].depth + entry
+             - history_first(history, linear);
+}
+
+// Finds the closest ancestor of a linear history, or the linear history
+// itself, whose first entry is at most at the given depth.
+static uint32_t history_nav_find(const HistoryNav *restrict nav,
+                                 const History *restrict history,
+                                 uint32_t linear,
+                                 uint64_t depth)
+{
+        const LinearHistory *tree = history->tree.address;
+        uint32_t jump;
+
+        while (nav->nodes[linear].depth > depth) {
+                jump = nav->nodes[linear].jump;
+                linear = nav->nodes[jump].depth > depth ? jump
+                                                        : tree[linear].parent;
+        }
+
+        return linear;
+}
+
+// Returns the entry at a depth on the path to a linear history.
+static inline uint64_t history_nav_entry(const HistoryNav *restrict nav,
+                                         const History *restrict history,
+                                         uint32_t linear,
+                                         uint64_t depth)
+{
+        linear = history_nav_find(nav, history, linear, depth);
+
+        return history_first(history, linear) + depth
+             - nav->nodes[linear].depth;
+}
+
+uint64_t history_ancestor(const HistoryNav *restrict nav,
+                          const History *restrict history,
+                          uint64_t entry,
+                          uint64_t undos)
+{
+        uint32_t linear = history_locate(nav, history, entry);
+        uint64_t depth = nav->nodes[linear].depth + entry
+                       - history_first(history, linear);
+
+        if (undos > depth) {
+                return HISTORY_NIL;
+        }
+
+        return history_nav_entry(nav, history, linear, depth - undos);
+}
+
+// Finds the ancestor of a linear history at a level, at most its own.
+static uint32_t history_nav_climb(const HistoryNav *restrict nav,
+                                  const History *restrict history,
+                                  uint32_t linear,
+                                  uint32_t level)
+{
+        const LinearHistory *tree = history->tree.address;
+        const HistoryNavNode *nodes = nav->nodes;
+
+        while (nodes[linear].level > level) {
+                linear = nodes[nodes[linear].jump].level >= level
+                               ? nodes[linear].jump
+                               : tree[linear].parent;
+        }
+
+        return linear;
+}
+
+// Finds the closest common ancestor of two linear histories.
+static uint32_t history_nav_common(const HistoryNav *restrict nav,
+                                   const History *restrict history,
+                                   uint32_t a,
+                                   uint32_t b)
+{
+        const LinearHistory *tree = history->tree.address;
+        const HistoryNavNode *nodes = nav->nodes;
+
+        a = history_nav_climb(nav, history, a, nodes[b].level);
+        b = history_nav_climb(nav, history, b, nodes[a].level);
+        // jumps only depend on the level, so both sides jump alike
+        while (a != b) {
+                if (nodes[a].jump != nodes[b].jump) {
+                        a = nodes[a].jump;
+                        b = nodes[b].jump;
+                } else {
+                        a = tree[a].parent;
+                        b = tree[b].parent;
+                }
+        }
+
+        return a;
+}
+
+// Returns the depth of the last entry of a common ancestor of an entry on
+// the path to the entry: the entry itself if it belongs to the common
+// ancestor, or the last entry before the branch that leads to it. Negative
+// if the path leaves the common ancestor before its first entry.
+static int64_t history_nav_last(const HistoryNav *restrict nav,
+                                const History *restrict history,
+                                uint32_t common,
+                                uint32_t linear,
+                                uint64_t entry)
+{
+        const LinearHistory *tree = history->tree.address;
+        uint64_t depth = nav->nodes[common].depth;
+
+        if (linear == common) {
+                return depth + entry - history_first(history, linear);
+        }
+        linear = history_nav_climb(nav,
+                                   history,
+                                   linear,
+                                   nav->nodes[common].level + 1);
+
+        return (int64_t)(depth + tree[linear].offset) - 1;
+}
+
+uint64_t history_common_ancestor(const HistoryNav *restrict nav,
+                                 const History *restrict history,
+                                 uint64_t a,
+                                 uint64_t b)
+{
+        uint32_t la = history_locate(nav, history, a),
+                 lb = history_locate(nav, history, b),
+                 common = history_nav_common(nav, history, la, lb);
+        int64_t depth = min(history_nav_last(nav, history, common, la, a),
+                            history_nav_last(nav, history, common, lb, b));
+
+        if (depth < 0) {
+                return HISTORY_NIL;
+        }
+
+        return history_nav_entry(nav, history, common, depth);
+}
+
+uint64_t history_path(const HistoryNav *restrict nav,
+                      const History *restrict history,
+                      uint64_t from,
+                      uint64_t to,
+                      uint64_t *restrict pundos,
+                      uint64_t *restrict predos)
+{
+        uint64_t common = history_common_ancestor(nav, history, from, to),
+                 depth;
+
+        if (common == HISTORY_NIL) {
+                return HISTORY_NIL;
+        }
+
+        depth = history_depth(nav, history, common);
+        *pundos = history_depth(nav, history, from) - depth;
+        *predos = history_depth(nav, history, to) - depth;
+
+        return common;
+}
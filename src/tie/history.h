@@ -0,0 +1,177 @@
+/*! \file history.h
+ *  \brief Histories held in memory
+ *
+ *  A history in memory holds addresses in its locations, and owns its tree
+ *  of linear histories and its entries, which are grown through the usual
+ *  reallocator protocol (see algo.h). Since the linear histories point into
+ *  the entries, growing the entries moves them along.
+ *
+ *  Moving around the history, by undoing and redoing or by jumping to an
+ *  entry, goes through a #HistoryNav, an index over the tree of linear
+ *  histories. Every linear history knows how many entries come before its
+ *  first one on its path from the root, which is the amount before its
+ *  parent's plus the offset of its branch, and keeps a jump pointer to one
+ *  of its ancestors, chosen as in a skew binary random access list, so that
+ *  reaching any ancestor takes \f$O(\log t)\f$ steps for \f$t\f$ linear
+ *  histories. Since branching never changes existing linear histories, a new
+ *  one is indexed in \f$O(1)\f$. Linear histories hold their entries in
+ *  their own order, so the one an entry belongs to is found by bisection.
+ *  Entries are identified by their index in the entries of the history, and
+ *  their depth is the amount of undos from the first entry of the history
+ *  to them.
+ */
+#ifndef TIE_HISTORY_H
+#define TIE_HISTORY_H
+
+#include <stdint.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "core.h"
+
+#define HISTORY_NIL UINT64_MAX
+
+typedef struct {
+        uint64_t depth; // of the first entry of the linear history
+        uint32_t level; // amount of ancestors
+        uint32_t jump; // an ancestor, or itself for the root
+} HistoryNavNode;
+
+typedef struct {
+        uint32_t count; // amount of linear histories indexed
+        size_t nodes_sz;
+        HistoryNavNode *nodes; // one per linear history
+} HistoryNav;
+
+/*! \brief Initializes an empty history without any memory.
+ *
+ *  \param[out] history The history to initialize. Its arrays must be freed
+ *  by the user once it's no longer needed.
+ */
+extern void history_init(History *restrict history);
+
+/*! \brief Makes room for entries and linear histories.
+ *
+ *  \param[in,out] history The history.
+ *  \param[in] size The amount of entries to make room for.
+ *  \param[in] tree_size The amount of linear histories to make room for.
+ *  \param[in] reallocator Reallocator for the arrays of the history. May be
+ *  NULL, in which case the function fails when they're too small.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the history
+ *  is left unchanged.
+ */
+extern int history_reserve(History *restrict history,
+                           uint64_t size,
+                           uint32_t tree_size,
+                           Reallocator *reallocator,
+                           void *user);
+
+/*! \brief Initializes an empty index without any memory.
+ *
+ *  \param[out] nav The index to initialize. Its arrays must be freed by the
+ *  user once it's no longer needed.
+ */
+extern void history_nav_init(HistoryNav *restrict nav);
+
+/*! \brief Indexes all linear histories of a history, e.g. one that was
+ *  loaded.
+ *
+ *  Runs in \f$O(t)\f$.
+ *
+ *  \param[in,out] nav The index.
+ *  \param[in] history The history.
+ *  \param[in] reallocator Reallocator for the arrays of the index. May be
+ *  NULL, in which case the function fails when they're too small.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure.
+ */
+extern int history_nav_build(HistoryNav *restrict nav,
+                             const History *restrict history,
+                             Reallocator *reallocator,
+                             void *user);
+
+/*! \brief Indexes a new linear history, branching off anywhere in another.
+ *
+ *  Runs in \f$O(1)\f$, amortized.
+ *
+ *  \param[in,out] nav The index.
+ *  \param[in] history The history.
+ *  \param[in] linear The new linear history, the one after the last one
+ *  indexed, whose entries start after those of all others.
+ *  \param[in] reallocator See history_nav_build().
+ *  \param[in,out] user See history_nav_build().
+ *
+ *  \return 0 on success, -1 on allocation failure.
+ */
+extern int history_nav_add(HistoryNav *restrict nav,
+                           const History *restrict history,
+                           uint32_t linear,
+                           Reallocator *reallocator,
+                           void *user);
+
+/*! \brief Finds the linear history an entry belongs to, in
+ *  \f$O(\log t)\f$.
+ */
+extern PURE_FUNC uint32_t history_locate(const HistoryNav *restrict nav,
+                                         const History *restrict history,
+                                         uint64_t entry);
+
+/*! \brief Returns the amount of undos from the first entry of the history to
+ *  an entry, in \f$O(\log t)\f$.
+ */
+extern PURE_FUNC uint64_t history_depth(const HistoryNav *restrict nav,
+                                        const History *restrict history,
+                                        uint64_t entry);
+
+/*! \brief Finds the entry that a number of undos lead to, in
+ *  \f$O(\log t)\f$.
+ *
+ *  \param[in] nav The index.
+ *  \param[in] history The history.
+ *  \param[in] entry The entry to undo from.
+ *  \param[in] undos The amount of undos.
+ *
+ *  \return The entry, or #HISTORY_NIL if there are fewer entries before it.
+ */
+extern PURE_FUNC uint64_t history_ancestor(const HistoryNav *restrict nav,
+                                           const History *restrict history,
+                                           uint64_t entry,
+                                           uint64_t undos);
+
+/*! \brief Finds the latest entry that two entries were both made from, in
+ *  \f$O(\log t)\f$.
+ *
+ *  \return The entry, which may be either of the two, or #HISTORY_NIL if the
+ *  entries have no common ancestor.
+ */
+extern PURE_FUNC uint64_t history_common_ancestor(
+        const HistoryNav *restrict nav,
+        const History *restrict history,
+        uint64_t a,
+        uint64_t b);
+
+/*! \brief Computes the shortest way from one entry to another, in
+ *  \f$O(\log t)\f$: undoing to their common ancestor, then redoing.
+ *
+ *  \param[in] nav The index.
+ *  \param[in] history The history.
+ *  \param[in] from The entry to start from.
+ *  \param[in] to The entry to reach.
+ *  \param[out] pundos The amount of undos.
+ *  \param[out] predos The amount of redos. The entry reached after `i` of
+ *  them is the ancestor of `to` `*predos - i` undos away.
+ *
+ *  \return The common ancestor, or #HISTORY_NIL if there's none, in which
+ *  case the outputs are left unchanged.
+ */
+extern uint64_t history_path(const HistoryNav *restrict nav,
+                             const History *restrict history,
+                             uint64_t from,
+                             uint64_t to,
+                             uint64_t *restrict pundos,
+                             uint64_t *restrict predos);
+
+#endif
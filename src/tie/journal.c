@@ -0,0 +1,934 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "history.h"
+#include "journal.h"
+#include "memalloc.h"
+#include "tiefile.h"
+
+typedef struct {
+        uint8_t magic_byte; // 0x83
+        int8_t journal_string[3];
+        uint16_t major;
+        uint16_t minor;
+        uint64_t generation;
+        JournalPosition base; // of the file the generation started from
+} JournalHeader;
+
+typedef enum {
+        JOURNAL_ENTRY,
+        JOURNAL_TREE,
+        JOURNAL_CURRENT,
+        JOURNAL_NODES,
+        JOURNAL_OBJECTS,
+        JOURNAL_GENERATIONS,
+        JOURNAL_LINKS
+} JournalRecordType;
+
+// Followed by `size` bytes of payload.
+typedef struct {
+        uint32_t type;
+        uint32_t size;
+        uint64_t checksum; // of the type, the size and the payload
+} JournalRecord;
+
+typedef struct {
+        uint32_t linear;
+        uint32_t edit; // of the store, in which the objects were set
+        HistoryEntry entry;
+} JournalEntry;
+
+// Followed by `count` items appended to an array of the object store, the
+// first of which is at `first`.
+typedef struct {
+        uint64_t first;
+        uint64_t count;
+} JournalItems;
+
+typedef struct {
+        uint32_t linear;
+        LinearHistory node; // its entries hold the index of the first one
+} JournalTree;
+
+typedef struct {
+        uint64_t current_entry;
+} JournalCurrent;
+
+// 64-bit FNV-1a, going on from `hash`.
+static uint64_t journal_hash(uint64_t hash, const void *data, size_t size)
+{
+        const unsigned char *p;
+
+        if (size == 0) {
+                return hash;
+        }
+        traverse(p,
+                 (const unsigned char *)data,
+                 (const unsigned char *)data + size) {
+                hash = (hash ^ *p) * 0x100000001B3;
+        }
+
+        return hash;
+}
+
+// Checksums a record whose payload is a head followed by items.
+static uint64_t journal_checksum(const JournalRecord *record,
+                                 const void *head,
+                                 uint32_t head_size,
+                                 const void *items)
+{
+        uint64_t hash = journal_hash(0xCBF29CE484222325,
+                                     record,
+                                     offsetof(JournalRecord, checksum));
+
+        hash = journal_hash(hash, head, head_size);
+
+        return journal_hash(hash, items, record->size - head_size);
+}
+
+static bool journal_write_all(int fd, const unsigned char *p, size_t n)
+{
+        ssize_t written;
+
+        while (n > 0) {
+                written = write(fd, p, n);
+                if (written < 0 && errno != EINTR) {
+                        return false;
+                }
+                if (written > 0) {
+                        p += written;
+                        n -= written;
+                }
+        }
+
+        return true;
+}
+
+// Writes the buffer without syncing it. A failed write is cut off, so that
+// the buffer can be written again after whatever was written before it.
+static TieFileStatus journal_flush(Journal *restrict journal)
+{
+        off_t end = lseek(journal->fd, 0, SEEK_END);
+
+        if (end < 0) {
+                return TIEFILE_IO_ERROR;
+        }
+        if (!journal_write_all(journal->fd,
+                               journal->buffer,
+                               journal->buffered)) {
+                (void)!ftruncate(journal->fd, end);
+                return TIEFILE_IO_ERROR;
+        }
+        journal->buffered = 0;
+
+        return TIEFILE_OK;
+}
+
+static void journal_header(JournalHeader *restrict header,
+                           uint64_t generation,
+                           JournalPosition base)
+{
+        memset(header, 0, sizeof(*header));
+        header->magic_byte = JOURNAL_MAGIC_BYTE;
+        memcpy(header->journal_string, JOURNAL_STRING, 3);
+        header->major = JOURNAL_MAJOR;
+        header->minor = JOURNAL_MINOR;
+        header->generation = generation;
+        header->base = base;
+}
+
+// Empties the journal, starting a new generation from a file that holds
+// every record so far. Generations only grow, so that files can tell which
+// of two positions is the later one.
+static TieFileStatus journal_reset(Journal *restrict journal,
+                                   JournalPosition base)
+{
+        uint64_t generation = max(journal->generation, base.generation) + 1;
+        JournalHeader header;
+
+        journal_header(&header, generation, base);
+        journal->buffered = 0;
+        journal->pending = 0;
+        if (ftruncate(journal->fd, 0)
+            || !journal_write_all(journal->fd,
+                                  (const unsigned char *)&header,
+                                  sizeof(header))
+            || fdatasync(journal->fd)) {
+                return TIEFILE_IO_ERROR;
+        }
+        journal->generation = generation;
+        journal->records = 0;
+        journal->base = base;
+
+        return TIEFILE_OK;
+}
+
+// Writes the buffered records and syncs them. The lock must be held.
+static TieFileStatus journal_commit_locked(Journal *restrict journal)
+{
+        TieFileStatus status;
+
+        if (journal->pending == 0 && journal->buffered == 0) {
+                return TIEFILE_OK;
+        }
+        status = journal_flush(journal);
+        if (status != TIEFILE_OK) {
+                return status;
+        }
+        if (fdatasync(journal->fd)) {
+                return TIEFILE_IO_ERROR;
+        }
+        journal->pending = 0;
+
+        return TIEFILE_OK;
+}
+
+// Buffers a record whose payload is a head followed by items, either of
+// which may be empty.
+static TieFileStatus journal_push(Journal *restrict journal,
+                                  JournalRecordType type,
+                                  const void *head,
+                                  uint32_t head_size,
+                                  const void *items,
+                                  uint32_t items_size)
+{
+        JournalRecord record;
+        TieFileStatus status;
+
+        assert(sizeof(record) + head_size + items_size <= JOURNAL_BUFFER_SIZE);
+        mtx_lock(&journal->lock);
+        if (journal->buffered + sizeof(record) + head_size + items_size
+                    > JOURNAL_BUFFER_SIZE
+            && (status = journal_flush(journal)) != TIEFILE_OK) {
+                mtx_unlock(&journal->lock);
+                return status;
+        }
+
+        record.type = type;
+        record.size = head_size + items_size;
+        record.checksum = journal_checksum(&record, head, head_size, items);
+        memcpy(journal->buffer + journal->buffered, &record, sizeof(record));
+        journal->buffered += sizeof(record);
+        if (head_size > 0) {
+                memcpy(journal->buffer + journal->buffered, head, head_size);
+                journal->buffered += head_size;
+        }
+        if (items_size > 0) {
+                memcpy(journal->buffer + journal->buffered, items, items_size);
+                journal->buffered += items_size;
+        }
+        ++journal->records;
+
+        status = ++journal->pending >= journal->group
+                       ? journal_commit_locked(journal)
+                       : TIEFILE_OK;
+        mtx_unlock(&journal->lock);
+
+        return status;
+}
+
+static TieFileStatus journal_replay_entry(History *restrict history,
+                                          ObjectStore *restrict store,
+                                          const JournalEntry *record,
+                                          Reallocator *reallocator,
+                                          void *user)
+{
+        LinearHistory *linear;
+
+        if (record->linear >= history->tree_size
+            || record->edit == UINT32_MAX) {
+                return TIEFILE_INVALID;
+        }
+        linear = history->tree.address + record->linear;
+        if (linear->entries.address + linear->size
+            != history->entries.address + history->size) {
+                return TIEFILE_INVALID;
+        }
+
+        // the objects of the entry are replayed before it, and nothing is
+        // changed in place after it
+        store->edit = max(store->edit, record->edit);
+        object_store_begin(store);
+        if (object_store_loaded(store, reallocator, user)) {
+                return TIEFILE_NO_MEMORY;
+        }
+        if (object_store_check(store, record->entry.objects)) {
+                return TIEFILE_INVALID;
+        }
+        if (history_reserve(history,
+                            history->size + 1,
+                            history->tree_size,
+                            reallocator,
+                            user)) {
+                return TIEFILE_NO_MEMORY;
+        }
+
+        linear = history->tree.address + record->linear;
+        history->current_entry = history->size;
+        history->entries.address[history->size++] = record->entry;
+        ++linear->size;
+
+        return TIEFILE_OK;
+}
+
+// Appends the items of a record to an array of the store. Items that the
+// store holds already, because the file was saved after they were set but
+// before they were recorded, are skipped. Generations go with the objects
+// recorded before them.
+static TieFileStatus journal_replay_items(ObjectStore *restrict store,
+                                          const JournalRecord *record,
+                                          const unsigned char *payload,
+                                          Reallocator *reallocator,
+                                          void *user)
+{
+        uint64_t held, end, limit = UINT32_MAX, skip, n;
+        uint64_t nodes, objects, links;
+        JournalItems items;
+        unsigned char *array;
+        size_t size;
+
+        switch (record->type) {
+        case JOURNAL_NODES:
+                held = store->node_count;
+                end = held;
+                size = sizeof(ObjectStoreNode);
+                break;
+        case JOURNAL_OBJECTS:
+                held = store->object_count;
+                end = held;
+                size = sizeof(Object);
+                break;
+        case JOURNAL_GENERATIONS:
+                held = store->loaded_objects;
+                end = store->object_count;
+                size = sizeof(uint32_t);
+                break;
+        default:
+                held = store->link_count;
+                end = held;
+                size = sizeof(ObjectID);
+                limit = UINT64_MAX;
+                break;
+        }
+        if (record->size < sizeof(items)
+            || (record->size - sizeof(items)) % size != 0) {
+                return TIEFILE_INVALID;
+        }
+        memcpy(&items, payload, sizeof(items));
+        payload += sizeof(items);
+        if (items.count != (record->size - sizeof(items)) / size
+            || items.first > end || items.count > limit - items.first
+            || (record->type == JOURNAL_GENERATIONS
+                && items.first + items.count > end)) {
+                return TIEFILE_INVALID;
+        }
+        if (items.first + items.count <= held) {
+                return TIEFILE_OK;
+        }
+
+        skip = items.first < held ? held - items.first : 0;
+        n = items.count - skip;
+        nodes = store->node_count;
+        objects = store->object_count;
+        links = store->link_count;
+        switch (record->type) {
+        case JOURNAL_NODES:
+                nodes += n;
+                break;
+        case JOURNAL_OBJECTS:
+                objects += n;
+                break;
+        case JOURNAL_GENERATIONS:
+                break;
+        default:
+                links += n;
+                break;
+        }
+        if (object_store_reserve(store,
+                                 nodes,
+                                 objects,
+                                 links,
+                                 reallocator,
+                                 user)) {
+                return TIEFILE_NO_MEMORY;
+        }
+
+        switch (record->type) {
+        case JOURNAL_NODES:
+                array = (unsigned char *)store->nodes;
+                break;
+        case JOURNAL_OBJECTS:
+                array = (unsigned char *)store->objects;
+                break;
+        case JOURNAL_GENERATIONS:
+                array = (unsigned char *)store->generations;
+                break;
+        default:
+                array = (unsigned char *)store->links;
+                break;
+        }
+        // copied with memcpy, since records are only aligned to 8 bytes
+        memcpy(array + (items.first + skip) * size,
+               payload + skip * size,
+               n * size);
+        store->node_count = nodes;
+        store->object_count = objects;
+        store->link_count = links;
+
+        return TIEFILE_OK;
+}
+
+static TieFileStatus journal_replay_tree(History *restrict history,
+                                         const JournalTree *record,
+                                         Reallocator *reallocator,
+                                         void *user)
+{
+        const LinearHistory *last;
+        LinearHistory *linear;
+        uint64_t first = record->node.entries.offset, end = 0;
+        uint32_t parent = record->node.parent;
+
+        if (history->tree_size > 0) {
+                last = history->tree.address + history->tree_size - 1;
+                end = last->entries.address - history->entries.address
+                    + last->size;
+        }
+        if (record->linear != history->tree_size
+            || record->linear == MAX_LINEAR_HISTORIES
+            || (parent >= record->linear
+                && (record->linear != 0 || parent != 0))
+            || (record->linear != 0
+                && record->node.offset > history->tree.address[parent].size)
+            || first < end || first > history->size
+            || record->node.size > history->size - first) {
+                return TIEFILE_INVALID;
+        }
+        if (history_reserve(history,
+                            history->size,
+                            record->linear + 1,
+                            reallocator,
+                            user)) {
+                return TIEFILE_NO_MEMORY;
+        }
+
+        linear = history->tree.address + record->linear;
+        *linear = record->node;
+        linear->entries.address = history->entries.address + first;
+        ++history->tree_size;
+
+        return TIEFILE_OK;
+}
+
+// Checks what can only be checked once every record is replayed, including
+// the version of the current entry, which may come from the file.
+static bool journal_replayed_valid(const History *restrict history,
+                                   ObjectStore *restrict store)
+{
+        return history->size == 0
+            || (history->current_entry < history->size
+                && !object_store_check(
+                        store,
+                        history->entries.address[history->current_entry]
+                                .objects));
+}
+
+// Replays the records of a mapped journal but for the first `skip`, which
+// the file already holds, and returns the length of the part of the journal
+// that is intact in `end`, and the amount of records in it in `records`.
+static TieFileStatus journal_replay(const unsigned char *base,
+                                    size_t size,
+                                    uint64_t skip,
+                                    size_t *restrict end,
+                                    uint64_t *restrict records,
+                                    History *restrict history,
+                                    ObjectStore *restrict store,
+                                    Reallocator *reallocator,
+                                    void *user)
+{
+        union {
+                JournalEntry entry;
+                JournalTree tree;
+                JournalCurrent current;
+        } fixed;
+        size_t offset = sizeof(JournalHeader);
+        TieFileStatus status = TIEFILE_OK;
+        const unsigned char *payload;
+        JournalRecord record;
+        uint64_t count = 0;
+
+        while (status == TIEFILE_OK && size - offset >= sizeof(record)) {
+                memcpy(&record, base + offset, sizeof(record));
+                payload = base + offset + sizeof(record);
+                if (record.size > size - offset - sizeof(record)
+                    || journal_checksum(&record, payload, record.size, NULL)
+                               != record.checksum) {
+                        break;
+                }
+
+                offset += sizeof(record) + record.size;
+                // records that the file already holds are only checked
+                if (count++ < skip) {
+                        continue;
+                }
+
+                // copied out, since records are only aligned to 8 bytes
+                if (record.size <= sizeof(fixed)) {
+                        memcpy(&fixed, payload, record.size);
+                }
+                if (record.type == JOURNAL_ENTRY
+                    && record.size == sizeof(JournalEntry)) {
+                        status = journal_replay_entry(history,
+                                                      store,
+                                                      &fixed.entry,
+                                                      reallocator,
+                                                      user);
+                } else if (record.type == JOURNAL_TREE
+                           && record.size == sizeof(JournalTree)) {
+                        status = journal_replay_tree(
+                                history, &fixed.tree, reallocator, user);
+                } else if (record.type == JOURNAL_CURRENT
+                           && record.size == sizeof(JournalCurrent)) {
+                        history->current_entry = fixed.current.current_entry;
+                } else if (record.type == JOURNAL_NODES
+                           || record.type == JOURNAL_OBJECTS
+                           || record.type == JOURNAL_GENERATIONS
+                           || record.type == JOURNAL_LINKS) {
+                        status = journal_replay_items(
+                                store, &record, payload, reallocator, user);
+                } else {
+                        status = TIEFILE_INVALID;
+                }
+        }
+        *end = offset;
+        *records = count;
+
+        if (status == TIEFILE_OK && !journal_replayed_valid(history, store)) {
+                return TIEFILE_INVALID;
+        }
+
+        return status;
+}
+
+TieFileStatus journal_open(Journal *restrict journal,
+                           const char *restrict path,
+                           uint32_t group,
+                           JournalPosition position,
+                           History *restrict history,
+                           ObjectStore *restrict store,
+                           Reallocator *reallocator,
+                           void *user)
+{
+        size_t length = strlen(path) + 1;
+        const JournalHeader *header;
+        TieFileStatus status;
+        struct stat st;
+        void *base;
+        uint64_t skip = 0, records = 0;
+        size_t end;
+
+        assert(group > 0);
+
+        journal->path = tie_malloc(length, 1);
+        if (!journal->path) {
+                return TIEFILE_NO_MEMORY;
+        }
+        memcpy(journal->path, path, length);
+        if (mtx_init(&journal->lock, mtx_plain) != thrd_success) {
+                tie_free(journal->path);
+                return TIEFILE_NO_MEMORY;
+        }
+        journal->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (journal->fd < 0) {
+                mtx_destroy(&journal->lock);
+                tie_free(journal->path);
+                return TIEFILE_IO_ERROR;
+        }
+        journal->group = group;
+        journal->pending = 0;
+        journal->generation = 0;
+        journal->records = 0;
+        journal->base = position;
+        journal->saved = position;
+        journal->mark = position;
+        journal->mark_offset = 0;
+        journal->buffered = 0;
+        if (fstat(journal->fd, &st)) {
+                status = TIEFILE_IO_ERROR;
+                goto done;
+        }
+        // a crash while starting the journal may leave it empty
+        if ((size_t)st.st_size < sizeof(*header)) {
+                status = journal_reset(journal, position);
+                goto done;
+        }
+
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, journal->fd, 0);
+        if (base == MAP_FAILED) {
+                status = TIEFILE_IO_ERROR;
+                goto done;
+        }
+        header = base;
+        end = st.st_size;
+        if (header->magic_byte != JOURNAL_MAGIC_BYTE
+            || memcmp(header->journal_string, JOURNAL_STRING, 3)) {
+                status = TIEFILE_INVALID;
+        } else if (header->major != JOURNAL_MAJOR) {
+                status = TIEFILE_UNSUPPORTED;
+        } else {
+                journal->generation = header->generation;
+                if (header->generation == position.generation) {
+                        // the file was saved during this generation
+                        skip = position.records;
+                } else if (header->base.generation != position.generation
+                           || header->base.records != position.records) {
+                        // the file was saved past this journal otherwise
+                        skip = UINT64_MAX;
+                }
+                status = journal_replay(base,
+                                        st.st_size,
+                                        skip,
+                                        &end,
+                                        &records,
+                                        history,
+                                        store,
+                                        reallocator,
+                                        user);
+                journal->base = header->base;
+                journal->records = records;
+        }
+        munmap(base, st.st_size);
+        if (status != TIEFILE_OK) {
+                goto done;
+        }
+        journal->nodes = store->node_count;
+        journal->objects = store->object_count;
+        journal->links = store->link_count;
+
+        if (records <= skip) {
+                // nothing that the file doesn't hold
+                status = journal_reset(journal, position);
+        } else if (end < (size_t)st.st_size
+                   && (ftruncate(journal->fd, end) || fdatasync(journal->fd))) {
+                status = TIEFILE_IO_ERROR;
+        }
+
+done:
+        if (status != TIEFILE_OK) {
+                close(journal->fd);
+                mtx_destroy(&journal->lock);
+                tie_free(journal->path);
+        }
+
+        return status;
+}
+
+TieFileStatus journal_close(Journal *restrict journal)
+{
+        TieFileStatus status = journal_commit(journal);
+
+        close(journal->fd);
+        mtx_destroy(&journal->lock);
+        tie_free(journal->path);
+
+        return status;
+}
+
+// Records the items of an array of the store from `first` up to `count`, in
+// as many records as they take.
+static TieFileStatus journal_append_items(Journal *restrict journal,
+                                          JournalRecordType type,
+                                          const void *array,
+                                          size_t size,
+                                          uint64_t first,
+                                          uint64_t count)
+{
+        uint64_t chunk = (JOURNAL_BUFFER_SIZE - sizeof(JournalRecord)
+                          - sizeof(JournalItems))
+                       / size;
+        JournalItems items;
+        TieFileStatus status;
+
+        for (items.first = first; items.first < count;
+             items.first += items.count) {
+                items.count = min(count - items.first, chunk);
+                status = journal_push(journal,
+                                      type,
+                                      &items,
+                                      sizeof(items),
+                                      (const unsigned char *)array
+                                              + items.first * size,
+                                      items.count * size);
+                if (status != TIEFILE_OK) {
+                        return status;
+                }
+        }
+
+        return TIEFILE_OK;
+}
+
+TieFileStatus journal_append_entry(Journal *restrict journal,
+                                   uint32_t linear,
+                                   const HistoryEntry *restrict entry,
+                                   ObjectStore *restrict store)
+{
+        JournalEntry record;
+        TieFileStatus status;
+
+        // what the entry added to the store comes first, so that it's
+        // there when the entry is replayed
+        status = journal_append_items(journal,
+                                      JOURNAL_NODES,
+                                      store->nodes,
+                                      sizeof(*store->nodes),
+                                      journal->nodes,
+                                      store->node_count);
+        if (status == TIEFILE_OK) {
+                status = journal_append_items(journal,
+                                              JOURNAL_OBJECTS,
+                                              store->objects,
+                                              sizeof(*store->objects),
+                                              journal->objects,
+                                              store->object_count);
+        }
+        if (status == TIEFILE_OK) {
+                status = journal_append_items(journal,
+                                              JOURNAL_GENERATIONS,
+                                              store->generations,
+                                              sizeof(*store->generations),
+                                              journal->objects,
+                                              store->object_count);
+        }
+        if (status == TIEFILE_OK) {
+                status = journal_append_items(journal,
+                                              JOURNAL_LINKS,
+                                              store->links,
+                                              sizeof(*store->links),
+                                              journal->links,
+                                              store->link_count);
+        }
+        if (status != TIEFILE_OK) {
+                return status;
+        }
+        journal->nodes = store->node_count;
+        journal->objects = store->object_count;
+        journal->links = store->link_count;
+
+        // zeroed so that the checksum doesn't depend on padding
+        memset(&record, 0, sizeof(record));
+        record.linear = linear;
+        record.edit = store->edit;
+        record.entry.cursor_position = entry->cursor_position;
+        record.entry.objects = entry->objects;
+        record.entry.selection_stack = entry->selection_stack;
+        // what was recorded must not change in place
+        object_store_begin(store);
+
+        return journal_push(journal,
+                            JOURNAL_ENTRY,
+                            &record,
+                            sizeof(record),
+                            NULL,
+                            0);
+}
+
+TieFileStatus journal_append_tree(Journal *restrict journal,
+                                  const History *restrict history,
+                                  uint32_t linear)
+{
+        const LinearHistory *node = history->tree.address + linear;
+        JournalTree record;
+
+        assert(linear < history->tree_size);
+        memset(&record, 0, sizeof(record));
+        record.linear = linear;
+        record.node.size = node->size;
+        record.node.entries.offset =
+                node->entries.address - history->entries.address;
+        record.node.offset = node->offset;
+        record.node.parent = node->parent;
+
+        return journal_push(journal,
+                            JOURNAL_TREE,
+                            &record,
+                            sizeof(record),
+                            NULL,
+                            0);
+}
+
+TieFileStatus journal_append_current(Journal *restrict journal,
+                                     uint64_t current_entry)
+{
+        JournalCurrent record = { .current_entry = current_entry };
+
+        return journal_push(journal,
+                            JOURNAL_CURRENT,
+                            &record,
+                            sizeof(record),
+                            NULL,
+                            0);
+}
+
+TieFileStatus journal_commit(Journal *restrict journal)
+{
+        TieFileStatus status;
+
+        mtx_lock(&journal->lock);
+        status = journal_commit_locked(journal);
+        mtx_unlock(&journal->lock);
+
+        return status;
+}
+
+TieFileStatus journal_mark(Journal *restrict journal,
+                           JournalPosition *restrict pposition)
+{
+        TieFileStatus status;
+        off_t end;
+
+        mtx_lock(&journal->lock);
+        status = journal_commit_locked(journal);
+        if (status == TIEFILE_OK) {
+                end = lseek(journal->fd, 0, SEEK_END);
+                if (end < 0) {
+                        status = TIEFILE_IO_ERROR;
+                } else {
+                        journal->mark.generation = journal->generation;
+                        journal->mark.records = journal->records;
+                        journal->mark_offset = end;
+                        *pposition = journal->mark;
+                }
+        }
+        mtx_unlock(&journal->lock);
+
+        return status;
+}
+
+PURE_FUNC static inline bool journal_later(JournalPosition a,
+                                           JournalPosition b)
+{
+        return a.generation > b.generation
+            || (a.generation == b.generation && a.records > b.records);
+}
+
+// Starts a new generation from the mark, keeping the records after it. The
+// new journal is written next to the old one and renamed over it, so that
+// either one is found after a crash; both agree with the file at the mark.
+// Failing leaves the journal as it was. The lock must be held, and every
+// record committed up to the mark.
+static void journal_rebase(Journal *restrict journal)
+{
+        size_t length = strlen(journal->path);
+        unsigned char chunk[4096];
+        JournalHeader header;
+        char *temporary;
+        off_t offset = journal->mark_offset;
+        ssize_t got;
+        bool ok;
+        int fd;
+
+        temporary = tie_malloc(length + sizeof(".tmp"), 1);
+        if (!temporary) {
+                return;
+        }
+        memcpy(temporary, journal->path, length);
+        memcpy(temporary + length, ".tmp", sizeof(".tmp"));
+        fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (fd < 0) {
+                tie_free(temporary);
+                return;
+        }
+
+        journal_header(&header, journal->generation + 1, journal->mark);
+        ok = journal_write_all(fd,
+                               (const unsigned char *)&header,
+                               sizeof(header));
+        while (ok) {
+                got = pread(journal->fd, chunk, sizeof(chunk), offset);
+                if (got < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (got <= 0) {
+                        ok = got == 0;
+                        break;
+                }
+                ok = journal_write_all(fd, chunk, got);
+                offset += got;
+        }
+        ok = ok && !fdatasync(fd) && !rename(temporary, journal->path);
+        if (!ok) {
+                close(fd);
+                remove(temporary);
+                tie_free(temporary);
+                return;
+        }
+        tie_free(temporary);
+
+        close(journal->fd);
+        journal->fd = fd;
+        journal->generation = header.generation;
+        journal->records -= journal->mark.records;
+        journal->base = journal->mark;
+}
+
+TieFileStatus journal_replace(Journal *restrict journal,
+                              const char *restrict temporary,
+                              const char *restrict path)
+{
+        TieFileStatus status = TIEFILE_OK;
+
+        mtx_lock(&journal->lock);
+        if (!journal_later(journal->mark, journal->saved)) {
+                remove(temporary);
+        } else {
+                status = tiefile_replace(temporary, path);
+                if (status == TIEFILE_OK || status == TIEFILE_NOT_DURABLE) {
+                        journal->saved = journal->mark;
+                }
+                // until the rename is durable, the journal must hold every
+                // record
+                if (status == TIEFILE_OK
+                    && journal->generation == journal->mark.generation) {
+                        journal_rebase(journal);
+                }
+        }
+        mtx_unlock(&journal->lock);
+
+        return status;
+}
+
+TieFileStatus journal_checkpoint(Journal *restrict journal,
+                                 const char *restrict path,
+                                 const History *restrict history,
+                                 const ObjectStore *restrict store)
+{
+        JournalPosition position;
+        TieFileStatus status;
+
+        mtx_lock(&journal->lock);
+        // until the file is replaced, the journal must hold every change
+        status = journal_commit_locked(journal);
+        if (status == TIEFILE_OK) {
+                position.generation = journal->generation;
+                position.records = journal->records;
+                status = tiefile_save(path, history, store, &position, NULL);
+                if (status == TIEFILE_OK || status == TIEFILE_NOT_DURABLE) {
+                        journal->saved = position;
+                }
+                if (status == TIEFILE_OK) {
+                        status = journal_reset(journal, position);
+                }
+        }
+        mtx_unlock(&journal->lock);
+
+        return status;
+}
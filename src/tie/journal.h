@@ -0,0 +1,211 @@
+/*! \file journal.h
+ *  \brief Append-only journal of history changes
+ *
+ *  Saving a document rewrites its whole .tie file, which takes time
+ *  proportional to the history. A journal next to the file instead records
+ *  each change to the history as it happens, so that saving only costs as
+ *  much as the changes since the last save: new entries along with the
+ *  nodes, objects and links they added to the object store (see
+ *  objectstore.h), linear histories that are created when branching, and
+ *  moves of the current entry. Records
+ *  are collected in a buffer and committed in groups, with one write and
+ *  one sync per group, which amortizes the cost of syncing over many edits.
+ *  A checkpoint rewrites the .tie file with tiefile_save() and empties the
+ *  journal.
+ *
+ *  Every record is checksummed. When a journal is opened its records are
+ *  replayed onto the history of the file, up to the first record that was
+ *  torn by a crash, which is cut off along with everything after it. The
+ *  versions of replayed entries are checked like those of a file (see
+ *  object_store_check()).
+ *
+ *  Records are numbered within generations of the journal, each of which
+ *  starts when the journal is emptied, and .tie files remember how many
+ *  records of which generation they hold (see #JournalPosition). Opening a
+ *  journal only replays the records that its file doesn't hold yet, so a
+ *  file saved before the journal could be emptied, or while records kept
+ *  being added, e.g. in the background by an autosave (see autosave.h),
+ *  loses nothing and gets nothing twice.
+ *
+ *  A journal may be used by the thread of an autosave while the editor
+ *  adds records; its functions take a lock for that, which also keeps
+ *  checkpoints and background saves from replacing the file at once.
+ *
+ *  Journals are stored in the byte order of the machine that wrote them.
+ */
+#ifndef TIE_JOURNAL_H
+#define TIE_JOURNAL_H
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include "algo.h"
+#include "core.h"
+#include "objectstore.h"
+#include "tiefile.h"
+
+#define JOURNAL_MAGIC_BYTE 0x83
+#define JOURNAL_STRING "TIJ"
+#define JOURNAL_MAJOR 2
+#define JOURNAL_MINOR 0
+// Records are buffered up to this many bytes before being written.
+#define JOURNAL_BUFFER_SIZE (1 << 16)
+
+typedef struct {
+        int fd;
+        char *path;
+        mtx_t lock;
+        uint32_t group; // records per sync
+        uint32_t pending; // records since the last sync
+        uint64_t generation;
+        uint64_t records; // in the generation, including buffered ones
+        JournalPosition base; // of the file the generation started from
+        JournalPosition saved; // of the last file saved at the .tie path
+        // Set by journal_mark(), with the length of the journal there.
+        JournalPosition mark;
+        uint64_t mark_offset;
+        // Counts of the object store up to which it was recorded.
+        uint32_t nodes;
+        uint32_t objects;
+        uint64_t links;
+        size_t buffered; // bytes in the buffer
+        alignas(16) unsigned char buffer[JOURNAL_BUFFER_SIZE];
+} Journal;
+
+/*! \brief Opens or creates a journal and replays it.
+ *
+ *  \param[out] journal The journal, to be closed with journal_close().
+ *  \param[in] path The path of the journal.
+ *  \param[in] group The amount of records to commit at once, at least 1.
+ *  Records are also committed by journal_commit(), e.g. once per frame.
+ *  \param[in] position The position of the .tie file in the journal, from
+ *  its header, or zeros for a new document.
+ *  \param[in,out] history The history of the .tie file the journal belongs
+ *  to, in memory (see history.h). Receives the changes recorded in the
+ *  journal.
+ *  \param[in,out] store The object store of the history, which receives
+ *  the nodes, objects and links recorded in the journal.
+ *  \param[in] reallocator Reallocator for the history and the store, e.g.
+ *  history_pager_reallocator() for those loaded by tiefile_load(). See
+ *  history_reserve().
+ *  \param[in,out] user See history_reserve().
+ *
+ *  \return #TIEFILE_OK on success, an error otherwise. The history and the
+ *  store may have been partially replayed onto when the journal is found
+ *  corrupt past its checksums.
+ */
+extern TieFileStatus journal_open(Journal *restrict journal,
+                                  const char *restrict path,
+                                  uint32_t group,
+                                  JournalPosition position,
+                                  History *restrict history,
+                                  ObjectStore *restrict store,
+                                  Reallocator *reallocator,
+                                  void *user);
+
+/*! \brief Closes a journal, committing its pending records.
+ *
+ *  \return #TIEFILE_OK on success, #TIEFILE_IO_ERROR if the pending records
+ *  couldn't be committed. The journal is closed either way.
+ */
+extern TieFileStatus journal_close(Journal *restrict journal);
+
+/*! \brief Records an entry appended to a linear history, along with the
+ *  version of its objects.
+ *
+ *  The linear history must end at the end of the entries of the history.
+ *  The entry becomes the current one. The nodes, objects and links added to
+ *  the store since the last entry was recorded are recorded before it, and
+ *  an edit begins in the store, so that they aren't changed in place
+ *  afterwards.
+ *
+ *  \param[in,out] journal The journal.
+ *  \param[in] linear The number of the linear history.
+ *  \param[in] entry The entry.
+ *  \param[in,out] store The object store of the history.
+ *
+ *  \return #TIEFILE_OK on success, #TIEFILE_IO_ERROR on failure to commit
+ *  a group.
+ */
+extern TieFileStatus journal_append_entry(Journal *restrict journal,
+                                          uint32_t linear,
+                                          const HistoryEntry *restrict entry,
+                                          ObjectStore *restrict store);
+
+/*! \brief Records a linear history that was created by branching.
+ *
+ *  Linear histories must be recorded in their order, before their entries.
+ *
+ *  \param[in,out] journal The journal.
+ *  \param[in] history The history, in memory.
+ *  \param[in] linear The number of the linear history, the last one.
+ *
+ *  \return See journal_append_entry().
+ */
+extern TieFileStatus journal_append_tree(Journal *restrict journal,
+                                         const History *restrict history,
+                                         uint32_t linear);
+
+/*! \brief Records a move of the current entry, e.g. by undo or redo.
+ *
+ *  \return See journal_append_entry().
+ */
+extern TieFileStatus journal_append_current(Journal *restrict journal,
+                                            uint64_t current_entry);
+
+/*! \brief Writes the buffered records and syncs them to disk.
+ *
+ *  \return #TIEFILE_OK on success, #TIEFILE_IO_ERROR otherwise.
+ */
+extern TieFileStatus journal_commit(Journal *restrict journal);
+
+/*! \brief Commits the records and marks the position they end at, for a
+ *  save of the history at that point.
+ *
+ *  \param[in,out] journal The journal.
+ *  \param[out] pposition The position, to be saved in the .tie file.
+ *
+ *  \return See journal_commit().
+ */
+extern TieFileStatus journal_mark(Journal *restrict journal,
+                                  JournalPosition *restrict pposition);
+
+/*! \brief Replaces the .tie file with one saved at the mark, and drops the
+ *  records that it holds from the journal.
+ *
+ *  Nothing is replaced if a file at a later position was saved since the
+ *  mark, e.g. by a checkpoint, and the temporary file is removed instead.
+ *  The journal keeps the records if dropping them fails, which the file
+ *  then skips when the journal is opened.
+ *
+ *  \param[in,out] journal The journal.
+ *  \param[in] temporary A file written by tiefile_write_temporary() with
+ *  the history and the position of the mark.
+ *  \param[in] path The path of the .tie file.
+ *
+ *  \return See tiefile_replace().
+ */
+extern TieFileStatus journal_replace(Journal *restrict journal,
+                                     const char *restrict temporary,
+                                     const char *restrict path);
+
+/*! \brief Rewrites a .tie file with a history and empties the journal.
+ *
+ *  \param[in,out] journal The journal.
+ *  \param[in] path The path of the .tie file.
+ *  \param[in] history The history, in memory, including every change that
+ *  was recorded.
+ *  \param[in] store The object store of the history.
+ *
+ *  \return #TIEFILE_OK on success, an error of journal_commit() or
+ *  tiefile_save() otherwise, in which case the journal still holds the
+ *  changes. That includes #TIEFILE_NOT_DURABLE, since the old file may come
+ *  back after a crash.
+ */
+extern TieFileStatus journal_checkpoint(Journal *restrict journal,
+                                        const char *restrict path,
+                                        const History *restrict history,
+                                        const ObjectStore *restrict store);
+
+#endif
@@ -2,6 +2,7 @@
 #define TIE_MATH_H
 
 #include <assert.h>
+#include <float.h>
 #include <math.h>
 #include <stdalign.h>
 #include <stdbool.h>
@@ -25,6 +26,11 @@ typedef union {
         vec2d cols[2];
 } mat2d;
 
+typedef struct {
+        vec2d min;
+        vec2d max;
+} aabb2d;
+
 #define scalev_decl(vtype, name, op)                                           \
         static inline void name##_##vtype(vtype *restrict out, double s)       \
         {                                                                      \
@@ -117,4 +123,85 @@ static inline double cross_vec2d(const vec2d *restrict a,
         return vec_x(*a) * vec_y(*b) - vec_x(*b) * vec_y(*a);
 }
 
+// An empty box is inverted, so that extending or joining it with anything
+// yields the other operand. DBL_MAX is used instead of infinities since we
+// compile with -ffast-math.
+static inline void empty_aabb2d(aabb2d *restrict box)
+{
+        box->min = (vec2d)make_vec2d(DBL_MAX, DBL_MAX);
+        box->max = (vec2d)make_vec2d(-DBL_MAX, -DBL_MAX);
+}
+
+static inline void extend_aabb2d(aabb2d *restrict box, const vec2d *restrict p)
+{
+        vec_x(box->min) = fmin(vec_x(box->min), vec_x(*p));
+        vec_y(box->min) = fmin(vec_y(box->min), vec_y(*p));
+        vec_x(box->max) = fmax(vec_x(box->max), vec_x(*p));
+        vec_y(box->max) = fmax(vec_y(box->max), vec_y(*p));
+}
+
+static inline void union_aabb2d(aabb2d *restrict acc,
+                                const aabb2d *restrict box)
+{
+        vec_x(acc->min) = fmin(vec_x(acc->min), vec_x(box->min));
+        vec_y(acc->min) = fmin(vec_y(acc->min), vec_y(box->min));
+        vec_x(acc->max) = fmax(vec_x(acc->max), vec_x(box->max));
+        vec_y(acc->max) = fmax(vec_y(acc->max), vec_y(box->max));
+}
+
+PURE_FUNC static inline bool overlaps_aabb2d(const aabb2d *a, const aabb2d *b)
+{
+        return vec_x(a->min) <= vec_x(b->max) && vec_x(b->min) <= vec_x(a->max)
+            && vec_y(a->min) <= vec_y(b->max) && vec_y(b->min) <= vec_y(a->max);
+}
+
+PURE_FUNC static inline bool contains_aabb2d(const aabb2d *outer,
+                                             const aabb2d *inner)
+{
+        return vec_x(outer->min) <= vec_x(inner->min)
+            && vec_y(outer->min) <= vec_y(inner->min)
+            && vec_x(inner->max) <= vec_x(outer->max)
+            && vec_y(inner->max) <= vec_y(outer->max);
+}
+
+PURE_FUNC static inline double area_aabb2d(const aabb2d *box)
+{
+        return (vec_x(box->max) - vec_x(box->min))
+             * (vec_y(box->max) - vec_y(box->min));
+}
+
+// Half of the perimeter.
+PURE_FUNC static inline double margin_aabb2d(const aabb2d *box)
+{
+        return (vec_x(box->max) - vec_x(box->min))
+             + (vec_y(box->max) - vec_y(box->min));
+}
+
+PURE_FUNC static inline double overlap_aabb2d(const aabb2d *a,
+                                              const aabb2d *b)
+{
+        double w, h;
+
+        w = fmin(vec_x(a->max), vec_x(b->max))
+          - fmax(vec_x(a->min), vec_x(b->min));
+        h = fmin(vec_y(a->max), vec_y(b->max))
+          - fmax(vec_y(a->min), vec_y(b->min));
+
+        return w > 0 && h > 0 ? w * h : 0;
+}
+
+// Squared distance from p to the closest point of the box; zero inside.
+PURE_FUNC static inline double sqrdist_aabb2d(const aabb2d *restrict box,
+                                              const vec2d *restrict p)
+{
+        double dx, dy;
+
+        dx = fmax(fmax(vec_x(box->min) - vec_x(*p), 0),
+                  vec_x(*p) - vec_x(box->max));
+        dy = fmax(fmax(vec_y(box->min) - vec_y(*p), 0),
+                  vec_y(*p) - vec_y(box->max));
+
+        return dx * dx + dy * dy;
+}
+
 #endif
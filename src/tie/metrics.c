@@ -0,0 +1,244 @@
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "attrib.h"
+#include "math.h"
+#include "metrics.h"
+
+// The sums every edge contributes to, in terms of the signed area.
+enum {
+        METRICS_AREA, // 2 A
+        METRICS_X, // 6 A cx
+        METRICS_Y, // 6 A cy
+        METRICS_YY, // 12 times the integral of y²
+        METRICS_XX, // 12 times the integral of x²
+        METRICS_XY, // 24 times the integral of xy
+        METRICS_PERIMETER,
+        METRICS_SUMS
+};
+
+// Compensated sums, one for each of the above.
+typedef struct {
+        double sum[METRICS_SUMS];
+        double error[METRICS_SUMS];
+} MetricsSums;
+
+// Adds x to a sum, accumulating the rounding error of the addition, which
+// Knuth's two-sum recovers exactly.
+static inline void metrics_add(double *restrict sum,
+                               double *restrict error,
+                               double x)
+{
+        double t = *sum + x, z = t - *sum;
+
+        *error += (*sum - (t - z)) + (x - z);
+        *sum = t;
+}
+
+// Adds the terms of the edge from (x0, y0) to (x1, y1), both relative to the
+// first vertex.
+static void metrics_add_edge(MetricsSums *restrict sums,
+                             double x0,
+                             double y0,
+                             double x1,
+                             double y1)
+{
+        const double cross = x0 * y1 - x1 * y0;
+        const double terms[METRICS_SUMS] = {
+                [METRICS_AREA] = cross,
+                [METRICS_X] = (x0 + x1) * cross,
+                [METRICS_Y] = (y0 + y1) * cross,
+                [METRICS_YY] = (y0 * y0 + y0 * y1 + y1 * y1) * cross,
+                [METRICS_XX] = (x0 * x0 + x0 * x1 + x1 * x1) * cross,
+                [METRICS_XY] =
+                        (x0 * y1 + 2 * x0 * y0 + 2 * x1 * y1 + x1 * y0) * cross,
+                [METRICS_PERIMETER] = hypot(x1 - x0, y1 - y0),
+        };
+        size_t i;
+
+        for (i = 0; i < METRICS_SUMS; ++i) {
+                metrics_add(&sums->sum[i], &sums->error[i], terms[i]);
+        }
+}
+
+#if defined(__SSE2__)
+static inline void metrics_add_sse2(__m128d *restrict sum,
+                                    __m128d *restrict error,
+                                    __m128d x)
+{
+        __m128d t = _mm_add_pd(*sum, x), z = _mm_sub_pd(t, *sum);
+
+        *error = _mm_add_pd(*error,
+                            _mm_add_pd(_mm_sub_pd(*sum, _mm_sub_pd(t, z)),
+                                       _mm_sub_pd(x, z)));
+        *sum = t;
+}
+#endif
+
+// Sums up the edges of a polygon of n > 1 vertices.
+static void metrics_sum(size_t n,
+                        const vec2d polygon[static restrict n],
+                        MetricsSums *restrict sums)
+{
+        const double rx = vec_x(polygon[0]), ry = vec_y(polygon[0]);
+        size_t i = 0, k;
+
+        for (k = 0; k < METRICS_SUMS; ++k) {
+                sums->sum[k] = 0;
+                sums->error[k] = 0;
+        }
+
+#if defined(__SSE2__)
+        // Edges i and i + 1 in the two lanes, with separate sums per lane
+        // that are merged at the end.
+        const __m128d vrx = _mm_set1_pd(rx), vry = _mm_set1_pd(ry);
+        const __m128d two = _mm_set1_pd(2);
+        __m128d sum[METRICS_SUMS], error[METRICS_SUMS], terms[METRICS_SUMS];
+        __m128d p0, p1, p2, x0, y0, x1, y1, cross, dx, dy;
+        double lanes[2];
+
+        for (k = 0; k < METRICS_SUMS; ++k) {
+                sum[k] = _mm_setzero_pd();
+                error[k] = _mm_setzero_pd();
+        }
+        for (; i + 2 < n; i += 2) {
+                p0 = _mm_load_pd(polygon[i].v);
+                p1 = _mm_load_pd(polygon[i + 1].v);
+                p2 = _mm_load_pd(polygon[i + 2].v);
+                x0 = _mm_sub_pd(_mm_unpacklo_pd(p0, p1), vrx);
+                y0 = _mm_sub_pd(_mm_unpackhi_pd(p0, p1), vry);
+                x1 = _mm_sub_pd(_mm_unpacklo_pd(p1, p2), vrx);
+                y1 = _mm_sub_pd(_mm_unpackhi_pd(p1, p2), vry);
+                cross = _mm_sub_pd(_mm_mul_pd(x0, y1), _mm_mul_pd(x1, y0));
+                dx = _mm_sub_pd(x1, x0);
+                dy = _mm_sub_pd(y1, y0);
+
+                terms[METRICS_AREA] = cross;
+                terms[METRICS_X] = _mm_mul_pd(_mm_add_pd(x0, x1), cross);
+                terms[METRICS_Y] = _mm_mul_pd(_mm_add_pd(y0, y1), cross);
+                terms[METRICS_YY] = _mm_mul_pd(
+                        _mm_add_pd(_mm_add_pd(_mm_mul_pd(y0, y0),
+                                              _mm_mul_pd(y0, y1)),
+                                   _mm_mul_pd(y1, y1)),
+                        cross);
+                terms[METRICS_XX] = _mm_mul_pd(
+                        _mm_add_pd(_mm_add_pd(_mm_mul_pd(x0, x0),
+                                              _mm_mul_pd(x0, x1)),
+                                   _mm_mul_pd(x1, x1)),
+                        cross);
+                terms[METRICS_XY] = _mm_mul_pd(
+                        _mm_add_pd(
+                                _mm_add_pd(_mm_mul_pd(x0, y1),
+                                           _mm_mul_pd(x1, y0)),
+                                _mm_mul_pd(two,
+                                           _mm_add_pd(_mm_mul_pd(x0, y0),
+                                                      _mm_mul_pd(x1, y1)))),
+                        cross);
+                terms[METRICS_PERIMETER] = _mm_sqrt_pd(
+                        _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+
+                for (k = 0; k < METRICS_SUMS; ++k) {
+                        metrics_add_sse2(&sum[k], &error[k], terms[k]);
+                }
+        }
+
+        for (k = 0; k < METRICS_SUMS; ++k) {
+                _mm_storeu_pd(lanes, sum[k]);
+                metrics_add(&sums->sum[k], &sums->error[k], lanes[0]);
+                metrics_add(&sums->sum[k], &sums->error[k], lanes[1]);
+                _mm_storeu_pd(lanes, error[k]);
+                sums->error[k] += lanes[0] + lanes[1];
+        }
+#endif
+
+        for (; i + 1 < n; ++i) {
+                metrics_add_edge(sums,
+                                 vec_x(polygon[i]) - rx,
+                                 vec_y(polygon[i]) - ry,
+                                 vec_x(polygon[i + 1]) - rx,
+                                 vec_y(polygon[i + 1]) - ry);
+        }
+        // the closing edge ends at the first vertex, i.e. at zero
+        metrics_add_edge(sums,
+                         vec_x(polygon[n - 1]) - rx,
+                         vec_y(polygon[n - 1]) - ry,
+                         0,
+                         0);
+}
+
+// Fills in the metrics of a polygon that encloses no area.
+static void metrics_degenerate(size_t n,
+                               const vec2d polygon[static restrict n],
+                               double perimeter,
+                               PolygonMetrics *restrict out)
+{
+        double x = 0, y = 0;
+        size_t i;
+
+        for (i = 0; i < n; ++i) {
+                x += vec_x(polygon[i]);
+                y += vec_y(polygon[i]);
+        }
+
+        out->area = 0;
+        out->perimeter = perimeter;
+        vec_x(out->centroid) = x / n;
+        vec_y(out->centroid) = y / n;
+        out->ixx = 0;
+        out->iyy = 0;
+        out->ixy = 0;
+}
+
+void polygon_metrics(size_t count,
+                     const size_t offsets[static restrict count + 1],
+                     const vec2d points[restrict],
+                     PolygonMetrics out[static restrict count])
+{
+        double total[METRICS_SUMS];
+        const vec2d *polygon;
+        MetricsSums sums;
+        double area, cx, cy, sign;
+        size_t i, k, n;
+
+        for (i = 0; i < count; ++i) {
+                polygon = &points[offsets[i]];
+                n = offsets[i + 1] - offsets[i];
+                assert(n > 0);
+
+                if (n == 1) {
+                        metrics_degenerate(n, polygon, 0, &out[i]);
+                        continue;
+                }
+
+                metrics_sum(n, polygon, &sums);
+                for (k = 0; k < METRICS_SUMS; ++k) {
+                        total[k] = sums.sum[k] + sums.error[k];
+                }
+
+                area = total[METRICS_AREA] / 2;
+                if (area == 0) {
+                        metrics_degenerate(n,
+                                           polygon,
+                                           total[METRICS_PERIMETER],
+                                           &out[i]);
+                        continue;
+                }
+
+                // relative to the first vertex, then moved to the centroid
+                // by the parallel axis theorem
+                cx = total[METRICS_X] / (6 * area);
+                cy = total[METRICS_Y] / (6 * area);
+                sign = area < 0 ? -1 : 1;
+
+                out[i].area = area;
+                out[i].perimeter = total[METRICS_PERIMETER];
+                vec_x(out[i].centroid) = vec_x(polygon[0]) + cx;
+                vec_y(out[i].centroid) = vec_y(polygon[0]) + cy;
+                out[i].ixx = sign * (total[METRICS_YY] / 12 - area * cy * cy);
+                out[i].iyy = sign * (total[METRICS_XX] / 12 - area * cx * cx);
+                out[i].ixy = sign * (total[METRICS_XY] / 24 - area * cx * cy);
+        }
+}
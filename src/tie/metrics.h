@@ -0,0 +1,61 @@
+/*! \file metrics.h
+ *  \brief Batched polygon metrics
+ *
+ *  Inspector panels and alignment tools need the area, centroid, moments
+ *  and perimeter of every selected shape. All of them are sums of terms of
+ *  the edges of a polygon, so they're computed together in a single pass
+ *  over its vertices, two edges at a time with SSE2 when available.
+ *
+ *  Large polygons far from the origin sum many terms that mostly cancel
+ *  out, so the sums are compensated: the rounding error of every addition
+ *  is recovered exactly and accumulated separately, which makes the result
+ *  about as accurate as if the sums were computed in twice the precision.
+ *  The terms themselves are computed relative to the first vertex of each
+ *  polygon. The implementation relies on IEEE 754 arithmetic and must not be
+ *  compiled with -ffast-math or similar flags.
+ */
+#ifndef TIE_METRICS_H
+#define TIE_METRICS_H
+
+#include <stddef.h>
+
+#include "attrib.h"
+#include "math.h"
+
+typedef struct {
+        double area; // signed like polygon_signed_area()
+        double perimeter;
+        // The center of mass of the enclosed region, or the average of the
+        // vertices if the polygon encloses no area.
+        vec2d centroid;
+        // Second moments of the enclosed region about its centroid: the
+        // integrals of y², x² and xy over it, relative to the centroid.
+        // They don't depend on the orientation of the polygon.
+        double ixx;
+        double iyy;
+        double ixy;
+} PolygonMetrics;
+
+/*! \brief Computes the metrics of many polygons.
+ *
+ *  The polygons are stored back to back: polygon `i` is
+ *  `points[offsets[i]]` through `points[offsets[i + 1] - 1]`, and its last
+ *  vertex is implicitly connected to its first. Every polygon must have at
+ *  least one vertex. Self-intersecting polygons count the regions they wind
+ *  around several times with their winding number. Runs in \f$O(n)\f$,
+ *  where \f$n\f$ is the total amount of vertices.
+ *
+ *  \param[in] count The amount of polygons.
+ *  \param[in] offsets Offsets of the polygons in `points`, followed by the
+ *  total amount of vertices.
+ *  \param[in] points The vertices of all polygons.
+ *  \param[out] out The metrics of each polygon.
+ *
+ *  \sa polygon_signed_area()
+ */
+extern void polygon_metrics(size_t count,
+                            const size_t offsets[static restrict count + 1],
+                            const vec2d points[restrict],
+                            PolygonMetrics out[static restrict count]);
+
+#endif
@@ -0,0 +1,415 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "objectstore.h"
+
+void object_store_init(ObjectStore *restrict store)
+{
+        memset(store, 0, sizeof(*store));
+}
+
+void object_store_begin(ObjectStore *restrict store)
+{
+        ++store->edit;
+        store->edit_objects = store->object_count;
+}
+
+int object_store_loaded(ObjectStore *restrict store,
+                        Reallocator *reallocator,
+                        void *user)
+{
+        size_t sz = store->checks_sz;
+        uint64_t *checks = store->checks;
+
+        if (store->node_count > sz
+            && !auxiliary_realloc(reallocator,
+                                  &sz,
+                                  &checks,
+                                  &store->checks_sz,
+                                  &store->checks,
+                                  store->node_count,
+                                  user)) {
+                return -1;
+        }
+        if (store->node_count > store->loaded_nodes) {
+                memset(store->checks + store->loaded_nodes,
+                       0,
+                       (store->node_count - store->loaded_nodes)
+                               * sizeof(*store->checks));
+        }
+        store->loaded_nodes = store->node_count;
+        store->loaded_objects = store->object_count;
+        store->loaded_links = store->link_count;
+
+        return 0;
+}
+
+// Checks that a loaded object has as many children as its type allows, and
+// that its links lie in the loaded links.
+static bool object_store_check_object(const ObjectStore *restrict store,
+                                      uint32_t object)
+{
+        const Object *o = &store->objects[object];
+        uint64_t links = (uint64_t)o->parent_count + o->child_count, first;
+        bool valid;
+
+        if (object >= store->loaded_objects) {
+                return false;
+        }
+        switch (o->type) {
+        case POINT:
+                valid = o->child_count == 0;
+                break;
+        case LINE:
+                valid = o->child_count == 2;
+                break;
+        case BEZIER:
+                valid = o->child_count > 0
+                     && o->child_count <= OBJECT_MAX_CONTROL_POINTS;
+                break;
+        case DELETED:
+                valid = links == 0;
+                break;
+        default:
+                valid = false;
+                break;
+        }
+        if (!valid || links == 0) {
+                return valid;
+        }
+
+        first = o->parents.offset / sizeof(ObjectID);
+        return o->parents.offset % sizeof(ObjectID) == 0
+            && o->children.offset
+                       == o->parents.offset
+                                  + (uint64_t)o->parent_count * sizeof(ObjectID)
+            && first <= store->loaded_links
+            && links <= store->loaded_links - first;
+}
+
+// What object_store_check_node() found out about a node: the level it was
+// reached at plus one in the low byte, and the amount of slots it fills.
+#define OBJECT_STORE_CHECK_LEVEL 0xff
+#define OBJECT_STORE_CHECK_INVALID UINT64_MAX
+
+// Checks a loaded node reached at a level above the leaves and everything
+// under it, and returns the amount of slots under it, from the first one,
+// that hold objects, or UINT64_MAX if it was reached at another level before
+// or refers to anything that wasn't loaded along with it.
+static uint64_t object_store_check_node(ObjectStore *restrict store,
+                                        uint32_t node,
+                                        uint32_t level)
+{
+        uint64_t filled = 0, child;
+        uint64_t width = (uint64_t)1 << (level * OBJECT_STORE_BITS);
+        const uint32_t *slot;
+        uint64_t *check;
+        bool gap = false;
+
+        if (node >= store->loaded_nodes) {
+                return UINT64_MAX;
+        }
+        check = &store->checks[node];
+        if (*check != 0) {
+                return (*check & OBJECT_STORE_CHECK_LEVEL) == level + 1
+                             ? *check >> 8
+                             : UINT64_MAX;
+        }
+        // nodes that could be changed in place would change other versions
+        if (store->nodes[node].edit >= store->edit) {
+                *check = OBJECT_STORE_CHECK_INVALID;
+                return UINT64_MAX;
+        }
+
+        traverse_array(slot, store->nodes[node].slots) {
+                if (*slot == OBJECT_STORE_NIL) {
+                        gap = true;
+                        continue;
+                }
+                if (level == 0) {
+                        child = object_store_check_object(store, *slot)
+                                      ? 1
+                                      : UINT64_MAX;
+                } else {
+                        // the level goes down on the way to the leaves, so
+                        // there's no cycle
+                        child = object_store_check_node(
+                                store, *slot, level - 1);
+                }
+                if (child == UINT64_MAX) {
+                        *check = OBJECT_STORE_CHECK_INVALID;
+                        return UINT64_MAX;
+                }
+                if (!gap) {
+                        filled += child;
+                        gap = child < width;
+                }
+        }
+        *check = filled << 8 | (level + 1);
+
+        return filled;
+}
+
+int object_store_check(ObjectStore *restrict store, ObjectVersion version)
+{
+        uint64_t filled;
+
+        if (version.root == OBJECT_STORE_NIL) {
+                return version.count == 0 ? 0 : -1;
+        }
+        // a taller trie would have slots past the largest index
+        if (version.root >= store->node_count
+            || version.height > 31 / OBJECT_STORE_BITS) {
+                return -1;
+        }
+        // nodes made in memory are only made from checked versions
+        if (version.root >= store->loaded_nodes) {
+                return 0;
+        }
+        filled = object_store_check_node(store, version.root, version.height);
+
+        return filled != UINT64_MAX && version.count <= filled ? 0 : -1;
+}
+
+// Moves a pointer into the links from where they were to where they are.
+static inline ObjectID *object_store_rebase(const ObjectID *p,
+                                            uintptr_t old,
+                                            ObjectID *links)
+{
+        return links + ((uintptr_t)p - old) / sizeof(*links);
+}
+
+// Tests whether a pointer points into the links in use.
+static inline bool object_store_links_to(const ObjectStore *restrict store,
+                                         const ObjectID *p)
+{
+        return (uintptr_t)p >= (uintptr_t)store->links
+            && (uintptr_t)p < (uintptr_t)(store->links + store->link_count);
+}
+
+int object_store_reserve(ObjectStore *restrict store,
+                         uint32_t nodes,
+                         uint32_t objects,
+                         uint64_t links,
+                         Reallocator *reallocator,
+                         void *user)
+{
+        size_t nodes_sz = store->nodes_sz, objects_sz = store->objects_sz;
+        size_t generations_sz = store->generations_sz;
+        size_t links_sz = store->links_sz;
+        ObjectStoreNode *pnodes = store->nodes;
+        Object *pobjects = store->objects;
+        uint32_t *pgenerations = store->generations;
+        ObjectID *plinks = store->links;
+
+        if (nodes > nodes_sz
+            && !auxiliary_realloc(reallocator,
+                                  &nodes_sz,
+                                  &pnodes,
+                                  &store->nodes_sz,
+                                  &store->nodes,
+                                  nodes,
+                                  user)) {
+                return -1;
+        }
+        if (objects > objects_sz
+            && !auxiliary_realloc(reallocator,
+                                  &objects_sz,
+                                  &pobjects,
+                                  &store->objects_sz,
+                                  &store->objects,
+                                  objects,
+                                  user)) {
+                return -1;
+        }
+        if (objects > generations_sz
+            && !auxiliary_realloc(reallocator,
+                                  &generations_sz,
+                                  &pgenerations,
+                                  &store->generations_sz,
+                                  &store->generations,
+                                  objects,
+                                  user)) {
+                return -1;
+        }
+        if (links > links_sz
+            && !auxiliary_realloc(reallocator,
+                                  &links_sz,
+                                  &plinks,
+                                  &store->links_sz,
+                                  &store->links,
+                                  links,
+                                  user)) {
+                return -1;
+        }
+
+        return 0;
+}
+
+// Tests whether `n` links can be copied from `from` to `to` in a range of
+// the links while it's being written to, i.e. whether they either are where
+// they go already, or lie outside of the range.
+static inline bool object_store_fits(const ObjectID *from,
+                                     uint64_t n,
+                                     const ObjectID *to,
+                                     const ObjectID *begin,
+                                     const ObjectID *end)
+{
+        return n == 0 || from == to || (uintptr_t)(from + n) <= (uintptr_t)begin
+            || (uintptr_t)from >= (uintptr_t)end;
+}
+
+static uint32_t object_store_new_node(ObjectStore *restrict store)
+{
+        ObjectStoreNode *node = &store->nodes[store->node_count];
+        uint32_t *slot;
+
+        node->edit = store->edit;
+        traverse_array(slot, node->slots) {
+                *slot = OBJECT_STORE_NIL;
+        }
+
+        return store->node_count++;
+}
+
+// Returns a node that may be changed in place: the node itself if it was
+// created during the current edit, or a copy of it otherwise.
+static uint32_t object_store_own(ObjectStore *restrict store, uint32_t n)
+{
+        if (store->nodes[n].edit == store->edit) {
+                return n;
+        }
+        store->nodes[store->node_count] = store->nodes[n];
+        store->nodes[store->node_count].edit = store->edit;
+
+        return store->node_count++;
+}
+
+int object_store_set(ObjectStore *restrict store,
+                     ObjectVersion *restrict version,
+                     ObjectID id,
+                     const Object *value,
+                     Reallocator *reallocator,
+                     void *user)
+{
+        ObjectVersion v = *version;
+        // the value may link into the links of the store, which may move
+        // when the store grows
+        Object copy = *value;
+        bool parents_stored =
+                object_store_links_to(store, copy.parents.address);
+        bool children_stored =
+                object_store_links_to(store, copy.children.address);
+        uintptr_t old = (uintptr_t)store->links;
+        uint32_t index = id.index, n, child, *slot, shift, links;
+        uint64_t at;
+        Object *o;
+
+        assert(index <= v.count);
+        // a new root and a path down to the leaves
+        if (object_store_reserve(store,
+                                 store->node_count + v.height + 2,
+                                 store->object_count + 1,
+                                 store->link_count
+                                         + (uint64_t)copy.parent_count
+                                         + copy.child_count,
+                                 reallocator,
+                                 user)) {
+                return -1;
+        }
+        if (parents_stored) {
+                copy.parents.address = object_store_rebase(
+                        copy.parents.address,
+                        old,
+                        store->links);
+        }
+        if (children_stored) {
+                copy.children.address = object_store_rebase(
+                        copy.children.address,
+                        old,
+                        store->links);
+        }
+
+        if (v.root == OBJECT_STORE_NIL) {
+                v.root = object_store_new_node(store);
+                v.height = 0;
+        } else if ((uint64_t)index
+                   >> ((v.height + 1) * OBJECT_STORE_BITS) != 0) {
+                // the trie is full, so it grows a level
+                n = object_store_new_node(store);
+                store->nodes[n].slots[0] = v.root;
+                v.root = n;
+                ++v.height;
+        }
+
+        // copy the path to the leaf
+        n = v.root = object_store_own(store, v.root);
+        for (shift = v.height * OBJECT_STORE_BITS; shift > 0;
+             shift -= OBJECT_STORE_BITS) {
+                slot = &store->nodes[n].slots[(index >> shift)
+                                              & (OBJECT_STORE_WIDTH - 1)];
+                child = *slot == OBJECT_STORE_NIL
+                              ? object_store_new_node(store)
+                              : object_store_own(store, *slot);
+                // the nodes don't move, since there's room for all of them
+                *slot = child;
+                n = child;
+        }
+
+        slot = &store->nodes[n].slots[index & (OBJECT_STORE_WIDTH - 1)];
+        links = copy.parent_count + copy.child_count;
+        at = store->link_count;
+        if (*slot == OBJECT_STORE_NIL || *slot < store->edit_objects) {
+                *slot = store->object_count++;
+        } else if (links > 0) {
+                // The object was set during the current edit already, so it
+                // reuses its links if they have room or are the last ones,
+                // rather than appending them again.
+                o = &store->objects[*slot];
+                at = o->parents.offset / sizeof(ObjectID);
+                if ((links > o->parent_count + o->child_count
+                     && at + o->parent_count + o->child_count
+                                != store->link_count)
+                    || !object_store_fits(copy.parents.address,
+                                          copy.parent_count,
+                                          store->links + at,
+                                          store->links + at,
+                                          store->links + at + links)
+                    || !object_store_fits(copy.children.address,
+                                          copy.child_count,
+                                          store->links + at
+                                                  + copy.parent_count,
+                                          store->links + at,
+                                          store->links + at + links)) {
+                        at = store->link_count;
+                }
+        }
+        store->generations[*slot] = id.generation;
+        o = &store->objects[*slot];
+        *o = copy;
+        o->parents.offset = 0;
+        o->children.offset = 0;
+        if (links > 0) {
+                o->parents.offset = at * sizeof(ObjectID);
+                o->children.offset =
+                        (at + copy.parent_count) * sizeof(ObjectID);
+                if (copy.parent_count > 0) {
+                        memmove(store->links + at,
+                                copy.parents.address,
+                                copy.parent_count * sizeof(ObjectID));
+                }
+                if (copy.child_count > 0) {
+                        memmove(store->links + at + copy.parent_count,
+                                copy.children.address,
+                                copy.child_count * sizeof(ObjectID));
+                }
+                store->link_count = max(store->link_count, at + links);
+        }
+
+        if (index == v.count) {
+                ++v.count;
+        }
+        *version = v;
+
+        return 0;
+}
@@ -0,0 +1,258 @@
+/*! \file objectstore.h
+ *  \brief Persistent object store shared by history entries
+ *
+ *  Keeps every version of the objects of a document in a persistent vector:
+ *  a trie of nodes of 32 slots, whose leaves point to objects. Changing an
+ *  object copies it and the path from the root to its leaf, and leaves all
+ *  other nodes shared with the previous version, so keeping the version of
+ *  every history entry, on every branch, costs memory proportional to the
+ *  changes rather than to the amount of versions times their size. Looking
+ *  up an object in any version takes \f$O(\log_{32} n)\f$.
+ *
+ *  Changes are grouped into edits, typically one per history entry. Nodes
+ *  and objects created during an edit are changed in place until the next
+ *  edit begins, so changing many objects in the same leaf, or the same
+ *  object many times, only copies things once. Versions only become
+ *  persistent once the next edit begins.
+ *
+ *  Every history entry holds the version of its objects, against which the
+ *  IDs of the entry are resolved with object_store_identify().
+ *
+ *  Nodes, objects and the links of objects are appended to arrays owned by
+ *  the user, grown through the usual reallocator protocol (see algo.h), and
+ *  never freed, since the history only grows. A pager may back them along
+ *  with the history, to page out the versions of old entries (see pager.h).
+ *  The links of stored objects are offsets from the start of the links of
+ *  the store, resolved with object_store_parents() and
+ *  object_store_children(), so that the arrays are used as they are
+ *  wherever they lie: growing them never writes to them, and they're saved
+ *  and loaded verbatim. Derived data isn't stored: it's cached by the object
+ *  table (see objecttable.h).
+ *
+ *  A store may be loaded from disk, e.g. mapped from a .tie file (see
+ *  tiefile.h), in which case the versions of its entries must be checked
+ *  with object_store_check() before they're used, which walks the nodes
+ *  they reach for the first time and checks their objects. Nodes are
+ *  shared by versions, so checking every version takes as long as checking
+ *  the whole store once, but only the versions that are used are checked.
+ */
+#ifndef TIE_OBJECTSTORE_H
+#define TIE_OBJECTSTORE_H
+
+#include <stdint.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "core.h"
+
+typedef struct {
+        uint32_t edit;
+        // Objects from this one on were created during the current edit.
+        uint32_t edit_objects;
+        uint32_t node_count;
+        uint32_t object_count;
+        uint64_t link_count;
+        size_t nodes_sz;
+        ObjectStoreNode *nodes;
+        size_t objects_sz;
+        Object *objects;
+        // The generation of the ID of each object.
+        size_t generations_sz;
+        uint32_t *generations;
+        size_t links_sz;
+        ObjectID *links;
+        // What came before these was loaded from disk and is only trusted
+        // once checked.
+        uint32_t loaded_nodes;
+        uint32_t loaded_objects;
+        uint64_t loaded_links;
+        // What object_store_check() found out about each loaded node, 0 if
+        // it wasn't reached yet.
+        size_t checks_sz;
+        uint64_t *checks;
+} ObjectStore;
+
+/*! \brief Initializes an empty store without any memory.
+ *
+ *  \param[out] store The store to initialize. Its arrays must be freed by the
+ *  user once it's no longer needed.
+ */
+extern void object_store_init(ObjectStore *restrict store);
+
+/*! \brief Begins an edit, making all versions made so far persistent.
+ */
+extern void object_store_begin(ObjectStore *restrict store);
+
+/*! \brief Makes room for nodes, objects and links.
+ *
+ *  \param[in,out] store The store.
+ *  \param[in] nodes The amount of nodes to make room for.
+ *  \param[in] objects The amount of objects to make room for.
+ *  \param[in] links The amount of links to make room for.
+ *  \param[in] reallocator Reallocator for the arrays of the store. May be
+ *  NULL, in which case the function fails if they're too small.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the store
+ *  is left as it was, apart from arrays that grew.
+ */
+extern int object_store_reserve(ObjectStore *restrict store,
+                                uint32_t nodes,
+                                uint32_t objects,
+                                uint64_t links,
+                                Reallocator *reallocator,
+                                void *user);
+
+/*! \brief Marks everything in the store as loaded from disk, e.g. after
+ *  reading its arrays from a file, so that it's checked before it's used.
+ *
+ *  \param[in,out] store The store.
+ *  \param[in] reallocator Reallocator for the checks of the store. May be
+ *  NULL, in which case the function fails if they're too small.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the store
+ *  is left as it was, apart from arrays that grew.
+ */
+extern int object_store_loaded(ObjectStore *restrict store,
+                               Reallocator *reallocator,
+                               void *user);
+
+/*! \brief Checks that a version only refers to what the store holds.
+ *
+ *  Versions reached from the store of a file or a journal must be checked
+ *  before they're given to the other functions. The nodes and objects that
+ *  the version shares with versions checked before aren't checked again.
+ *  Objects are checked to be of a known type, to have as many children as
+ *  their type allows, and to have their links in the store.
+ *
+ *  \return 0 if the version may be used, -1 if it's corrupt.
+ */
+extern int object_store_check(ObjectStore *restrict store,
+                              ObjectVersion version);
+
+// Returns the index of the object in a slot of a version.
+PURE_FUNC static inline uint32_t object_store_locate(
+        const ObjectStore *restrict store,
+        ObjectVersion version,
+        uint32_t index)
+{
+        const ObjectStoreNode *node = &store->nodes[version.root];
+        uint32_t shift = version.height * OBJECT_STORE_BITS;
+
+        assert(index < version.count);
+        for (; shift > 0; shift -= OBJECT_STORE_BITS) {
+                node = &store->nodes[node->slots[(index >> shift)
+                                                 & (OBJECT_STORE_WIDTH - 1)]];
+        }
+
+        return node->slots[index & (OBJECT_STORE_WIDTH - 1)];
+}
+
+/*! \brief Looks up an object in a version.
+ *
+ *  \param[in] store The store.
+ *  \param[in] version The version.
+ *  \param[in] index The slot of the object, less than the amount of slots of
+ *  the version.
+ *
+ *  \return The object, which must not be changed.
+ */
+PURE_FUNC static inline const Object *object_store_get(
+        const ObjectStore *restrict store,
+        ObjectVersion version,
+        uint32_t index)
+{
+        return &store->objects[object_store_locate(store, version, index)];
+}
+
+/*! \brief Resolves an object ID against a version.
+ *
+ *  The slots of removed objects are reused by other objects with another
+ *  generation (see objecttable.h), so IDs of objects that a version doesn't
+ *  hold are told apart from those of the objects in their slot.
+ *
+ *  \return The object, which must not be changed, or NULL if the version
+ *  holds no object with the ID.
+ */
+PURE_FUNC static inline const Object *object_store_identify(
+        const ObjectStore *restrict store,
+        ObjectVersion version,
+        const ObjectID *id)
+{
+        uint32_t object;
+
+        if (id->index >= version.count) {
+                return NULL;
+        }
+        object = object_store_locate(store, version, id->index);
+
+        return store->generations[object] == id->generation
+                     ? &store->objects[object]
+                     : NULL;
+}
+
+/*! \brief The parents of an object of the store.
+ */
+PURE_FUNC static inline const ObjectID *object_store_parents(
+        const ObjectStore *restrict store,
+        const Object *object)
+{
+        return location_resolve(store->links, object->parents);
+}
+
+/*! \brief The children of an object of the store.
+ */
+PURE_FUNC static inline const ObjectID *object_store_children(
+        const ObjectStore *restrict store,
+        const Object *object)
+{
+        return location_resolve(store->links, object->children);
+}
+
+/*! \brief Copies an object of the store with its links as addresses, e.g.
+ *  to change it and set it again.
+ *
+ *  The links are only valid until the store grows.
+ */
+PURE_FUNC static inline Object object_store_resolve(
+        const ObjectStore *restrict store,
+        const Object *object)
+{
+        Object copy = *object;
+
+        copy.parents.address = (ObjectID *)object_store_parents(store, object);
+        copy.children.address =
+                (ObjectID *)object_store_children(store, object);
+
+        return copy;
+}
+
+/*! \brief Sets an object, making a new version.
+ *
+ *  Copies the object, its links and the nodes on its path that weren't
+ *  created during the current edit. Runs in \f$O(\log_{32} n + l)\f$, where
+ *  \f$l\f$ is the amount of links of the object.
+ *
+ *  \param[in,out] store The store.
+ *  \param[in,out] version The version to change, replaced by the new one.
+ *  \param[in] id The ID of the object, whose slot is at most the amount of
+ *  slots of the version, in which case a slot is added.
+ *  \param[in] value The object, whose links are addresses. They may point
+ *  into the links of the store, e.g. those of an object returned by
+ *  object_store_resolve(), which are read before the store grows.
+ *  \param[in] reallocator Reallocator for the arrays of the store. May be
+ *  NULL, in which case the function fails when they become full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the version
+ *  is left unchanged.
+ */
+extern int object_store_set(ObjectStore *restrict store,
+                            ObjectVersion *restrict version,
+                            ObjectID id,
+                            const Object *value,
+                            Reallocator *reallocator,
+                            void *user);
+
+#endif
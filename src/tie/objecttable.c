@@ -0,0 +1,281 @@
+#include <string.h>
+
+#include "objecttable.h"
+
+// Defines object_table_reserve_<name>(), which makes room for `n` items in
+// one of the arrays of the table.
+#define object_table_reserve_decl(type, name)                                  \
+        static bool object_table_reserve_##name(ObjectTable *restrict table,   \
+                                                uint64_t n,                    \
+                                                Reallocator *reallocator,      \
+                                                void *user)                    \
+        {                                                                      \
+                size_t sz = table->name##_sz;                                  \
+                type *arr = table->name;                                       \
+                                                                               \
+                return n <= sz                                                 \
+                    || auxiliary_realloc(reallocator,                          \
+                                         &sz,                                  \
+                                         &arr,                                 \
+                                         &table->name##_sz,                    \
+                                         &table->name,                         \
+                                         n,                                    \
+                                         user);                                \
+        }                                                                      \
+        static bool object_table_reserve_##name(ObjectTable *restrict table,   \
+                                                uint64_t n,                    \
+                                                Reallocator *reallocator,      \
+                                                void *user)
+
+object_table_reserve_decl(ObjectType, types);
+object_table_reserve_decl(uint32_t, generations);
+object_table_reserve_decl(uint32_t, cached);
+object_table_reserve_decl(Transform, transforms);
+object_table_reserve_decl(aabb2d, bounds);
+object_table_reserve_decl(ArcLengthTable *, arclengths);
+object_table_reserve_decl(uint64_t, link_first);
+object_table_reserve_decl(uint32_t, parent_counts);
+object_table_reserve_decl(uint32_t, child_counts);
+object_table_reserve_decl(ObjectID, links);
+object_table_reserve_decl(ObjectID, spare_links);
+
+void object_table_init(ObjectTable *restrict table)
+{
+        memset(table, 0, sizeof(*table));
+        table->free = OBJECT_TABLE_NIL;
+}
+
+// Makes room for a new slot in every per-slot array.
+static bool object_table_reserve_slot(ObjectTable *restrict table,
+                                      Reallocator *reallocator,
+                                      void *user)
+{
+        uint64_t n = (uint64_t)table->count + 1;
+
+        return table->free != OBJECT_TABLE_NIL
+            || (table->count < OBJECT_TABLE_NIL
+                && object_table_reserve_types(table, n, reallocator, user)
+                && object_table_reserve_generations(table,
+                                                    n,
+                                                    reallocator,
+                                                    user)
+                && object_table_reserve_cached(table, n, reallocator, user)
+                && object_table_reserve_transforms(table,
+                                                   n,
+                                                   reallocator,
+                                                   user)
+                && object_table_reserve_bounds(table, n, reallocator, user)
+                && object_table_reserve_arclengths(table,
+                                                   n,
+                                                   reallocator,
+                                                   user)
+                && object_table_reserve_link_first(table,
+                                                   n,
+                                                   reallocator,
+                                                   user)
+                && object_table_reserve_parent_counts(table,
+                                                      n,
+                                                      reallocator,
+                                                      user)
+                && object_table_reserve_child_counts(table,
+                                                     n,
+                                                     reallocator,
+                                                     user));
+}
+
+// Makes room for `n` more links at the end of the shared links, compacting
+// them first if the gaps are worth it.
+static bool object_table_reserve_more_links(ObjectTable *restrict table,
+                                            uint64_t n,
+                                            Reallocator *reallocator,
+                                            void *user)
+{
+        if (table->link_count + n <= table->links_sz) {
+                return true;
+        }
+        if (table->link_gaps > 0
+            && table->link_gaps >= table->link_count / 2) {
+                object_table_compact(table, reallocator, user);
+        }
+
+        return object_table_reserve_links(table,
+                                          table->link_count + n,
+                                          reallocator,
+                                          user);
+}
+
+// Writes the links of the object in a slot at the given position of the
+// shared links.
+static inline void object_table_write_links(ObjectTable *restrict table,
+                                            uint32_t slot,
+                                            uint64_t first,
+                                            uint32_t parent_count,
+                                            const ObjectID *restrict parents,
+                                            uint32_t child_count,
+                                            const ObjectID *restrict children)
+{
+        table->link_first[slot] = first;
+        table->parent_counts[slot] = parent_count;
+        table->child_counts[slot] = child_count;
+        if (parent_count > 0) {
+                memcpy(table->links + first,
+                       parents,
+                       parent_count * sizeof(*parents));
+        }
+        if (child_count > 0) {
+                memcpy(table->links + first + parent_count,
+                       children,
+                       child_count * sizeof(*children));
+        }
+}
+
+ObjectID object_table_insert(ObjectTable *restrict table,
+                             ObjectType type,
+                             const Transform *restrict transform,
+                             uint32_t parent_count,
+                             const ObjectID parents[restrict],
+                             uint32_t child_count,
+                             const ObjectID children[restrict],
+                             Reallocator *reallocator,
+                             void *user)
+{
+        uint64_t links = (uint64_t)parent_count + child_count;
+        uint32_t slot;
+
+        assert(type != DELETED);
+        if (!object_table_reserve_slot(table, reallocator, user)
+            || !object_table_reserve_more_links(table,
+                                                links,
+                                                reallocator,
+                                                user)) {
+                return OBJECT_ID_NIL;
+        }
+
+        if (table->free != OBJECT_TABLE_NIL) {
+                slot = table->free;
+                table->free = table->link_first[slot];
+        } else {
+                slot = table->count++;
+                table->generations[slot] = 0;
+                table->arclengths[slot] = NULL;
+        }
+        table->types[slot] = type;
+        table->cached[slot] = 0;
+        table->transforms[slot] = *transform;
+        object_table_write_links(table,
+                                 slot,
+                                 table->link_count,
+                                 parent_count,
+                                 parents,
+                                 child_count,
+                                 children);
+        table->link_count += links;
+
+        return object_table_id(table, slot);
+}
+
+bool object_table_remove(ObjectTable *restrict table, ObjectID id)
+{
+        uint32_t slot = object_table_resolve(table, id);
+
+        if (slot == OBJECT_TABLE_NIL || table->types[slot] == DELETED) {
+                return false;
+        }
+
+        table->link_gaps += (uint64_t)table->parent_counts[slot]
+                          + table->child_counts[slot];
+        table->types[slot] = DELETED;
+        table->cached[slot] = 0;
+        ++table->generations[slot];
+        table->parent_counts[slot] = 0;
+        table->child_counts[slot] = 0;
+        table->link_first[slot] = table->free;
+        table->free = slot;
+
+        return true;
+}
+
+int object_table_set_links(ObjectTable *restrict table,
+                           uint32_t slot,
+                           uint32_t parent_count,
+                           const ObjectID parents[restrict],
+                           uint32_t child_count,
+                           const ObjectID children[restrict],
+                           Reallocator *reallocator,
+                           void *user)
+{
+        uint64_t links = (uint64_t)parent_count + child_count, old, first;
+
+        assert(slot < table->count);
+        assert(table->types[slot] != DELETED);
+        old = (uint64_t)table->parent_counts[slot] + table->child_counts[slot];
+        first = table->link_first[slot];
+
+        if (links <= old) {
+                table->link_gaps += old - links;
+        } else if (first + old == table->link_count
+                   && table->link_count + links - old <= table->links_sz) {
+                // the last links grow in place
+                table->link_count += links - old;
+        } else {
+                if (!object_table_reserve_more_links(table,
+                                                     links,
+                                                     reallocator,
+                                                     user)) {
+                        return -1;
+                }
+                first = table->link_count;
+                table->link_count += links;
+                table->link_gaps += old;
+        }
+        object_table_write_links(table,
+                                 slot,
+                                 first,
+                                 parent_count,
+                                 parents,
+                                 child_count,
+                                 children);
+
+        return 0;
+}
+
+int object_table_compact(ObjectTable *restrict table,
+                         Reallocator *reallocator,
+                         void *user)
+{
+        uint64_t live = table->link_count - table->link_gaps, count = 0, n;
+        size_t sz;
+        ObjectID *links;
+        uint32_t slot;
+
+        if (!object_table_reserve_spare_links(table, live, reallocator, user)) {
+                return -1;
+        }
+
+        for (slot = 0; slot < table->count; ++slot) {
+                n = (uint64_t)table->parent_counts[slot]
+                  + table->child_counts[slot];
+                if (table->types[slot] == DELETED) {
+                        continue;
+                }
+                if (n > 0) {
+                        memcpy(table->spare_links + count,
+                               table->links + table->link_first[slot],
+                               n * sizeof(*table->links));
+                }
+                table->link_first[slot] = count;
+                count += n;
+        }
+        assert(count == live);
+
+        sz = table->links_sz;
+        links = table->links;
+        table->links_sz = table->spare_links_sz;
+        table->links = table->spare_links;
+        table->spare_links_sz = sz;
+        table->spare_links = links;
+        table->link_count = live;
+        table->link_gaps = 0;
+
+        return 0;
+}
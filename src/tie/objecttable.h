@@ -0,0 +1,201 @@
+/*! \file objecttable.h
+ *  \brief Slot map of the objects of a document
+ *
+ *  Stores the latest state of every object as a structure of arrays indexed
+ *  by slot: types, transforms, cached data and the range of the links of
+ *  each object, so that passes over the whole document, like transforming,
+ *  culling or saving, stream through the one array they need. The parents
+ *  and children of all objects are flattened into one shared array of IDs
+ *  instead of being allocated per object; the parents of an object come
+ *  first, followed by its children.
+ *
+ *  Objects are identified by an #ObjectID, made of their slot and its
+ *  generation. Removing an object frees its slot for reuse and advances the
+ *  generation of the slot, so resolving an ID is one comparison and IDs of
+ *  removed objects are detected as stale rather than silently referring to
+ *  whatever object took their place.
+ *
+ *  Links that are replaced leave a gap in the shared array, which is
+ *  compacted once the gaps outgrow the links in use; compaction writes the
+ *  links in slot order into a second array and swaps the two. All arrays
+ *  are owned by the user and grown through the usual reallocator protocol
+ *  (see algo.h).
+ */
+#ifndef TIE_OBJECTTABLE_H
+#define TIE_OBJECTTABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "algo.h"
+#include "arclength.h"
+#include "attrib.h"
+#include "core.h"
+#include "math.h"
+
+#define OBJECT_TABLE_NIL UINT32_MAX
+// An ID that never resolves.
+#define OBJECT_ID_NIL                                                          \
+        ((ObjectID){ .index = OBJECT_TABLE_NIL, .generation = 0 })
+
+typedef struct {
+        uint32_t count; // amount of slots, including free ones
+        uint32_t free; // the first free slot, or #OBJECT_TABLE_NIL
+        uint64_t link_count; // including the gaps left by replaced links
+        uint64_t link_gaps;
+        // Arrays with an item per slot. Free slots are #DELETED, have no
+        // links, and keep the next free slot in their `link_first`.
+        size_t types_sz;
+        ObjectType *types;
+        size_t generations_sz;
+        uint32_t *generations;
+        size_t cached_sz;
+        uint32_t *cached; // flags of the cached data that is up to date
+        size_t transforms_sz;
+        Transform *transforms;
+        size_t bounds_sz;
+        aabb2d *bounds;
+        // Bezier curves only, allocated on demand and kept for the next
+        // object in the slot. Must be freed by the user with tie_free().
+        size_t arclengths_sz;
+        ArcLengthTable **arclengths;
+        size_t link_first_sz;
+        uint64_t *link_first;
+        size_t parent_counts_sz;
+        uint32_t *parent_counts;
+        size_t child_counts_sz;
+        uint32_t *child_counts;
+        // The shared links, and the array they're compacted into.
+        size_t links_sz;
+        ObjectID *links;
+        size_t spare_links_sz;
+        ObjectID *spare_links;
+} ObjectTable;
+
+/*! \brief Initializes an empty table without any memory.
+ *
+ *  \param[out] table The table to initialize. Its arrays must be freed by the
+ *  user once it's no longer needed.
+ */
+extern void object_table_init(ObjectTable *restrict table);
+
+/*! \brief Resolves an ID to the slot of its object.
+ *
+ *  \return The slot, or #OBJECT_TABLE_NIL if the object was removed.
+ */
+PURE_FUNC static inline uint32_t object_table_resolve(
+        const ObjectTable *restrict table,
+        ObjectID id)
+{
+        return id.index < table->count
+                    && table->generations[id.index] == id.generation
+                     ? id.index
+                     : OBJECT_TABLE_NIL;
+}
+
+/*! \brief Returns the ID of the object in a slot that is in use.
+ */
+PURE_FUNC static inline ObjectID object_table_id(
+        const ObjectTable *restrict table,
+        uint32_t slot)
+{
+        assert(slot < table->count);
+        assert(table->types[slot] != DELETED);
+
+        return (ObjectID){ .index = slot,
+                           .generation = table->generations[slot] };
+}
+
+/*! \brief Returns the parents of the object in a slot.
+ *
+ *  The pointer is invalidated by any change to the links of the table.
+ */
+PURE_FUNC static inline const ObjectID *object_table_parents(
+        const ObjectTable *restrict table,
+        uint32_t slot)
+{
+        return table->links + table->link_first[slot];
+}
+
+/*! \brief Returns the children of the object in a slot.
+ *
+ *  \sa object_table_parents()
+ */
+PURE_FUNC static inline const ObjectID *object_table_children(
+        const ObjectTable *restrict table,
+        uint32_t slot)
+{
+        return table->links + table->link_first[slot]
+             + table->parent_counts[slot];
+}
+
+/*! \brief Inserts an object, reusing a free slot if there's one.
+ *
+ *  \param[in,out] table The table.
+ *  \param[in] type The type of the object, not #DELETED.
+ *  \param[in] transform The transform of the object.
+ *  \param[in] parent_count The amount of parents.
+ *  \param[in] parents The parents, which must not point into the table.
+ *  \param[in] child_count The amount of children.
+ *  \param[in] children The children, which must not point into the table.
+ *  \param[in] reallocator Reallocator for the arrays of the table. May be
+ *  NULL, in which case the function fails when they become full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return The ID of the object, or #OBJECT_ID_NIL on allocation failure, in
+ *  which case the table is left unchanged.
+ */
+extern ObjectID object_table_insert(ObjectTable *restrict table,
+                                    ObjectType type,
+                                    const Transform *restrict transform,
+                                    uint32_t parent_count,
+                                    const ObjectID parents[restrict],
+                                    uint32_t child_count,
+                                    const ObjectID children[restrict],
+                                    Reallocator *reallocator,
+                                    void *user);
+
+/*! \brief Removes an object, advancing the generation of its slot.
+ *
+ *  Objects linked to it aren't changed.
+ *
+ *  \return true on success, false if the ID is stale.
+ */
+extern bool object_table_remove(ObjectTable *restrict table, ObjectID id);
+
+/*! \brief Replaces the parents and children of the object in a slot.
+ *
+ *  Links that fit in the room of the old ones are written in place, others
+ *  are appended to the shared links. The cached data of the object isn't
+ *  invalidated.
+ *
+ *  \param[in] parents The parents, which must not point into the table.
+ *  \param[in] children The children, which must not point into the table.
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the links
+ *  are left unchanged.
+ *
+ *  \sa object_table_insert()
+ */
+extern int object_table_set_links(ObjectTable *restrict table,
+                                  uint32_t slot,
+                                  uint32_t parent_count,
+                                  const ObjectID parents[restrict],
+                                  uint32_t child_count,
+                                  const ObjectID children[restrict],
+                                  Reallocator *reallocator,
+                                  void *user);
+
+/*! \brief Closes the gaps in the shared links, leaving them in slot order.
+ *
+ *  Runs in \f$O(n + l)\f$, where \f$n\f$ is the amount of slots and \f$l\f$
+ *  the amount of links in use. Called as needed by the other functions.
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the links
+ *  are left unchanged.
+ */
+extern int object_table_compact(ObjectTable *restrict table,
+                                Reallocator *reallocator,
+                                void *user);
+
+#endif
@@ -0,0 +1,516 @@
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "algo.h"
+#include "pager.h"
+
+// Trimming pages arrays out a slice at a time, oldest first.
+#define HISTORY_PAGER_ROUNDS 64
+
+TieFileStatus history_pager_open(HistoryPager *restrict pager,
+                                 const char *restrict path,
+                                 uint64_t budget,
+                                 uint64_t reserve)
+{
+        long page_size = sysconf(_SC_PAGESIZE);
+        int fd;
+
+        if (page_size <= 0) {
+                return TIEFILE_IO_ERROR;
+        }
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0) {
+                return TIEFILE_IO_ERROR;
+        }
+        if (unlink(path)) {
+                close(fd);
+                return TIEFILE_IO_ERROR;
+        }
+
+        pager->fd = fd;
+        pager->page_size = page_size;
+        pager->budget = budget;
+        pager->reserve = (reserve + page_size - 1) / page_size * page_size;
+        pager->array_count = 0;
+
+        return TIEFILE_OK;
+}
+
+void history_pager_close(HistoryPager *restrict pager)
+{
+        HistoryPagerArray *a;
+
+        traverse(a, pager->arrays, pager->arrays + pager->array_count) {
+                munmap(a->base, pager->reserve);
+        }
+        pager->array_count = 0;
+        close(pager->fd);
+}
+
+// Every array has a range of the spill file as large as its reserve, which
+// the file only takes room for once the array grows into it.
+static inline off_t history_pager_offset(const HistoryPager *restrict pager,
+                                         const HistoryPagerArray *a)
+{
+        return (off_t)(a - pager->arrays) * pager->reserve;
+}
+
+// Finds the array at an address, or makes one if the address is NULL.
+static HistoryPagerArray *history_pager_array(HistoryPager *restrict pager,
+                                              const void *p)
+{
+        HistoryPagerArray *a;
+        void *base;
+
+        if (p) {
+                traverse(a, pager->arrays, pager->arrays + pager->array_count) {
+                        if (a->base + a->skew == p) {
+                                return a;
+                        }
+                }
+                return NULL;
+        }
+        if (pager->array_count == HISTORY_PAGER_MAX_ARRAYS) {
+                return NULL;
+        }
+
+        a = &pager->arrays[pager->array_count];
+        // the whole range is mapped at once and made accessible as the
+        // array grows, so that it never moves
+        base = mmap(NULL,
+                    pager->reserve,
+                    PROT_NONE,
+                    MAP_SHARED,
+                    pager->fd,
+                    history_pager_offset(pager, a));
+        if (base == MAP_FAILED) {
+                return NULL;
+        }
+        a->base = base;
+        a->size = 0;
+        a->skew = 0;
+        a->mapped = 0;
+        ++pager->array_count;
+
+        return a;
+}
+
+// Makes the first `size` bytes of an array accessible, taking room for them
+// in the spill file.
+static bool history_pager_grow(HistoryPager *restrict pager,
+                               HistoryPagerArray *restrict a,
+                               uint64_t size)
+{
+        // other arrays may lie further in the file
+        uint64_t end = history_pager_offset(pager, a) + size;
+        struct stat st;
+
+        if (size <= a->size) {
+                return true;
+        }
+        if (fstat(pager->fd, &st)
+            || ((uint64_t)st.st_size < end && ftruncate(pager->fd, end))
+            || mprotect(a->base + a->size,
+                        size - a->size,
+                        PROT_READ | PROT_WRITE)) {
+                return false;
+        }
+        a->size = size;
+
+        return true;
+}
+
+size_t history_pager_reallocator(void **restrict p,
+                                 size_t n,
+                                 size_t new_n,
+                                 size_t sz,
+                                 void *user)
+{
+        HistoryPager *pager = user;
+        HistoryPagerArray *a = history_pager_array(pager, *p);
+        uint64_t limit, size;
+
+        if (!a || new_n > (limit = (pager->reserve - a->skew) / sz)) {
+                *p = NULL;
+                return 0;
+        }
+
+        size = a->skew + min(max(new_n, n * 3 / 2), limit) * sz;
+        size = (size + pager->page_size - 1) / pager->page_size
+             * pager->page_size;
+        if (!history_pager_grow(pager, a, size)) {
+                *p = NULL;
+                return 0;
+        }
+        *p = a->base + a->skew;
+
+        return (a->size - a->skew) / sz;
+}
+
+size_t history_pager_map(HistoryPager *restrict pager,
+                         void **restrict p,
+                         int fd,
+                         uint64_t offset,
+                         size_t n,
+                         size_t sz)
+{
+        uint64_t skew = offset % pager->page_size, end, mapped;
+        HistoryPagerArray *a;
+
+        *p = NULL;
+        if (n > (pager->reserve - skew) / sz) {
+                return 0;
+        }
+        a = history_pager_array(pager, NULL);
+        if (!a) {
+                return 0;
+        }
+
+        // Only whole pages of the file are mapped, since touching a page
+        // past its end would fault. The rest of the part is read into the
+        // spill file, where the array goes on growing.
+        end = skew + (uint64_t)n * sz;
+        mapped = end / pager->page_size * pager->page_size;
+        if (mapped > 0
+            && mmap(a->base,
+                    mapped,
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_FIXED,
+                    fd,
+                    offset - skew)
+                       == MAP_FAILED) {
+                goto fail;
+        }
+        a->size = mapped;
+        a->mapped = mapped;
+        if (end > mapped
+            && (!history_pager_grow(pager, a, mapped + pager->page_size)
+                || pread(fd,
+                         a->base + mapped,
+                         end - mapped,
+                         offset - skew + mapped)
+                           != (ssize_t)(end - mapped))) {
+                goto fail;
+        }
+        a->skew = skew;
+        *p = a->base + skew;
+
+        return (a->size - skew) / sz;
+
+fail:
+        // the array is the last one
+        munmap(a->base, pager->reserve);
+        --pager->array_count;
+
+        return 0;
+}
+
+bool history_pager_owns(const HistoryPager *restrict pager, const void *p)
+{
+        const HistoryPagerArray *a;
+
+        traverse(a, pager->arrays, pager->arrays + pager->array_count) {
+                if (a->base + a->skew == p) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+// The amount of accessible pages of an array.
+static inline uint64_t history_pager_pages(const HistoryPager *restrict pager,
+                                           const HistoryPagerArray *a)
+{
+        return (a->size + pager->page_size - 1) / pager->page_size;
+}
+
+// What trimming knows about a page of an array.
+enum {
+        HISTORY_PAGER_RESIDENT = 1 << 0,
+        HISTORY_PAGER_HOT = 1 << 1
+};
+
+typedef struct {
+        HistoryPagerArray *array;
+        unsigned char *pages;
+} HistoryPagerTrim;
+
+// Marks the pages that hold `n` bytes at `p` as hot, if they lie in one of
+// the arrays being trimmed.
+static void history_pager_hot(const HistoryPager *restrict pager,
+                              HistoryPagerTrim *trims,
+                              size_t count,
+                              const void *p,
+                              size_t n)
+{
+        const unsigned char *c = p;
+        HistoryPagerTrim *t;
+        uint64_t first, last;
+
+        traverse(t, trims, trims + count) {
+                if (n == 0 || c < t->array->base
+                    || c + n > t->array->base + t->array->size) {
+                        continue;
+                }
+                first = (c - t->array->base) / pager->page_size;
+                last = (c + n - 1 - t->array->base) / pager->page_size;
+                for (; first <= last; ++first) {
+                        t->pages[first] |= HISTORY_PAGER_HOT;
+                }
+                return;
+        }
+}
+
+// Marks the pages of a node of the store and of everything under it as hot.
+// Anything out of range is skipped, since versions loaded from a file may
+// not have been checked yet.
+static void history_pager_hot_node(const HistoryPager *restrict pager,
+                                   HistoryPagerTrim *trims,
+                                   size_t count,
+                                   const ObjectStore *restrict store,
+                                   unsigned char *restrict visited,
+                                   uint32_t node,
+                                   uint32_t level)
+{
+        const uint32_t *slot;
+        const Object *o;
+
+        if (node >= store->node_count || visited[node / 8] & 1 << node % 8) {
+                return;
+        }
+        visited[node / 8] |= 1 << node % 8;
+        history_pager_hot(pager,
+                          trims,
+                          count,
+                          &store->nodes[node],
+                          sizeof(*store->nodes));
+
+        traverse_array(slot, store->nodes[node].slots) {
+                if (*slot == OBJECT_STORE_NIL) {
+                        continue;
+                }
+                if (level > 0) {
+                        history_pager_hot_node(pager,
+                                               trims,
+                                               count,
+                                               store,
+                                               visited,
+                                               *slot,
+                                               level - 1);
+                        continue;
+                }
+                if (*slot >= store->object_count) {
+                        continue;
+                }
+                o = &store->objects[*slot];
+                history_pager_hot(pager, trims, count, o, sizeof(*o));
+                history_pager_hot(pager,
+                                  trims,
+                                  count,
+                                  &store->generations[*slot],
+                                  sizeof(*store->generations));
+                if (o->parents.offset / sizeof(ObjectID)
+                            + (uint64_t)o->parent_count + o->child_count
+                    <= store->link_count) {
+                        history_pager_hot(
+                                pager,
+                                trims,
+                                count,
+                                object_store_parents(store, o),
+                                ((uint64_t)o->parent_count + o->child_count)
+                                        * sizeof(ObjectID));
+                }
+        }
+}
+
+// Marks an entry and the version of its objects as hot.
+static void history_pager_hot_entry(const HistoryPager *restrict pager,
+                                    HistoryPagerTrim *trims,
+                                    size_t count,
+                                    const ObjectStore *restrict store,
+                                    unsigned char *restrict visited,
+                                    const HistoryEntry *entry)
+{
+        ObjectVersion v = entry->objects;
+
+        history_pager_hot(pager, trims, count, entry, sizeof(*entry));
+        if (v.root != OBJECT_STORE_NIL && v.height <= 31 / OBJECT_STORE_BITS) {
+                history_pager_hot_node(
+                        pager, trims, count, store, visited, v.root, v.height);
+        }
+}
+
+// Pages out a run of cold pages of an array that are resident. Pages of the
+// spill file are written back and dropped from the page cache, and pages
+// mapped from a file are dropped or swapped out if they were changed. Returns
+// false on failure.
+static bool history_pager_evict(HistoryPager *restrict pager,
+                                const HistoryPagerArray *a,
+                                uint64_t first,
+                                uint64_t last)
+{
+        unsigned char *p = a->base + first * pager->page_size;
+        uint64_t n = (last - first) * pager->page_size;
+
+        if (first * pager->page_size < a->mapped) {
+#ifdef MADV_PAGEOUT
+                return !madvise(p, n, MADV_PAGEOUT);
+#else
+                // without a way to page them out, they're left to the
+                // system
+                return true;
+#endif
+        }
+
+        return !msync(p, n, MS_SYNC) && !madvise(p, n, MADV_DONTNEED)
+            && !posix_fadvise(pager->fd,
+                              history_pager_offset(pager, a)
+                                      + first * pager->page_size,
+                              n,
+                              POSIX_FADV_DONTNEED);
+}
+
+// Finds where a run of cold resident pages of an array that starts at
+// `first` ends, up to `end`. Runs stop where the part mapped from a file does.
+static uint64_t history_pager_run(const HistoryPager *restrict pager,
+                                  const HistoryPagerTrim *t,
+                                  uint64_t first,
+                                  uint64_t end)
+{
+        bool mapped = first * pager->page_size < t->array->mapped;
+        uint64_t last = first;
+
+        while (last < end && t->pages[last] == HISTORY_PAGER_RESIDENT
+               && (last * pager->page_size < t->array->mapped) == mapped) {
+                ++last;
+        }
+
+        return last;
+}
+
+TieFileStatus history_pager_trim(HistoryPager *restrict pager,
+                                 const History *restrict history,
+                                 const ObjectStore *restrict store,
+                                 uint64_t recent)
+{
+        const void *arrays[] = { history->tree.address,
+                                 history->entries.address,
+                                 store->nodes,
+                                 store->objects,
+                                 store->generations,
+                                 store->links };
+        HistoryPagerTrim trims[array_size(arrays)], *t;
+        const LinearHistory *linear;
+        const HistoryEntry *entries = history->entries.address, *e;
+        unsigned char *visited = NULL;
+        TieFileStatus status = TIEFILE_IO_ERROR;
+        uint64_t resident = 0, pages, first, last, end, i, round;
+        size_t count = 0, j;
+
+        // the tree is always hot
+        for (j = 0; j < array_size(arrays); ++j) {
+                t = &trims[count];
+                t->array = arrays[j] ? history_pager_array(pager, arrays[j])
+                                     : NULL;
+                if (!t->array || t->array->size == 0) {
+                        continue;
+                }
+                pages = history_pager_pages(pager, t->array);
+                t->pages = tie_calloc(pages, 1);
+                if (!t->pages) {
+                        status = TIEFILE_NO_MEMORY;
+                        goto done;
+                }
+                ++count;
+                if (mincore(t->array->base, t->array->size, t->pages)) {
+                        goto done;
+                }
+                for (i = 0; i < pages; ++i) {
+                        t->pages[i] &= HISTORY_PAGER_RESIDENT;
+                        resident += t->pages[i];
+                        if (j == 0) {
+                                t->pages[i] |= HISTORY_PAGER_HOT;
+                        }
+                }
+        }
+        if (resident * pager->page_size <= pager->budget) {
+                status = TIEFILE_OK;
+                goto done;
+        }
+
+        // the current entry, recent ones and the tips of linear histories
+        // stay hot, along with everything their objects lead to
+        if (store->node_count > 0) {
+                visited = tie_calloc((store->node_count + 7) / 8, 1);
+                if (!visited) {
+                        status = TIEFILE_NO_MEMORY;
+                        goto done;
+                }
+        }
+        if (history->size > 0) {
+                history_pager_hot_entry(pager,
+                                        trims,
+                                        count,
+                                        store,
+                                        visited,
+                                        &entries[history->current_entry]);
+        }
+        traverse(e, entries + history->size - min(recent, history->size),
+                 entries + history->size) {
+                history_pager_hot_entry(
+                        pager, trims, count, store, visited, e);
+        }
+        traverse(linear,
+                 history->tree.address,
+                 history->tree.address + history->tree_size) {
+                if (linear->size > 0) {
+                        history_pager_hot_entry(
+                                pager,
+                                trims,
+                                count,
+                                store,
+                                visited,
+                                linear->entries.address + linear->size - 1);
+                }
+        }
+
+        // Arrays only grow at their end, so their first pages are the
+        // oldest ones. Every round pages out the next slice of each array,
+        // which keeps what's resident of them about as old.
+        for (round = 0; round < HISTORY_PAGER_ROUNDS; ++round) {
+                traverse(t, trims, trims + count) {
+                        pages = history_pager_pages(pager, t->array);
+                        end = pages * (round + 1) / HISTORY_PAGER_ROUNDS;
+                        for (first = pages * round / HISTORY_PAGER_ROUNDS;
+                             first < end
+                             && resident * pager->page_size > pager->budget;
+                             first = last) {
+                                last = history_pager_run(pager, t, first, end);
+                                if (last == first) {
+                                        ++last;
+                                        continue;
+                                }
+                                if (!history_pager_evict(
+                                            pager, t->array, first, last)) {
+                                        goto done;
+                                }
+                                resident -= last - first;
+                        }
+                }
+        }
+        status = TIEFILE_OK;
+
+done:
+        tie_free(visited);
+        traverse(t, trims, trims + count) {
+                tie_free(t->pages);
+        }
+
+        return status;
+}
@@ -0,0 +1,160 @@
+/*! \file pager.h
+ *  \brief Paging the history out of memory
+ *
+ *  Long sessions make a history and an object store (see objectstore.h)
+ *  that outgrow memory. The pager backs their arrays with a spill file
+ *  mapped into memory, so that the parts of them that aren't used, which
+ *  are most of them, are paged out to the file rather than kept resident or
+ *  swapped. Both only grow at their end, so the parts used by the current
+ *  entry and recent ones are mostly the last ones, and those of older
+ *  entries are read back from the file transparently when they're touched.
+ *
+ *  Arrays are grown with history_pager_reallocator() and never move: each
+ *  one reserves a range of address space up front and grows by making more
+ *  of it accessible. Addresses into the arrays therefore stay valid while
+ *  they grow, which lets the history be saved in the background while it
+ *  changes (see autosave.h).
+ *
+ *  Arrays may also start out as a part of another file, e.g. of a .tie file
+ *  (see tiefile.h), which is mapped privately: its pages are read when
+ *  they're first touched, shared with the page cache until they're changed,
+ *  and only copied then. Such arrays grow into the spill file past the part
+ *  that was mapped.
+ *
+ *  The spill file is removed as soon as it's opened, so it doesn't outlive
+ *  the pager.
+ */
+#ifndef TIE_PAGER_H
+#define TIE_PAGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tiefile.h"
+
+// The entries and tree of a history and the five arrays of a store take
+// seven; the rest are for the user.
+#define HISTORY_PAGER_MAX_ARRAYS 16
+
+typedef struct {
+        unsigned char *base; // the address space reserved for the array
+        uint64_t size; // accessible bytes, from its start
+        // The array starts this far into its first page, where the part of
+        // a file it was mapped from starts.
+        uint64_t skew;
+        uint64_t mapped; // bytes mapped from a file, from its start
+} HistoryPagerArray;
+
+typedef struct HistoryPager_ HistoryPager;
+
+struct HistoryPager_ {
+        int fd;
+        size_t page_size;
+        uint64_t budget; // resident bytes
+        uint64_t reserve; // bytes of address space per array
+        uint32_t array_count;
+        HistoryPagerArray arrays[HISTORY_PAGER_MAX_ARRAYS];
+};
+
+/*! \brief Opens a pager with an empty spill file.
+ *
+ *  \param[out] pager The pager, to be closed with history_pager_close().
+ *  \param[in] path The path of the spill file, which is created and removed
+ *  at once.
+ *  \param[in] budget The amount of bytes of the arrays to keep resident
+ *  when they're trimmed.
+ *  \param[in] reserve The largest size in bytes of an array. Only address
+ *  space is reserved for it, so it may well exceed memory.
+ *
+ *  \return #TIEFILE_OK on success, #TIEFILE_IO_ERROR otherwise.
+ */
+extern TieFileStatus history_pager_open(HistoryPager *restrict pager,
+                                        const char *restrict path,
+                                        uint64_t budget,
+                                        uint64_t reserve);
+
+/*! \brief Unmaps all arrays and closes the spill file.
+ *
+ *  The arrays are freed along with the pager, not by the user.
+ */
+extern void history_pager_close(HistoryPager *restrict pager);
+
+/*! \brief A reallocator whose arrays never move.
+ *
+ *  Grows arrays that it made, or makes one if the array is NULL. Fails if
+ *  the array would exceed the reserve of the pager or the pager has no
+ *  room for another array.
+ *
+ *  \param[in,out] user The #HistoryPager.
+ *
+ *  \sa #Reallocator
+ */
+extern size_t history_pager_reallocator(void **restrict p,
+                                        size_t n,
+                                        size_t new_n,
+                                        size_t sz,
+                                        void *user);
+
+/*! \brief Makes an array that starts out as a part of a file.
+ *
+ *  The part is mapped privately, so that the file is never written to, and
+ *  may be closed or replaced afterwards. The array is grown with
+ *  history_pager_reallocator().
+ *
+ *  \param[in,out] pager The pager.
+ *  \param[out] p The array, or NULL on failure.
+ *  \param[in] fd The file, open for reading.
+ *  \param[in] offset Where the part starts in the file, aligned for the
+ *  items.
+ *  \param[in] n The amount of items in the part, which must lie in the
+ *  file.
+ *  \param[in] sz The size of the items.
+ *
+ *  \return The capacity of the array in items, or 0 on failure, like
+ *  history_pager_reallocator().
+ */
+extern size_t history_pager_map(HistoryPager *restrict pager,
+                                void **restrict p,
+                                int fd,
+                                uint64_t offset,
+                                size_t n,
+                                size_t sz);
+
+/*! \brief Tests whether an array was made by history_pager_reallocator()
+ *  or history_pager_map() of a pager.
+ */
+extern bool history_pager_owns(const HistoryPager *restrict pager,
+                               const void *p);
+
+/*! \brief Pages the cold parts of a history and its store out of memory,
+ *  to fit them in the budget.
+ *
+ *  The tree of the history, its current entry, its last few entries and the
+ *  last entry of each linear history are hot, along with the parts of the
+ *  store their objects take. Cold pages are paged out, the oldest first,
+ *  until the resident pages of the arrays of the history and the store fit
+ *  in the budget. Pages of the spill file are written back to it and
+ *  dropped, and read back from it when they're touched again. Pages mapped
+ *  from a file are dropped, or swapped out if they were changed. Arrays of
+ *  the pager that aren't the history's or the store's are left alone.
+ *
+ *  Arrays may be in use by other threads meanwhile, but the history and the
+ *  store must not change. Should be called from time to time, e.g. after
+ *  every few history entries.
+ *
+ *  \param[in,out] pager The pager.
+ *  \param[in] history The history, whose arrays were made by the pager.
+ *  \param[in] store The store of the history, whose arrays were made by the
+ *  pager.
+ *  \param[in] recent The amount of last entries to keep hot.
+ *
+ *  \return #TIEFILE_OK on success, #TIEFILE_NO_MEMORY or #TIEFILE_IO_ERROR
+ *  otherwise.
+ */
+extern TieFileStatus history_pager_trim(HistoryPager *restrict pager,
+                                        const History *restrict history,
+                                        const ObjectStore *restrict store,
+                                        uint64_t recent);
+
+#endif
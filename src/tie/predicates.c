@@ -0,0 +1,257 @@
+#include <math.h>
+
+#include "attrib.h"
+#include "math.h"
+#include "predicates.h"
+
+// An expansion is a sum of doubles ordered by increasing magnitude, none of
+// which overlap in their significant bits. Its sign is the sign of its last
+// (largest) component.
+
+// Half of the machine epsilon, i.e. the relative rounding error bound.
+#define PREDICATES_EPSILON 0x1p-53
+
+// Error bounds of the filtered evaluations, taken from Shewchuk's paper.
+#define ORIENT2D_ERRBOUND                                                      \
+        ((3.0 + 16.0 * PREDICATES_EPSILON) * PREDICATES_EPSILON)
+#define INCIRCLE_ERRBOUND                                                      \
+        ((10.0 + 96.0 * PREDICATES_EPSILON) * PREDICATES_EPSILON)
+
+// x + y = a + b exactly, x = fl(a + b).
+static inline void two_sum(double a, double b, double *x, double *y)
+{
+        double av, bv;
+
+        *x = a + b;
+        bv = *x - a;
+        av = *x - bv;
+        *y = (a - av) + (b - bv);
+}
+
+// Same as two_sum(), but requires |a| >= |b|.
+static inline void fast_two_sum(double a, double b, double *x, double *y)
+{
+        *x = a + b;
+        *y = b - (*x - a);
+}
+
+// x + y = a * b exactly, x = fl(a * b).
+static inline void two_product(double a, double b, double *x, double *y)
+{
+        *x = a * b;
+        *y = fma(a, b, -*x);
+}
+
+// h = e + f, dropping zero components. h must have room for elen + flen
+// components and must not alias the inputs.
+static size_t expansion_sum(size_t elen,
+                            const double e[static restrict elen],
+                            size_t flen,
+                            const double f[static restrict flen],
+                            double h[restrict])
+{
+        double q, next, hh;
+        size_t i = 0, j = 0, n = 0;
+
+        // merge the components by increasing magnitude and accumulate them
+        if (fabs(e[0]) < fabs(f[0])) {
+                q = e[i++];
+        } else {
+                q = f[j++];
+        }
+        while (i < elen || j < flen) {
+                if (j == flen || (i < elen && fabs(e[i]) < fabs(f[j]))) {
+                        next = e[i++];
+                } else {
+                        next = f[j++];
+                }
+                two_sum(q, next, &q, &hh);
+                if (hh != 0) {
+                        h[n++] = hh;
+                }
+        }
+        if (q != 0 || n == 0) {
+                h[n++] = q;
+        }
+
+        return n;
+}
+
+// h = b * e, dropping zero components. h must have room for 2 * elen
+// components and must not alias e.
+static size_t scale_expansion(size_t elen,
+                              const double e[static restrict elen],
+                              double b,
+                              double h[restrict])
+{
+        double q, sum, hh, p1, p0;
+        size_t i, n = 0;
+
+        two_product(e[0], b, &q, &hh);
+        if (hh != 0) {
+                h[n++] = hh;
+        }
+        for (i = 1; i < elen; ++i) {
+                two_product(e[i], b, &p1, &p0);
+                two_sum(q, p0, &sum, &hh);
+                if (hh != 0) {
+                        h[n++] = hh;
+                }
+                fast_two_sum(p1, sum, &q, &hh);
+                if (hh != 0) {
+                        h[n++] = hh;
+                }
+        }
+        if (q != 0 || n == 0) {
+                h[n++] = q;
+        }
+
+        return n;
+}
+
+// Exact p x q as an expansion of at most 4 components.
+static size_t cross_expansion(const vec2d *p, const vec2d *q, double h[4])
+{
+        double l[2], r[2];
+
+        two_product(vec_x(*p), vec_y(*q), &l[1], &l[0]);
+        two_product(-vec_y(*p), vec_x(*q), &r[1], &r[0]);
+
+        return expansion_sum(2, l, 2, r, h);
+}
+
+// Exact orientation determinant, a x b + b x c + c x a, as an expansion of at
+// most 12 components.
+static size_t orient2d_expansion(const vec2d *a,
+                                 const vec2d *b,
+                                 const vec2d *c,
+                                 double h[12])
+{
+        double ab[4], bc[4], ca[4], abbc[8];
+        size_t ablen, bclen, calen, abbclen;
+
+        ablen = cross_expansion(a, b, ab);
+        bclen = cross_expansion(b, c, bc);
+        calen = cross_expansion(c, a, ca);
+        abbclen = expansion_sum(ablen, ab, bclen, bc, abbc);
+
+        return expansion_sum(abbclen, abbc, calen, ca, h);
+}
+
+PURE_FUNC double orient2d(const vec2d *a, const vec2d *b, const vec2d *c)
+{
+        double detleft, detright, det, detsum, exact[12];
+        size_t n;
+
+        detleft = (vec_x(*a) - vec_x(*c)) * (vec_y(*b) - vec_y(*c));
+        detright = (vec_y(*a) - vec_y(*c)) * (vec_x(*b) - vec_x(*c));
+        det = detleft - detright;
+
+        // if the products have different signs, no cancellation can occur
+        if (detleft > 0) {
+                if (detright <= 0) {
+                        return det;
+                }
+                detsum = detleft + detright;
+        } else if (detleft < 0) {
+                if (detright >= 0) {
+                        return det;
+                }
+                detsum = -detleft - detright;
+        } else {
+                return det;
+        }
+
+        if (fabs(det) >= ORIENT2D_ERRBOUND * detsum) {
+                return det;
+        }
+
+        n = orient2d_expansion(a, b, c, exact);
+        return exact[n - 1];
+}
+
+// Exact (px^2 + py^2) * sign * o, where o is an orientation expansion.
+static size_t lift_expansion(const vec2d *p,
+                             double sign,
+                             size_t olen,
+                             const double o[static olen],
+                             double h[96])
+{
+        double ox[24], oxx[48], oy[24], oyy[48];
+        size_t oxlen, oxxlen, oylen, oyylen;
+
+        oxlen = scale_expansion(olen, o, vec_x(*p), ox);
+        oxxlen = scale_expansion(oxlen, ox, sign * vec_x(*p), oxx);
+        oylen = scale_expansion(olen, o, vec_y(*p), oy);
+        oyylen = scale_expansion(oylen, oy, sign * vec_y(*p), oyy);
+
+        return expansion_sum(oxxlen, oxx, oyylen, oyy, h);
+}
+
+// The 4x4 determinant with rows (x, y, x^2 + y^2, 1), expanded along the
+// lifted column into four orientation determinants.
+static double incircle_exact(const vec2d *a,
+                             const vec2d *b,
+                             const vec2d *c,
+                             const vec2d *d)
+{
+        double o[12], adet[96], bdet[96], cdet[96], ddet[96];
+        double abdet[192], cddet[192], det[384];
+        size_t olen, alen, blen, clen, dlen, ablen, cdlen, n;
+
+        olen = orient2d_expansion(b, c, d, o);
+        alen = lift_expansion(a, 1, olen, o, adet);
+        olen = orient2d_expansion(a, c, d, o);
+        blen = lift_expansion(b, -1, olen, o, bdet);
+        olen = orient2d_expansion(a, b, d, o);
+        clen = lift_expansion(c, 1, olen, o, cdet);
+        olen = orient2d_expansion(a, b, c, o);
+        dlen = lift_expansion(d, -1, olen, o, ddet);
+
+        ablen = expansion_sum(alen, adet, blen, bdet, abdet);
+        cdlen = expansion_sum(clen, cdet, dlen, ddet, cddet);
+        n = expansion_sum(ablen, abdet, cdlen, cddet, det);
+
+        return det[n - 1];
+}
+
+PURE_FUNC double incircle(const vec2d *a,
+                          const vec2d *b,
+                          const vec2d *c,
+                          const vec2d *d)
+{
+        double adx, ady, bdx, bdy, cdx, cdy;
+        double bdxcdy, cdxbdy, cdxady, adxcdy, adxbdy, bdxady;
+        double alift, blift, clift, det, permanent;
+
+        adx = vec_x(*a) - vec_x(*d);
+        ady = vec_y(*a) - vec_y(*d);
+        bdx = vec_x(*b) - vec_x(*d);
+        bdy = vec_y(*b) - vec_y(*d);
+        cdx = vec_x(*c) - vec_x(*d);
+        cdy = vec_y(*c) - vec_y(*d);
+
+        bdxcdy = bdx * cdy;
+        cdxbdy = cdx * bdy;
+        alift = adx * adx + ady * ady;
+
+        cdxady = cdx * ady;
+        adxcdy = adx * cdy;
+        blift = bdx * bdx + bdy * bdy;
+
+        adxbdy = adx * bdy;
+        bdxady = bdx * ady;
+        clift = cdx * cdx + cdy * cdy;
+
+        det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy)
+            + clift * (adxbdy - bdxady);
+        permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * alift
+                  + (fabs(cdxady) + fabs(adxcdy)) * blift
+                  + (fabs(adxbdy) + fabs(bdxady)) * clift;
+
+        if (fabs(det) > INCIRCLE_ERRBOUND * permanent) {
+                return det;
+        }
+
+        return incircle_exact(a, b, c, d);
+}
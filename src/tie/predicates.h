@@ -0,0 +1,57 @@
+/*! \file predicates.h
+ *  \brief Robust geometric predicates
+ *
+ *  The predicates in this file always return the correct sign, no matter how
+ *  close to degenerate their input is. They first evaluate the determinant
+ *  in plain floating-point arithmetic together with a bound on its rounding
+ *  error; only if the bound doesn't rule out the wrong sign is the
+ *  determinant evaluated again with exact expansion arithmetic, as described
+ *  by Shewchuk in "Adaptive Precision Floating-Point Arithmetic and Fast
+ *  Robust Geometric Predicates". For the vast majority of inputs the first,
+ *  cheap evaluation is enough.
+ *
+ *  The implementation relies on IEEE 754 round-to-nearest arithmetic and must
+ *  not be compiled with -ffast-math or similar flags.
+ */
+#ifndef TIE_PREDICATES_H
+#define TIE_PREDICATES_H
+
+#include "attrib.h"
+#include "math.h"
+
+/*! \brief Computes the orientation of three points.
+ *
+ *  \param[in] a First point.
+ *  \param[in] b Second point.
+ *  \param[in] c Third point.
+ *
+ *  \return A positive value if `a`, `b` and `c` are in counter-clockwise
+ *  order, a negative value if they're in clockwise order and zero if they're
+ *  colinear. The value approximates twice the signed area of the triangle,
+ *  but only its sign is guaranteed to be exact.
+ */
+extern PURE_FUNC double orient2d(const vec2d *a,
+                                 const vec2d *b,
+                                 const vec2d *c);
+
+/*! \brief Tests whether a point lies inside the circle through three others.
+ *
+ *  \param[in] a First point on the circle.
+ *  \param[in] b Second point on the circle.
+ *  \param[in] c Third point on the circle.
+ *  \param[in] d The point to test.
+ *
+ *  \return A positive value if `d` lies inside the circle, a negative value
+ *  if it lies outside and zero if the four points are cocircular, provided
+ *  that `a`, `b` and `c` are in counter-clockwise order; the sign is
+ *  reversed otherwise. Only the sign of the result is guaranteed to be
+ *  exact.
+ *
+ *  \sa orient2d()
+ */
+extern PURE_FUNC double incircle(const vec2d *a,
+                                 const vec2d *b,
+                                 const vec2d *c,
+                                 const vec2d *d);
+
+#endif
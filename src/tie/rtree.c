@@ -0,0 +1,840 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "algo.h"
+#include "array.h"
+#include "functional.h"
+#include "math.h"
+#include "numeric.h"
+#include "rtree.h"
+
+// Amount of entries distributed between two nodes during a split.
+#define RTREE_SPLIT_SIZE (RTREE_MAX_ENTRIES + 1)
+// Depth-first traversals push at most every entry of one node per level.
+#define RTREE_STACK_SIZE (RTREE_MAX_HEIGHT * RTREE_MAX_ENTRIES)
+
+#define rtree_cmp_min_x(a, b)                                                  \
+        compare(vec_x((a).bounds.min), vec_x((b).bounds.min))
+#define rtree_cmp_max_x(a, b)                                                  \
+        compare(vec_x((a).bounds.max), vec_x((b).bounds.max))
+#define rtree_cmp_min_y(a, b)                                                  \
+        compare(vec_y((a).bounds.min), vec_y((b).bounds.min))
+#define rtree_cmp_max_y(a, b)                                                  \
+        compare(vec_y((a).bounds.max), vec_y((b).bounds.max))
+
+static inline void rtree_node_bounds(aabb2d *restrict out,
+                                     const RTreeNode *restrict node)
+{
+        const RTreeEntry *e;
+
+        empty_aabb2d(out);
+        traverse(e, node->entries, node->entries + node->count) {
+                union_aabb2d(out, &e->bounds);
+        }
+}
+
+static inline uint32_t rtree_node_alloc(RTree *tree, uint16_t level)
+{
+        uint32_t i;
+
+        if (tree->free_count > 0) {
+                i = tree->free_node;
+                tree->free_node = tree->nodes[i].parent;
+                tree->free_count -= 1;
+        } else {
+                assert(tree->node_count < tree->nodes_sz);
+                i = tree->node_count++;
+        }
+
+        tree->nodes[i].parent = RTREE_NIL;
+        tree->nodes[i].level = level;
+        tree->nodes[i].count = 0;
+
+        return i;
+}
+
+static inline void rtree_node_free(RTree *tree, uint32_t i)
+{
+        tree->nodes[i].parent = tree->free_node;
+        tree->free_node = i;
+        tree->free_count += 1;
+}
+
+// Makes sure that at least n nodes can be allocated without reallocating.
+static inline int rtree_reserve(RTree *tree,
+                                size_t n,
+                                Reallocator *reallocator,
+                                void *user)
+{
+        size_t nodes_sz = tree->nodes_sz;
+        RTreeNode *nodes = tree->nodes;
+
+        if (tree->free_count + (nodes_sz - tree->node_count) >= n) {
+                return 0;
+        }
+        assert(tree->node_count + n - tree->free_count < RTREE_NIL);
+        if (!auxiliary_realloc(reallocator,
+                               &nodes_sz,
+                               &nodes,
+                               &tree->nodes_sz,
+                               &tree->nodes,
+                               tree->node_count + n - tree->free_count,
+                               user)) {
+                return -1;
+        }
+
+        return 0;
+}
+
+static inline void rtree_adopt(RTree *tree, uint32_t i)
+{
+        RTreeNode *node = &tree->nodes[i];
+        const RTreeEntry *e;
+
+        if (node->level == 0) {
+                return;
+        }
+        traverse(e, node->entries, node->entries + node->count) {
+                tree->nodes[e->id].parent = i;
+        }
+}
+
+static inline RTreeEntry *rtree_parent_entry(RTree *tree, uint32_t i)
+{
+        RTreeNode *parent = &tree->nodes[tree->nodes[i].parent];
+        RTreeEntry *e;
+
+        find_by(e,
+                e->id == i,
+                parent->entries,
+                parent->entries + parent->count);
+        assert(e < parent->entries + parent->count);
+
+        return e;
+}
+
+void rtree_init(RTree *restrict tree,
+                size_t nodes_sz,
+                RTreeNode nodes[static restrict nodes_sz])
+{
+        assert(nodes_sz > 0);
+
+        tree->size = 0;
+        tree->free_node = RTREE_NIL;
+        tree->free_count = 0;
+        tree->node_count = 0;
+        tree->nodes_sz = nodes_sz;
+        tree->nodes = nodes;
+        tree->root = rtree_node_alloc(tree, 0);
+}
+
+// R*-tree subtree choice: minimize overlap enlargement when choosing among
+// leaves, area enlargement otherwise. Ties are broken by the smaller area.
+static uint32_t rtree_choose_subtree(const RTree *restrict tree,
+                                     const aabb2d *restrict bounds,
+                                     uint16_t level)
+{
+        const RTreeNode *node;
+        const RTreeEntry *e, *f, *best;
+        aabb2d grown;
+        double overlap, enlargement, area;
+        double best_overlap, best_enlargement, best_area;
+        uint32_t i = tree->root;
+
+        while ((node = &tree->nodes[i])->level > level) {
+                best = node->entries;
+                best_overlap = best_enlargement = best_area = DBL_MAX;
+                traverse(e, node->entries, node->entries + node->count) {
+                        grown = e->bounds;
+                        union_aabb2d(&grown, bounds);
+                        area = area_aabb2d(&e->bounds);
+                        enlargement = area_aabb2d(&grown) - area;
+                        overlap = 0;
+                        if (node->level == 1) {
+                                traverse(f,
+                                         node->entries,
+                                         node->entries + node->count) {
+                                        if (f == e) {
+                                                continue;
+                                        }
+                                        overlap += overlap_aabb2d(&grown,
+                                                                  &f->bounds)
+                                                 - overlap_aabb2d(&e->bounds,
+                                                                  &f->bounds);
+                                }
+                        }
+                        if (overlap > best_overlap
+                            || (overlap == best_overlap
+                                && (enlargement > best_enlargement
+                                    || (enlargement == best_enlargement
+                                        && area >= best_area)))) {
+                                continue;
+                        }
+                        best = e;
+                        best_overlap = overlap;
+                        best_enlargement = enlargement;
+                        best_area = area;
+                }
+                i = best->id;
+        }
+
+        return i;
+}
+
+static void rtree_sort_entries(RTreeEntry entries[static RTREE_SPLIT_SIZE],
+                               int key)
+{
+        RTreeEntry *p, *q, temp;
+
+        switch (key) {
+        case 0:
+                insertion_sort(p,
+                               q,
+                               entries,
+                               entries + RTREE_SPLIT_SIZE,
+                               rtree_cmp_min_x,
+                               temp);
+                break;
+        case 1:
+                insertion_sort(p,
+                               q,
+                               entries,
+                               entries + RTREE_SPLIT_SIZE,
+                               rtree_cmp_max_x,
+                               temp);
+                break;
+        case 2:
+                insertion_sort(p,
+                               q,
+                               entries,
+                               entries + RTREE_SPLIT_SIZE,
+                               rtree_cmp_min_y,
+                               temp);
+                break;
+        default:
+                insertion_sort(p,
+                               q,
+                               entries,
+                               entries + RTREE_SPLIT_SIZE,
+                               rtree_cmp_max_y,
+                               temp);
+                break;
+        }
+}
+
+// prefix[i] bounds entries [0, i], suffix[i] bounds [i, RTREE_SPLIT_SIZE).
+static void rtree_split_bounds(
+        const RTreeEntry entries[static restrict RTREE_SPLIT_SIZE],
+        aabb2d prefix[static restrict RTREE_SPLIT_SIZE],
+        aabb2d suffix[static restrict RTREE_SPLIT_SIZE])
+{
+        size_t i;
+
+        prefix[0] = entries[0].bounds;
+        for (i = 1; i < RTREE_SPLIT_SIZE; ++i) {
+                prefix[i] = prefix[i - 1];
+                union_aabb2d(&prefix[i], &entries[i].bounds);
+        }
+        suffix[RTREE_SPLIT_SIZE - 1] = entries[RTREE_SPLIT_SIZE - 1].bounds;
+        for (i = RTREE_SPLIT_SIZE - 1; i > 0; --i) {
+                suffix[i - 1] = suffix[i];
+                union_aabb2d(&suffix[i - 1], &entries[i - 1].bounds);
+        }
+}
+
+// R*-tree split: choose the axis with the smallest sum of margins over all
+// distributions, then the distribution on that axis with the least overlap,
+// breaking ties by total area. Sorts the entries so that the first group
+// comes first and returns its size.
+static size_t rtree_split(RTreeEntry entries[static RTREE_SPLIT_SIZE])
+{
+        aabb2d prefix[RTREE_SPLIT_SIZE], suffix[RTREE_SPLIT_SIZE];
+        double margin, overlap, area;
+        double best_margin = DBL_MAX, best_overlap = DBL_MAX,
+               best_area = DBL_MAX;
+        int axis, key, best_axis = 0, best_key = 0;
+        size_t k, best_k = RTREE_MIN_ENTRIES;
+
+        for (axis = 0; axis < 2; ++axis) {
+                margin = 0;
+                for (key = 2 * axis; key < 2 * axis + 2; ++key) {
+                        rtree_sort_entries(entries, key);
+                        rtree_split_bounds(entries, prefix, suffix);
+                        for (k = RTREE_MIN_ENTRIES;
+                             k <= RTREE_SPLIT_SIZE - RTREE_MIN_ENTRIES;
+                             ++k) {
+                                margin += margin_aabb2d(&prefix[k - 1])
+                                        + margin_aabb2d(&suffix[k]);
+                        }
+                }
+                if (margin < best_margin) {
+                        best_margin = margin;
+                        best_axis = axis;
+                }
+        }
+
+        for (key = 2 * best_axis; key < 2 * best_axis + 2; ++key) {
+                rtree_sort_entries(entries, key);
+                rtree_split_bounds(entries, prefix, suffix);
+                for (k = RTREE_MIN_ENTRIES;
+                     k <= RTREE_SPLIT_SIZE - RTREE_MIN_ENTRIES;
+                     ++k) {
+                        overlap = overlap_aabb2d(&prefix[k - 1], &suffix[k]);
+                        area = area_aabb2d(&prefix[k - 1])
+                             + area_aabb2d(&suffix[k]);
+                        if (overlap < best_overlap
+                            || (overlap == best_overlap && area < best_area)) {
+                                best_overlap = overlap;
+                                best_area = area;
+                                best_key = key;
+                                best_k = k;
+                        }
+                }
+        }
+
+        if (best_key != 2 * best_axis + 1) {
+                rtree_sort_entries(entries, best_key);
+        }
+
+        return best_k;
+}
+
+// Inserts an entry into a node on the given level, splitting nodes on the
+// way up as needed. Enough nodes must have been reserved beforehand.
+static void rtree_insert_entry(RTree *restrict tree,
+                               const RTreeEntry *restrict entry,
+                               uint16_t level)
+{
+        RTreeEntry all[RTREE_SPLIT_SIZE], carry = *entry;
+        RTreeNode *node, *split, *root;
+        uint32_t i, sibling;
+        size_t k;
+
+        i = rtree_choose_subtree(tree, &entry->bounds, level);
+
+        while ((node = &tree->nodes[i])->count == RTREE_MAX_ENTRIES) {
+                memcpy(all, node->entries, sizeof(node->entries));
+                all[RTREE_MAX_ENTRIES] = carry;
+                k = rtree_split(all);
+
+                sibling = rtree_node_alloc(tree, node->level);
+                split = &tree->nodes[sibling];
+                memcpy(node->entries, all, k * sizeof(*all));
+                node->count = k;
+                memcpy(split->entries,
+                       all + k,
+                       (RTREE_SPLIT_SIZE - k) * sizeof(*all));
+                split->count = RTREE_SPLIT_SIZE - k;
+                rtree_adopt(tree, i);
+                rtree_adopt(tree, sibling);
+
+                if (i == tree->root) {
+                        tree->root = rtree_node_alloc(tree, node->level + 1);
+                        root = &tree->nodes[tree->root];
+                        root->count = 2;
+                        rtree_node_bounds(&root->entries[0].bounds, node);
+                        root->entries[0].id = i;
+                        rtree_node_bounds(&root->entries[1].bounds, split);
+                        root->entries[1].id = sibling;
+                        rtree_adopt(tree, tree->root);
+                        return;
+                }
+
+                // the split node shrinks, the sibling is carried up
+                rtree_node_bounds(&rtree_parent_entry(tree, i)->bounds, node);
+                rtree_node_bounds(&carry.bounds, split);
+                carry.id = sibling;
+                i = node->parent;
+        }
+
+        node->entries[node->count] = carry;
+        node->count += 1;
+        if (node->level > 0) {
+                tree->nodes[carry.id].parent = i;
+        }
+
+        // Every ancestor now bounds its old contents plus the new entry.
+        while (i != tree->root) {
+                union_aabb2d(&rtree_parent_entry(tree, i)->bounds,
+                             &entry->bounds);
+                i = tree->nodes[i].parent;
+        }
+}
+
+int rtree_insert(RTree *restrict tree,
+                 const aabb2d *restrict bounds,
+                 uint32_t id,
+                 Reallocator *reallocator,
+                 void *user)
+{
+        RTreeEntry entry;
+
+        // a split on every level and a new root at worst
+        if (rtree_reserve(tree,
+                          tree->nodes[tree->root].level + 2,
+                          reallocator,
+                          user)) {
+                return -1;
+        }
+
+        entry.bounds = *bounds;
+        entry.id = id;
+        rtree_insert_entry(tree, &entry, 0);
+        tree->size += 1;
+
+        return 0;
+}
+
+static uint32_t rtree_find_leaf(const RTree *restrict tree,
+                                const aabb2d *restrict bounds,
+                                uint32_t id,
+                                size_t *restrict index)
+{
+        uint32_t stack[RTREE_STACK_SIZE], *top = stack;
+        const RTreeNode *node;
+        const RTreeEntry *e;
+
+        *top++ = tree->root;
+        while (top != stack) {
+                node = &tree->nodes[*--top];
+                traverse(e, node->entries, node->entries + node->count) {
+                        if (!contains_aabb2d(&e->bounds, bounds)) {
+                                continue;
+                        }
+                        if (node->level > 0) {
+                                *top++ = e->id;
+                        } else if (e->id == id) {
+                                *index = e - node->entries;
+                                return node - tree->nodes;
+                        }
+                }
+        }
+
+        return RTREE_NIL;
+}
+
+// Fixes up the tree after an entry was removed from node i. Underflowing
+// nodes are merged into the sibling that grows the least, or, if that
+// sibling is too full, take its entries closest to them.
+static void rtree_condense(RTree *tree, uint32_t i)
+{
+        RTreeNode *node, *parent, *sibling;
+        RTreeEntry *entry, *e, *f, *best;
+        aabb2d bounds, grown;
+        double enlargement, best_enlargement;
+        uint32_t p, old_root;
+
+        while (i != tree->root) {
+                node = &tree->nodes[i];
+                p = node->parent;
+                parent = &tree->nodes[p];
+                entry = rtree_parent_entry(tree, i);
+
+                if (node->count >= RTREE_MIN_ENTRIES) {
+                        rtree_node_bounds(&entry->bounds, node);
+                        i = p;
+                        continue;
+                }
+
+                rtree_node_bounds(&bounds, node);
+                best = NULL;
+                best_enlargement = DBL_MAX;
+                traverse(e, parent->entries, parent->entries + parent->count) {
+                        if (e == entry) {
+                                continue;
+                        }
+                        grown = e->bounds;
+                        union_aabb2d(&grown, &bounds);
+                        enlargement = area_aabb2d(&grown)
+                                    - area_aabb2d(&e->bounds);
+                        if (enlargement < best_enlargement) {
+                                best = e;
+                                best_enlargement = enlargement;
+                        }
+                }
+                // non-root inner nodes always have at least two children
+                assert(best);
+                sibling = &tree->nodes[best->id];
+
+                if (sibling->count + node->count <= RTREE_MAX_ENTRIES) {
+                        memcpy(sibling->entries + sibling->count,
+                               node->entries,
+                               node->count * sizeof(*node->entries));
+                        sibling->count += node->count;
+                        rtree_adopt(tree, best->id);
+                        union_aabb2d(&best->bounds, &bounds);
+                        *entry = parent->entries[parent->count - 1];
+                        parent->count -= 1;
+                        rtree_node_free(tree, i);
+                        i = p;
+                        continue;
+                }
+
+                while (node->count < RTREE_MIN_ENTRIES) {
+                        best_enlargement = DBL_MAX;
+                        f = sibling->entries;
+                        traverse(e,
+                                 sibling->entries,
+                                 sibling->entries + sibling->count) {
+                                grown = e->bounds;
+                                union_aabb2d(&grown, &bounds);
+                                enlargement = area_aabb2d(&grown)
+                                            - area_aabb2d(&bounds);
+                                if (enlargement < best_enlargement) {
+                                        f = e;
+                                        best_enlargement = enlargement;
+                                }
+                        }
+                        union_aabb2d(&bounds, &f->bounds);
+                        node->entries[node->count] = *f;
+                        node->count += 1;
+                        *f = sibling->entries[sibling->count - 1];
+                        sibling->count -= 1;
+                }
+                rtree_adopt(tree, i);
+                entry->bounds = bounds;
+                rtree_node_bounds(&best->bounds, sibling);
+                i = p;
+        }
+
+        while (tree->nodes[tree->root].level > 0
+               && tree->nodes[tree->root].count == 1) {
+                old_root = tree->root;
+                tree->root = tree->nodes[old_root].entries[0].id;
+                tree->nodes[tree->root].parent = RTREE_NIL;
+                rtree_node_free(tree, old_root);
+        }
+}
+
+bool rtree_remove(RTree *restrict tree,
+                  const aabb2d *restrict bounds,
+                  uint32_t id)
+{
+        RTreeNode *leaf;
+        size_t index;
+        uint32_t i;
+
+        i = rtree_find_leaf(tree, bounds, id, &index);
+        if (i == RTREE_NIL) {
+                return false;
+        }
+
+        leaf = &tree->nodes[i];
+        leaf->entries[index] = leaf->entries[leaf->count - 1];
+        leaf->count -= 1;
+        tree->size -= 1;
+        rtree_condense(tree, i);
+
+        return true;
+}
+
+PURE_FUNC static inline size_t rtree_level_nodes(size_t k)
+{
+        return k <= RTREE_MAX_ENTRIES ? 1 : div_ceil(k, RTREE_MAX_ENTRIES);
+}
+
+static int rtree_compare_center_x(const void *a, const void *b)
+{
+        const RTreeEntry *p = a, *q = b;
+
+        return compare(vec_x(p->bounds.min) + vec_x(p->bounds.max),
+                       vec_x(q->bounds.min) + vec_x(q->bounds.max));
+}
+
+static int rtree_compare_center_y(const void *a, const void *b)
+{
+        const RTreeEntry *p = a, *q = b;
+
+        return compare(vec_y(p->bounds.min) + vec_y(p->bounds.max),
+                       vec_y(q->bounds.min) + vec_y(q->bounds.max));
+}
+
+// Orders k entries that are to be packed into m nodes: the entries are cut
+// into vertical slices of about sqrt(m) nodes each and every slice is
+// ordered from bottom to top.
+static void rtree_tile(size_t k, RTreeEntry entries[static k], size_t m)
+{
+        size_t slice, i;
+
+        qsort(entries, k, sizeof(*entries), rtree_compare_center_x);
+        slice = div_ceil(m, (size_t)ceil(sqrt((double)m))) * RTREE_MAX_ENTRIES;
+        for (i = 0; i < k; i += slice) {
+                qsort(entries + i,
+                      min(slice, k - i),
+                      sizeof(*entries),
+                      rtree_compare_center_y);
+        }
+}
+
+int rtree_bulk_load(RTree *restrict tree,
+                    size_t n,
+                    RTreeEntry items[static restrict n],
+                    Reallocator *reallocator,
+                    void *user)
+{
+        size_t nodes_sz = tree->nodes_sz, needed = 0, k, m, j, begin, end;
+        RTreeNode *nodes = tree->nodes, *node;
+        uint16_t level = 0;
+        uint32_t i;
+
+        k = n;
+        do {
+                k = rtree_level_nodes(k);
+                needed += k;
+        } while (k > 1);
+
+        assert(needed < RTREE_NIL);
+        if (needed > nodes_sz
+            && !auxiliary_realloc(reallocator,
+                                  &nodes_sz,
+                                  &nodes,
+                                  &tree->nodes_sz,
+                                  &tree->nodes,
+                                  needed,
+                                  user)) {
+                return -1;
+        }
+
+        tree->size = n;
+        tree->free_node = RTREE_NIL;
+        tree->free_count = 0;
+        tree->node_count = 0;
+        if (n == 0) {
+                tree->root = rtree_node_alloc(tree, 0);
+                return 0;
+        }
+
+        // Pack each level as evenly as possible, so that no node ends up with
+        // less than RTREE_MIN_ENTRIES. The entries of the next level are
+        // written over the beginning of the array, which has already been
+        // consumed by then.
+        k = n;
+        do {
+                m = rtree_level_nodes(k);
+                rtree_tile(k, items, m);
+                for (j = 0; j < m; ++j) {
+                        begin = j * k / m;
+                        end = (j + 1) * k / m;
+                        i = rtree_node_alloc(tree, level);
+                        node = &tree->nodes[i];
+                        memcpy(node->entries,
+                               items + begin,
+                               (end - begin) * sizeof(*items));
+                        node->count = end - begin;
+                        rtree_adopt(tree, i);
+                        rtree_node_bounds(&items[j].bounds, node);
+                        items[j].id = i;
+                }
+                k = m;
+                ++level;
+        } while (k > 1);
+
+        tree->root = items[0].id;
+
+        return 0;
+}
+
+uint32_t *rtree_search(const RTree *restrict tree,
+                       const aabb2d *restrict window,
+                       size_t *restrict pout_sz,
+                       uint32_t *restrict *restrict pout,
+                       Reallocator *reallocator,
+                       void *user)
+{
+        uint32_t stack[RTREE_STACK_SIZE], *top = stack, *out = *pout;
+        size_t out_sz = *pout_sz, count = 0;
+        const RTreeNode *node;
+        const RTreeEntry *e;
+
+        *top++ = tree->root;
+        while (top != stack) {
+                node = &tree->nodes[*--top];
+                traverse(e, node->entries, node->entries + node->count) {
+                        if (!overlaps_aabb2d(&e->bounds, window)) {
+                                continue;
+                        }
+                        if (node->level > 0) {
+                                *top++ = e->id;
+                                continue;
+                        }
+                        if (count == out_sz
+                            && !auxiliary_realloc(reallocator,
+                                                  &out_sz,
+                                                  &out,
+                                                  pout_sz,
+                                                  pout,
+                                                  out_sz + 1,
+                                                  user)) {
+                                return NULL;
+                        }
+                        out[count++] = e->id;
+                }
+        }
+
+        return out + count;
+}
+
+static inline void rtree_queue_push(size_t *restrict n,
+                                    RTreeCandidate queue[restrict],
+                                    const RTreeCandidate *restrict c)
+{
+        size_t i = *n;
+
+        while (i > 0 && queue[(i - 1) / 2].sqrdist > c->sqrdist) {
+                queue[i] = queue[(i - 1) / 2];
+                i = (i - 1) / 2;
+        }
+        queue[i] = *c;
+        *n += 1;
+}
+
+static inline void rtree_queue_pop(size_t *restrict n,
+                                   RTreeCandidate queue[restrict])
+{
+        RTreeCandidate last;
+        size_t i = 0, j;
+
+        *n -= 1;
+        last = queue[*n];
+        while ((j = 2 * i + 1) < *n) {
+                if (j + 1 < *n && queue[j + 1].sqrdist < queue[j].sqrdist) {
+                        ++j;
+                }
+                if (last.sqrdist <= queue[j].sqrdist) {
+                        break;
+                }
+                queue[i] = queue[j];
+                i = j;
+        }
+        queue[i] = last;
+}
+
+RTreeNeighbour *rtree_nearest(const RTree *restrict tree,
+                              const vec2d *restrict p,
+                              size_t k,
+                              RTreeNeighbour out[static restrict k],
+                              size_t *restrict paux_sz,
+                              RTreeCandidate *restrict *restrict paux,
+                              Reallocator *reallocator,
+                              void *user)
+{
+        RTreeCandidate *queue = *paux, top, c;
+        size_t queue_sz = *paux_sz, n = 0, count = 0;
+        const RTreeNode *node;
+        const RTreeEntry *e;
+
+        assert(queue_sz > 0);
+
+        if (k == 0 || tree->size == 0) {
+                return out;
+        }
+
+        c.sqrdist = 0;
+        c.id = tree->root;
+        c.level = tree->nodes[tree->root].level + 1;
+        rtree_queue_push(&n, queue, &c);
+
+        while (n > 0 && count < k) {
+                top = queue[0];
+                rtree_queue_pop(&n, queue);
+                if (top.level == 0) {
+                        out[count].id = top.id;
+                        out[count].sqrdist = top.sqrdist;
+                        ++count;
+                        continue;
+                }
+
+                node = &tree->nodes[top.id];
+                if (n + node->count > queue_sz
+                    && !auxiliary_realloc(reallocator,
+                                          &queue_sz,
+                                          &queue,
+                                          paux_sz,
+                                          paux,
+                                          n + node->count,
+                                          user)) {
+                        return NULL;
+                }
+                // children of a node on level l are on level l - 1, or
+                // items if l is 0
+                traverse(e, node->entries, node->entries + node->count) {
+                        c.sqrdist = sqrdist_aabb2d(&e->bounds, p);
+                        c.id = e->id;
+                        c.level = node->level;
+                        rtree_queue_push(&n, queue, &c);
+                }
+        }
+
+        return out + count;
+}
+
+RTreePair *rtree_overlapping_pairs(const RTree *restrict tree,
+                                   size_t *restrict pout_sz,
+                                   RTreePair *restrict *restrict pout,
+                                   size_t *restrict paux_sz,
+                                   RTreePair *restrict *restrict paux,
+                                   Reallocator *reallocator,
+                                   void *user)
+{
+        RTreePair *out = *pout, *stack = *paux, pair;
+        size_t out_sz = *pout_sz, stack_sz = *paux_sz, count = 0, top = 0;
+        const RTreeNode *a, *b;
+        const RTreeEntry *e, *f;
+
+        assert(stack_sz > 0);
+
+        stack[top].a = tree->root;
+        stack[top].b = tree->root;
+        ++top;
+
+        while (top > 0) {
+                pair = stack[--top];
+                a = &tree->nodes[pair.a];
+                b = &tree->nodes[pair.b];
+                // Within a single node every unordered pair of entries is
+                // visited once; inner nodes are also paired with themselves.
+                traverse(e, a->entries, a->entries + a->count) {
+                        traverse(f,
+                                 a == b ? e : b->entries,
+                                 b->entries + b->count) {
+                                if ((f == e && a->level == 0)
+                                    || !overlaps_aabb2d(&e->bounds,
+                                                        &f->bounds)) {
+                                        continue;
+                                }
+                                if (a->level > 0) {
+                                        if (top == stack_sz
+                                            && !auxiliary_realloc(reallocator,
+                                                                  &stack_sz,
+                                                                  &stack,
+                                                                  paux_sz,
+                                                                  paux,
+                                                                  stack_sz + 1,
+                                                                  user)) {
+                                                return NULL;
+                                        }
+                                        stack[top].a = e->id;
+                                        stack[top].b = f->id;
+                                        ++top;
+                                        continue;
+                                }
+                                if (count == out_sz
+                                    && !auxiliary_realloc(reallocator,
+                                                          &out_sz,
+                                                          &out,
+                                                          pout_sz,
+                                                          pout,
+                                                          out_sz + 1,
+                                                          user)) {
+                                        return NULL;
+                                }
+                                out[count].a = e->id;
+                                out[count].b = f->id;
+                                ++count;
+                        }
+                }
+        }
+
+        return out + count;
+}
@@ -0,0 +1,225 @@
+/*! \file rtree.h
+ *  \brief Dynamic R*-tree over axis-aligned bounding boxes
+ *
+ *  The tree indexes pairs of a bounding box and a 32-bit item ID, usually the
+ *  index of an object. Nodes live in a single array owned by the user, which
+ *  is grown through the usual reallocator protocol (see algo.h) whenever the
+ *  tree runs out of nodes. Removed nodes are recycled through a free list, so
+ *  the array never shrinks.
+ *
+ *  Insertion follows the R*-tree heuristics for choosing a subtree and for
+ *  splitting overflowing nodes. Underflowing nodes left after a removal are
+ *  merged with or refilled from a sibling, so removals never allocate.
+ *  Bulk loading packs the tree with the Sort-Tile-Recursive algorithm.
+ */
+#ifndef TIE_RTREE_H
+#define TIE_RTREE_H
+
+#include <stdint.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "math.h"
+
+#define RTREE_MAX_ENTRIES 16
+#define RTREE_MIN_ENTRIES 6
+// With at least RTREE_MIN_ENTRIES per node, 16 levels are enough for
+// any 32-bit amount of items.
+#define RTREE_MAX_HEIGHT 16
+#define RTREE_NIL UINT32_MAX
+
+/*! \brief A bounding box together with the item or node it bounds.
+ *
+ *  In leaves, `id` is the ID of the indexed item; in inner nodes, it is the
+ *  index of the child node.
+ */
+typedef struct {
+        aabb2d bounds;
+        uint32_t id;
+} RTreeEntry;
+
+typedef struct {
+        uint32_t parent; // RTREE_NIL for the root; next free node if freed
+        uint16_t level; // leaves are on level 0
+        uint16_t count;
+        RTreeEntry entries[RTREE_MAX_ENTRIES];
+} RTreeNode;
+
+typedef struct {
+        size_t size; // amount of indexed items
+        uint32_t root;
+        uint32_t free_node; // head of the free node list
+        uint32_t free_count;
+        uint32_t node_count; // nodes handed out from `nodes` so far
+        size_t nodes_sz;
+        RTreeNode *nodes;
+} RTree;
+
+typedef struct {
+        uint32_t id;
+        double sqrdist;
+} RTreeNeighbour;
+
+typedef struct {
+        uint32_t a;
+        uint32_t b;
+} RTreePair;
+
+/*! \brief Element of the priority queue used by rtree_nearest().
+ */
+typedef struct {
+        double sqrdist;
+        uint32_t id;
+        uint32_t level; // 0 for items, level of the node plus one otherwise
+} RTreeCandidate;
+
+/*! \brief Initializes an empty tree.
+ *
+ *  \param[out] tree The tree to initialize.
+ *  \param[in] nodes_sz Size of the `nodes` array. Must be at least 1.
+ *  \param[in] nodes The node array. Must come from an allocator compatible
+ *  with the reallocator later passed to the modifying routines.
+ */
+extern void rtree_init(RTree *restrict tree,
+                       size_t nodes_sz,
+                       RTreeNode nodes[static restrict nodes_sz]);
+
+/*! \brief Inserts an item into the tree.
+ *
+ *  Runs in \f$O(\log n)\f$. Items are not deduplicated; inserting the same
+ *  ID twice indexes it twice.
+ *
+ *  \param[in,out] tree The tree.
+ *  \param[in] bounds Bounds of the item.
+ *  \param[in] id ID of the item.
+ *  \param[in] reallocator Reallocator for the node array. May be NULL, in
+ *  which case the function fails when the node array becomes full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure. On failure the tree is
+ *  left unchanged.
+ */
+extern int rtree_insert(RTree *restrict tree,
+                        const aabb2d *restrict bounds,
+                        uint32_t id,
+                        Reallocator *reallocator,
+                        void *user);
+
+/*! \brief Removes an item from the tree.
+ *
+ *  Runs in \f$O(\log n)\f$ on average. Never allocates.
+ *
+ *  \param[in,out] tree The tree.
+ *  \param[in] bounds The bounds the item was inserted with.
+ *  \param[in] id ID of the item.
+ *
+ *  \return `true` if the item was found and removed, `false` otherwise.
+ */
+extern bool rtree_remove(RTree *restrict tree,
+                         const aabb2d *restrict bounds,
+                         uint32_t id);
+
+/*! \brief Replaces the contents of the tree with the given items.
+ *
+ *  Packs the items with the Sort-Tile-Recursive algorithm, which gives
+ *  better query performance than inserting them one by one and runs in
+ *  \f$O(n \log n)\f$.
+ *
+ *  \param[in,out] tree The tree. Any items it contains are dropped.
+ *  \param[in] n Amount of items.
+ *  \param[in,out] items The items to load. The array is used as scratch
+ *  space and its contents are unspecified after the call.
+ *  \param[in] reallocator See rtree_insert().
+ *  \param[in,out] user See rtree_insert().
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the tree
+ *  is left unchanged.
+ */
+extern int rtree_bulk_load(RTree *restrict tree,
+                           size_t n,
+                           RTreeEntry items[static restrict n],
+                           Reallocator *reallocator,
+                           void *user);
+
+/*! \brief Finds all items whose bounds overlap a window.
+ *
+ *  Writes the IDs of the items to `*pout`, in no particular order. Passing
+ *  a degenerate window finds the items under a point.
+ *
+ *  \param[in] tree The tree.
+ *  \param[in] window The query window.
+ *  \param[in,out] pout_sz Size of the output array. Modified on
+ *  reallocations.
+ *  \param[out] pout The output array. Modified on reallocations.
+ *  \param[in] reallocator Reallocator for the output array. May be NULL.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return A pointer one past the last written ID, or NULL on allocation
+ *  failure.
+ */
+extern uint32_t *rtree_search(const RTree *restrict tree,
+                              const aabb2d *restrict window,
+                              size_t *restrict pout_sz,
+                              uint32_t *restrict *restrict pout,
+                              Reallocator *reallocator,
+                              void *user);
+
+/*! \brief Finds the k items closest to a point.
+ *
+ *  Distances are measured to the bounds of the items, so for anything other
+ *  than points they are lower bounds that the caller may refine. Nodes are
+ *  visited best-first, using `*paux` as the priority queue.
+ *
+ *  \param[in] tree The tree.
+ *  \param[in] p The query point.
+ *  \param[in] k Maximum amount of neighbours to find.
+ *  \param[out] out Output array, filled in order of increasing distance.
+ *  \param[in,out] paux_sz Size of the auxiliary array. Modified on
+ *  reallocations. Initial value must be at least 1.
+ *  \param paux Auxiliary array for the priority queue. Modified on
+ *  reallocations.
+ *  \param[in] reallocator Reallocator for the auxiliary array. May be NULL.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return A pointer one past the last found neighbour, or NULL on
+ *  allocation failure.
+ */
+extern RTreeNeighbour *rtree_nearest(const RTree *restrict tree,
+                                     const vec2d *restrict p,
+                                     size_t k,
+                                     RTreeNeighbour out[static restrict k],
+                                     size_t *restrict paux_sz,
+                                     RTreeCandidate *restrict *restrict paux,
+                                     Reallocator *reallocator,
+                                     void *user);
+
+/*! \brief Enumerates all pairs of items with overlapping bounds.
+ *
+ *  This is the broad phase for intersection tests: the tree is joined with
+ *  itself, descending only into pairs of overlapping subtrees. Each pair is
+ *  reported once, in no particular order.
+ *
+ *  \param[in] tree The tree.
+ *  \param[in,out] pout_sz Size of the output array. Modified on
+ *  reallocations.
+ *  \param[out] pout The output array. Modified on reallocations.
+ *  \param[in,out] paux_sz Size of the auxiliary array. Modified on
+ *  reallocations. Initial value must be at least 1.
+ *  \param paux Auxiliary array used as a stack of node pairs. Modified on
+ *  reallocations.
+ *  \param[in] reallocator Reallocator in case the provided arrays are not
+ *  sufficient. It should handle both arrays independently. May be NULL.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return A pointer one past the last written pair, or NULL on allocation
+ *  failure.
+ */
+extern RTreePair *rtree_overlapping_pairs(const RTree *restrict tree,
+                                          size_t *restrict pout_sz,
+                                          RTreePair *restrict *restrict pout,
+                                          size_t *restrict paux_sz,
+                                          RTreePair *restrict *restrict paux,
+                                          Reallocator *reallocator,
+                                          void *user);
+
+#endif
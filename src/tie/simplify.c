@@ -0,0 +1,359 @@
+#include <math.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "array.h"
+#include "attrib.h"
+#include "functional.h"
+#include "math.h"
+#include "numeric.h"
+#include "simplify.h"
+
+// Finds the vertex in [begin, end) furthest from the line through a and b,
+// which must be distinct. Writes its distance from the line, multiplied by
+// |b - a|, to *max.
+static const vec2d *simplify_furthest(const vec2d *restrict a,
+                                      const vec2d *restrict b,
+                                      const vec2d *begin,
+                                      const vec2d *end,
+                                      double *restrict max)
+{
+        const vec2d *p = begin, *best = begin;
+        double dx, dy, d, best_d = -1;
+
+        dx = vec_x(*b) - vec_x(*a);
+        dy = vec_y(*b) - vec_y(*a);
+
+#if defined(__SSE2__)
+        // Two vertices per iteration: transpose them into a vector of X and
+        // a vector of Y coordinates and keep a running maximum per lane,
+        // together with the offset of the vertex it came from.
+        const __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(INT64_MAX));
+        const __m128d vdx = _mm_set1_pd(dx), vdy = _mm_set1_pd(dy);
+        const __m128d vax = _mm_set1_pd(vec_x(*a));
+        const __m128d vay = _mm_set1_pd(vec_y(*a));
+        const __m128d two = _mm_set1_pd(2);
+        __m128d vmax = _mm_set1_pd(-1), vbest = _mm_setzero_pd();
+        __m128d offset = _mm_set_pd(1, 0);
+        __m128d p0, p1, xs, ys, cross, greater;
+        double lane_max[2], lane_best[2];
+
+        for (; p + 1 < end; p += 2) {
+                p0 = _mm_load_pd(p[0].v);
+                p1 = _mm_load_pd(p[1].v);
+                xs = _mm_unpacklo_pd(p0, p1);
+                ys = _mm_unpackhi_pd(p0, p1);
+                cross = _mm_sub_pd(_mm_mul_pd(vdx, _mm_sub_pd(ys, vay)),
+                                   _mm_mul_pd(vdy, _mm_sub_pd(xs, vax)));
+                cross = _mm_and_pd(cross, abs_mask);
+                greater = _mm_cmpgt_pd(cross, vmax);
+                vmax = _mm_or_pd(_mm_and_pd(greater, cross),
+                                 _mm_andnot_pd(greater, vmax));
+                vbest = _mm_or_pd(_mm_and_pd(greater, offset),
+                                  _mm_andnot_pd(greater, vbest));
+                offset = _mm_add_pd(offset, two);
+        }
+
+        _mm_storeu_pd(lane_max, vmax);
+        _mm_storeu_pd(lane_best, vbest);
+        // on ties, prefer the earlier vertex like the scalar loop does
+        if (lane_max[1] > lane_max[0]
+            || (lane_max[1] == lane_max[0] && lane_best[1] < lane_best[0])) {
+                lane_max[0] = lane_max[1];
+                lane_best[0] = lane_best[1];
+        }
+        if (lane_max[0] >= 0) {
+                best_d = lane_max[0];
+                best = begin + (size_t)lane_best[0];
+        }
+#endif
+
+        for (; p < end; ++p) {
+                d = fabs(dx * (vec_y(*p) - vec_y(*a))
+                         - dy * (vec_x(*p) - vec_x(*a)));
+                if (d > best_d) {
+                        best_d = d;
+                        best = p;
+                }
+        }
+
+        *max = best_d;
+        return best;
+}
+
+// Finds the vertex in [begin, end) furthest from a. Writes the squared
+// distance to *max.
+static const vec2d *simplify_furthest_from_point(const vec2d *restrict a,
+                                                 const vec2d *begin,
+                                                 const vec2d *end,
+                                                 double *restrict max)
+{
+        const vec2d *p, *best = begin;
+        vec2d diff;
+        double d;
+
+        *max = -1;
+        traverse(p, begin, end) {
+                diff = *p;
+                sub_vec2d(&diff, a);
+                d = sqrmag_vec2d(&diff);
+                if (d > *max) {
+                        *max = d;
+                        best = p;
+                }
+        }
+
+        return best;
+}
+
+// Crossing number test of q against the polygon [begin, end).
+PURE_FUNC static bool simplify_inside(const vec2d *restrict q,
+                                      const vec2d *begin,
+                                      const vec2d *end)
+{
+        const vec2d *p, *prev = end - 1;
+        bool inside = false;
+        double t;
+
+        traverse(p, begin, end) {
+                if ((vec_y(*p) > vec_y(*q)) != (vec_y(*prev) > vec_y(*q))) {
+                        t = (vec_y(*q) - vec_y(*p))
+                          / (vec_y(*prev) - vec_y(*p));
+                        if (vec_x(*q)
+                            < vec_x(*p) + t * (vec_x(*prev) - vec_x(*p))) {
+                                inside = !inside;
+                        }
+                }
+                prev = p;
+        }
+
+        return inside;
+}
+
+// Saalfeld's sidedness test: replacing the range with a single segment can
+// only make the line strip intersect itself if some vertex outside of the
+// range lies in the polygon the range forms with that segment.
+PURE_FUNC static bool simplify_encloses(size_t n,
+                                        const vec2d polyline[static n],
+                                        const SimplifyRange *range)
+{
+        const vec2d *first = polyline + range->first;
+        const vec2d *end = polyline + range->last + 1;
+        const vec2d *p;
+        aabb2d box;
+
+        empty_aabb2d(&box);
+        traverse(p, first, end) {
+                extend_aabb2d(&box, p);
+        }
+
+        traverse(p, polyline, polyline + n) {
+                if (p == first) {
+                        p = end - 1;
+                        continue;
+                }
+                if (vec_x(*p) >= vec_x(box.min) && vec_x(*p) <= vec_x(box.max)
+                    && vec_y(*p) >= vec_y(box.min)
+                    && vec_y(*p) <= vec_y(box.max)
+                    && simplify_inside(p, first, end)) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+vec2d *polyline_simplify(size_t n,
+                         const vec2d polyline[static restrict n],
+                         vec2d out[static restrict n],
+                         SimplifyRange stack[static restrict n],
+                         double tolerance,
+                         bool preserve_topology)
+{
+        SimplifyRange *top = stack, range;
+        const vec2d *a, *b, *furthest;
+        vec2d *result = out, diff;
+        double max, sqrlen;
+        bool split;
+
+        assert(n > 0);
+        assert(n <= UINT32_MAX);
+        assert(tolerance >= 0);
+
+        *result++ = polyline[0];
+        if (n == 1) {
+                return result;
+        }
+
+        // Ranges are popped left to right, so that the last vertex of every
+        // accepted range can be output immediately. The ranges on the stack
+        // never overlap, so there are never more than n of them.
+        top->first = 0;
+        top->last = n - 1;
+        ++top;
+        while (top != stack) {
+                range = *--top;
+                a = polyline + range.first;
+                b = polyline + range.last;
+
+                if (range.last - range.first > 1) {
+                        diff = *b;
+                        sub_vec2d(&diff, a);
+                        sqrlen = sqrmag_vec2d(&diff);
+                        if (sqrlen > 0) {
+                                furthest = simplify_furthest(
+                                        a, b, a + 1, b, &max);
+                                split = max * max
+                                      > tolerance * tolerance * sqrlen;
+                        } else {
+                                furthest = simplify_furthest_from_point(
+                                        a, a + 1, b, &max);
+                                split = max > tolerance * tolerance;
+                        }
+                        if (!split && preserve_topology) {
+                                split = simplify_encloses(n, polyline, &range);
+                        }
+                        if (split) {
+                                top->first = furthest - polyline;
+                                top->last = range.last;
+                                ++top;
+                                top->first = range.first;
+                                top->last = furthest - polyline;
+                                ++top;
+                                continue;
+                        }
+                }
+
+                *result++ = *b;
+        }
+
+        return result;
+}
+
+PURE_FUNC static inline double simplify_area(const vec2d *p,
+                                             const vec2d *q,
+                                             const vec2d *r)
+{
+        vec2d pq = *q, pr = *r;
+
+        sub_vec2d(&pq, p);
+        sub_vec2d(&pr, p);
+
+        return fabs(cross_vec2d(&pq, &pr)) * 0.5;
+}
+
+static inline void simplify_heap_swap(SimplifyVertex aux[],
+                                      uint32_t i,
+                                      uint32_t j)
+{
+        uint32_t t;
+
+        swap(aux[i].heap, aux[j].heap, t);
+        aux[aux[i].heap].slot = i;
+        aux[aux[j].heap].slot = j;
+}
+
+static void simplify_sift_up(SimplifyVertex aux[], uint32_t i)
+{
+        while (i > 0
+               && aux[aux[(i - 1) / 2].heap].area > aux[aux[i].heap].area) {
+                simplify_heap_swap(aux, i, (i - 1) / 2);
+                i = (i - 1) / 2;
+        }
+}
+
+static void simplify_sift_down(SimplifyVertex aux[],
+                               uint32_t size,
+                               uint32_t i)
+{
+        uint32_t j;
+
+        while ((j = 2 * i + 1) < size) {
+                if (j + 1 < size
+                    && aux[aux[j + 1].heap].area < aux[aux[j].heap].area) {
+                        ++j;
+                }
+                if (aux[aux[i].heap].area <= aux[aux[j].heap].area) {
+                        break;
+                }
+                simplify_heap_swap(aux, i, j);
+                i = j;
+        }
+}
+
+vec2d *polyline_simplify_by_area(size_t n,
+                                 const vec2d polyline[static n],
+                                 vec2d out[static n],
+                                 SimplifyVertex aux[static restrict n],
+                                 double min_area)
+{
+        uint32_t v, size, i, neighbours[2], *u;
+        double area;
+        vec2d *result = out;
+
+        assert(n > 0);
+        assert(n <= UINT32_MAX);
+
+        // without interior vertices, there's nothing to remove
+        if (n < 3) {
+                for (v = 0; v < n; ++v) {
+                        *result++ = polyline[v];
+                }
+                return result;
+        }
+
+        // the endpoints are always kept and never enter the heap
+        aux[0].next = 1;
+        aux[n - 1].prev = n - 2;
+        size = n - 2;
+        for (v = 1; v + 1 < n; ++v) {
+                aux[v].prev = v - 1;
+                aux[v].next = v + 1;
+                aux[v].area = simplify_area(
+                        &polyline[v - 1], &polyline[v], &polyline[v + 1]);
+                aux[v - 1].heap = v;
+                aux[v].slot = v - 1;
+        }
+        for (i = size / 2; i-- > 0;) {
+                simplify_sift_down(aux, size, i);
+        }
+
+        while (size > 0 && aux[aux[0].heap].area < min_area) {
+                v = aux[0].heap;
+                area = aux[v].area;
+                simplify_heap_swap(aux, 0, size - 1);
+                --size;
+                simplify_sift_down(aux, size, 0);
+
+                neighbours[0] = aux[v].prev;
+                neighbours[1] = aux[v].next;
+                aux[neighbours[0]].next = neighbours[1];
+                aux[neighbours[1]].prev = neighbours[0];
+
+                traverse_array(u, neighbours) {
+                        if (*u == 0 || *u == n - 1) {
+                                continue;
+                        }
+                        // Clamping the area to the one just removed keeps
+                        // the removal order monotonic.
+                        aux[*u].area = simplify_area(&polyline[aux[*u].prev],
+                                                     &polyline[*u],
+                                                     &polyline[aux[*u].next]);
+                        aux[*u].area = max(aux[*u].area, area);
+                        simplify_sift_up(aux, aux[*u].slot);
+                        simplify_sift_down(aux, size, aux[*u].slot);
+                }
+        }
+
+        // Surviving vertices never come before their position in the input,
+        // so the output can overwrite it.
+        for (v = 0; v != n - 1; v = aux[v].next) {
+                *result++ = polyline[v];
+        }
+        *result++ = polyline[n - 1];
+
+        return result;
+}
@@ -0,0 +1,94 @@
+/*! \file simplify.h
+ *  \brief Polyline simplification
+ *
+ *  Routines that drop vertices from line strips, such as the ones produced by
+ *  bezier_discretize(), while keeping them within a given tolerance of the
+ *  original. None of them recurse or allocate; any bookkeeping they need is
+ *  done in caller-provided arrays.
+ */
+#ifndef TIE_SIMPLIFY_H
+#define TIE_SIMPLIFY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "attrib.h"
+#include "math.h"
+
+/*! \brief A range of vertices, used as the stack of polyline_simplify().
+ */
+typedef struct {
+        uint32_t first;
+        uint32_t last;
+} SimplifyRange;
+
+/*! \brief Bookkeeping for a single vertex in polyline_simplify_by_area().
+ */
+typedef struct {
+        double area;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t slot; // position of this vertex in the heap
+        uint32_t heap; // the vertex stored at this position of the heap
+} SimplifyVertex;
+
+/*! \brief Simplifies a line strip using the Douglas-Peucker algorithm.
+ *
+ *  Keeps the endpoints, and recursively keeps the vertex furthest from the
+ *  segment between the last two kept vertices while it's further than the
+ *  tolerance. The recursion is done with an explicit stack, and the search
+ *  for the furthest vertex processes two vertices at a time with SSE2 when
+ *  available. Runs in \f$O(n \log n)\f$ on typical input and \f$O(n^2)\f$ in
+ *  the worst case.
+ *
+ *  If `preserve_topology` is set, a segment is only accepted if no other
+ *  vertex of the input lies in the polygon formed by the segment and the
+ *  vertices it replaces (the sidedness test by Saalfeld). This guarantees
+ *  that simplifying a simple line strip doesn't make it self-intersecting,
+ *  at the cost of an additional \f$O(n)\f$ per accepted segment.
+ *
+ *  \param[in] n The amount of vertices. Must be positive.
+ *  \param[in] polyline The line strip to simplify. Its first and last vertex
+ *  may coincide.
+ *  \param[out] out The simplified line strip. Must not overlap `polyline`.
+ *  \param stack Auxiliary array for the explicit recursion stack.
+ *  \param[in] tolerance Maximal distance of a dropped vertex from the
+ *  simplified line strip. Must be nonnegative.
+ *  \param[in] preserve_topology Whether to keep the line strip from
+ *  intersecting itself.
+ *
+ *  \return A pointer one past the last vertex of the simplified line strip.
+ *
+ *  \sa bezier_discretize()
+ */
+extern vec2d *polyline_simplify(size_t n,
+                                const vec2d polyline[static restrict n],
+                                vec2d out[static restrict n],
+                                SimplifyRange stack[static restrict n],
+                                double tolerance,
+                                bool preserve_topology);
+
+/*! \brief Simplifies a line strip using the Visvalingam-Whyatt algorithm.
+ *
+ *  Repeatedly drops the vertex that forms the triangle of the smallest area
+ *  with its neighbours, until every remaining triangle is at least
+ *  `min_area` large. Areas never decrease as vertices are dropped, so the
+ *  result is the same as thresholding the order in which vertices would be
+ *  removed. Runs in \f$O(n \log n)\f$.
+ *
+ *  \param[in] n The amount of vertices. Must be positive.
+ *  \param[in] polyline The line strip to simplify.
+ *  \param[out] out The simplified line strip. May be the same array as
+ *  `polyline`.
+ *  \param aux Auxiliary array for the vertex heap.
+ *  \param[in] min_area The area below which vertices are dropped.
+ *
+ *  \return A pointer one past the last vertex of the simplified line strip.
+ */
+extern vec2d *polyline_simplify_by_area(size_t n,
+                                        const vec2d polyline[static n],
+                                        vec2d out[static n],
+                                        SimplifyVertex aux[static restrict n],
+                                        double min_area);
+
+#endif
@@ -0,0 +1,471 @@
+#include <math.h>
+
+#include "array.h"
+#include "attrib.h"
+#include "geometry.h"
+#include "math.h"
+#include "numeric.h"
+#include "stroke.h"
+
+#define STROKE_PI 3.14159265358979323846
+
+// Everything the helpers below need, to keep their parameter lists short.
+typedef struct {
+        const StrokeStyle *style;
+        StrokeBuffers *buffers;
+        Reallocator *reallocator;
+        void *user;
+        double half_width;
+} Stroker;
+
+// Makes room for nv more vertices and ni more indices.
+static int stroke_reserve(Stroker *restrict s, size_t nv, size_t ni)
+{
+        StrokeBuffers *b = s->buffers;
+        size_t vertices_sz = b->vertices_sz, indices_sz = b->indices_sz;
+        vec2d *vertices = b->vertices;
+        uint32_t *indices = b->indices;
+
+        assert(b->vertex_count + nv <= UINT32_MAX);
+        if (b->vertex_count + nv > vertices_sz
+            && !auxiliary_realloc(s->reallocator,
+                                  &vertices_sz,
+                                  &vertices,
+                                  &b->vertices_sz,
+                                  &b->vertices,
+                                  b->vertex_count + nv,
+                                  s->user)) {
+                return -1;
+        }
+        if (b->index_count + ni > indices_sz
+            && !auxiliary_realloc(s->reallocator,
+                                  &indices_sz,
+                                  &indices,
+                                  &b->indices_sz,
+                                  &b->indices,
+                                  b->index_count + ni,
+                                  s->user)) {
+                return -1;
+        }
+
+        return 0;
+}
+
+// Appends a vertex at p + scale * offset; space must be reserved.
+static inline uint32_t stroke_vertex(Stroker *restrict s,
+                                     const vec2d *restrict p,
+                                     const vec2d *restrict offset,
+                                     double scale)
+{
+        StrokeBuffers *b = s->buffers;
+        vec2d *v = &b->vertices[b->vertex_count];
+
+        *v = *offset;
+        scale_vec2d(v, scale);
+        add_vec2d(v, p);
+
+        return b->vertex_count++;
+}
+
+static inline void stroke_triangle(Stroker *restrict s,
+                                   uint32_t a,
+                                   uint32_t b,
+                                   uint32_t c)
+{
+        uint32_t *out = &s->buffers->indices[s->buffers->index_count];
+
+        out[0] = a;
+        out[1] = b;
+        out[2] = c;
+        s->buffers->index_count += 3;
+}
+
+// Left-hand normal of a unit direction.
+static inline vec2d stroke_normal(const vec2d *restrict dir)
+{
+        vec2d n = *dir;
+
+        vec_x(n) = -vec_y(*dir);
+        vec_y(n) = vec_x(*dir);
+
+        return n;
+}
+
+// Amount of triangles for an arc of the given angle, so that the chords
+// deviate from it by at most the tolerance.
+static size_t stroke_arc_steps(const Stroker *restrict s, double angle)
+{
+        double ratio = s->style->tolerance / s->half_width;
+        double step = ratio < 1 ? 2 * acos(1 - ratio) : STROKE_PI;
+
+        return max((size_t)ceil(fabs(angle) / step), (size_t)1);
+}
+
+// Fans triangles around center from vertex a, at offset `from` from the
+// center, through the given signed angle to vertex b.
+static int stroke_fan(Stroker *restrict s,
+                      uint32_t center,
+                      const vec2d *restrict p,
+                      uint32_t a,
+                      const vec2d *restrict from,
+                      double angle,
+                      uint32_t b)
+{
+        size_t steps = stroke_arc_steps(s, angle), i;
+        double c, sn;
+        vec2d offset = *from, rotated;
+        uint32_t prev = a, next;
+
+        if (stroke_reserve(s, steps - 1, 3 * steps)) {
+                return -1;
+        }
+
+        c = cos(angle / steps);
+        sn = sin(angle / steps);
+        for (i = 1; i <= steps; ++i) {
+                if (i == steps) {
+                        next = b;
+                } else {
+                        vec_x(rotated) = c * vec_x(offset) - sn * vec_y(offset);
+                        vec_y(rotated) = sn * vec_x(offset) + c * vec_y(offset);
+                        offset = rotated;
+                        next = stroke_vertex(s, p, &offset, 1);
+                }
+                stroke_triangle(s, center, prev, next);
+                prev = next;
+        }
+
+        return 0;
+}
+
+// Fills the gap on the outer side of the turn from direction d0 to d1 at p.
+// end and start are the left and right vertices of the quads meeting there.
+static int stroke_join(Stroker *restrict s,
+                       const vec2d *restrict p,
+                       const vec2d *restrict d0,
+                       const vec2d *restrict d1,
+                       const uint32_t end[static 2],
+                       const uint32_t start[static 2])
+{
+        const vec2d *vertices = s->buffers->vertices;
+        double cross = cross_vec2d(d0, d1), dot = dot_vec2d(d0, d1);
+        double cos_half;
+        vec2d from, to, bisector;
+        uint32_t center, miter;
+        int side;
+
+        if (cross == 0 && dot > 0) {
+                return 0;
+        }
+
+        // turning left leaves the gap on the right side
+        side = cross > 0;
+        from = vertices[end[side]];
+        sub_vec2d(&from, p);
+        to = vertices[start[side]];
+        sub_vec2d(&to, p);
+
+        switch (s->style->join) {
+        case STROKE_JOIN_MITER:
+                // the miter is 1 / cos(turn / 2) half widths long
+                cos_half = sqrt(fmax((1 + dot) / 2, 0));
+                if (cos_half * s->style->miter_limit < 1) {
+                        break;
+                }
+                if (stroke_reserve(s, 2, 6)) {
+                        return -1;
+                }
+                bisector = from;
+                add_vec2d(&bisector, &to);
+                normalize_vec2d(&bisector);
+                center = stroke_vertex(s, p, &bisector, 0);
+                miter = stroke_vertex(s,
+                                      p,
+                                      &bisector,
+                                      s->half_width / cos_half);
+                stroke_triangle(s, center, end[side], miter);
+                stroke_triangle(s, center, miter, start[side]);
+                return 0;
+        case STROKE_JOIN_ROUND:
+                if (stroke_reserve(s, 1, 0)) {
+                        return -1;
+                }
+                center = stroke_vertex(s, p, &from, 0);
+                return stroke_fan(s,
+                                  center,
+                                  p,
+                                  end[side],
+                                  &from,
+                                  (side ? 1 : -1) * acos(fmax(dot, -1)),
+                                  start[side]);
+        case STROKE_JOIN_BEVEL:
+                break;
+        }
+
+        if (stroke_reserve(s, 1, 3)) {
+                return -1;
+        }
+        center = stroke_vertex(s, p, &from, 0);
+        stroke_triangle(s, center, end[side], start[side]);
+
+        return 0;
+}
+
+// Caps the stroke at p, which ends in the outward direction dir between the
+// vertices left and right of it.
+static int stroke_cap(Stroker *restrict s,
+                      const vec2d *restrict p,
+                      const vec2d *restrict dir,
+                      uint32_t left,
+                      uint32_t right)
+{
+        vec2d from;
+        uint32_t center, left2, right2;
+
+        switch (s->style->cap) {
+        case STROKE_CAP_BUTT:
+                break;
+        case STROKE_CAP_ROUND:
+                if (stroke_reserve(s, 1, 0)) {
+                        return -1;
+                }
+                from = stroke_normal(dir);
+                center = stroke_vertex(s, p, &from, 0);
+                scale_vec2d(&from, s->half_width);
+                return stroke_fan(s, center, p, left, &from, -STROKE_PI, right);
+        case STROKE_CAP_SQUARE:
+                if (stroke_reserve(s, 2, 6)) {
+                        return -1;
+                }
+                left2 = stroke_vertex(s,
+                                      &s->buffers->vertices[left],
+                                      dir,
+                                      s->half_width);
+                right2 = stroke_vertex(s,
+                                       &s->buffers->vertices[right],
+                                       dir,
+                                       s->half_width);
+                stroke_triangle(s, left, right, right2);
+                stroke_triangle(s, left, right2, left2);
+                break;
+        }
+
+        return 0;
+}
+
+// Draws a line strip that degenerated to a single point.
+static int stroke_dot(Stroker *restrict s, const vec2d *restrict p)
+{
+        vec2d dir = make_vec2d(1, 0), normal;
+        uint32_t left, right;
+
+        if (s->style->cap == STROKE_CAP_BUTT) {
+                return 0;
+        }
+
+        // two back to back caps with no segment in between
+        if (stroke_reserve(s, 2, 0)) {
+                return -1;
+        }
+        normal = stroke_normal(&dir);
+        left = stroke_vertex(s, p, &normal, s->half_width);
+        right = stroke_vertex(s, p, &normal, -s->half_width);
+        if (stroke_cap(s, p, &dir, left, right)) {
+                return -1;
+        }
+        scale_vec2d(&dir, -1);
+        return stroke_cap(s, p, &dir, right, left);
+}
+
+// Appends the quad of the segment from a to b and joins it to the previous
+// one. On return, dir is its direction and end its end vertices.
+static int stroke_segment(Stroker *restrict s,
+                          const vec2d *restrict a,
+                          const vec2d *restrict b,
+                          bool first,
+                          vec2d *restrict dir,
+                          uint32_t start[static 2],
+                          uint32_t end[static 2])
+{
+        vec2d prev_dir = *dir, normal;
+        uint32_t prev_end[2] = { end[0], end[1] };
+
+        if (stroke_reserve(s, 4, 6)) {
+                return -1;
+        }
+
+        *dir = *b;
+        sub_vec2d(dir, a);
+        normalize_vec2d(dir);
+        normal = stroke_normal(dir);
+
+        start[0] = stroke_vertex(s, a, &normal, s->half_width);
+        start[1] = stroke_vertex(s, a, &normal, -s->half_width);
+        end[0] = stroke_vertex(s, b, &normal, s->half_width);
+        end[1] = stroke_vertex(s, b, &normal, -s->half_width);
+        stroke_triangle(s, start[0], start[1], end[0]);
+        stroke_triangle(s, end[0], start[1], end[1]);
+
+        if (first) {
+                return 0;
+        }
+        return stroke_join(s, a, &prev_dir, dir, prev_end, start);
+}
+
+static inline bool stroke_same_point(const vec2d *a, const vec2d *b)
+{
+        return vec_x(*a) == vec_x(*b) && vec_y(*a) == vec_y(*b);
+}
+
+void stroke_buffers_init(StrokeBuffers *restrict buffers)
+{
+        buffers->vertex_count = 0;
+        buffers->index_count = 0;
+        buffers->vertices_sz = 0;
+        buffers->vertices = NULL;
+        buffers->indices_sz = 0;
+        buffers->indices = NULL;
+        buffers->points_sz = 0;
+        buffers->points = NULL;
+        buffers->aux_sz = 0;
+        buffers->aux = NULL;
+}
+
+void stroke_buffers_clear(StrokeBuffers *restrict buffers)
+{
+        buffers->vertex_count = 0;
+        buffers->index_count = 0;
+}
+
+int stroke_polyline(size_t n,
+                    const vec2d points[static restrict n],
+                    const StrokeStyle *restrict style,
+                    StrokeBuffers *restrict buffers,
+                    Reallocator *reallocator,
+                    void *user)
+{
+        Stroker s = {
+                .style = style,
+                .buffers = buffers,
+                .reallocator = reallocator,
+                .user = user,
+                .half_width = style->width / 2,
+        };
+        const size_t vertex_count = buffers->vertex_count;
+        const size_t index_count = buffers->index_count;
+        const vec2d *a, *b;
+        vec2d dir, first_dir;
+        uint32_t start[2], end[2] = { 0, 0 }, first_start[2];
+        size_t segments = 0;
+
+        assert(n > 0);
+        assert(style->width > 0);
+        assert(style->tolerance > 0);
+
+        a = points;
+        traverse(b, points + 1, points + n) {
+                if (stroke_same_point(a, b)) {
+                        continue;
+                }
+                if (stroke_segment(&s, a, b, !segments, &dir, start, end)) {
+                        goto fail;
+                }
+                if (!segments) {
+                        first_dir = dir;
+                        first_start[0] = start[0];
+                        first_start[1] = start[1];
+                }
+                ++segments;
+                a = b;
+        }
+
+        if (!segments) {
+                if (stroke_dot(&s, points)) {
+                        goto fail;
+                }
+                return 0;
+        }
+
+        if (style->closed && segments > 1) {
+                // a is the last distinct point
+                if (!stroke_same_point(a, points)
+                    && stroke_segment(&s, a, points, false, &dir, start, end)) {
+                        goto fail;
+                }
+                if (stroke_join(&s,
+                                points,
+                                &dir,
+                                &first_dir,
+                                end,
+                                first_start)) {
+                        goto fail;
+                }
+                return 0;
+        }
+
+        scale_vec2d(&first_dir, -1);
+        if (stroke_cap(&s, points, &first_dir, first_start[1], first_start[0])
+            || stroke_cap(&s, a, &dir, end[0], end[1])) {
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        buffers->vertex_count = vertex_count;
+        buffers->index_count = index_count;
+        return -1;
+}
+
+int stroke_bezier(size_t n,
+                  const vec2d bezier[static restrict n],
+                  const StrokeStyle *restrict style,
+                  StrokeBuffers *restrict buffers,
+                  Reallocator *reallocator,
+                  void *user)
+{
+        size_t points_sz = buffers->points_sz, aux_sz = buffers->aux_sz;
+        vec2d *points = buffers->points, *aux = buffers->aux, *end;
+
+        // bezier_discretize() needs a nonempty output and room for the curve
+        if (points_sz < 1
+            && !auxiliary_realloc(reallocator,
+                                  &points_sz,
+                                  &points,
+                                  &buffers->points_sz,
+                                  &buffers->points,
+                                  1,
+                                  user)) {
+                return -1;
+        }
+        if (aux_sz < n
+            && !auxiliary_realloc(reallocator,
+                                  &aux_sz,
+                                  &aux,
+                                  &buffers->aux_sz,
+                                  &buffers->aux,
+                                  n,
+                                  user)) {
+                return -1;
+        }
+
+        end = bezier_discretize(n,
+                                bezier,
+                                &buffers->points_sz,
+                                &buffers->points,
+                                &buffers->aux_sz,
+                                &buffers->aux,
+                                style->tolerance,
+                                reallocator,
+                                user);
+        if (!end) {
+                return -1;
+        }
+
+        return stroke_polyline(end - buffers->points,
+                               buffers->points,
+                               style,
+                               buffers,
+                               reallocator,
+                               user);
+}
@@ -0,0 +1,132 @@
+/*! \file stroke.h
+ *  \brief Stroke tessellation
+ *
+ *  Turns line strips and bezier curves into triangles covering their stroke
+ *  of a given width, ready to be uploaded as vertex and index buffers.
+ *  Every stroked line strip is appended to the same buffers, so that a whole
+ *  frame's worth of strokes can be drawn with a single call, and the buffers
+ *  keep their memory when cleared, so that after the first few frames
+ *  stroking doesn't allocate at all. The buffers grow through the usual
+ *  reallocator protocol (see algo.h).
+ *
+ *  Each segment of a line strip becomes a quad; joins and caps add fans
+ *  around the vertices. The triangles of adjacent segments overlap on the
+ *  inner side of joins, so translucent strokes should be drawn with a
+ *  stencil or depth test to avoid blending them twice.
+ */
+#ifndef TIE_STROKE_H
+#define TIE_STROKE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "math.h"
+
+typedef enum {
+        STROKE_JOIN_MITER,
+        STROKE_JOIN_ROUND,
+        STROKE_JOIN_BEVEL
+} StrokeJoin;
+
+typedef enum {
+        STROKE_CAP_BUTT,
+        STROKE_CAP_ROUND,
+        STROKE_CAP_SQUARE
+} StrokeCap;
+
+typedef struct {
+        double width;
+        // Longest allowed miter, relative to the width. Sharper joins are
+        // beveled.
+        double miter_limit;
+        // Largest distance of round joins and caps from a true circle.
+        double tolerance;
+        StrokeJoin join;
+        StrokeCap cap;
+        bool closed; // join the last vertex to the first, without caps
+} StrokeStyle;
+
+/*! \brief Triangle buffers, together with scratch space for stroking.
+ *
+ *  The triangles are `indices[0]` through `indices[index_count - 1]`, three
+ *  indices per triangle, into `vertices`. All arrays are owned by the user
+ *  and must come from an allocator compatible with the reallocator passed
+ *  to the stroking routines.
+ */
+typedef struct {
+        size_t vertex_count;
+        size_t index_count;
+        size_t vertices_sz;
+        vec2d *vertices;
+        size_t indices_sz;
+        uint32_t *indices;
+        // scratch space for discretizing curves
+        size_t points_sz;
+        vec2d *points;
+        size_t aux_sz;
+        vec2d *aux;
+} StrokeBuffers;
+
+/*! \brief Initializes empty buffers without any memory.
+ *
+ *  \param[out] buffers The buffers.
+ */
+extern void stroke_buffers_init(StrokeBuffers *restrict buffers);
+
+/*! \brief Drops all triangles, keeping the memory for the next frame.
+ *
+ *  \param[in,out] buffers The buffers.
+ */
+extern void stroke_buffers_clear(StrokeBuffers *restrict buffers);
+
+/*! \brief Appends the stroke of a line strip to the buffers.
+ *
+ *  Runs in \f$O(n)\f$. Repeated points are skipped; a line strip that
+ *  degenerates to a single point is drawn as a dot by round and square caps
+ *  and not at all otherwise.
+ *
+ *  \param[in] n The amount of points. Must be positive.
+ *  \param[in] points The line strip.
+ *  \param[in] style The stroke style.
+ *  \param[in,out] buffers The buffers to append to.
+ *  \param[in] reallocator Reallocator for the buffers. May be NULL, in which
+ *  case the function fails when the buffers become full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure. On failure nothing is
+ *  appended.
+ */
+extern int stroke_polyline(size_t n,
+                           const vec2d points[static restrict n],
+                           const StrokeStyle *restrict style,
+                           StrokeBuffers *restrict buffers,
+                           Reallocator *reallocator,
+                           void *user);
+
+/*! \brief Appends the stroke of a bezier curve to the buffers.
+ *
+ *  Discretizes the curve into the scratch space of the buffers, with the
+ *  tolerance of the style, and strokes the resulting line strip.
+ *
+ *  \param[in] n The amount of control points. Must be positive.
+ *  \param[in] bezier The control points of the curve.
+ *  \param[in] style The stroke style.
+ *  \param[in,out] buffers The buffers to append to.
+ *  \param[in] reallocator See stroke_polyline().
+ *  \param[in,out] user See stroke_polyline().
+ *
+ *  \return 0 on success, -1 on allocation failure. On failure nothing is
+ *  appended.
+ *
+ *  \sa bezier_discretize()
+ */
+extern int stroke_bezier(size_t n,
+                         const vec2d bezier[static restrict n],
+                         const StrokeStyle *restrict style,
+                         StrokeBuffers *restrict buffers,
+                         Reallocator *reallocator,
+                         void *user);
+
+#endif
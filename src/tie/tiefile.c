@@ -0,0 +1,552 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "history.h"
+#include "memalloc.h"
+#include "pager.h"
+#include "tiefile.h"
+
+// Resolves a location that holds an offset from `base`, or an address if
+// `base` is NULL.
+#define tiefile_location(base, location)                                       \
+        ((base) ? location_resolve(base, location) : (void *)(location).address)
+
+static inline uint64_t tiefile_align(uint64_t offset, size_t alignment)
+{
+        return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Tests whether `count` items of the given size and alignment starting at
+// `offset` lie within a file of the given size, without overflowing.
+static inline bool tiefile_within(size_t size,
+                                  uint64_t offset,
+                                  uint64_t count,
+                                  size_t item_size,
+                                  size_t alignment)
+{
+        return offset % alignment == 0 && offset <= size
+            && count <= (size - offset) / item_size;
+}
+
+static TieFileStatus tiefile_validate(const unsigned char *base, size_t size)
+{
+        const TieFileHeader *header = (const TieFileHeader *)base;
+        const History *history = &header->history;
+        const StoredObjects *objects = &header->objects;
+        const LinearHistory *tree, *linear;
+        uint64_t first, end = 0;
+
+        if (size < sizeof(*header) || header->magic_byte != TIE_MAGIC_BYTE
+            || memcmp(header->tie_string, TIE_STRING, 3)) {
+                return TIEFILE_INVALID;
+        }
+        if (header->major != TIE_MAJOR) {
+                return TIEFILE_UNSUPPORTED;
+        }
+        if (!tiefile_within(size,
+                            history->tree.offset,
+                            history->tree_size,
+                            sizeof(*tree),
+                            alignof(LinearHistory))
+            || !tiefile_within(size,
+                               history->entries.offset,
+                               history->size,
+                               sizeof(HistoryEntry),
+                               alignof(HistoryEntry))
+            || (history->size > 0 && history->current_entry >= history->size)
+            || !tiefile_within(size,
+                               objects->nodes.offset,
+                               objects->node_count,
+                               sizeof(ObjectStoreNode),
+                               alignof(ObjectStoreNode))
+            || !tiefile_within(size,
+                               objects->objects.offset,
+                               objects->object_count,
+                               sizeof(Object),
+                               alignof(Object))
+            || !tiefile_within(size,
+                               objects->generations.offset,
+                               objects->object_count,
+                               sizeof(uint32_t),
+                               alignof(uint32_t))
+            || !tiefile_within(size,
+                               objects->links.offset,
+                               objects->link_count,
+                               sizeof(ObjectID),
+                               alignof(ObjectID))) {
+                return TIEFILE_INVALID;
+        }
+
+        // entries are only checked to lie within the file as a whole, so
+        // that their pages aren't touched until they're used
+        tree = location_resolve(base, history->tree);
+        traverse(linear, tree, tree + history->tree_size) {
+                if (linear->parent > linear - tree
+                    || (linear->parent == linear - tree && linear != tree)
+                    || linear->offset > tree[linear->parent].size
+                    || linear->entries.offset < history->entries.offset
+                    || (linear->entries.offset - history->entries.offset)
+                                       % sizeof(HistoryEntry)
+                               != 0) {
+                        return TIEFILE_INVALID;
+                }
+                first = (linear->entries.offset - history->entries.offset)
+                      / sizeof(HistoryEntry);
+                // linear histories hold the entries in their own order
+                if (first < end || first > history->size
+                    || linear->size > history->size - first) {
+                        return TIEFILE_INVALID;
+                }
+                end = first + linear->size;
+        }
+
+        return TIEFILE_OK;
+}
+
+TieFileStatus tiefile_open(TieFile *restrict file, const char *restrict path)
+{
+        TieFileStatus status;
+        struct stat st;
+        void *base;
+        int fd;
+
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                return TIEFILE_IO_ERROR;
+        }
+        if (fstat(fd, &st)) {
+                close(fd);
+                return TIEFILE_IO_ERROR;
+        }
+        if ((size_t)st.st_size < sizeof(TieFileHeader)) {
+                close(fd);
+                return TIEFILE_INVALID;
+        }
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+                close(fd);
+                return TIEFILE_IO_ERROR;
+        }
+
+        status = tiefile_validate(base, st.st_size);
+        if (status != TIEFILE_OK) {
+                munmap(base, st.st_size);
+                close(fd);
+                return status;
+        }
+        file->base = base;
+        file->size = st.st_size;
+        file->fd = fd;
+
+        return TIEFILE_OK;
+}
+
+void tiefile_close(TieFile *restrict file)
+{
+        munmap((void *)file->base, file->size);
+        close(file->fd);
+        file->base = NULL;
+        file->size = 0;
+        file->fd = -1;
+}
+
+// Maps an array of the file into an array of the pager, unless it's empty.
+static bool tiefile_map(const TieFile *restrict file,
+                        HistoryPager *restrict pager,
+                        uint64_t offset,
+                        uint64_t n,
+                        size_t sz,
+                        void **restrict p,
+                        size_t *restrict capacity)
+{
+        if (n == 0) {
+                return true;
+        }
+        *capacity = history_pager_map(pager, p, file->fd, offset, n, sz);
+
+        return *p;
+}
+
+TieFileStatus tiefile_load(const TieFile *restrict file,
+                           History *restrict history,
+                           ObjectStore *restrict store,
+                           HistoryPager *restrict pager)
+{
+        const History *stored = &tiefile_header(file)->history;
+        const StoredObjects *objects = tiefile_objects(file);
+        const LinearHistory *tree = tiefile_tree(file), *linear;
+        LinearHistory *copy;
+        void *entries = NULL;
+        size_t capacity = 0;
+
+        assert(!history->entries.address && !history->tree.address);
+        assert(!store->nodes && !store->objects && !store->generations
+               && !store->links && !store->checks);
+        if (!tiefile_map(file,
+                         pager,
+                         stored->entries.offset,
+                         stored->size,
+                         sizeof(HistoryEntry),
+                         &entries,
+                         &capacity)
+            || !tiefile_map(file,
+                            pager,
+                            objects->nodes.offset,
+                            objects->node_count,
+                            sizeof(ObjectStoreNode),
+                            (void **)&store->nodes,
+                            &store->nodes_sz)
+            || !tiefile_map(file,
+                            pager,
+                            objects->objects.offset,
+                            objects->object_count,
+                            sizeof(Object),
+                            (void **)&store->objects,
+                            &store->objects_sz)
+            || !tiefile_map(file,
+                            pager,
+                            objects->generations.offset,
+                            objects->object_count,
+                            sizeof(uint32_t),
+                            (void **)&store->generations,
+                            &store->generations_sz)
+            || !tiefile_map(file,
+                            pager,
+                            objects->links.offset,
+                            objects->link_count,
+                            sizeof(ObjectID),
+                            (void **)&store->links,
+                            &store->links_sz)) {
+                goto no_memory;
+        }
+        history->entries.address = entries;
+        history->capacity = capacity;
+        if (history_reserve(history,
+                            stored->size,
+                            stored->tree_size,
+                            history_pager_reallocator,
+                            pager)) {
+                goto no_memory;
+        }
+
+        history->size = stored->size;
+        history->current_entry = stored->current_entry;
+        history->tree_size = stored->tree_size;
+        copy = history->tree.address;
+        traverse(linear, tree, tree + stored->tree_size) {
+                *copy = *linear;
+                copy->entries.address =
+                        history->entries.address
+                        + (linear->entries.offset - stored->entries.offset)
+                                  / sizeof(HistoryEntry);
+                ++copy;
+        }
+
+        store->node_count = objects->node_count;
+        store->object_count = objects->object_count;
+        store->link_count = objects->link_count;
+        // nodes and objects of the file are never changed in place
+        store->edit = objects->edit;
+        object_store_begin(store);
+        if (object_store_loaded(store, history_pager_reallocator, pager)) {
+                goto no_memory;
+        }
+        if (history->size > 0
+            && object_store_check(
+                       store,
+                       history->entries.address[history->current_entry]
+                               .objects)) {
+                history_init(history);
+                object_store_init(store);
+                return TIEFILE_INVALID;
+        }
+
+        return TIEFILE_OK;
+
+no_memory:
+        // the arrays that were made are freed along with the pager
+        history_init(history);
+        object_store_init(store);
+
+        return TIEFILE_NO_MEMORY;
+}
+
+static bool tiefile_pad(FILE *f, uint64_t *offset, size_t alignment)
+{
+        static const unsigned char zeros[alignof(max_align_t)];
+        uint64_t aligned = tiefile_align(*offset, alignment);
+
+        assert(aligned - *offset <= sizeof(zeros));
+        if (fwrite(zeros, 1, aligned - *offset, f) != aligned - *offset) {
+                return false;
+        }
+        *offset = aligned;
+
+        return true;
+}
+
+// Makes a rename within the directory of `path` durable.
+static bool tiefile_sync_directory(const char *path)
+{
+        const char *slash = strrchr(path, '/');
+        char *directory;
+        int fd;
+        bool ok;
+
+        if (!slash) {
+                fd = open(".", O_RDONLY);
+        } else {
+                directory = tie_malloc(slash - path + 2, 1);
+                if (!directory) {
+                        return false;
+                }
+                memcpy(directory, path, slash - path + 1);
+                directory[slash - path + 1] = '\0';
+                fd = open(directory, O_RDONLY);
+                tie_free(directory);
+        }
+        if (fd < 0) {
+                return false;
+        }
+        ok = !fsync(fd);
+        close(fd);
+
+        return ok;
+}
+
+// Writes an array after padding to its alignment.
+static bool tiefile_write_array(FILE *f,
+                                uint64_t *offset,
+                                const void *array,
+                                uint64_t count,
+                                size_t size,
+                                size_t alignment)
+{
+        if (!tiefile_pad(f, offset, alignment)
+            || (count > 0 && fwrite(array, size, count, f) != count)) {
+                return false;
+        }
+        *offset += count * size;
+
+        return true;
+}
+
+// Writes the objects of a store, whose links are already relative to the
+// links that follow them.
+static bool tiefile_write_objects(FILE *f, const ObjectStore *restrict store)
+{
+        const Object *o;
+        Object chunk[64], *c;
+        size_t n;
+
+        for (o = store->objects; o < store->objects + store->object_count;
+             o += n) {
+                n = store->objects + store->object_count - o;
+                n = n < array_size(chunk) ? n : array_size(chunk);
+                // zeroed so that padding is written deterministically
+                memset(chunk, 0, n * sizeof(*chunk));
+                traverse(c, chunk, chunk + n) {
+                        c->type = o[c - chunk].type;
+                        c->transform = o[c - chunk].transform;
+                        c->parent_count = o[c - chunk].parent_count;
+                        c->child_count = o[c - chunk].child_count;
+                        c->parents = o[c - chunk].parents;
+                        c->children = o[c - chunk].children;
+                }
+                if (fwrite(chunk, sizeof(*chunk), n, f) != n) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+static bool tiefile_write(FILE *f,
+                          const History *restrict history,
+                          const ObjectStore *restrict store,
+                          const JournalPosition *restrict journal,
+                          const void *base)
+{
+        const LinearHistory *tree = tiefile_location(base, history->tree);
+        const HistoryEntry *entries = tiefile_location(base, history->entries);
+        const LinearHistory *linear;
+        const HistoryEntry *e;
+        TieFileHeader header;
+        StoredObjects *objects = &header.objects;
+        LinearHistory node;
+        HistoryEntry chunk[64], *c;
+        uint64_t offset, tree_offset, entries_offset;
+        size_t n;
+
+        tree_offset = tiefile_align(sizeof(header), alignof(LinearHistory));
+        entries_offset = tiefile_align(tree_offset
+                                               + history->tree_size
+                                                         * sizeof(*tree),
+                                       alignof(HistoryEntry));
+
+        // zeroed so that padding is written deterministically
+        memset(&header, 0, sizeof(header));
+        header.magic_byte = TIE_MAGIC_BYTE;
+        memcpy(header.tie_string, TIE_STRING, 3);
+        header.major = TIE_MAJOR;
+        header.minor = TIE_MINOR;
+        header.history = *history;
+        header.history.capacity = history->size;
+        header.history.tree_capacity = history->tree_size;
+        header.history.tree.offset = tree_offset;
+        header.history.entries.offset = entries_offset;
+        if (journal) {
+                header.journal = *journal;
+        }
+        objects->edit = store->edit;
+        objects->node_count = store->node_count;
+        objects->object_count = store->object_count;
+        objects->link_count = store->link_count;
+        objects->nodes.offset = tiefile_align(
+                entries_offset + history->size * sizeof(*entries),
+                alignof(ObjectStoreNode));
+        objects->objects.offset = tiefile_align(
+                objects->nodes.offset
+                        + store->node_count * sizeof(ObjectStoreNode),
+                alignof(Object));
+        objects->generations.offset = tiefile_align(
+                objects->objects.offset
+                        + store->object_count * sizeof(Object),
+                alignof(uint32_t));
+        objects->links.offset = tiefile_align(
+                objects->generations.offset
+                        + store->object_count * sizeof(uint32_t),
+                alignof(ObjectID));
+        if (fwrite(&header, sizeof(header), 1, f) != 1) {
+                return false;
+        }
+        offset = sizeof(header);
+
+        if (!tiefile_pad(f, &offset, alignof(LinearHistory))) {
+                return false;
+        }
+        traverse(linear, tree, tree + history->tree_size) {
+                e = tiefile_location(base, linear->entries);
+                node = *linear;
+                node.entries.offset = entries_offset
+                                    + (e - entries) * sizeof(*entries);
+                if (fwrite(&node, sizeof(node), 1, f) != 1) {
+                        return false;
+                }
+        }
+        offset += history->tree_size * sizeof(*tree);
+
+        if (!tiefile_pad(f, &offset, alignof(HistoryEntry))) {
+                return false;
+        }
+        for (e = entries; e < entries + history->size; e += n) {
+                n = entries + history->size - e;
+                n = n < array_size(chunk) ? n : array_size(chunk);
+                memset(chunk, 0, n * sizeof(*chunk));
+                traverse(c, chunk, chunk + n) {
+                        c->cursor_position = e[c - chunk].cursor_position;
+                        c->objects = e[c - chunk].objects;
+                        c->selection_stack = e[c - chunk].selection_stack;
+                }
+                if (fwrite(chunk, sizeof(*chunk), n, f) != n) {
+                        return false;
+                }
+        }
+        offset += history->size * sizeof(*entries);
+
+        if (!tiefile_write_array(f,
+                                 &offset,
+                                 store->nodes,
+                                 store->node_count,
+                                 sizeof(ObjectStoreNode),
+                                 alignof(ObjectStoreNode))
+            || !tiefile_pad(f, &offset, alignof(Object))
+            || !tiefile_write_objects(f, store)) {
+                return false;
+        }
+        offset += store->object_count * sizeof(Object);
+
+        return tiefile_write_array(f,
+                                   &offset,
+                                   store->generations,
+                                   store->object_count,
+                                   sizeof(uint32_t),
+                                   alignof(uint32_t))
+            && tiefile_write_array(f,
+                                   &offset,
+                                   store->links,
+                                   store->link_count,
+                                   sizeof(ObjectID),
+                                   alignof(ObjectID));
+}
+
+TieFileStatus tiefile_write_temporary(const char *restrict temporary,
+                                     const History *restrict history,
+                                     const ObjectStore *restrict store,
+                                     const JournalPosition *restrict journal,
+                                     const void *base)
+{
+        FILE *f;
+        bool ok;
+
+        f = fopen(temporary, "wb");
+        if (!f) {
+                return TIEFILE_IO_ERROR;
+        }
+        ok = tiefile_write(f, history, store, journal, base) && !fflush(f)
+          && !fsync(fileno(f));
+        ok = !fclose(f) && ok;
+        if (!ok) {
+                remove(temporary);
+                return TIEFILE_IO_ERROR;
+        }
+
+        return TIEFILE_OK;
+}
+
+TieFileStatus tiefile_replace(const char *restrict temporary,
+                              const char *restrict path)
+{
+        if (rename(temporary, path)) {
+                remove(temporary);
+                return TIEFILE_IO_ERROR;
+        }
+
+        // the new file is in place, but the rename may still be lost
+        return tiefile_sync_directory(path) ? TIEFILE_OK : TIEFILE_NOT_DURABLE;
+}
+
+TieFileStatus tiefile_save(const char *restrict path,
+                           const History *restrict history,
+                           const ObjectStore *restrict store,
+                           const JournalPosition *restrict journal,
+                           const void *base)
+{
+        size_t length = strlen(path);
+        TieFileStatus status;
+        char *temporary;
+
+        temporary = tie_malloc(length + sizeof(".tmp"), 1);
+        if (!temporary) {
+                return TIEFILE_NO_MEMORY;
+        }
+        memcpy(temporary, path, length);
+        memcpy(temporary + length, ".tmp", sizeof(".tmp"));
+
+        status = tiefile_write_temporary(
+                temporary, history, store, journal, base);
+        if (status == TIEFILE_OK) {
+                status = tiefile_replace(temporary, path);
+        }
+        tie_free(temporary);
+
+        return status;
+}
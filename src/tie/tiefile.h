@@ -0,0 +1,193 @@
+/*! \file tiefile.h
+ *  \brief Loading and saving .tie files
+ *
+ *  Files are mapped into memory read-only and used in place: opening one
+ *  only validates the header and walks the tree of linear histories once,
+ *  so it takes the same time whatever the amount of entries, and entries
+ *  are only read from disk when they're first touched. Since the mapping is
+ *  never written to, its pages are shared with the page cache and can be
+ *  dropped under memory pressure instead of being swapped out.
+ *
+ *  Locations in a mapped file hold offsets from its start and are resolved
+ *  on access with location_resolve(). Saving does the opposite, turning
+ *  addresses back into offsets while writing, and replaces the file
+ *  atomically, so a file that is mapped can be saved over.
+ *
+ *  The objects of the entries are kept in the object store of the document
+ *  (see objectstore.h), which is saved after the entries, array by array.
+ *  Loading a file for editing maps its entries and its store in place as
+ *  well, privately, so that only what is touched is read and only what is
+ *  changed is copied, and checks the versions of entries as they're used.
+ */
+#ifndef TIE_TIEFILE_H
+#define TIE_TIEFILE_H
+
+#include <stddef.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "core.h"
+#include "objectstore.h"
+
+typedef enum {
+        TIEFILE_OK = 0,
+        TIEFILE_IO_ERROR = -1, // see errno
+        TIEFILE_INVALID = -2, // not a .tie file, or a corrupt one
+        TIEFILE_UNSUPPORTED = -3, // written by an incompatible version
+        TIEFILE_NO_MEMORY = -4,
+        // The file was replaced, but the replacement may not survive a
+        // crash, see errno.
+        TIEFILE_NOT_DURABLE = -5,
+        TIEFILE_BUSY = -6 // another save is still in progress
+} TieFileStatus;
+
+typedef struct {
+        const unsigned char *base; // the mapping, starting with the header
+        size_t size;
+        int fd; // kept open for tiefile_load()
+} TieFile;
+
+typedef struct HistoryPager_ HistoryPager;
+
+/*! \brief Maps a file and validates its layout.
+ *
+ *  Checks the magic byte, the tie string and the version, and that the tree
+ *  of linear histories, all of their entries and the arrays of the object
+ *  store lie within the file. The object store is checked as it's used
+ *  once it's loaded.
+ *
+ *  \param[out] file The mapped file, to be closed with tiefile_close().
+ *  Untouched on failure.
+ *  \param[in] path The path of the file.
+ *
+ *  \return #TIEFILE_OK on success, an error otherwise.
+ */
+extern TieFileStatus tiefile_open(TieFile *restrict file,
+                                  const char *restrict path);
+
+/*! \brief Unmaps and closes a file.
+ *
+ *  Every pointer into the file is invalidated, but for those into a
+ *  history and a store loaded from it, which map it on their own.
+ */
+extern void tiefile_close(TieFile *restrict file);
+
+/*! \brief Loads the history and the object store of a mapped file in
+ *  place, so that they can be edited.
+ *
+ *  The entries and the arrays of the store are mapped privately into arrays
+ *  of a pager, and only the tree of linear histories is copied, so nothing
+ *  is read from the file but what is touched, and pages are only copied
+ *  when they're changed. Only the
+ *  version of the current entry is checked (see object_store_check()): the
+ *  versions of other entries must be checked before they're used.
+ *
+ *  \param[in] file The mapped file.
+ *  \param[out] history An empty history without arrays (see history.h),
+ *  which receives the one of the file.
+ *  \param[out] store An empty object store without arrays, which receives
+ *  the one of the file. Its next edit comes after those of the file.
+ *  \param[in,out] pager The pager that makes the arrays of the history and
+ *  of the store, which must be grown with history_pager_reallocator() and
+ *  are freed along with the pager.
+ *
+ *  \return #TIEFILE_OK on success, #TIEFILE_INVALID if the version of the
+ *  current entry is corrupt, #TIEFILE_NO_MEMORY if the pager has no room for
+ *  the arrays. On failure, the history and the store are left empty.
+ */
+extern TieFileStatus tiefile_load(const TieFile *restrict file,
+                                  History *restrict history,
+                                  ObjectStore *restrict store,
+                                  HistoryPager *restrict pager);
+
+/*! \brief Saves a history and its objects.
+ *
+ *  Lays out the header, the tree of linear histories, the entries and the
+ *  arrays of the object store one after the other, writes them to a
+ *  temporary file next to `path`, syncs it to disk and renames it over
+ *  `path`, so that either the old or the new file is found after a crash.
+ *  The same as tiefile_write_temporary() followed by tiefile_replace().
+ *
+ *  \param[in] path The path of the file.
+ *  \param[in] history The history, whose linear histories must all lie in
+ *  its entries.
+ *  \param[in] store The object store of the history, in memory.
+ *  \param[in] journal How far the history got in the journal of the
+ *  document (see journal.h). May be NULL if it has none.
+ *  \param[in] base What the locations of the history are relative to, e.g.
+ *  the `base` of a mapped file, or NULL if they hold addresses.
+ *
+ *  \return #TIEFILE_OK on success, #TIEFILE_NOT_DURABLE if the file was
+ *  replaced but its directory couldn't be synced, in which case the old
+ *  file may be found after a crash, or #TIEFILE_IO_ERROR or
+ *  #TIEFILE_NO_MEMORY otherwise, in which case the file at `path` is left
+ *  untouched.
+ */
+extern TieFileStatus tiefile_save(const char *restrict path,
+                                  const History *restrict history,
+                                  const ObjectStore *restrict store,
+                                  const JournalPosition *restrict journal,
+                                  const void *base);
+
+/*! \brief Writes a file that is to replace another one, and syncs it to
+ *  disk.
+ *
+ *  \param[in] temporary The path of the file, which is created or
+ *  truncated. Writers that may run at the same time need temporary files
+ *  of their own.
+ *  \param[in] history See tiefile_save().
+ *  \param[in] store See tiefile_save().
+ *  \param[in] journal See tiefile_save().
+ *  \param[in] base See tiefile_save().
+ *
+ *  \return #TIEFILE_OK on success, #TIEFILE_IO_ERROR otherwise, in which
+ *  case the file is removed.
+ */
+extern TieFileStatus tiefile_write_temporary(
+        const char *restrict temporary,
+        const History *restrict history,
+        const ObjectStore *restrict store,
+        const JournalPosition *restrict journal,
+        const void *base);
+
+/*! \brief Renames a file written by tiefile_write_temporary() over another
+ *  one, and makes the rename durable.
+ *
+ *  \return See tiefile_save(). The temporary file is removed on failure.
+ */
+extern TieFileStatus tiefile_replace(const char *restrict temporary,
+                                     const char *restrict path);
+
+/*! \brief The header of a mapped file.
+ */
+PURE_FUNC static inline const TieFileHeader *tiefile_header(
+        const TieFile *file)
+{
+        return (const TieFileHeader *)file->base;
+}
+
+/*! \brief The linear histories of a mapped file, indexed by their number.
+ */
+PURE_FUNC static inline const LinearHistory *tiefile_tree(const TieFile *file)
+{
+        return location_resolve(file->base, tiefile_header(file)->history.tree);
+}
+
+/*! \brief The entries of a linear history of a mapped file.
+ */
+PURE_FUNC static inline const HistoryEntry *tiefile_entries(
+        const TieFile *file,
+        const LinearHistory *linear)
+{
+        return location_resolve(file->base, linear->entries);
+}
+
+/*! \brief The object store of a mapped file.
+ */
+PURE_FUNC static inline const StoredObjects *tiefile_objects(
+        const TieFile *file)
+{
+        return &tiefile_header(file)->objects;
+}
+
+#endif
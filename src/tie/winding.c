@@ -0,0 +1,391 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "array.h"
+#include "attrib.h"
+#include "functional.h"
+#include "math.h"
+#include "winding.h"
+
+// Queries per batch of polygon_contains().
+#define WINDING_CHUNK 64
+
+// Twice the signed area of the triangle a, b, q; positive if q lies left of
+// the line from a to b. Every routine goes through this, so that they all
+// agree on points close to the boundary.
+PURE_FUNC static inline double winding_side(const vec2d *restrict a,
+                                            const vec2d *restrict b,
+                                            const vec2d *restrict q)
+{
+        return (vec_x(*b) - vec_x(*a)) * (vec_y(*q) - vec_y(*a))
+             - (vec_y(*b) - vec_y(*a)) * (vec_x(*q) - vec_x(*a));
+}
+
+PURE_FUNC int32_t winding_number(size_t n,
+                                 const vec2d polygon[static restrict n],
+                                 const vec2d *restrict q)
+{
+        const vec2d *a = &polygon[n - 1], *b;
+        int32_t winding = 0;
+
+        traverse(b, polygon, polygon + n) {
+                if (vec_y(*a) <= vec_y(*q)) {
+                        if (vec_y(*b) > vec_y(*q)
+                            && winding_side(a, b, q) > 0) {
+                                ++winding;
+                        }
+                } else if (vec_y(*b) <= vec_y(*q)
+                           && winding_side(a, b, q) < 0) {
+                        --winding;
+                }
+                a = b;
+        }
+
+        return winding;
+}
+
+void winding_numbers(size_t n,
+                     const vec2d polygon[static restrict n],
+                     size_t m,
+                     const vec2d queries[static restrict m],
+                     int32_t out[static restrict m])
+{
+        const vec2d *q = queries, *end = queries + m;
+
+#if defined(__SSE2__)
+        // Two queries per iteration, with their X and Y coordinates in one
+        // vector each. The comparisons yield all ones, i.e. -1 as an
+        // integer, in the lanes where an edge crosses to the right of the
+        // query, so the winding numbers are accumulated by subtracting the
+        // masks of upward crossings and adding those of downward ones.
+        const __m128d zero = _mm_setzero_pd();
+        const vec2d *a, *b;
+        __m128d qx, qy, ax, ay, bx, by, side, up, down;
+        __m128i winding;
+        int64_t lanes[2];
+
+        for (; q + 1 < end; q += 2, out += 2) {
+                qx = _mm_unpacklo_pd(_mm_load_pd(q[0].v), _mm_load_pd(q[1].v));
+                qy = _mm_unpackhi_pd(_mm_load_pd(q[0].v), _mm_load_pd(q[1].v));
+                winding = _mm_setzero_si128();
+                a = &polygon[n - 1];
+                traverse(b, polygon, polygon + n) {
+                        ax = _mm_set1_pd(vec_x(*a));
+                        ay = _mm_set1_pd(vec_y(*a));
+                        bx = _mm_set1_pd(vec_x(*b));
+                        by = _mm_set1_pd(vec_y(*b));
+                        side = _mm_sub_pd(
+                                _mm_mul_pd(_mm_sub_pd(bx, ax),
+                                           _mm_sub_pd(qy, ay)),
+                                _mm_mul_pd(_mm_sub_pd(by, ay),
+                                           _mm_sub_pd(qx, ax)));
+                        up = _mm_and_pd(_mm_and_pd(_mm_cmple_pd(ay, qy),
+                                                   _mm_cmpgt_pd(by, qy)),
+                                        _mm_cmpgt_pd(side, zero));
+                        down = _mm_and_pd(_mm_and_pd(_mm_cmpgt_pd(ay, qy),
+                                                     _mm_cmple_pd(by, qy)),
+                                          _mm_cmplt_pd(side, zero));
+                        winding = _mm_sub_epi64(winding, _mm_castpd_si128(up));
+                        winding = _mm_add_epi64(winding,
+                                                _mm_castpd_si128(down));
+                        a = b;
+                }
+                _mm_storeu_si128((__m128i *)lanes, winding);
+                out[0] = (int32_t)lanes[0];
+                out[1] = (int32_t)lanes[1];
+        }
+#endif
+
+        for (; q < end; ++q, ++out) {
+                *out = winding_number(n, polygon, q);
+        }
+}
+
+void polygon_contains(size_t n,
+                      const vec2d polygon[static restrict n],
+                      size_t m,
+                      const vec2d queries[static restrict m],
+                      FillRule rule,
+                      bool out[static restrict m])
+{
+        int32_t windings[WINDING_CHUNK];
+        size_t i, j, k;
+
+        for (i = 0; i < m; i += k) {
+                k = min(m - i, (size_t)WINDING_CHUNK);
+                winding_numbers(n, polygon, k, queries + i, windings);
+                for (j = 0; j < k; ++j) {
+                        out[i + j] = fill_rule_inside(rule, windings[j]);
+                }
+        }
+}
+
+void winding_index_init(WindingIndex *restrict index)
+{
+        index->slab_count = 0;
+        index->edges_sz = 0;
+        index->edges = NULL;
+        index->slabs_sz = 0;
+        index->slabs = NULL;
+        index->entries_sz = 0;
+        index->entries = NULL;
+}
+
+static int winding_compare_slabs(const void *a, const void *b)
+{
+        const WindingSlab *p = a, *q = b;
+
+        return compare(p->y, q->y);
+}
+
+static int winding_compare_entries(const void *a, const void *b)
+{
+        const WindingEntry *p = a, *q = b;
+
+        return compare(p->x, q->x);
+}
+
+// Finds the last of the n slab boundaries at or below y, which must not lie
+// below the first one.
+PURE_FUNC static size_t winding_locate(size_t n,
+                                       const WindingSlab slabs[static n],
+                                       double y)
+{
+        size_t lo = 0, hi = n, mid;
+
+        while (hi - lo > 1) {
+                mid = lo + (hi - lo) / 2;
+                if (slabs[mid].y <= y) {
+                        lo = mid;
+                } else {
+                        hi = mid;
+                }
+        }
+
+        return lo;
+}
+
+// Finds the slabs [*first, *last) an edge spans.
+static void winding_edge_slabs(size_t n,
+                               const WindingSlab slabs[static n],
+                               const WindingEdge *restrict edge,
+                               size_t *restrict first,
+                               size_t *restrict last)
+{
+        *first = winding_locate(n, slabs, fmin(vec_y(edge->a), vec_y(edge->b)));
+        *last = winding_locate(n, slabs, fmax(vec_y(edge->a), vec_y(edge->b)));
+}
+
+PURE_FUNC static inline double winding_edge_x(const WindingEdge *restrict edge,
+                                              double y)
+{
+        return vec_x(edge->a)
+             + (y - vec_y(edge->a)) * (vec_x(edge->b) - vec_x(edge->a))
+                       / (vec_y(edge->b) - vec_y(edge->a));
+}
+
+// Orders the entries of a slab from left to right and sums up their
+// directions.
+static void winding_sort_slab(const WindingEdge *restrict edges,
+                              WindingSlab *restrict slab,
+                              WindingEntry *restrict entries)
+{
+        const double bottom = slab[0].y, top = slab[1].y;
+        WindingEntry *begin = entries + slab[0].first;
+        WindingEntry *end = entries + slab[1].first, *p;
+        int32_t sum = 0;
+
+        traverse(p, begin, end) {
+                p->x = winding_edge_x(&edges[p->edge], (bottom + top) / 2);
+        }
+        qsort(begin, end - begin, sizeof(*begin), winding_compare_entries);
+
+        // edges are straight, so if they're ordered at both ends of the slab
+        // they're ordered throughout
+        slab->ordered = true;
+        traverse(p, begin + 1, end) {
+                if (winding_edge_x(&edges[p[-1].edge], bottom)
+                            > winding_edge_x(&edges[p->edge], bottom)
+                    || winding_edge_x(&edges[p[-1].edge], top)
+                               > winding_edge_x(&edges[p->edge], top)) {
+                        slab->ordered = false;
+                        break;
+                }
+        }
+
+        for (p = end; p != begin;) {
+                --p;
+                sum += edges[p->edge].dir;
+                p->sum = sum;
+        }
+}
+
+int winding_index_build(WindingIndex *restrict index,
+                        size_t n,
+                        const vec2d polygon[static restrict n],
+                        Reallocator *reallocator,
+                        void *user)
+{
+        size_t edges_sz = index->edges_sz, slabs_sz = index->slabs_sz;
+        size_t entries_sz = index->entries_sz;
+        WindingEdge *edges = index->edges, *e;
+        WindingSlab *slabs = index->slabs;
+        WindingEntry *entries = index->entries;
+        size_t edge_count = 0, bounds = 1, total = 0, first, last, i, s;
+        const vec2d *a, *b;
+
+        assert(n > 0);
+
+        index->slab_count = 0;
+        if ((n > edges_sz
+             && !auxiliary_realloc(reallocator,
+                                   &edges_sz,
+                                   &edges,
+                                   &index->edges_sz,
+                                   &index->edges,
+                                   n,
+                                   user))
+            || (n > slabs_sz
+                && !auxiliary_realloc(reallocator,
+                                      &slabs_sz,
+                                      &slabs,
+                                      &index->slabs_sz,
+                                      &index->slabs,
+                                      n,
+                                      user))) {
+                return -1;
+        }
+
+        // horizontal edges never cross a horizontal ray, so they're dropped
+        a = &polygon[n - 1];
+        for (i = 0; i < n; ++i) {
+                b = &polygon[i];
+                if (vec_y(*a) != vec_y(*b)) {
+                        edges[edge_count].a = *a;
+                        edges[edge_count].b = *b;
+                        edges[edge_count].dir = vec_y(*b) > vec_y(*a) ? 1 : -1;
+                        ++edge_count;
+                }
+                slabs[i].y = vec_y(*b);
+                a = b;
+        }
+
+        // slab boundaries at every distinct vertex height
+        qsort(slabs, n, sizeof(*slabs), winding_compare_slabs);
+        for (i = 1; i < n; ++i) {
+                if (slabs[i].y != slabs[bounds - 1].y) {
+                        slabs[bounds++].y = slabs[i].y;
+                }
+        }
+        if (bounds < 2) {
+                return 0;
+        }
+
+        for (s = 0; s < bounds; ++s) {
+                slabs[s].first = 0;
+        }
+        traverse(e, edges, edges + edge_count) {
+                winding_edge_slabs(bounds, slabs, e, &first, &last);
+                for (s = first; s < last; ++s) {
+                        ++slabs[s].first;
+                }
+                total += last - first;
+        }
+        assert(total <= UINT32_MAX);
+        if (total > entries_sz
+            && !auxiliary_realloc(reallocator,
+                                  &entries_sz,
+                                  &entries,
+                                  &index->entries_sz,
+                                  &index->entries,
+                                  total,
+                                  user)) {
+                return -1;
+        }
+
+        // Turn the counts into the offsets one past the end of each slab and
+        // fill the slabs from the back, which leaves the offsets at their
+        // start. The topmost boundary is left at the total.
+        for (s = 0, total = 0; s < bounds; ++s) {
+                total += slabs[s].first;
+                slabs[s].first = total;
+        }
+        traverse(e, edges, edges + edge_count) {
+                winding_edge_slabs(bounds, slabs, e, &first, &last);
+                for (s = first; s < last; ++s) {
+                        entries[--slabs[s].first].edge = e - edges;
+                }
+        }
+        for (s = 0; s + 1 < bounds; ++s) {
+                winding_sort_slab(edges, &slabs[s], entries);
+        }
+
+        index->slab_count = bounds - 1;
+
+        return 0;
+}
+
+PURE_FUNC int32_t winding_index_query(const WindingIndex *restrict index,
+                                      const vec2d *restrict q)
+{
+        const WindingEdge *edges = index->edges, *e;
+        const WindingSlab *slabs = index->slabs, *slab;
+        const WindingEntry *begin, *end, *p;
+        size_t lo, hi, mid;
+        int32_t winding = 0;
+
+        if (!index->slab_count || vec_y(*q) < slabs[0].y
+            || vec_y(*q) >= slabs[index->slab_count].y) {
+                return 0;
+        }
+
+        // every edge of the slab spans all of it, so only the side of the
+        // query matters
+        slab = &slabs[winding_locate(index->slab_count, slabs, vec_y(*q))];
+        begin = index->entries + slab[0].first;
+        end = index->entries + slab[1].first;
+
+        if (!slab->ordered) {
+                traverse(p, begin, end) {
+                        e = &edges[p->edge];
+                        if (winding_side(&e->a, &e->b, q) * e->dir > 0) {
+                                winding += e->dir;
+                        }
+                }
+                return winding;
+        }
+
+        // the first edge the query lies left of
+        lo = 0;
+        hi = end - begin;
+        while (lo < hi) {
+                mid = lo + (hi - lo) / 2;
+                e = &edges[begin[mid].edge];
+                if (winding_side(&e->a, &e->b, q) * e->dir > 0) {
+                        hi = mid;
+                } else {
+                        lo = mid + 1;
+                }
+        }
+
+        return lo < (size_t)(end - begin) ? begin[lo].sum : 0;
+}
+
+void winding_index_contains(const WindingIndex *restrict index,
+                            size_t m,
+                            const vec2d queries[static restrict m],
+                            FillRule rule,
+                            bool out[static restrict m])
+{
+        size_t i;
+
+        for (i = 0; i < m; ++i) {
+                out[i] = fill_rule_inside(rule,
+                                          winding_index_query(index,
+                                                              &queries[i]));
+        }
+}
@@ -0,0 +1,194 @@
+/*! \file winding.h
+ *  \brief Winding numbers and point-in-polygon tests
+ *
+ *  The winding number of a point with respect to a closed polygon counts how
+ *  many times the polygon winds around it, counter-clockwise turns counting
+ *  positively. Fill rules derive insideness from it: the nonzero rule fills
+ *  every point the polygon winds around at all, the even-odd rule only the
+ *  points it winds around an odd number of times.
+ *
+ *  Region selection and lasso selection test many points against the same
+ *  polygon, so the routines here work on batches of queries. The direct
+ *  routines test every query against every edge, two queries at a time with
+ *  SSE2 when available. For larger polygons, a winding index splits the
+ *  plane into horizontal slabs at the vertices of the polygon. Within a slab
+ *  no edge begins or ends, so the edges of a simple polygon keep their order
+ *  from left to right and a query only needs a binary search for its slab
+ *  and one for its position among the slab's edges.
+ *
+ *  Edges include their lower endpoint but not their upper one, so that
+ *  every vertex is counted once. Points on the boundary of the polygon may
+ *  be reported either way.
+ */
+#ifndef TIE_WINDING_H
+#define TIE_WINDING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "algo.h"
+#include "attrib.h"
+#include "math.h"
+
+typedef enum {
+        FILL_NONZERO,
+        FILL_EVENODD
+} FillRule;
+
+/*! \brief A non-horizontal edge of the polygon, in the polygon's direction.
+ */
+typedef struct {
+        vec2d a;
+        vec2d b;
+        int32_t dir; // 1 if it runs upwards, -1 otherwise
+} WindingEdge;
+
+typedef struct {
+        double y; // bottom of the slab
+        uint32_t first; // first entry of the slab
+        bool ordered; // whether its edges don't cross within the slab
+} WindingSlab;
+
+/*! \brief An edge crossing a slab.
+ */
+typedef struct {
+        double x; // x coordinate of the edge halfway up the slab
+        uint32_t edge;
+        int32_t sum; // sum of dir of this and all later entries of the slab
+} WindingEntry;
+
+/*! \brief Slab decomposition of a polygon, see winding_index_build().
+ *
+ *  Slab `i` spans from `slabs[i].y` up to `slabs[i + 1].y` and its edges
+ *  are `entries[slabs[i].first]` through
+ *  `entries[slabs[i + 1].first - 1]`, from left to right.
+ */
+typedef struct {
+        size_t slab_count;
+        size_t edges_sz;
+        WindingEdge *edges;
+        size_t slabs_sz;
+        WindingSlab *slabs;
+        size_t entries_sz;
+        WindingEntry *entries;
+} WindingIndex;
+
+/*! \brief Decides whether a winding number is inside under a fill rule.
+ */
+PURE_FUNC static inline bool fill_rule_inside(FillRule rule, int32_t winding)
+{
+        return rule == FILL_NONZERO ? winding != 0 : (winding & 1) != 0;
+}
+
+/*! \brief Computes the winding number of a polygon around a point.
+ *
+ *  Runs in \f$O(n)\f$.
+ *
+ *  \param[in] n The amount of vertices. Must be positive.
+ *  \param[in] polygon The vertices of the polygon. The last vertex is
+ *  implicitly connected to the first.
+ *  \param[in] q The point.
+ *
+ *  \return The winding number.
+ */
+extern PURE_FUNC int32_t winding_number(size_t n,
+                                        const vec2d polygon[static restrict n],
+                                        const vec2d *restrict q);
+
+/*! \brief Computes the winding numbers of a polygon around many points.
+ *
+ *  Same as calling winding_number() for every point, but vectorized across
+ *  the points. Runs in \f$O(nm)\f$.
+ *
+ *  \param[in] n The amount of vertices. Must be positive.
+ *  \param[in] polygon The vertices of the polygon.
+ *  \param[in] m The amount of points.
+ *  \param[in] queries The points.
+ *  \param[out] out The winding numbers.
+ */
+extern void winding_numbers(size_t n,
+                            const vec2d polygon[static restrict n],
+                            size_t m,
+                            const vec2d queries[static restrict m],
+                            int32_t out[static restrict m]);
+
+/*! \brief Tests many points for being inside a polygon.
+ *
+ *  \param[in] n The amount of vertices. Must be positive.
+ *  \param[in] polygon The vertices of the polygon.
+ *  \param[in] m The amount of points.
+ *  \param[in] queries The points.
+ *  \param[in] rule The fill rule.
+ *  \param[out] out Whether each point is inside.
+ *
+ *  \sa winding_numbers()
+ */
+extern void polygon_contains(size_t n,
+                             const vec2d polygon[static restrict n],
+                             size_t m,
+                             const vec2d queries[static restrict m],
+                             FillRule rule,
+                             bool out[static restrict m]);
+
+/*! \brief Initializes an empty index without any memory.
+ *
+ *  An empty index has a winding number of zero everywhere.
+ *
+ *  \param[out] index The index.
+ */
+extern void winding_index_init(WindingIndex *restrict index);
+
+/*! \brief Builds the slab decomposition of a polygon.
+ *
+ *  Slabs whose edges cross each other, which only happens in
+ *  self-intersecting polygons, are marked as unordered and are searched
+ *  linearly instead. Runs in \f$O(n \log n + k \log k)\f$, where \f$k\f$ is
+ *  the total amount of slab entries. \f$k\f$ is linear in \f$n\f$ for
+ *  typical shapes, but may be quadratic in the worst case, e.g. for a comb.
+ *
+ *  \param[in,out] index The index. Its previous contents are dropped.
+ *  \param[in] n The amount of vertices. Must be positive.
+ *  \param[in] polygon The vertices of the polygon. Not referenced after the
+ *  call.
+ *  \param[in] reallocator Reallocator for the arrays of the index. May be
+ *  NULL, in which case the function fails when they become full.
+ *  \param[in,out] user Private data to pass to the reallocator.
+ *
+ *  \return 0 on success, -1 on allocation failure, in which case the index
+ *  is left empty.
+ */
+extern int winding_index_build(WindingIndex *restrict index,
+                               size_t n,
+                               const vec2d polygon[static restrict n],
+                               Reallocator *reallocator,
+                               void *user);
+
+/*! \brief Computes the winding number of an indexed polygon around a point.
+ *
+ *  Runs in \f$O(\log n)\f$ in ordered slabs.
+ *
+ *  \param[in] index The index of the polygon.
+ *  \param[in] q The point.
+ *
+ *  \return The same as winding_number() for the polygon.
+ */
+extern PURE_FUNC int32_t winding_index_query(const WindingIndex *restrict index,
+                                             const vec2d *restrict q);
+
+/*! \brief Tests many points for being inside an indexed polygon.
+ *
+ *  \param[in] index The index of the polygon.
+ *  \param[in] m The amount of points.
+ *  \param[in] queries The points.
+ *  \param[in] rule The fill rule.
+ *  \param[out] out Whether each point is inside.
+ *
+ *  \sa winding_index_query()
+ */
+extern void winding_index_contains(const WindingIndex *restrict index,
+                                   size_t m,
+                                   const vec2d queries[static restrict m],
+                                   FillRule rule,
+                                   bool out[static restrict m]);
+
+#endif
@@ -0,0 +1,171 @@
+#include "base_array.h"
+#include "memalloc.h"
+#include "numeric.h"
+#include "workpool.h"
+
+// Runs chunks of the current run until there are none left.
+static void worker_pool_work(WorkerPool *restrict pool, Worker *restrict w)
+{
+        uint64_t begin, end;
+
+        for (;;) {
+                begin = atomic_fetch_add_explicit(&pool->next,
+                                                  WORKER_POOL_CHUNK,
+                                                  memory_order_relaxed);
+                if (begin >= pool->n) {
+                        break;
+                }
+                end = min(begin + WORKER_POOL_CHUNK, pool->n);
+                for (; begin < end; ++begin) {
+                        pool->func(begin, &w->scratch, pool->user);
+                }
+        }
+}
+
+static int worker_main(void *arg)
+{
+        Worker *w = arg;
+        WorkerPool *pool = w->pool;
+        uint64_t run = 0;
+
+        mtx_lock(&pool->lock);
+        for (;;) {
+                while (pool->run == run && !pool->quit) {
+                        cnd_wait(&pool->start, &pool->lock);
+                }
+                if (pool->quit) {
+                        break;
+                }
+                run = pool->run;
+                mtx_unlock(&pool->lock);
+
+                worker_pool_work(pool, w);
+
+                mtx_lock(&pool->lock);
+                if (--pool->running == 0) {
+                        cnd_signal(&pool->done);
+                }
+        }
+        mtx_unlock(&pool->lock);
+
+        return 0;
+}
+
+// Stops and joins the first `started` workers, and frees the pool.
+static void worker_pool_stop(WorkerPool *restrict pool, uint32_t started)
+{
+        Worker *w;
+
+        mtx_lock(&pool->lock);
+        pool->quit = true;
+        cnd_broadcast(&pool->start);
+        mtx_unlock(&pool->lock);
+
+        for (w = pool->workers + 1; w < pool->workers + started; ++w) {
+                thrd_join(w->thread, NULL);
+        }
+        for (w = pool->workers; w < pool->workers + pool->thread_count; ++w) {
+                tie_free(w->scratch.base);
+        }
+        tie_free(pool->workers);
+        cnd_destroy(&pool->done);
+        cnd_destroy(&pool->start);
+        mtx_destroy(&pool->lock);
+}
+
+int worker_pool_init(WorkerPool *restrict pool,
+                     uint32_t thread_count,
+                     size_t scratch_size)
+{
+        Worker *w;
+        uint32_t started;
+
+        assert(thread_count > 0);
+
+        pool->thread_count = thread_count;
+        pool->run = 0;
+        pool->running = 0;
+        pool->quit = false;
+        pool->n = 0;
+        atomic_init(&pool->next, 0);
+        pool->workers = tie_calloc(thread_count, sizeof(*pool->workers));
+        if (!pool->workers) {
+                return -1;
+        }
+        if (mtx_init(&pool->lock, mtx_plain) != thrd_success) {
+                tie_free(pool->workers);
+                return -1;
+        }
+        if (cnd_init(&pool->start) != thrd_success) {
+                mtx_destroy(&pool->lock);
+                tie_free(pool->workers);
+                return -1;
+        }
+        if (cnd_init(&pool->done) != thrd_success) {
+                cnd_destroy(&pool->start);
+                mtx_destroy(&pool->lock);
+                tie_free(pool->workers);
+                return -1;
+        }
+
+        for (w = pool->workers; w < pool->workers + thread_count; ++w) {
+                w->pool = pool;
+                w->scratch.size = scratch_size;
+                if (scratch_size > 0) {
+                        w->scratch.base = tie_malloc(scratch_size, 1);
+                        if (!w->scratch.base) {
+                                worker_pool_stop(pool, 1);
+                                return -1;
+                        }
+                }
+        }
+        for (started = 1; started < thread_count; ++started) {
+                w = &pool->workers[started];
+                if (thrd_create(&w->thread, worker_main, w) != thrd_success) {
+                        worker_pool_stop(pool, started);
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+void worker_pool_destroy(WorkerPool *restrict pool)
+{
+        worker_pool_stop(pool, pool->thread_count);
+}
+
+void worker_pool_run(WorkerPool *restrict pool,
+                     uint32_t n,
+                     WorkerPoolFunc *func,
+                     void *user)
+{
+        Worker *w;
+
+        traverse(w, pool->workers, pool->workers + pool->thread_count) {
+                w->scratch.used = 0;
+        }
+        pool->func = func;
+        pool->user = user;
+        pool->n = n;
+        atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+
+        if (n <= WORKER_POOL_CHUNK || pool->thread_count == 1) {
+                worker_pool_work(pool, pool->workers);
+                return;
+        }
+
+        mtx_lock(&pool->lock);
+        pool->running = pool->thread_count - 1;
+        ++pool->run;
+        cnd_broadcast(&pool->start);
+        mtx_unlock(&pool->lock);
+
+        worker_pool_work(pool, pool->workers);
+
+        mtx_lock(&pool->lock);
+        while (pool->running > 0) {
+                cnd_wait(&pool->done, &pool->lock);
+        }
+        mtx_unlock(&pool->lock);
+}
@@ -0,0 +1,116 @@
+/*! \file workpool.h
+ *  \brief Pool of worker threads with scratch arenas
+ *
+ *  Runs a function over a range of indices on several threads: the calling
+ *  thread and the workers of the pool, which sleep between runs. Threads
+ *  take the indices in chunks of #WORKER_POOL_CHUNK, so uneven work evens
+ *  out, and ranges no larger than a chunk run on the calling thread alone.
+ *
+ *  Every thread has a scratch arena of a fixed size for the results of its
+ *  work, which stay valid until the next run, so that functions running
+ *  in parallel don't need to allocate or to synchronize with each other.
+ */
+#ifndef TIE_WORKPOOL_H
+#define TIE_WORKPOOL_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+#define WORKER_POOL_CHUNK 16
+
+typedef struct {
+        size_t size;
+        size_t used;
+        unsigned char *base;
+} ScratchArena;
+
+/*! \brief Function typedef for the work done for an index.
+ *
+ *  \param[in] index The index, in the range of the run.
+ *  \param[in,out] scratch The arena of the thread doing the work.
+ *  \param[in,out] user Private data passed to worker_pool_run().
+ */
+typedef void WorkerPoolFunc(uint32_t index,
+                            ScratchArena *restrict scratch,
+                            void *user);
+
+typedef struct WorkerPool_ WorkerPool;
+
+typedef struct {
+        WorkerPool *pool;
+        thrd_t thread;
+        ScratchArena scratch;
+} Worker;
+
+struct WorkerPool_ {
+        uint32_t thread_count; // including the calling thread
+        Worker *workers; // the first one is the calling thread
+        mtx_t lock;
+        cnd_t start;
+        cnd_t done;
+        uint64_t run; // incremented by every run
+        uint32_t running; // workers that didn't finish the run yet
+        bool quit;
+        // The current run.
+        WorkerPoolFunc *func;
+        void *user;
+        uint32_t n;
+        atomic_uint_fast64_t next; // the first index nobody took yet
+};
+
+/*! \brief Starts a pool.
+ *
+ *  \param[out] pool The pool, to be destroyed with worker_pool_destroy().
+ *  Its workers refer to it, so it must not be moved.
+ *  \param[in] thread_count The amount of threads to run on, including the
+ *  calling thread, at least 1.
+ *  \param[in] scratch_size The size in bytes of the arena of every thread.
+ *
+ *  \return 0 on success, -1 if memory or threads couldn't be obtained.
+ */
+extern int worker_pool_init(WorkerPool *restrict pool,
+                            uint32_t thread_count,
+                            size_t scratch_size);
+
+/*! \brief Stops the workers of a pool and frees its memory.
+ */
+extern void worker_pool_destroy(WorkerPool *restrict pool);
+
+/*! \brief Runs a function for every index in \f$[0, n)\f$ and waits for it
+ *  to finish.
+ *
+ *  The order in which indices are run is unspecified. Empties the arenas
+ *  first. Must not be called from the function itself.
+ */
+extern void worker_pool_run(WorkerPool *restrict pool,
+                            uint32_t n,
+                            WorkerPoolFunc *func,
+                            void *user);
+
+/*! \brief Allocates memory from a scratch arena.
+ *
+ *  \param[in,out] scratch The arena.
+ *  \param[in] size The size in bytes.
+ *  \param[in] align The alignment, a power of 2 at most that of
+ *  `max_align_t`.
+ *
+ *  \return The memory, or NULL if the arena is full.
+ */
+static inline void *scratch_alloc(ScratchArena *restrict scratch,
+                                  size_t size,
+                                  size_t align)
+{
+        size_t at = (scratch->used + align - 1) & ~(align - 1);
+
+        if (at > scratch->size || size > scratch->size - at) {
+                return NULL;
+        }
+        scratch->used = at + size;
+
+        return scratch->base + at;
+}
+
+#endif